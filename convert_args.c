@@ -1,5 +1,7 @@
 #include "convert_args.h"
 
+#include <math.h>
+
 jl_value_t *
 pg_oid_to_jl_value(Oid argtype, const char *value)
 {
@@ -39,7 +41,7 @@ pg_oid_to_jl_value(Oid argtype, const char *value)
 			 * to float64 in julia
 			 */
 			;
-			jl_function_t *parse_func = jl_get_function(jl_main_module, "parse_bigfloat");
+			jl_function_t *parse_func = jl_get_function(pljulia_module, "parse_bigfloat");
 
 			result = jl_call1(parse_func, jl_cstr_to_string(value));
 			break;
@@ -118,6 +120,330 @@ pg_oid_to_jl_datatype(Oid argtype)
 	return (jl_value_t *) result;
 }
 
+/*
+ * Return the element type of the Julia vector that holds a column of the
+ * given type when it is decoded from its binary representation, or NULL if
+ * the column has to go through the text representation of its values.
+ */
+jl_datatype_t *
+pg_oid_to_jl_column_type(Oid argtype)
+{
+	switch (argtype)
+	{
+		case INT2OID:
+			return jl_int16_type;
+		case INT4OID:
+			return jl_int32_type;
+		case INT8OID:
+			return jl_int64_type;
+		case FLOAT4OID:
+			return jl_float32_type;
+		case FLOAT8OID:
+			return jl_float64_type;
+		case BOOLOID:
+			return jl_bool_type;
+		default:
+			return NULL;
+	}
+}
+
+/*
+ * Store the i-th (0-based) value of a column into the data of the vector
+ * created for it, for the types pg_oid_to_jl_column_type knows about.
+ */
+void
+pg_datum_to_jl_column(Datum value, Oid argtype, void *data, size_t i)
+{
+	switch (argtype)
+	{
+		case INT2OID:
+			((int16_t *) data)[i] = DatumGetInt16(value);
+			break;
+		case INT4OID:
+			((int32_t *) data)[i] = DatumGetInt32(value);
+			break;
+		case INT8OID:
+			((int64_t *) data)[i] = DatumGetInt64(value);
+			break;
+		case FLOAT4OID:
+			((float *) data)[i] = DatumGetFloat4(value);
+			break;
+		case FLOAT8OID:
+			((double *) data)[i] = DatumGetFloat8(value);
+			break;
+		case BOOLOID:
+			((uint8_t *) data)[i] = DatumGetBool(value);
+			break;
+		default:
+			elog(ERROR, "type %u can't be stored in a column vector", argtype);
+	}
+}
+
+/*
+ * Box a Datum of one of the types pg_oid_to_jl_column_type knows about into
+ * the same Julia type. Returns NULL for the other types, which the caller
+ * converts through their text representation.
+ */
+jl_value_t *
+pg_datum_to_jl_value(Datum value, Oid argtype)
+{
+	switch (argtype)
+	{
+		case INT2OID:
+			return jl_box_int16(DatumGetInt16(value));
+		case INT4OID:
+			return jl_box_int32(DatumGetInt32(value));
+		case INT8OID:
+			return jl_box_int64(DatumGetInt64(value));
+		case FLOAT4OID:
+			return jl_box_float32(DatumGetFloat4(value));
+		case FLOAT8OID:
+			return jl_box_float64(DatumGetFloat8(value));
+		case BOOLOID:
+			return jl_box_bool(DatumGetBool(value));
+		default:
+			return NULL;
+	}
+}
+
+/*
+ * Return the type of the query parameter a Julia value is bound as. Julia
+ * values are normalized by PLJulia.bind_value before they get here. NULLs
+ * (nothing) have no type of their own and get InvalidOid, so that the query
+ * decides it. Values of other Julia types come as the text of a
+ * PLJulia.UntypedParam, of type unknown: the query decides their type too.
+ */
+Oid
+jl_value_to_pg_param_type(jl_value_t *value)
+{
+	if (jl_is_nothing(value))
+		return InvalidOid;
+	if (strcmp(jl_typeof_str(value), "UntypedParam") == 0)
+		return UNKNOWNOID;
+	if (jl_is_string(value))
+		return TEXTOID;
+	if (jl_is_bool(value))
+		return BOOLOID;
+	if (jl_is_int16(value))
+		return INT2OID;
+	if (jl_is_int32(value))
+		return INT4OID;
+	if (jl_is_int64(value))
+		return INT8OID;
+	if (jl_typeis(value, jl_float32_type))
+		return FLOAT4OID;
+	if (jl_typeis(value, jl_float64_type))
+		return FLOAT8OID;
+	if (strcmp(jl_typeof_str(value), "BigFloat") == 0)
+		return NUMERICOID;
+	elog(ERROR, "cannot bind a Julia value of type %s as a query parameter",
+		 jl_typeof_str(value));
+	return InvalidOid;			/* keep compiler quiet */
+}
+
+/*
+ * Convert a non-NULL Julia value to a query parameter of the type returned
+ * by jl_value_to_pg_param_type. An unknown parameter is a C string, converted
+ * once the type of the parameter is known.
+ */
+Datum
+jl_value_to_pg_param(jl_value_t *value, Oid paramtype)
+{
+	switch (paramtype)
+	{
+		case BOOLOID:
+			return BoolGetDatum(jl_unbox_bool(value));
+		case INT2OID:
+			return Int16GetDatum(jl_unbox_int16(value));
+		case INT4OID:
+			return Int32GetDatum(jl_unbox_int32(value));
+		case INT8OID:
+			return Int64GetDatum(jl_unbox_int64(value));
+		case FLOAT4OID:
+			return Float4GetDatum(jl_unbox_float32(value));
+		case FLOAT8OID:
+			return Float8GetDatum(jl_unbox_float64(value));
+		case TEXTOID:
+			return PointerGetDatum(cstring_to_text_with_len(jl_string_ptr(value),
+															jl_string_len(value)));
+		case UNKNOWNOID:
+			{
+				jl_value_t *str = jl_get_nth_field(value, 0);
+
+				return CStringGetDatum(pnstrdup(jl_string_ptr(str),
+												jl_string_len(str)));
+			}
+		case NUMERICOID:
+			{
+				jl_value_t *str;
+
+				str = jl_call1(jl_get_function(jl_base_module, "string"), value);
+				return DirectFunctionCall3(numeric_in,
+										   CStringGetDatum(jl_string_ptr(str)),
+										   ObjectIdGetDatum(InvalidOid),
+										   Int32GetDatum(-1));
+			}
+		default:
+			elog(ERROR, "cannot bind a Julia value as type %u", paramtype);
+	}
+	return (Datum) 0;			/* keep compiler quiet */
+}
+
+/*
+ * Choose the conversion of the Julia values bound to a parameter of the
+ * given type.
+ */
+pljulia_param_conv
+pg_oid_to_param_conv(Oid paramtype)
+{
+	switch (paramtype)
+	{
+		case BOOLOID:
+			return PARAM_CONV_BOOL;
+		case INT2OID:
+			return PARAM_CONV_INT2;
+		case INT4OID:
+			return PARAM_CONV_INT4;
+		case INT8OID:
+			return PARAM_CONV_INT8;
+		case FLOAT4OID:
+			return PARAM_CONV_FLOAT4;
+		case FLOAT8OID:
+			return PARAM_CONV_FLOAT8;
+		case NUMERICOID:
+			return PARAM_CONV_NUMERIC;
+		case TEXTOID:
+		case VARCHAROID:
+			return PARAM_CONV_TEXT;
+		default:
+			return PARAM_CONV_GENERIC;
+	}
+}
+
+/*
+ * Get the value of a Julia integer of any of the usual widths
+ */
+static bool
+jl_unbox_any_int(jl_value_t *value, int64 *result)
+{
+	if (jl_is_int64(value))
+		*result = jl_unbox_int64(value);
+	else if (jl_is_int32(value))
+		*result = jl_unbox_int32(value);
+	else if (jl_is_int16(value))
+		*result = jl_unbox_int16(value);
+	else if (jl_is_int8(value))
+		*result = jl_unbox_int8(value);
+	else if (jl_is_uint8(value))
+		*result = jl_unbox_uint8(value);
+	else if (jl_is_uint16(value))
+		*result = jl_unbox_uint16(value);
+	else if (jl_is_uint32(value))
+		*result = jl_unbox_uint32(value);
+	else
+		return false;
+	return true;
+}
+
+/*
+ * Get the value of a Julia Float64, Float32 or integer as a double
+ */
+static bool
+jl_unbox_any_float(jl_value_t *value, double *result)
+{
+	int64		i;
+
+	if (jl_typeis(value, jl_float64_type))
+		*result = jl_unbox_float64(value);
+	else if (jl_typeis(value, jl_float32_type))
+		*result = jl_unbox_float32(value);
+	else if (jl_unbox_any_int(value, &i))
+		*result = (double) i;
+	else
+		return false;
+	return true;
+}
+
+/*
+ * Convert a non-NULL Julia value to a parameter Datum without going through
+ * text. Returns false if the Julia type of the value has no direct
+ * conversion, in which case the caller should use the generic one.
+ */
+bool
+jl_value_to_param_datum(jl_value_t *value, pljulia_param_conv conv,
+						Datum *result)
+{
+	int64		i;
+	double		d;
+
+	switch (conv)
+	{
+		case PARAM_CONV_BOOL:
+			if (!jl_is_bool(value))
+				return false;
+			*result = BoolGetDatum(jl_unbox_bool(value));
+			return true;
+		case PARAM_CONV_INT2:
+			if (!jl_unbox_any_int(value, &i))
+				return false;
+			if (i < PG_INT16_MIN || i > PG_INT16_MAX)
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("smallint out of range")));
+			*result = Int16GetDatum((int16) i);
+			return true;
+		case PARAM_CONV_INT4:
+			if (!jl_unbox_any_int(value, &i))
+				return false;
+			if (i < PG_INT32_MIN || i > PG_INT32_MAX)
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("integer out of range")));
+			*result = Int32GetDatum((int32) i);
+			return true;
+		case PARAM_CONV_INT8:
+			if (!jl_unbox_any_int(value, &i))
+				return false;
+			*result = Int64GetDatum(i);
+			return true;
+		case PARAM_CONV_FLOAT4:
+			if (!jl_unbox_any_float(value, &d))
+				return false;
+			if (isinf((float4) d) && !isinf(d))
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("value out of range: overflow")));
+			*result = Float4GetDatum((float4) d);
+			return true;
+		case PARAM_CONV_FLOAT8:
+			if (!jl_unbox_any_float(value, &d))
+				return false;
+			*result = Float8GetDatum(d);
+			return true;
+		case PARAM_CONV_NUMERIC:
+			if (jl_unbox_any_int(value, &i))
+				*result = DirectFunctionCall1(int8_numeric, Int64GetDatum(i));
+			else if (jl_typeis(value, jl_float64_type) ||
+					 jl_typeis(value, jl_float32_type))
+			{
+				jl_unbox_any_float(value, &d);
+				*result = DirectFunctionCall1(float8_numeric, Float8GetDatum(d));
+			}
+			else
+				return false;
+			return true;
+		case PARAM_CONV_TEXT:
+			if (!jl_is_string(value))
+				return false;
+			*result = PointerGetDatum(cstring_to_text_with_len(jl_string_ptr(value),
+															   jl_string_len(value)));
+			return true;
+		case PARAM_CONV_GENERIC:
+			return false;
+	}
+	return false;
+}
+
 /*
  * The index_rm is the index in row-major format (C-indexing).
  * This function converts it to the equivalent col-major representation
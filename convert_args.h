@@ -4,8 +4,37 @@
 #include <utils/syscache.h>
 #include <utils/array.h>
 #include <utils/lsyscache.h>
+#include <utils/builtins.h>
+#include <utils/fmgrprotos.h>
+
+extern jl_module_t *pljulia_module;
+
+/*
+ * How the Julia values bound to a parameter of a saved plan are converted,
+ * chosen once from the parameter type when the plan is prepared
+ */
+typedef enum pljulia_param_conv
+{
+	PARAM_CONV_GENERIC,			/* through the text representation */
+	PARAM_CONV_BOOL,
+	PARAM_CONV_INT2,
+	PARAM_CONV_INT4,
+	PARAM_CONV_INT8,
+	PARAM_CONV_FLOAT4,
+	PARAM_CONV_FLOAT8,
+	PARAM_CONV_NUMERIC,
+	PARAM_CONV_TEXT
+} pljulia_param_conv;
 
 jl_value_t *pg_oid_to_jl_value(Oid argtype, const char *value);
 jl_value_t *pg_oid_to_jl_datatype(Oid argtype);
+jl_datatype_t *pg_oid_to_jl_column_type(Oid argtype);
+void		pg_datum_to_jl_column(Datum value, Oid argtype, void *data, size_t i);
+jl_value_t *pg_datum_to_jl_value(Datum value, Oid argtype);
+Oid			jl_value_to_pg_param_type(jl_value_t *value);
+Datum		jl_value_to_pg_param(jl_value_t *value, Oid paramtype);
+pljulia_param_conv pg_oid_to_param_conv(Oid paramtype);
+bool		jl_value_to_param_datum(jl_value_t *value, pljulia_param_conv conv,
+									Datum *result);
 int			calculate_cm_offset(int, int, int *);
 int			calculate_rm_offset(int, int, int *);
@@ -0,0 +1,100 @@
+CREATE FUNCTION pljulia_call_handler()
+RETURNS language_handler
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+CREATE FUNCTION pljulia_validator(oid) RETURNS void
+STRICT LANGUAGE c AS 'MODULE_PATHNAME';
+
+CREATE FUNCTION pljulia_inline_handler(internal)
+RETURNS void
+AS 'MODULE_PATHNAME'
+STRICT LANGUAGE C;
+
+CREATE LANGUAGE pljulia
+HANDLER pljulia_call_handler
+INLINE pljulia_inline_handler
+VALIDATOR pljulia_validator;
+
+COMMENT ON LANGUAGE pljulia IS 'PL/Julia procedural language';
+
+-- Introspection of the caches of the current session
+CREATE FUNCTION pljulia_cache_info(OUT func regprocedure,
+                                   OUT memory_bytes bigint,
+                                   OUT calls bigint,
+                                   OUT last_used timestamptz,
+                                   OUT memo_entries bigint,
+                                   OUT memo_hits bigint,
+                                   OUT memo_misses bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION pljulia_plan_cache_info(OUT plan text,
+                                        OUT query text,
+                                        OUT nargs integer,
+                                        OUT memory_bytes bigint,
+                                        OUT calls bigint,
+                                        OUT last_used timestamptz,
+                                        OUT refs integer)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION pljulia_cache_evict(regprocedure)
+RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION pljulia_heap_size()
+RETURNS bigint
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+-- Foreign tables whose rows are produced by pljulia functions
+CREATE FUNCTION pljulia_fdw_handler()
+RETURNS fdw_handler
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION pljulia_fdw_validator(text[], oid)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FOREIGN DATA WRAPPER pljulia_fdw
+HANDLER pljulia_fdw_handler
+VALIDATOR pljulia_fdw_validator;
+
+-- Rows of Arrow IPC files of the server, as a given row type. Like
+-- pg_read_file, this reads any file the server can, so only superusers may
+-- call it unless granted.
+CREATE FUNCTION pljulia_read_arrow(path text, rowtype anyelement)
+RETURNS SETOF anyelement
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE EXECUTE ON FUNCTION pljulia_read_arrow(text, anyelement) FROM PUBLIC;
+
+-- Arrays shared by all backends through files of the data directory, see
+-- shared_array
+CREATE FUNCTION pljulia_publish_array(name text, data anyarray)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION pljulia_unpublish_array(name text)
+RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+REVOKE EXECUTE ON FUNCTION pljulia_publish_array(text, anyarray) FROM PUBLIC;
+REVOKE EXECUTE ON FUNCTION pljulia_unpublish_array(text) FROM PUBLIC;
+
+-- The values shared by all sessions in SD
+CREATE FUNCTION pljulia_shared_data_info(OUT entries bigint,
+                                         OUT size_bytes bigint,
+                                         OUT max_size_bytes bigint)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
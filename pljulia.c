@@ -25,13 +25,86 @@
 #include <executor/spi.h>
 #include <commands/trigger.h>
 #include "mb/pg_wchar.h"
+#include <common/int.h>
+#include <datatype/timestamp.h>
+#include <utils/date.h>
 #include <commands/event_trigger.h>
 #include <utils/guc.h>
+#include <utils/inval.h>
+#include <common/hashfn.h>
+#include <lib/ilist.h>
+#include <access/xact.h>
+#include <executor/spi_priv.h>
+#include <utils/plancache.h>
+#include <utils/timestamp.h>
+#include <utils/datum.h>
+#include <utils/rls.h>
+#include <utils/varlena.h>
+#include <access/table.h>
+#include <catalog/namespace.h>
+#include <commands/copy.h>
+#include <executor/executor.h>
+#include <nodes/makefuncs.h>
+#include <parser/parse_relation.h>
+#include <access/tupconvert.h>
+#include <port/pg_bswap.h>
+#include <tcop/pquery.h>
+#include <tcop/dest.h>
+#include <catalog/pg_collation.h>
+#include <utils/acl.h>
+#include <utils/resowner.h>
+#include <utils/snapmgr.h>
+#include <access/tableam.h>
+#include <access/genam.h>
+#include <access/nbtree.h>
+#include <access/skey.h>
+#include <catalog/index.h>
+#include <catalog/pg_am.h>
+#include <executor/tuptable.h>
+#include <access/reloptions.h>
+#include <catalog/pg_foreign_server.h>
+#include <catalog/pg_foreign_table.h>
+#include <commands/defrem.h>
+#include <commands/explain.h>
+#include <commands/proclang.h>
+#include <foreign/fdwapi.h>
+#include <foreign/foreign.h>
+#include <nodes/nodeFuncs.h>
+#include <optimizer/cost.h>
+#include <optimizer/optimizer.h>
+#include <optimizer/pathnode.h>
+#include <optimizer/planmain.h>
+#include <optimizer/restrictinfo.h>
+#include <libpq/be-fsstubs.h>
+#include <libpq/libpq-fs.h>
+#include <parser/parse_func.h>
+#include <parser/parse_param.h>
+#include <replication/logical.h>
+#include <storage/fd.h>
+#include <storage/shmem.h>
+#include <lib/dshash.h>
+#include <utils/dsa.h>
+#if PG_VERSION_NUM >= 170000
+#include <storage/dsm_registry.h>
+#endif
+#include <replication/output_plugin.h>
+#include <utils/regproc.h>
 
 #include <sys/time.h>
 #include <julia.h>
 #include "convert_args.h"
 
+/* the standard arguments of trigger and event trigger functions */
+#define PLJULIA_TRIGGER_ARGS \
+	"TD_name, TD_relid, TD_table_name, TD_table_schema, TD_event, TD_when, " \
+	"TD_level, TD_NEW, TD_OLD, args"
+#define PLJULIA_EVENT_TRIGGER_ARGS "TD_event, TD_tag"
+
+/* string keys are the default for hash tables before PostgreSQL 14 */
+#ifndef HASH_STRINGS
+#define HASH_STRINGS 0
+#endif
+
 #define DOUBLE_LEN 316
 #define LONG_INT_LEN 20
 #define jl_is_dict(ret) (strcmp(jl_typeof_str(ret), "Dict") == 0)
@@ -66,18 +139,62 @@ typedef struct pljulia_proc_desc
 	bool	   *arg_is_rowtype; /* is the argument composite? */
 	bool		fn_retisset;	/* true if function returns set (SRF) */
 	bool		fn_retistuple;	/* true if function returns composite */
+	jl_function_t *julia_func;	/* the compiled function, kept alive by its
+								 * module in PLJulia.modules */
+	Oid			fn_oid;
+	bool		is_trigger;
+	int			use_count;		/* number of active calls, the function
+								 * is only freed once it's not in use */
+	bool		evicted;		/* removed from the cache while in use */
+	int64		calls;			/* number of calls since compiled */
+	TimestampTz last_used;
+	dlist_node	lru_node;		/* most recently used functions first */
+
+	/*
+	 * Results of previous calls of an immutable function, keyed by the hash
+	 * of their arguments. NULL unless memoization is enabled.
+	 */
+	HTAB	   *memo;
+	MemoryContext memo_cxt;
+	dlist_head	memo_lru;		/* most recently used results first */
+	int			memo_size;		/* maximum number of results kept */
+	int64		memo_hits;
+	int64		memo_misses;
+	int16	   *arg_typlen;
+	bool	   *arg_typbyval;
+	int16		result_typlen;
+	bool		result_typbyval;
 } pljulia_proc_desc;
 
+/* A memoized result of an immutable function */
+typedef struct pljulia_memo_entry
+{
+	uint64		args_hash;		/* hash key */
+	Datum	   *args;			/* copies of the arguments */
+	bool	   *argnulls;
+	Datum		result;
+	bool		isnull;
+	dlist_node	lru_node;
+} pljulia_memo_entry;
+
 /* the information we cache about prepared and saved plans */
 typedef struct pljulia_query_desc
 {
-	char		qname[24];
+	char		qname[32];
 	MemoryContext plan_cxt;		/* context holding this struct */
 	SPIPlanPtr	plan;
+	char	   *query;
 	int			nargs;
 	Oid		   *argtypes;
 	FmgrInfo   *arginfuncs;
 	Oid		   *argtypioparams;
+	pljulia_param_conv *argconvs;	/* how to convert the arguments */
+	uint64		key;			/* hash of the query and argument types */
+	int			refcount;		/* spi_prepare calls not yet freed */
+	int			use_count;		/* executions in progress */
+	int64		calls;			/* number of executions */
+	TimestampTz last_used;
+	dlist_node	lru_node;
 }			pljulia_query_desc;
 
 /* The procedure hash key */
@@ -105,6 +222,356 @@ typedef struct pljulia_query_entry
 	pljulia_query_desc *query_desc;
 }			pljulia_query_entry;
 
+/*
+ * A function called by pg_call. The key is a hash of the signature, which is
+ * kept to tell collisions apart. The signature is resolved again when the
+ * search_path it was resolved with changes.
+ */
+typedef struct pljulia_fcall_entry
+{
+	uint64		key;
+	char	   *signature;
+	FmgrInfo	flinfo;
+	Oid			collation;		/* input collation, if the function uses one */
+	int			nargs;
+	Oid		   *argtypes;
+	pljulia_param_conv *argconvs;
+	Oid			rettype;
+	FmgrInfo	retoutfunc;		/* output function of the result type */
+	OverrideSearchPath *search_path;	/* the signature was resolved in */
+} pljulia_fcall_entry;
+
+/*
+ * The index, scan keys and columns of an index_lookup call site. The key is
+ * a hash of the index name and column names (the signature), which is kept
+ * to tell collisions apart. Entries are resolved again after a relcache
+ * invalidation of their index or table, or when the search_path the index
+ * name was looked up with changes.
+ */
+typedef struct pljulia_index_entry
+{
+	uint64		key;
+	char	   *signature;
+	MemoryContext cxt;			/* holds everything below */
+	bool		valid;
+	Oid			indexoid;
+	Oid			heapoid;
+	int			nkeys;			/* key columns of the index */
+	RegProcedure *eqprocs;		/* their btree equality functions */
+	Oid		   *keytypes;		/* the types the key values are converted to */
+	Oid		   *keycollations;
+	pljulia_param_conv *keyconvs;
+	int			ncols;			/* the columns returned */
+	AttrNumber *attnums;
+	char	  **attnames;
+	Oid		   *typids;
+	int16	   *typlens;
+	bool	   *typbyvals;
+	AttrNumber	maxattnum;
+	OverrideSearchPath *search_path;	/* the index name was looked up in */
+} pljulia_index_entry;
+
+/* State of the pljulia output plugin */
+typedef struct pljulia_decoding_data
+{
+	MemoryContext context;		/* reset after every change */
+	bool		has_begin;		/* the callbacks given as options */
+	bool		has_change;
+	bool		has_commit;
+	int			batch_size;
+	int			nchanges;		/* changes in PLJulia.decoding_changes */
+} pljulia_decoding_data;
+
+/*
+ * How the rows of a relation are passed to the change callback of the
+ * output plugin, built on its first change and again after a relcache
+ * invalidation
+ */
+typedef struct pljulia_decoding_relation
+{
+	Oid			relid;
+	bool		valid;
+	jl_value_t *info;			/* PLJulia.DecodedRelation, kept alive by
+								 * PLJulia.decoding_relations */
+	int			natts;
+	int			ncolumns;		/* the attributes that aren't dropped */
+	FmgrInfo   *outfuncs;		/* for the types without a binary
+								 * conversion */
+	MemoryContext cxt;
+} pljulia_decoding_relation;
+
+/*
+ * The kinds of Arrow columns read by pljulia_read_arrow, with the same
+ * values as the ARROW_* constants of pljulia.jl
+ */
+typedef enum pljulia_arrow_kind
+{
+	ARROW_UNSUPPORTED,
+	ARROW_NULL,
+	ARROW_BOOL,
+	ARROW_INT8,
+	ARROW_INT16,
+	ARROW_INT32,
+	ARROW_INT64,
+	ARROW_UINT8,
+	ARROW_UINT16,
+	ARROW_UINT32,
+	ARROW_UINT64,
+	ARROW_FLOAT32,
+	ARROW_FLOAT64,
+	ARROW_UTF8,
+	ARROW_LARGE_UTF8,
+	ARROW_BINARY,
+	ARROW_LARGE_BINARY,
+	ARROW_DATE32,				/* days */
+	ARROW_DATE64,				/* milliseconds */
+	ARROW_TIMESTAMP				/* in unit since the Unix epoch */
+} pljulia_arrow_kind;
+
+/* A column of an Arrow file read into an attribute by pljulia_read_arrow */
+typedef struct pljulia_arrow_column
+{
+	const char *name;
+	pljulia_arrow_kind kind;
+	int			unit;			/* of timestamps: s, ms, us or ns */
+	Oid			typid;
+	int32		typmod;
+	bool		input;			/* strings read with the input function */
+	FmgrInfo	typinput;
+	Oid			typioparam;
+	/* the buffers of the current record batch, mapped in memory */
+	const uint8 *validity;		/* NULL if the column has no NULLs */
+	const char *values;			/* or offsets, for variable width types */
+	const char *data;
+	int64		datalen;
+} pljulia_arrow_column;
+
+/* The directory of shared arrays, in the data directory */
+#define PLJULIA_SHARED_DIR "pljulia_shared"
+
+/*
+ * SD, the data shared by all the backends of the cluster: a dshash table of
+ * serialized values in a DSA area. The area and the table are created by
+ * the first backend using SD, and found by the others through a small
+ * struct in the main shared memory segment, so that the library doesn't
+ * have to be preloaded.
+ */
+#define PLJULIA_SD_KEYSIZE 128
+
+typedef struct pljulia_sd_control
+{
+	bool		initialized;
+	int			tranche_id;
+	dsa_handle	area;
+	dshash_table_handle table;
+	pg_atomic_uint64 clock;		/* ticks for versions and recency */
+	pg_atomic_uint64 entries;
+	pg_atomic_uint64 size;		/* bytes of the values */
+} pljulia_sd_control;
+
+typedef struct pljulia_sd_entry
+{
+	char		key[PLJULIA_SD_KEYSIZE];	/* padded with zeros */
+	dsa_pointer value;
+	Size		size;
+	uint64		version;		/* the tick of the last put */
+	uint64		last_used;		/* the tick of the last get or put */
+} pljulia_sd_entry;
+
+/* What a value of size bytes counts against pljulia.shared_data_size */
+#define PLJULIA_SD_CHARGE(size) ((size) + sizeof(pljulia_sd_entry))
+
+/* The most values of SD evicted after one scan of the table */
+#define PLJULIA_SD_EVICT_BATCH 32
+
+/* A value of SD to evict, unless it was put again since the scan */
+typedef struct pljulia_sd_victim
+{
+	char		key[PLJULIA_SD_KEYSIZE];
+	uint64		version;
+	uint64		last_used;
+} pljulia_sd_victim;
+
+/* The hash entry to find a saved plan by query and argument types */
+typedef struct pljulia_plan_key_entry
+{
+	uint64		key;
+	pljulia_query_desc *query_desc;
+} pljulia_plan_key_entry;
+
+#define PLJULIA_FDW_DEFAULT_ROWS 1000
+#define PLJULIA_FDW_STARTUP_COST 100.0	/* the call into Julia */
+
+/* Planner information of a pljulia_fdw scan, kept in baserel->fdw_private */
+typedef struct pljulia_fdw_plan_state
+{
+	Oid			scanfunc;
+	List	   *attnums;		/* the columns fetched */
+	List	   *qual_attnums;	/* the quals passed to Julia: column, */
+	List	   *qual_opnames;	/* operator name */
+	List	   *qual_exprs;		/* and the Const or Param compared with */
+	List	   *local_quals;	/* the RestrictInfos of the other quals */
+	Cost		startup_cost;
+	Cost		total_cost;
+} pljulia_fdw_plan_state;
+
+/* Execution state of a pljulia_fdw scan */
+typedef struct pljulia_fdw_scan_state
+{
+	Oid			scanfunc;
+	List	   *columns;		/* the columns fetched */
+	int			ncols;
+	AttrNumber *attnums;		/* the same, as arrays */
+	Oid		   *typids;
+	pljulia_param_conv *convs;
+	List	   *qual_attnums;
+	List	   *qual_opnames;
+	List	   *qual_exprs;		/* ExprStates of the values of the quals */
+	int64		id;				/* the scan in PLJulia.fdw_scans, 0 if not
+								 * started */
+	jl_array_t *batch;			/* the current batch, kept alive by
+								 * PLJulia.fdw_scans */
+	int64		nrows;
+	int64		row;
+	bool		done;
+	MemoryContext rowcxt;		/* reset for every row */
+} pljulia_fdw_scan_state;
+
+/*
+ * The hash entry for a compiled DO block. The key is a hash of the source
+ * text, which is kept to tell the (unlikely) collisions apart.
+ */
+typedef struct pljulia_inline_entry
+{
+	uint64		source_hash;
+	char	   *source_text;
+	jl_function_t *julia_func;	/* kept alive by PLJulia.inline_functions */
+	dlist_node	lru_node;		/* most recently used blocks first */
+} pljulia_inline_entry;
+
+/*
+ * A statement executed by spi_exec with parameters. The plans of these are
+ * saved and reused by later calls with the same query and parameter types;
+ * the key is a hash of both.
+ */
+typedef struct pljulia_stmt_entry
+{
+	uint64		key;
+	char	   *query;
+	int			nargs;
+	Oid		   *argtypes;
+	SPIPlanPtr	plan;
+	int			use_count;		/* number of executions in progress */
+	int64		calls;
+	TimestampTz last_used;
+	dlist_node	lru_node;		/* most recently used statements first */
+} pljulia_stmt_entry;
+
+/*
+ * The parameter types of a statement, filled in by the parser for those
+ * bound to NULL
+ */
+typedef struct pljulia_param_types
+{
+	Oid		   *argtypes;
+	int			nargs;
+} pljulia_param_types;
+
+/*
+ * A query result kept for lazy access from Julia. It lives in the memory
+ * context of the SPI tuple table, which is moved under TopTransactionContext
+ * so that it outlives the SPI connection.
+ */
+typedef struct pljulia_spi_result
+{
+	SPITupleTable *tuptable;
+	uint64		ntuples;
+	uint64		generation;		/* pljulia_xact_generation when created */
+	FmgrInfo   *outfuncs;		/* output functions, looked up on first use */
+} pljulia_spi_result;
+
+/*
+ * Before 14, COPY FROM and COPY TO shared the CopyState struct
+ */
+#if PG_VERSION_NUM < 140000
+typedef CopyState CopyFromState;
+#endif
+
+/*
+ * A DestReceiver writing the tuples it receives as COPY data (binary or CSV)
+ * to a Julia IO, in chunks of about PLJULIA_COPY_CHUNK_SIZE bytes. COPY TO
+ * itself (BeginCopyTo and DoCopyTo) can only write to a file, a program or
+ * the client, so the rows are formatted here, as COPY TO does with its
+ * default options. CSV data is UTF-8 rather than in the client encoding, as
+ * Julia expects; binary values are those of the send functions, which give
+ * strings in the client encoding like binary COPY TO.
+ */
+typedef struct pljulia_copy_dest
+{
+	DestReceiver pub;
+	jl_value_t *io;				/* kept alive by the Julia caller */
+	bool		binary;
+	bool		header;			/* write the column names (CSV) */
+	int			natts;
+	FmgrInfo   *out_funcs;		/* send functions for binary format */
+	StringInfoData buf;
+	MemoryContext rowcontext;	/* reset for every tuple */
+	uint64		processed;
+} pljulia_copy_dest;
+
+#define PLJULIA_COPY_CHUNK_SIZE 65536
+
+/*
+ * A DestReceiver appending the tuples of return_query to the result of the
+ * current set-returning function, converting them only if the rowtype of the
+ * query differs from the result rowtype
+ */
+typedef struct pljulia_return_dest
+{
+	DestReceiver pub;
+	Tuplestorestate *tuple_store;
+	TupleDesc	ret_tupdesc;
+	TupleConversionMap *map;	/* NULL if the rowtypes match */
+	TupleTableSlot *outslot;	/* converted tuples, if map is set */
+	uint64		processed;
+} pljulia_return_dest;
+
+/*
+ * Column vectors being filled with the values of rows, see
+ * pljulia_columns_from_tuptable
+ */
+typedef struct pljulia_column_batch
+{
+	int			ncols;
+	size_t		nrows;
+	Oid		   *typids;
+	jl_datatype_t **eltypes;	/* element types of binary columns */
+	void	  **data;			/* and their data */
+	FmgrInfo   *outfuncs;		/* output functions of the other columns */
+	jl_function_t *parse_func;	/* for numeric columns */
+	jl_array_t *columns;
+	jl_array_t *valid;
+} pljulia_column_batch;
+
+/*
+ * A scan of a table opened by table_scan. It belongs to the top-level
+ * transaction, whose resource owner holds its buffer pins and snapshot, and
+ * the scans still open at commit are closed by pljulia_xact_callback.
+ */
+typedef struct pljulia_table_scan
+{
+	Relation	rel;
+	TableScanDesc scan;
+	Snapshot	snapshot;
+	TupleTableSlot *slot;
+	ResourceOwner owner;
+	int			ncols;
+	AttrNumber *attnums;		/* the attributes to return */
+	Oid		   *typids;
+	AttrNumber	maxattnum;		/* the tuples are deformed up to this one */
+	dlist_node	node;
+} pljulia_table_scan;
+
 /* This struct holds information about a single function call */
 typedef struct pljulia_call_data
 {
@@ -125,17 +592,87 @@ static pljulia_call_data *current_call_data = NULL;
 
 /* The hash table we use to lookup the function in case it already exists */
 static HTAB *pljulia_proc_hashtable = NULL;
+static dlist_head pljulia_proc_lru = DLIST_STATIC_INIT(pljulia_proc_lru);
+
+/* Set when pg_proc changes, the cached functions may have been dropped */
+static bool pljulia_proc_check_dropped = false;
+
+/*
+ * The functions called by pg_call, by signature. The cache is emptied when
+ * pg_proc or the search_path changes, and pg_call is not running.
+ */
+static HTAB *pljulia_fcall_hashtable = NULL;
+static MemoryContext pljulia_fcall_cxt = NULL;
+static bool pljulia_fcall_valid = true;
+static int	pljulia_fcall_depth = 0;
+
+/* The call sites of index_lookup, by signature */
+static HTAB *pljulia_index_hashtable = NULL;
 
-/* The hash table we use for saved plans */
+/* The relations decoded by the output plugin */
+static HTAB *pljulia_decoding_relations = NULL;
+
+/* The hash tables and LRU list we use for saved plans */
 static HTAB *pljulia_query_hashtable = NULL;
+static HTAB *pljulia_plan_key_hashtable = NULL;
+static dlist_head pljulia_plan_lru = DLIST_STATIC_INIT(pljulia_plan_lru);
+static uint64 pljulia_plan_counter = 0;
 
-MemoryContext TopMemoryContext = NULL;
+/* The hash table and LRU list of statements executed with parameters */
+static HTAB *pljulia_stmt_hashtable = NULL;
+static dlist_head pljulia_stmt_lru = DLIST_STATIC_INIT(pljulia_stmt_lru);
+static MemoryContext pljulia_stmt_cxt = NULL;
+
+/* The hash table and LRU list of compiled DO blocks */
+static HTAB *pljulia_inline_hashtable = NULL;
+static dlist_head pljulia_inline_lru = DLIST_STATIC_INIT(pljulia_inline_lru);
+
+/*
+ * Incremented at the end of every transaction, to tell whether objects
+ * handed to Julia that live in transaction memory are still valid.
+ */
+static uint64 pljulia_xact_generation = 0;
+
+/* The table_scan scans open in the transaction, ended at its end */
+static dlist_head pljulia_table_scans = DLIST_STATIC_INIT(pljulia_table_scans);
 
 /*
- * We won't be using this variable as a cglobal, but we declare it
- * anyway to keep a reference to it and prevent it from being GC'ed.
+ * The large objects opened by lo_open, by descriptor: the serial number of
+ * the open, 0 once closed, and the subtransaction it belongs to. Descriptors
+ * are reused once closed, so Julia refers to a large object by both.
  */
-jl_value_t *GD;
+typedef struct pljulia_lo_handle
+{
+	uint64		serial;
+	SubTransactionId subid;
+} pljulia_lo_handle;
+
+static pljulia_lo_handle *pljulia_lo_handles = NULL;
+static int	pljulia_lo_nhandles = 0;
+static uint64 pljulia_lo_serial = 0;
+
+/* Whether session caches logged entries written by the transaction */
+static bool pljulia_cache_logged = false;
+
+/* SD, once attached by pljulia_sd_attach */
+static pljulia_sd_control *pljulia_sd_ctl = NULL;
+static dsa_area *pljulia_sd_area = NULL;
+static dshash_table *pljulia_sd_table = NULL;
+
+/* GUC variables */
+static int	pljulia_inline_cache_size = 32;
+static int	pljulia_max_cached_functions = 0;
+static int	pljulia_memoize_size = 0;
+static int	pljulia_fetch_size = 1000;
+static int	pljulia_statement_cache_size = 64;
+static int	pljulia_max_saved_plans = 1000;
+static int	pljulia_shared_data_size = 65536;	/* kB */
+static int	pljulia_session_cache_size = 65536;	/* kB */
+
+MemoryContext TopMemoryContext = NULL;
+
+/* The PLJulia module, defined in pljulia.jl */
+jl_module_t *pljulia_module = NULL;
 
 PG_MODULE_MAGIC;
 
@@ -145,7 +682,18 @@ PG_FUNCTION_INFO_V1(pljulia_inline_handler);
 static Datum cstring_to_type(char *, Oid);
 static Datum jl_value_t_to_datum(FunctionCallInfo, jl_value_t *, Oid, bool);
 pljulia_proc_desc *pljulia_compile(FunctionCallInfo, HeapTuple, Form_pg_proc, bool, bool);
+static void pljulia_proc_invalidate(Datum, int, uint32);
+static void pljulia_forget_dropped(void);
 static Datum pljulia_execute(FunctionCallInfo);
+static jl_function_t *pljulia_compile_inline(const char *, uint64);
+static char *pljulia_function_code(const char *, HeapTuple, bool, bool);
+static void pljulia_proc_evict(pljulia_proc_desc *);
+static void pljulia_proc_free(pljulia_proc_desc *);
+static void pljulia_memo_init(pljulia_proc_desc *, HeapTuple, Form_pg_proc);
+static bool pljulia_memo_lookup(pljulia_proc_desc *, FunctionCallInfo,
+								Datum *, uint64 *, Datum *);
+static void pljulia_memo_store(pljulia_proc_desc *, FunctionCallInfo,
+							   Datum *, uint64, Datum);
 void		julia_setup_input_args(FunctionCallInfo, HeapTuple, Form_pg_proc,
 								   jl_value_t **, pljulia_proc_desc *);
 jl_value_t *convert_arg_to_julia(Datum, Oid, pljulia_proc_desc *, int);
@@ -161,16 +709,141 @@ static void pljulia_event_trigger_handler(FunctionCallInfo);
 Datum		pljulia_validator(FunctionCallInfo);
 
 void		_PG_init(void);
+void		_PG_output_plugin_init(OutputPluginCallbacks *cb);
 static HeapTuple pljulia_build_tuple_result(jl_value_t *, TupleDesc);
 void		pljulia_return_next(jl_value_t *);
+jl_value_t *pljulia_return_query(jl_value_t *, jl_value_t *);
+static pljulia_call_data *pljulia_srf_call_data(const char *);
+static bool pljulia_return_dest_receive(TupleTableSlot *, DestReceiver *);
+static void pljulia_return_dest_startup(DestReceiver *, int, TupleDesc);
+static void pljulia_return_dest_shutdown(DestReceiver *);
+static void pljulia_return_dest_destroy(DestReceiver *);
 void		pljulia_elog(jl_value_t *, jl_value_t *);
 jl_value_t *pljulia_spi_exec(jl_value_t *, jl_value_t *);
+jl_value_t *pljulia_spi_exec_columns(jl_value_t *, jl_value_t *);
+static jl_value_t *pljulia_columns_from_tuptable(SPITupleTable *, uint64);
+static void pljulia_column_batch_init(pljulia_column_batch *, Oid *, int,
+									  size_t);
+static void pljulia_column_batch_set(pljulia_column_batch *, size_t, int,
+									 Datum, bool);
+static void pljulia_column_batch_truncate(pljulia_column_batch *, size_t);
+static void pljulia_column_batch_free(pljulia_column_batch *);
 jl_value_t *pljulia_spi_query(jl_value_t *);
 jl_value_t *pljulia_spi_fetchrow(jl_value_t *);
 void		pljulia_spi_cursor_close(jl_value_t *);
 
 jl_value_t *pljulia_spi_prepare(jl_value_t *, jl_value_t *);
 jl_value_t *pljulia_spi_execplan(jl_value_t *, jl_value_t *, jl_value_t *);
+jl_value_t *pljulia_spi_execplan_many(jl_value_t *, jl_value_t *, jl_value_t *);
+jl_value_t *pljulia_copy_in(jl_value_t *, jl_value_t *, jl_value_t *);
+static int	pljulia_copy_in_read(void *, int, int);
+jl_value_t *pljulia_copy_out(jl_value_t *, jl_value_t *, jl_value_t *,
+							 jl_value_t *);
+static void pljulia_copy_dest_startup(DestReceiver *, int, TupleDesc);
+static bool pljulia_copy_dest_receive(TupleTableSlot *, DestReceiver *);
+static void pljulia_copy_dest_shutdown(DestReceiver *);
+static void pljulia_copy_dest_destroy(DestReceiver *);
+static void pljulia_copy_dest_flush(pljulia_copy_dest *);
+static void pljulia_copy_csv_attribute(StringInfo, const char *);
+jl_value_t *pljulia_spi_fetch(jl_value_t *, jl_value_t *);
+jl_value_t *pljulia_spi_cursor_open_plan(jl_value_t *, jl_value_t *);
+int			pljulia_cursor_fetch_size(void);
+static jl_value_t *pljulia_rows_from_tuptable(SPITupleTable *, uint64);
+static pljulia_query_desc *pljulia_find_plan(jl_value_t *, const char *);
+void		pljulia_spi_freeplan(jl_value_t *);
+static uint64 pljulia_plan_key(const char *, int, Oid *);
+static void pljulia_plan_release(pljulia_query_desc *);
+static void pljulia_plan_free(pljulia_query_desc *);
+static void pljulia_plan_args(pljulia_query_desc *, jl_value_t *, Datum **,
+							  char **);
+static inline void pljulia_plan_arg(pljulia_query_desc *, int, jl_value_t *,
+									Datum *, char *);
+jl_value_t *pljulia_spi_exec_rows(jl_value_t *, jl_value_t *);
+jl_value_t *pljulia_spi_exec_params(jl_value_t *, jl_value_t *, jl_value_t *);
+static void pljulia_bind_params(jl_value_t *, int *, Oid **, Datum **,
+								char **);
+static SPIPlanPtr pljulia_prepare_params(const char *, int, Oid *);
+static void pljulia_input_params(SPIPlanPtr, int, Oid *, Datum *, char *);
+static void pljulia_param_setup(struct ParseState *, void *);
+static pljulia_stmt_entry *pljulia_stmt_lookup(const char *, int, Oid *);
+static void pljulia_stmt_evict(pljulia_stmt_entry *);
+jl_value_t *pljulia_spi_result_value(pljulia_spi_result *, uint64, int64,
+									 int64);
+void		pljulia_spi_result_free(pljulia_spi_result *, uint64);
+static void pljulia_xact_callback(XactEvent, void *);
+static void pljulia_subxact_callback(SubXactEvent, SubTransactionId,
+									 SubTransactionId, void *);
+static void pljulia_cache_rollback(SubTransactionId);
+uint32		pljulia_cache_log(void);
+int64		pljulia_session_cache_size_bytes(void);
+jl_value_t *pljulia_table_scan_open(jl_value_t *, jl_value_t *);
+jl_value_t *pljulia_table_scan_fetch(pljulia_table_scan *, uint64, int64);
+void		pljulia_table_scan_close(pljulia_table_scan *, uint64);
+static void pljulia_table_scan_end(pljulia_table_scan *);
+jl_value_t *pljulia_pg_call(jl_value_t *, jl_value_t *);
+static pljulia_fcall_entry *pljulia_fcall_lookup(const char *);
+static void pljulia_fcall_invalidate(Datum, int, uint32);
+jl_value_t *pljulia_index_lookup(jl_value_t *, jl_value_t *, jl_value_t *);
+static void pljulia_index_resolve(pljulia_index_entry *, const char *,
+								  const char *, jl_value_t *, Relation *,
+								  Relation *);
+static void pljulia_index_invalidate(Datum, Oid);
+jl_value_t *pljulia_lo_open(Oid, int32);
+int64		pljulia_lo_read(int32, uint64, char *, int64);
+int64		pljulia_lo_write(int32, uint64, const char *, int64);
+int64		pljulia_lo_seek(int32, uint64, int64, int32);
+void		pljulia_lo_close(int32, uint64);
+static void pljulia_lo_check(int32, uint64);
+jl_value_t *pljulia_shared_path(jl_value_t *, int32);
+void		pljulia_shared_rename(jl_value_t *, jl_value_t *);
+static char *pljulia_shared_file(const char *);
+jl_value_t *pljulia_sd_get(jl_value_t *, int32);
+uint64		pljulia_sd_put(jl_value_t *, jl_value_t *, uint64, int32);
+int32		pljulia_sd_delete(jl_value_t *);
+static void pljulia_sd_attach(void);
+static void pljulia_sd_key(const char *, char *);
+static void pljulia_sd_evict(Size);
+static void pljulia_sd_remove(pljulia_sd_entry *);
+static List *pljulia_fdw_options(Oid, Oid *, Oid *);
+static Oid	pljulia_callback_oid(const char *, DefElem *);
+static jl_function_t *pljulia_callback_function(Oid);
+static jl_value_t *pljulia_fdw_spec(List *, TupleDesc, List *, List *, List *,
+									Datum *, bool *, Oid *);
+static void pljulia_fdw_quals(RelOptInfo *, pljulia_fdw_plan_state *);
+static void pljulia_fdw_rel_size(PlannerInfo *, RelOptInfo *, Oid);
+static void pljulia_fdw_paths(PlannerInfo *, RelOptInfo *, Oid);
+static ForeignScan *pljulia_fdw_plan(PlannerInfo *, RelOptInfo *, Oid,
+									 ForeignPath *, List *, List *, Plan *);
+static void pljulia_fdw_explain(ForeignScanState *, ExplainState *);
+static void pljulia_fdw_begin(ForeignScanState *, int);
+static void pljulia_fdw_start(ForeignScanState *);
+static TupleTableSlot *pljulia_fdw_iterate(ForeignScanState *);
+static void pljulia_fdw_rescan(ForeignScanState *);
+static void pljulia_fdw_end(ForeignScanState *);
+static void pljulia_decoding_startup(LogicalDecodingContext *,
+									 OutputPluginOptions *, bool);
+static void pljulia_decoding_begin(LogicalDecodingContext *,
+								   ReorderBufferTXN *);
+static void pljulia_decoding_change(LogicalDecodingContext *,
+									ReorderBufferTXN *, Relation,
+									ReorderBufferChange *);
+static void pljulia_decoding_truncate(LogicalDecodingContext *,
+									  ReorderBufferTXN *, int, Relation[],
+									  ReorderBufferChange *);
+static void pljulia_decoding_commit(LogicalDecodingContext *,
+									ReorderBufferTXN *, XLogRecPtr);
+static void pljulia_decoding_push(LogicalDecodingContext *,
+								  ReorderBufferTXN *, Relation, const char *,
+								  HeapTuple, HeapTuple);
+static void pljulia_decoding_call(LogicalDecodingContext *,
+								  ReorderBufferTXN *, const char *);
+static pljulia_decoding_relation *pljulia_decoding_relation_entry(Relation);
+static jl_value_t *pljulia_decoding_row(pljulia_decoding_relation *,
+										TupleDesc, HeapTuple);
+static void pljulia_decoding_invalidate(Datum, Oid);
+static bool pljulia_arrow_readable(pljulia_arrow_kind, Oid);
+static Datum pljulia_arrow_value(pljulia_arrow_column *, int64, bool *);
+static Datum pljulia_arrow_number(pljulia_arrow_column *, int64, double, bool);
 
 /* these are taken from pltcl so it would be good to find a way
  * to include them from the source code instead of copying them */
@@ -296,26 +969,7 @@ pljulia_spi_exec(jl_value_t *cmd, jl_value_t *lim)
 	ret = SPI_exec(command, row_limit);
 	/* store the returned rows in a Julia array, if any */
 	if (ret > 0 && SPI_tuptable != NULL)
-	{
-		SPITupleTable *tuptable = SPI_tuptable;
-		TupleDesc	tupdesc = tuptable->tupdesc;
-		uint64		i;
-		jl_value_t *ret;
-		jl_function_t *init_arr = jl_get_function(jl_main_module, "init_nulls_anyarray");
-
-		/* allocate an array to store the results */
-		ret_val = jl_call1(init_arr, jl_box_int64(tuptable->numvals));
-
-		for (i = 0; i < tuptable->numvals; i++)
-		{
-			HeapTuple	tuple;
-
-			tuple = tuptable->vals[i];
-			ret = pljulia_dict_from_tuple(tuple, tupdesc, false);
-			jl_arrayset(ret_val, ret, i);
-		}
-
-	}
+		ret_val = pljulia_rows_from_tuptable(SPI_tuptable, SPI_processed);
 	if (ret == SPI_OK_INSERT || ret == SPI_OK_UPDATE || ret == SPI_OK_DELETE)
 	{
 		/* SPI_processed is a uint64 */
@@ -329,1872 +983,6761 @@ pljulia_spi_exec(jl_value_t *cmd, jl_value_t *lim)
 }
 
 /*
- * Prepare and save a query. Input arguments are the query,
- * and a Julia array of parameter types (each type is passed as a string).
- * If the query accepts no parameters then an empty array should be passed.
- * Returns the internal name given to the query plan.
+ * Same as spi_exec, but the rows returned by a SELECT are given by column,
+ * see pljulia_columns_from_tuptable. PLJulia.spi_exec_columns turns the
+ * result into a NamedTuple of vectors.
  */
 jl_value_t *
-pljulia_spi_prepare(jl_value_t *cmd, jl_value_t *types_arr)
+pljulia_spi_exec_columns(jl_value_t *cmd, jl_value_t *lim)
 {
-	volatile	SPIPlanPtr plan = NULL;
-	volatile MemoryContext plan_cxt = NULL;
-	int			nargs;
-	pljulia_query_desc *qdesc;
-	int			i;
-	pljulia_query_entry *hash_entry;
-
-	MemoryContext oldcontext = CurrentMemoryContext;
-	jl_function_t *len = jl_get_function(jl_base_module, "length");
-	char	   *query = jl_string_ptr(cmd);
-	bool		found_hashentry;
-
-	plan_cxt = AllocSetContextCreate(TopMemoryContext, "PL/Julia spi_prepare query",
-									 ALLOCSET_SMALL_SIZES);
-	MemoryContextSwitchTo(plan_cxt);
-	qdesc = (pljulia_query_desc *) palloc0(sizeof(pljulia_query_desc));
-	snprintf(qdesc->qname, sizeof(qdesc->qname), "%p", qdesc);
-	qdesc->plan_cxt = plan_cxt;
-	nargs = jl_unbox_int64(jl_call1(len, types_arr));
-	qdesc->nargs = nargs;
-	qdesc->argtypes = (Oid *) palloc(nargs * sizeof(Oid));
-	qdesc->arginfuncs = (FmgrInfo *) palloc(nargs * sizeof(FmgrInfo));
-	qdesc->argtypioparams = (Oid *) palloc(nargs * sizeof(Oid));
-	MemoryContextSwitchTo(oldcontext);
-
-	/*
-	 * Resolve argument type names and then look them up by oid in the system
-	 * cache, and remember the required information for input conversion
-	 */
-	for (i = 0; i < nargs; i++)
-	{
-		Oid			typId,
-					typInput,
-					typIOParam;
-		int32		typmod;
-		jl_value_t *curr_argtype;
-
-		curr_argtype = jl_arrayref(types_arr, i);
-		parseTypeString(jl_string_ptr(curr_argtype), &typId, &typmod, false);
+	char	   *command;
+	int			row_limit;
+	int			ret;
+	jl_value_t *ret_val;
 
-		getTypeInputInfo(typId, &typInput, &typIOParam);
+	command = jl_string_ptr(cmd);
+	row_limit = jl_unbox_int64(lim);
 
-		qdesc->argtypes[i] = typId;
-		fmgr_info_cxt(typInput, &(qdesc->arginfuncs[i]), plan_cxt);
-		qdesc->argtypioparams[i] = typIOParam;
-	}
 	if (SPI_connect() != SPI_OK_CONNECT)
 		elog(ERROR, "could not connect to SPI manager");
 
-	plan = SPI_prepare(utf_u2e(query),
-					   nargs, qdesc->argtypes);
-	if (plan == NULL)
-		elog(ERROR, "SPI_prepare() failed");
-	qdesc->plan = plan;
-	/* Save the plan into permanent memory */
-	if (SPI_keepplan(plan))
-		elog(ERROR, "SPI_keepplan() failed");
+	ret = SPI_exec(command, row_limit);
+	if (ret > 0 && SPI_tuptable != NULL)
+		ret_val = pljulia_columns_from_tuptable(SPI_tuptable, SPI_processed);
+	else
+		ret_val = jl_box_int64(SPI_processed);
+
 	if (SPI_finish() != SPI_OK_FINISH)
 		elog(ERROR, "SPI_finish() failed");
-
-	/* Make a new hashentry for the saved plan */
-	hash_entry = hash_search(pljulia_query_hashtable,
-							 qdesc->qname,
-							 HASH_ENTER, &found_hashentry);
-	hash_entry->query_desc = qdesc;
-
-	return jl_cstr_to_string(qdesc->qname);
+	return ret_val;
 }
 
-
+/*
+ * Execute a query with parameters, given as a Julia array of values: the
+ * type of each parameter is inferred from the Julia type of its value. The
+ * plan is saved in a per-session LRU cache keyed by the query text and the
+ * parameter types, so repeating a statement doesn't parse and plan it again.
+ * The result is the same as spi_exec's.
+ */
 jl_value_t *
-pljulia_spi_execplan(jl_value_t *plan, jl_value_t *arguments, jl_value_t *lim)
+pljulia_spi_exec_params(jl_value_t *cmd, jl_value_t *arguments, jl_value_t *lim)
 {
-	int			i;
-	char	   *nulls;
-	int			limit;
+	char	   *query = jl_string_ptr(cmd);
 	int			nargs;
+	Oid		   *argtypes;
 	Datum	   *argvalues;
-	pljulia_query_desc *qdesc;
-	pljulia_query_entry *hash_entry;
-	jl_function_t *len = jl_get_function(jl_base_module, "length");
-	char	   *query;
+	char	   *nulls;
+	pljulia_stmt_entry *volatile entry;
+	SPIPlanPtr	plan;
 	int			spi_rv;
 	jl_value_t *ret_val;
 
-	ret_val = jl_eval_string("[]");
-	nargs = jl_unbox_int64(jl_call1(len, arguments));
-	query = jl_string_ptr(plan);
-	/* The hashtable entry key is a char * for the query hashtable */
-	hash_entry = hash_search(pljulia_query_hashtable, query,
-							 HASH_FIND, NULL);
-	if (hash_entry == NULL)
-		elog(ERROR, "spi_exec_prepared: Invalid prepared query passed");
+	pljulia_bind_params(arguments, &nargs, &argtypes, &argvalues, &nulls);
 
-	qdesc = hash_entry->query_desc;
-	if (qdesc == NULL)
-		elog(ERROR, "spi_exec_prepared: plperl query_hash value vanished");
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI manager");
 
-	if (qdesc->nargs != nargs)
-		elog(ERROR, "spi_exec_prepared: expected %d argument(s), %d passed",
-			 qdesc->nargs, nargs);
-	/* If everything's ok retrieving the plan, set up the arguments */
-	if (nargs > 0)
+	entry = pljulia_stmt_lookup(query, nargs, argtypes);
+	if (entry != NULL)
+		plan = entry->plan;
+	else
+		plan = pljulia_prepare_params(query, nargs, argtypes);
+	pljulia_input_params(plan, nargs, argtypes, argvalues, nulls);
+
+	PG_TRY();
 	{
-		nulls = (char *) palloc0(nargs * sizeof(char));
-		argvalues = (Datum *) palloc0(nargs * sizeof(Datum));
+		if (entry != NULL)
+			entry->use_count++;
+		spi_rv = SPI_execute_plan(plan, argvalues, nulls, false,
+								  jl_unbox_int64(lim));
 	}
-	else
+	PG_FINALLY();
 	{
-		nulls = NULL;
-		argvalues = NULL;
+		if (entry != NULL)
+			entry->use_count--;
 	}
+	PG_END_TRY();
 
-	for (i = 0; i < nargs; i++)
+	if (spi_rv > 0 && SPI_tuptable != NULL)
+		ret_val = pljulia_rows_from_tuptable(SPI_tuptable, SPI_processed);
+	else if (spi_rv == SPI_OK_INSERT || spi_rv == SPI_OK_UPDATE ||
+			 spi_rv == SPI_OK_DELETE)
+		ret_val = jl_box_int64(SPI_processed);
+	else
+		ret_val = jl_eval_string("[]");
+
+	if (entry == NULL)
+		SPI_freeplan(plan);
+
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish() failed");
+	return ret_val;
+}
+
+/*
+ * Convert the arguments of a parameterized query to Datums, with parameter
+ * types inferred from their Julia types. NULLs get InvalidOid and values of
+ * other Julia types UNKNOWNOID, resolved by pljulia_prepare_params.
+ */
+static void
+pljulia_bind_params(jl_value_t *arguments, int *nargs, Oid **argtypes,
+					Datum **argvalues, char **nulls)
+{
+	jl_function_t *len = jl_get_function(jl_base_module, "length");
+	int			i;
+
+	*nargs = jl_unbox_int64(jl_call1(len, arguments));
+	*argtypes = (Oid *) palloc(Max(*nargs, 1) * sizeof(Oid));
+	*argvalues = (Datum *) palloc(Max(*nargs, 1) * sizeof(Datum));
+	*nulls = (char *) palloc(Max(*nargs, 1) * sizeof(char));
+	for (i = 0; i < *nargs; i++)
 	{
-		bool		isnull;
 		jl_value_t *curr_arg = jl_arrayref(arguments, i);
 
-		/* null value? */
+		(*argtypes)[i] = jl_value_to_pg_param_type(curr_arg);
 		if (jl_is_nothing(curr_arg))
 		{
-			nulls[i] = 'n';
-			argvalues[i] = InputFunctionCall(&qdesc->arginfuncs[i], NULL,
-											 qdesc->argtypioparams[i], -1);
+			(*nulls)[i] = 'n';
+			(*argvalues)[i] = (Datum) 0;
 		}
 		else
 		{
-			nulls[i] = ' ';
-
-			/*
-			 * and this here is the tricky part..:) how to get the
-			 * argvalues[i]
-			 */
-			argvalues[i] = jl_value_t_to_datum(NULL, curr_arg,
-											   qdesc->argtypes[i], false);
+			(*nulls)[i] = ' ';
+			(*argvalues)[i] = jl_value_to_pg_param(curr_arg, (*argtypes)[i]);
 		}
 	}
-	/* Execute the plan */
-	if (SPI_connect() != SPI_OK_CONNECT)
-		elog(ERROR, "could not connect to SPI manager");
+}
 
-	limit = 0;
-	if (!jl_is_nothing(lim) && jl_is_int64(lim))
-		limit = jl_unbox_int64(lim);
-	spi_rv = SPI_execp(qdesc->plan, argvalues, nulls, limit);
+/*
+ * Prepare a statement with parameters. The parameters bound to NULL, of
+ * type InvalidOid, and those of type unknown take the type the query expects
+ * of them, found by parsing it once the way PREPARE does, or text if nothing
+ * is expected.
+ */
+static SPIPlanPtr
+pljulia_prepare_params(const char *query, int nargs, Oid *argtypes)
+{
+	SPIPlanPtr	plan;
+	Oid		   *types = argtypes;
+	int			i;
 
-	if (spi_rv > 0 && SPI_tuptable != NULL)
+	for (i = 0; i < nargs; i++)
 	{
-		SPITupleTable *tuptable = SPI_tuptable;
-		TupleDesc	tupdesc = tuptable->tupdesc;
-		uint64		i;
-		jl_value_t *ret;
-		jl_function_t *init_arr = jl_get_function(jl_main_module, "init_nulls_anyarray");
-
-		/* allocate an array to store the results */
-		ret_val = jl_call1(init_arr, jl_box_int64(tuptable->numvals));
-
-		for (i = 0; i < tuptable->numvals; i++)
-		{
-			HeapTuple	tuple;
-
-			tuple = tuptable->vals[i];
-			ret = pljulia_dict_from_tuple(tuple, tupdesc, false);
-			jl_arrayset(ret_val, ret, i);
-		}
-
+		if (!OidIsValid(argtypes[i]) || argtypes[i] == UNKNOWNOID)
+			break;
 	}
-	if (spi_rv == SPI_OK_INSERT || spi_rv == SPI_OK_UPDATE || spi_rv == SPI_OK_DELETE)
+	if (i < nargs)
 	{
-		/* SPI_processed is a uint64 */
-		ret_val = jl_box_int64(SPI_processed);
+		pljulia_param_types params;
+
+		params.nargs = nargs;
+		params.argtypes = (Oid *) palloc(nargs * sizeof(Oid));
+		memcpy(params.argtypes, argtypes, nargs * sizeof(Oid));
+		plan = SPI_prepare_params(query, pljulia_param_setup, &params, 0);
+		if (plan == NULL)
+			elog(ERROR, "SPI_prepare_params() failed:%s",
+				 SPI_result_code_string(SPI_result));
+		SPI_freeplan(plan);
+
+		types = params.argtypes;
+		for (i = 0; i < nargs; i++)
+		{
+			if (!OidIsValid(types[i]) || types[i] == UNKNOWNOID)
+				types[i] = TEXTOID;
+		}
 	}
 
-	if (SPI_finish() != SPI_OK_FINISH)
-		elog(ERROR, "SPI_finish() failed");
-	return ret_val;
+	plan = SPI_prepare(query, nargs, types);
+	if (plan == NULL)
+		elog(ERROR, "SPI_prepare() failed:%s",
+			 SPI_result_code_string(SPI_result));
+	return plan;
 }
 
-void
-pljulia_return_next(jl_value_t *obj)
+/*
+ * Convert the values of the unknown parameters, C strings, with the input
+ * function of the type pljulia_prepare_params found for them.
+ */
+static void
+pljulia_input_params(SPIPlanPtr plan, int nargs, Oid *argtypes,
+					 Datum *argvalues, char *nulls)
 {
-	pljulia_call_data *call_data;
-	FunctionCallInfo fcinfo;
-	pljulia_proc_desc *prodesc;
-	MemoryContext old_cxt;
-	ReturnSetInfo *rsi;
-
-	call_data = current_call_data;
-	fcinfo = call_data->fcinfo;
-	prodesc = call_data->prodesc;
-	rsi = (ReturnSetInfo *) fcinfo->resultinfo;
-
-	if (!prodesc->fn_retisset)
-		elog(ERROR, "return_next called in function that doesn't return set");
+	int			i;
 
-	/* Set up tuple store if first output row */
-	if (!call_data->ret_tupdesc)
+	for (i = 0; i < nargs; i++)
 	{
-		TupleDesc	tupdesc;
-
-		if (prodesc->fn_retistuple)
-		{
-			Oid			typid;
-
-			if (get_call_result_type(fcinfo, &typid, &tupdesc) !=
-				TYPEFUNC_COMPOSITE)
-				elog(ERROR, "function returning record called in context that "
-					 "cannot accept type record");
-		}
-		else
-		{
-			tupdesc = rsi->expectedDesc;
-			if (tupdesc == NULL || tupdesc->natts != 1)
-				elog(ERROR, "expected single-column result descriptor for "
-					 "non-composite SETOF result");
-		}
-
-		/*
-		 * Make sure the tuple_store and ret_tdesc are sufficiently
-		 * long-lived.
-		 */
-		old_cxt = MemoryContextSwitchTo(rsi->econtext->ecxt_per_query_memory);
+		Oid			typinput;
+		Oid			typioparam;
 
-		current_call_data->ret_tupdesc = CreateTupleDescCopy(tupdesc);
-		current_call_data->tuple_store = tuplestore_begin_heap(rsi->allowedModes
-															   & SFRM_Materialize_Random,
-															   false, work_mem);
-
-		MemoryContextSwitchTo(old_cxt);
-	}
-	/* done with first-call initializations */
-	if (!current_call_data->tmp_cxt)
-	{
-		current_call_data->tmp_cxt = AllocSetContextCreate(
-														   CurrentMemoryContext, "PL/Julia return_next temp context",
-														   ALLOCSET_SMALL_SIZES);
+		if (argtypes[i] != UNKNOWNOID || nulls[i] == 'n')
+			continue;
+		getTypeInputInfo(SPI_getargtypeid(plan, i), &typinput, &typioparam);
+		argvalues[i] = OidInputFunctionCall(typinput,
+											DatumGetCString(argvalues[i]),
+											typioparam, -1);
 	}
-	old_cxt = MemoryContextSwitchTo(current_call_data->tmp_cxt);
-
-	if (prodesc->fn_retistuple)
-	{
-		HeapTuple	tuple;
+}
 
-		tuple = pljulia_build_tuple_result(obj, current_call_data->ret_tupdesc);
-		tuplestore_puttuple(call_data->tuple_store, tuple);
-	}
-	else if (prodesc->result_typid)
-	{
-		Datum		ret[1];
-		bool		isNull[1];
+static void
+pljulia_param_setup(struct ParseState *pstate, void *arg)
+{
+	pljulia_param_types *params = (pljulia_param_types *) arg;
 
-		if (!obj || jl_is_nothing(obj))
-			isNull[0] = true;
-		else
-			isNull[0] = false;
-		ret[0] = jl_value_t_to_datum(fcinfo, obj, prodesc->result_typid, false);
-		tuplestore_putvalues(call_data->tuple_store, call_data->ret_tupdesc,
-							 ret, isNull);
-	}
-	MemoryContextSwitchTo(old_cxt);
-	MemoryContextReset(current_call_data->tmp_cxt);
+#if PG_VERSION_NUM >= 150000
+	setup_parse_variable_parameters(pstate, &params->argtypes, &params->nargs);
+#else
+	parse_variable_parameters(pstate, &params->argtypes, &params->nargs);
+#endif
 }
 
-void
-pljulia_elog(jl_value_t *lvl, jl_value_t *msg)
+/*
+ * Find the saved plan of a statement, or prepare and save it. Must be called
+ * while connected to SPI. Returns NULL if the statement cache is disabled.
+ */
+static pljulia_stmt_entry *
+pljulia_stmt_lookup(const char *query, int nargs, Oid *argtypes)
 {
-	volatile int level;
-	int			priority_idx;
-	int			i;
-
-	static const char *logpriorities[] = {
-		"DEBUG", "LOG", "INFO", "NOTICE",
-		"WARNING", "ERROR", "FATAL", (const char *) NULL
-	};
+	pljulia_stmt_entry *entry;
+	MemoryContext oldcontext;
+	SPIPlanPtr	plan;
+	uint64		key;
+	bool		found;
 
-	static const int loglevels[] = {
-		DEBUG1, LOG, INFO, NOTICE,
-		WARNING, ERROR, FATAL
-	};
+	if (pljulia_statement_cache_size <= 0)
+		return NULL;
 
-	for (i = 0; i < 8; i++)
+	key = pljulia_plan_key(query, nargs, argtypes);
+	entry = hash_search(pljulia_stmt_hashtable, &key, HASH_FIND, NULL);
+	if (entry != NULL)
 	{
-		if (strcmp(logpriorities[i], jl_string_ptr(lvl)) == 0)
+		if (entry->nargs == nargs && strcmp(entry->query, query) == 0 &&
+			memcmp(entry->argtypes, argtypes, nargs * sizeof(Oid)) == 0)
 		{
-			priority_idx = i;
-			break;
+			entry->calls++;
+			entry->last_used = GetCurrentStatementStartTimestamp();
+			dlist_move_head(&pljulia_stmt_lru, &entry->lru_node);
+			return entry;
 		}
+		/* a hash collision, the statement that was there makes way */
+		if (entry->use_count > 0)
+			return NULL;
+		pljulia_stmt_evict(entry);
 	}
-	if (i >= 7)
-		elog(ERROR, "no match found for elog levels");
-	else
+
+	/* make room, skipping statements being executed */
+	if (!dlist_is_empty(&pljulia_stmt_lru))
 	{
-		level = loglevels[priority_idx];
-		elog(level, "%s", jl_string_ptr(msg));
+		dlist_node *node = dlist_tail_node(&pljulia_stmt_lru);
+
+		while (node != NULL &&
+			   hash_get_num_entries(pljulia_stmt_hashtable) >= pljulia_statement_cache_size)
+		{
+			dlist_node *prev = dlist_has_prev(&pljulia_stmt_lru, node) ?
+			dlist_prev_node(&pljulia_stmt_lru, node) : NULL;
+			pljulia_stmt_entry *victim = dlist_container(pljulia_stmt_entry,
+														 lru_node, node);
+
+			if (victim->use_count == 0)
+				pljulia_stmt_evict(victim);
+			node = prev;
+		}
 	}
-	return;
-}
 
+	plan = pljulia_prepare_params(query, nargs, argtypes);
+	if (SPI_keepplan(plan))
+		elog(ERROR, "SPI_keepplan() failed");
+
+	oldcontext = MemoryContextSwitchTo(pljulia_stmt_cxt);
+	entry = hash_search(pljulia_stmt_hashtable, &key, HASH_ENTER, &found);
+	entry->query = pstrdup(query);
+	entry->nargs = nargs;
+	entry->argtypes = (Oid *) palloc(Max(nargs, 1) * sizeof(Oid));
+	memcpy(entry->argtypes, argtypes, nargs * sizeof(Oid));
+	entry->plan = plan;
+	entry->use_count = 0;
+	entry->calls = 1;
+	entry->last_used = GetCurrentStatementStartTimestamp();
+	dlist_push_head(&pljulia_stmt_lru, &entry->lru_node);
+	MemoryContextSwitchTo(oldcontext);
 
+	return entry;
+}
 
 /*
- * takes a Julia tuple or dictionary and a TupleDesc as input,
- * and returns a heaptuple to use in a SRF tuplestore.
+ * Free a cached statement and its plan.
  */
-static HeapTuple
-pljulia_build_tuple_result(jl_value_t *obj, TupleDesc tupdesc)
+static void
+pljulia_stmt_evict(pljulia_stmt_entry *entry)
 {
+	SPI_freeplan(entry->plan);
+	pfree(entry->query);
+	pfree(entry->argtypes);
+	dlist_delete(&entry->lru_node);
+	hash_search(pljulia_stmt_hashtable, &entry->key, HASH_REMOVE, NULL);
+}
+
+/*
+ * Convert the first ntuples rows of a tuple table to a Julia vector holding
+ * the column names, the column vectors, and for every column either nothing
+ * or a vector of Bools that are false where the value is NULL.
+ *
+ * The tuples are deformed once and their values stored in place: columns of
+ * the types pg_oid_to_jl_column_type knows about are decoded from their
+ * binary representation, numeric columns hold BigFloats and the others
+ * hold the text representation of their values.
+ */
+static jl_value_t *
+pljulia_columns_from_tuptable(SPITupleTable *tuptable, uint64 ntuples)
+{
+	TupleDesc	tupdesc = tuptable->tupdesc;
+	int			natts = tupdesc->natts;
+	jl_value_t *result = NULL;
+	jl_array_t *names = NULL;
+	pljulia_column_batch batch = {0};
+	Oid		   *typids;
 	Datum	   *values;
-	bool	   *nulls;
-	HeapTuple	tup;
-	int			nfields;
-	Form_pg_attribute att;
-	int			i;
-	jl_value_t *curr_elem;
+	bool	   *isnull;
+	uint64		i;
+	int			j;
 
-	if (!obj || jl_is_nothing(obj))
-		elog(ERROR, "Attempting to build tuple from nothing");
+	JL_GC_PUSH4(&result, &names, &batch.columns, &batch.valid);
 
-	if (jl_is_dict(obj))
+	names = jl_alloc_vec_any(natts);
+	typids = (Oid *) palloc(natts * sizeof(Oid));
+	for (j = 0; j < natts; j++)
 	{
-		jl_function_t *dict_nfields;
+		Form_pg_attribute att = TupleDescAttr(tupdesc, j);
 
-		dict_nfields = jl_get_function(jl_base_module, "length");
-
-		nfields = jl_unbox_int64(jl_call1(dict_nfields, obj));
-		if (tupdesc->natts != nfields)
-			elog(ERROR, "Dict number of fields mismatch");
+		jl_arrayset(names, jl_cstr_to_string(NameStr(att->attname)), j);
+		typids[j] = att->atttypid;
 	}
-	else
+	pljulia_column_batch_init(&batch, typids, natts, ntuples);
+
+	values = (Datum *) palloc(natts * sizeof(Datum));
+	isnull = (bool *) palloc(natts * sizeof(bool));
+	for (i = 0; i < ntuples; i++)
 	{
-		nfields = jl_nfields(obj);
-		if (tupdesc->natts != nfields)
-			elog(ERROR, "Tuple number of fields mismatch");
+		heap_deform_tuple(tuptable->vals[i], tupdesc, values, isnull);
+		for (j = 0; j < natts; j++)
+			pljulia_column_batch_set(&batch, i, j, values[j], isnull[j]);
 	}
 
-	values = (Datum *) palloc0(sizeof(Datum) * nfields);
-	nulls = (bool *) palloc0(sizeof(bool) * nfields);
+	result = (jl_value_t *) jl_alloc_vec_any(3);
+	jl_arrayset((jl_array_t *) result, (jl_value_t *) names, 0);
+	jl_arrayset((jl_array_t *) result, (jl_value_t *) batch.columns, 1);
+	jl_arrayset((jl_array_t *) result, (jl_value_t *) batch.valid, 2);
+	JL_GC_POP();
 
-	for (i = 0; i < nfields; i++)
-	{
-		att = TupleDescAttr(tupdesc, i);
-		nulls[i] = false;
+	pljulia_column_batch_free(&batch);
+	pfree(typids);
+	pfree(values);
+	pfree(isnull);
+	return result;
+}
 
-		if (jl_is_tuple(obj))
-			curr_elem = jl_get_nth_field(obj, i);
-		else
-		{
-			char	   *attname = NameStr(att->attname);
-			jl_value_t *key = jl_cstr_to_string(attname);
-			jl_function_t *dict_get = jl_get_function(jl_main_module, "dict_get");
+/*
+ * Allocate the column vectors of nrows values of the given types, and their
+ * validity masks. batch->columns and batch->valid must be rooted by the
+ * caller.
+ */
+static void
+pljulia_column_batch_init(pljulia_column_batch *batch, Oid *typids, int ncols,
+						  size_t nrows)
+{
+	jl_value_t *bigfloat_type;
+	int			j;
+
+	batch->ncols = ncols;
+	batch->nrows = nrows;
+	batch->typids = typids;
+	batch->eltypes = (jl_datatype_t **) palloc(Max(ncols, 1) * sizeof(jl_datatype_t *));
+	batch->data = (void **) palloc0(Max(ncols, 1) * sizeof(void *));
+	batch->outfuncs = (FmgrInfo *) palloc0(Max(ncols, 1) * sizeof(FmgrInfo));
+	batch->parse_func = jl_get_function(pljulia_module, "parse_bigfloat");
+	bigfloat_type = jl_get_global(jl_base_module, jl_symbol("BigFloat"));
+
+	batch->columns = jl_alloc_vec_any(ncols);
+	batch->valid = jl_alloc_vec_any(ncols);
+	for (j = 0; j < ncols; j++)
+	{
+		jl_value_t *column_type;
 
-			curr_elem = jl_call2(dict_get, key, obj);
-		}
+		jl_arrayset(batch->valid, jl_nothing, j);
 
-		if (jl_typeis(curr_elem, jl_nothing_type))
+		batch->eltypes[j] = pg_oid_to_jl_column_type(typids[j]);
+		if (batch->eltypes[j] == NULL)
 		{
-			nulls[i] = true;
-			continue;
+			Oid			typoutput;
+			bool		typisvarlena;
+
+			getTypeOutputInfo(typids[j], &typoutput, &typisvarlena);
+			fmgr_info(typoutput, &batch->outfuncs[j]);
 		}
 
-		values[i] = jl_value_t_to_datum(current_call_data->fcinfo, curr_elem,
-										att->atttypid, false);
+		if (batch->eltypes[j] != NULL)
+			column_type = jl_apply_array_type((jl_value_t *) batch->eltypes[j], 1);
+		else if (typids[j] == NUMERICOID)
+			column_type = jl_apply_array_type(bigfloat_type, 1);
+		else
+			column_type = jl_apply_array_type((jl_value_t *) jl_string_type, 1);
+		jl_arrayset(batch->columns,
+					(jl_value_t *) jl_alloc_array_1d(column_type, nrows), j);
+		if (batch->eltypes[j] != NULL)
+			batch->data[j] = jl_array_data(jl_arrayref(batch->columns, j));
 	}
-	tup = heap_form_tuple(tupdesc, values, nulls);
-	pfree(nulls);
-	pfree(values);
-	return tup;
 }
 
-void
-_PG_init(void)
+/*
+ * Store the value of column j of row i (0-based) of a batch
+ */
+static void
+pljulia_column_batch_set(pljulia_column_batch *batch, size_t i, int j,
+						 Datum value, bool isnull)
 {
-	double		jl_init_time;
-	struct timeval t1,
-				t2;
-	int			i,
-				npackages = 0;
-
-	gettimeofday(&t1, NULL);
-	/* required: setup the Julia context */
-	jl_init();
-	gettimeofday(&t2, NULL);
-	jl_init_time = (double) (t2.tv_usec - t1.tv_usec) / 1000 +
-		(double) (t2.tv_sec - t1.tv_sec) * 1000;
-	elog(DEBUG1, "Julia initialized in %f milliseconds.", jl_init_time);
-
-	/*
-	 * Initialize the hash table
-	 */
-	HASHCTL		hash_ctl;
-
-	memset(&hash_ctl, 0, sizeof(hash_ctl));
-	hash_ctl.keysize = sizeof(pljulia_proc_key);
-	hash_ctl.entrysize = sizeof(pljulia_hash_entry);
-
-	pljulia_proc_hashtable =
-		hash_create("PL/Julia cached procedures hashtable", 32, &hash_ctl,
-					HASH_ELEM);
-
-	/*
-	 * Our global data, a dictionary named GD, which holds data we want to be
-	 * shared between functions. This is also used for saved query plans. It's
-	 * initialized to an empty dictionary. This dictionary is a global
-	 * variable for the main module
-	 */
-	GD = jl_eval_string("GD = Dict()");
-	pljulia_query_hashtable = hash_create("PL/Julia cached plans hashtable",
-										  32, &hash_ctl, HASH_ELEM);
-
-	char	   *dict_set_command,
-			   *dict_get_command;
+	Oid			typid = batch->typids[j];
+	char	   *outputstr;
 
-	/*
-	 * The following functions are declared here and will be used to convert
-	 * composite types to dictionaries. There might be a nicer way to do this
-	 * using type constructors from Julia's C-API but it wasn't very obvious
-	 * how.
-	 */
-	dict_set_command = "function dict_set(key, val, dict)\n"
-		"dict[key] = val\n"
-		"end";
-	dict_get_command = "function dict_get(key, dict)\n"
-		"if haskey(dict,key)\n"
-		"return dict[key]\n"
-		"else\n"
-		"return nothing\n"
-		"end\n"
-		"end";
-	/* add these functions to jl_main_module */
-	jl_eval_string(dict_get_command);
-	jl_eval_string(dict_set_command);
-	jl_eval_string("init_nulls_anyarray(dims) = Array{Any}(nothing,dims)");
-	jl_eval_string(
-				   "return_next(arg) = ccall(:pljulia_return_next, Cvoid, (Any,), arg)");
-	jl_eval_string("parse_bigfloat(arg) = parse(BigFloat, arg)");
-	jl_eval_string("elog(level, message) = ccall(:pljulia_elog, Cvoid, "
-				   "(Any,Any), level, message)");
-	jl_eval_string("spi_exec(query, limit) = ccall(:pljulia_spi_exec, Any, "
-				   "(Any, Any), query, limit)");
-	jl_eval_string("spi_exec(query) = ccall(:pljulia_spi_query, Any, (Any,), query)");
-	jl_eval_string("spi_fetchrow(cursor) = ccall(:pljulia_spi_fetchrow, Any, (Any,), cursor)");
-	jl_eval_string("spi_cursor_close(cursor) = "
-				   "ccall(:pljulia_spi_cursor_close, Cvoid, (Any,), cursor)");
-	jl_eval_string("spi_prepare(query, argtypes) = ccall(:pljulia_spi_prepare, "
-				   "Any, (Any, Any), query, argtypes)");
-	jl_eval_string(
-				   "spi_exec_prepared(plan, args, limit) = ccall(:pljulia_spi_execplan, "
-				   "Any, (Any, Any, Any), plan, args, limit)");
-	/* load the installed packages */
-	jl_value_t *packages = jl_eval_string("using Pkg; collect(keys(Pkg.installed()))");
+	if (isnull)
+	{
+		jl_array_t *mask = (jl_array_t *) jl_arrayref(batch->valid, j);
 
-	JL_GC_PUSH1(&packages);
+		/* the validity mask is only created for columns with NULLs */
+		if (jl_is_nothing(mask))
+		{
+			mask = jl_alloc_array_1d(jl_apply_array_type((jl_value_t *) jl_bool_type, 1),
+									 batch->nrows);
+			memset(jl_array_data(mask), 1, batch->nrows);
+			jl_arrayset(batch->valid, (jl_value_t *) mask, j);
+		}
+		((uint8_t *) jl_array_data(mask))[i] = 0;
+		return;
+	}
 
-	npackages = jl_array_len(packages);
-	for (i = 0; i < npackages; i++)
+	if (batch->eltypes[j] != NULL)
 	{
-		char		packname[256];
-		jl_value_t *package;
-		int			j;
-
-		packname[0] = '\0';
-		package = jl_arrayref(packages, i);
-		strcpy(packname, "using ");
-		strcat(packname, jl_string_ptr(package));
-		j = strlen(packname);
-		packname[j] = '\0';
-		jl_eval_string(packname);
+		pg_datum_to_jl_column(value, typid, batch->data[j], i);
+		return;
 	}
-	JL_GC_POP();
+
+	outputstr = OutputFunctionCall(&batch->outfuncs[j], value);
+	if (typid == NUMERICOID)
+		jl_arrayset((jl_array_t *) jl_arrayref(batch->columns, j),
+					jl_call1(batch->parse_func, jl_cstr_to_string(outputstr)), i);
+	else
+		jl_arrayset((jl_array_t *) jl_arrayref(batch->columns, j),
+					jl_cstr_to_string(outputstr), i);
+	pfree(outputstr);
 }
 
 /*
- * Convert the C string "input" to a Datum of type "typeoid".
+ * Keep only the first nrows values of the column vectors of a batch
  */
-static Datum
-cstring_to_type(char *input, Oid typeoid)
+static void
+pljulia_column_batch_truncate(pljulia_column_batch *batch, size_t nrows)
 {
-	Oid			typInput,
-				typIOParam;
-	Datum		ret;
+	int			j;
 
-	getTypeInputInfo(typeoid, &typInput, &typIOParam);
-	ret = OidFunctionCall3(typInput, CStringGetDatum(input), 0, -1);
+	if (nrows >= batch->nrows)
+		return;
+	for (j = 0; j < batch->ncols; j++)
+	{
+		jl_value_t *mask = jl_arrayref(batch->valid, j);
 
-	PG_RETURN_DATUM(ret);
+		jl_array_del_end((jl_array_t *) jl_arrayref(batch->columns, j),
+						 batch->nrows - nrows);
+		if (!jl_is_nothing(mask))
+			jl_array_del_end((jl_array_t *) mask, batch->nrows - nrows);
+	}
+	batch->nrows = nrows;
+}
+
+static void
+pljulia_column_batch_free(pljulia_column_batch *batch)
+{
+	pfree(batch->eltypes);
+	pfree(batch->data);
+	pfree(batch->outfuncs);
 }
 
 /*
- * Convert the Julia result to a Datum of type "typeoid".
+ * Prepare and save a query. Input arguments are the query,
+ * and a Julia array of parameter types (each type is passed as a string).
+ * If the query accepts no parameters then an empty array should be passed.
+ * Returns the internal name given to the query plan.
+ *
+ * A plan saved for the same query and argument types is reused, and must
+ * then be freed as many times as it was prepared. The least recently used
+ * plans are freed when there are more than pljulia.max_saved_plans of them.
  */
-static Datum
-jl_value_t_to_datum(FunctionCallInfo fcinfo, jl_value_t *ret, Oid prorettype, bool usefcinfo)
+jl_value_t *
+pljulia_spi_prepare(jl_value_t *cmd, jl_value_t *types_arr)
 {
-	/* maybe I should check the depth of the recursion stack */
-	char	   *buffer;
-
-	/* A nothing in Julia is a NULL in Postgres */
-	if (jl_is_nothing(ret))
-		PG_RETURN_VOID();
-	/* Handle base types */
-	if (jl_is_string(ret))
-	{
-		elog(DEBUG1, "ret (string): %s", jl_string_ptr(ret));
-		PG_RETURN_DATUM(cstring_to_type((char *) jl_string_ptr(ret),
-										prorettype));
-	}
-	else if (jl_typeis(ret, jl_float64_type))
-	{
-		double		ret_unboxed = jl_unbox_float64(ret);
+	volatile	SPIPlanPtr plan = NULL;
+	volatile MemoryContext plan_cxt = NULL;
+	int			nargs;
+	pljulia_query_desc *volatile qdesc;
+	int			i;
+	pljulia_query_entry *hash_entry;
+	pljulia_plan_key_entry *key_entry;
+	Oid		   *argtypes;
+	uint64		key;
 
-		elog(DEBUG1, "ret (float64): %f", jl_unbox_float64(ret));
+	MemoryContext oldcontext = CurrentMemoryContext;
+	jl_function_t *len = jl_get_function(jl_base_module, "length");
+	char	   *query = jl_string_ptr(cmd);
+	bool		found_hashentry;
 
-		buffer = (char *) palloc0((DOUBLE_LEN + 1) * sizeof(char));
-		snprintf(buffer, DOUBLE_LEN, "%.16f", ret_unboxed);
-	}
-	else if (jl_is_bigfloat(ret))
+	/* Resolve argument type names */
+	nargs = jl_unbox_int64(jl_call1(len, types_arr));
+	argtypes = (Oid *) palloc(Max(nargs, 1) * sizeof(Oid));
+	for (i = 0; i < nargs; i++)
 	{
-		/* this is how we map the numeric types */
-		jl_function_t *str_func = jl_get_function(jl_base_module, "string");
+		int32		typmod;
 
-		/*
-		 * get the string representation of bigfloat since there's not a
-		 * function in Julia's C-API for unboxing this type
-		 */
-		buffer = jl_string_ptr(jl_call1(str_func, ret));
+		parseTypeString(jl_string_ptr(jl_arrayref(types_arr, i)),
+						&argtypes[i], &typmod, false);
 	}
-	else if (jl_typeis(ret, jl_float32_type))
-	{
-		double		ret_unboxed = jl_unbox_float32(ret);
 
-		elog(DEBUG1, "ret (float32): %f", jl_unbox_float32(ret));
-
-		buffer = (char *) palloc0((DOUBLE_LEN + 1) * sizeof(char));
-		snprintf(buffer, DOUBLE_LEN, "%f", ret_unboxed);
-	}
-	else if (jl_typeis(ret, jl_int64_type))
+	/* Reuse the plan saved for the same query and types, if any */
+	key = pljulia_plan_key(query, nargs, argtypes);
+	key_entry = hash_search(pljulia_plan_key_hashtable, &key, HASH_FIND, NULL);
+	if (key_entry != NULL)
 	{
-		long int	ret_unboxed = jl_unbox_int64(ret);
-
-		elog(DEBUG1, "ret (int64): %ld", jl_unbox_int64(ret));
-
-		buffer = (char *) palloc0((LONG_INT_LEN + 1) * sizeof(char));
-		snprintf(buffer, LONG_INT_LEN, "%ld", ret_unboxed);
+		qdesc = key_entry->query_desc;
+		if (qdesc->nargs == nargs && strcmp(qdesc->query, query) == 0 &&
+			memcmp(qdesc->argtypes, argtypes, nargs * sizeof(Oid)) == 0)
+		{
+			qdesc->refcount++;
+			dlist_move_head(&pljulia_plan_lru, &qdesc->lru_node);
+			pfree(argtypes);
+			return jl_cstr_to_string(qdesc->qname);
+		}
 	}
-	else if (jl_typeis(ret, jl_int32_type))
-	{
-		int			ret_unboxed = jl_unbox_int32(ret);
-
-		elog(DEBUG1, "ret (int32): %d", jl_unbox_int32(ret));
 
-		buffer = (char *) palloc0((LONG_INT_LEN + 1) * sizeof(char));
-		snprintf(buffer, LONG_INT_LEN, "%d", ret_unboxed);
-	}
-	else if (jl_typeis(ret, jl_char_type))
+	/* Make room, skipping plans being executed */
+	if (!dlist_is_empty(&pljulia_plan_lru))
 	{
-		char		ret_unboxed = jl_unbox_int32(ret);
+		dlist_node *node = dlist_tail_node(&pljulia_plan_lru);
 
-		elog(DEBUG1, "ret (int32): %d", jl_unbox_int32(ret));
-
-		buffer = (char *) palloc0((LONG_INT_LEN + 1) * sizeof(char));
-		snprintf(buffer, LONG_INT_LEN, "%c", ret_unboxed);
+		while (node != NULL &&
+			   hash_get_num_entries(pljulia_query_hashtable) >= pljulia_max_saved_plans)
+		{
+			dlist_node *prev = dlist_has_prev(&pljulia_plan_lru, node) ?
+			dlist_prev_node(&pljulia_plan_lru, node) : NULL;
+			pljulia_query_desc *victim = dlist_container(pljulia_query_desc,
+														 lru_node, node);
+
+			if (victim->use_count == 0)
+				pljulia_plan_free(victim);
+			node = prev;
+		}
 	}
-	else if (jl_typeis(ret, jl_bool_type))
+
+	plan_cxt = AllocSetContextCreate(TopMemoryContext, "PL/Julia spi_prepare query",
+									 ALLOCSET_SMALL_SIZES);
+	PG_TRY();
 	{
-		int			ret_unboxed = jl_unbox_bool(ret);
+		MemoryContextSwitchTo(plan_cxt);
+		qdesc = (pljulia_query_desc *) palloc0(sizeof(pljulia_query_desc));
+		snprintf(qdesc->qname, sizeof(qdesc->qname), "plan" UINT64_FORMAT,
+				 ++pljulia_plan_counter);
+		qdesc->plan_cxt = plan_cxt;
+		qdesc->query = pstrdup(query);
+		qdesc->nargs = nargs;
+		qdesc->argtypes = (Oid *) palloc(Max(nargs, 1) * sizeof(Oid));
+		memcpy(qdesc->argtypes, argtypes, nargs * sizeof(Oid));
+		qdesc->arginfuncs = (FmgrInfo *) palloc(nargs * sizeof(FmgrInfo));
+		qdesc->argtypioparams = (Oid *) palloc(nargs * sizeof(Oid));
+		qdesc->argconvs = (pljulia_param_conv *) palloc(nargs * sizeof(pljulia_param_conv));
+		qdesc->key = key;
+		qdesc->refcount = 1;
+		MemoryContextSwitchTo(oldcontext);
 
-		elog(DEBUG1, "ret (bool): %d", jl_unbox_bool(ret));
+		/*
+		 * Look up the argument types by oid in the system cache, and remember
+		 * the required information for input conversion
+		 */
+		for (i = 0; i < nargs; i++)
+		{
+			Oid			typInput,
+						typIOParam;
 
-		buffer = (char *) palloc0((LONG_INT_LEN + 1) * sizeof(char));
-		snprintf(buffer, LONG_INT_LEN, "%d", ret_unboxed);
-	}
-	/* If not a base type, but still a valid type */
-	else if (jl_is_array(ret))
-	{
-		/* handle the arraytype */
-		PG_RETURN_DATUM(pg_array_from_julia_array(fcinfo, ret, prorettype));
-	}
-	else if (jl_is_tuple(ret))
-	{
-		/* handle the tupletype - return a composite */
-		PG_RETURN_DATUM(pg_composite_from_julia_tuple(fcinfo, ret, prorettype, usefcinfo));
-	}
-	else if (jl_is_dict(ret))
-	{
-		PG_RETURN_DATUM(pg_composite_from_julia_dict(fcinfo, ret, prorettype, usefcinfo));
+			getTypeInputInfo(argtypes[i], &typInput, &typIOParam);
+
+			fmgr_info_cxt(typInput, &(qdesc->arginfuncs[i]), plan_cxt);
+			qdesc->argtypioparams[i] = typIOParam;
+			qdesc->argconvs[i] = pg_oid_to_param_conv(argtypes[i]);
+		}
+		if (SPI_connect() != SPI_OK_CONNECT)
+			elog(ERROR, "could not connect to SPI manager");
+
+		plan = SPI_prepare(utf_u2e(query),
+						   nargs, qdesc->argtypes);
+		if (plan == NULL)
+			elog(ERROR, "SPI_prepare() failed");
+		qdesc->plan = plan;
+		/* Save the plan into permanent memory */
+		if (SPI_keepplan(plan))
+			elog(ERROR, "SPI_keepplan() failed");
+		if (SPI_finish() != SPI_OK_FINISH)
+			elog(ERROR, "SPI_finish() failed");
 	}
-	else
+	PG_CATCH();
 	{
-		elog(ERROR, "ERROR: unexpected unboxed Julia return type");
-		PG_RETURN_NULL();
+		MemoryContextSwitchTo(oldcontext);
+		MemoryContextDelete(plan_cxt);
+		PG_RE_THROW();
 	}
-	elog(DEBUG1, "ret (buffer): %s", buffer);
+	PG_END_TRY();
 
-	PG_RETURN_DATUM(cstring_to_type(buffer, prorettype));
+	/* Make new hashentries for the saved plan */
+	hash_entry = hash_search(pljulia_query_hashtable,
+							 qdesc->qname,
+							 HASH_ENTER, &found_hashentry);
+	hash_entry->query_desc = qdesc;
+	/* on a hash collision, the plan is only found by its name */
+	key_entry = hash_search(pljulia_plan_key_hashtable, &key, HASH_ENTER,
+							&found_hashentry);
+	if (!found_hashentry)
+		key_entry->query_desc = qdesc;
+	dlist_push_head(&pljulia_plan_lru, &qdesc->lru_node);
+	pfree(argtypes);
+
+	return jl_cstr_to_string(qdesc->qname);
 }
 
+/*
+ * Release a plan saved by spi_prepare. The plan is freed once it has been
+ * released as many times as it was prepared, or at the end of its execution
+ * if it is being executed.
+ */
 void
-julia_setup_input_args(FunctionCallInfo fcinfo, HeapTuple procedure_tuple,
-					   Form_pg_proc procedure_struct, jl_value_t **boxed_args,
-					   pljulia_proc_desc *prodesc)
+pljulia_spi_freeplan(jl_value_t *plan)
 {
-	Oid		   *argtypes;
-	char	  **argnames;
-	char	   *argmodes;
-	int			i;
-	Form_pg_type type_struct;
-	HeapTuple	type_tuple;
-	MemoryContext proc_cxt;
-	bool		is_array_type;
-
-	get_func_arg_info(procedure_tuple, &argtypes, &argnames, &argmodes);
-	proc_cxt = prodesc->mcxt;
+	pljulia_query_entry *hash_entry;
+	pljulia_query_desc *qdesc;
 
-	for (i = 0; i < fcinfo->nargs; i++)
-	{
-		Oid			argtype = procedure_struct->proargtypes.values[i];
+	hash_entry = hash_search(pljulia_query_hashtable, jl_string_ptr(plan),
+							 HASH_FIND, NULL);
+	if (hash_entry == NULL)
+		elog(ERROR, "spi_freeplan: Invalid prepared query passed");
 
-		type_tuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(argtype));
-		if (!HeapTupleIsValid(type_tuple))
-			elog(ERROR, "cache lookup failed for type %u", argtype);
+	qdesc = hash_entry->query_desc;
+	if (qdesc->refcount > 0 && --qdesc->refcount == 0 &&
+		qdesc->use_count == 0)
+		pljulia_plan_free(qdesc);
+}
 
-		prodesc->arg_is_rowtype[i] = type_is_rowtype(argtypes[i]);
+/*
+ * The key of a saved plan in pljulia_plan_key_hashtable
+ */
+static uint64
+pljulia_plan_key(const char *query, int nargs, Oid *argtypes)
+{
+	uint64		key;
 
-		type_struct = (Form_pg_type) GETSTRUCT(type_tuple);
-		if (!prodesc->arg_is_rowtype[i])
-			fmgr_info_cxt(type_struct->typoutput, &(prodesc->arg_out_func[i]),
-						  proc_cxt);
-		/* Whether it's a "true" array type */
-		is_array_type = (type_struct->typelem != 0 &&
-						 type_struct->typlen == -1);
-		prodesc->arg_arraytype[i] = (is_array_type) ? argtypes[i] : InvalidOid;
+	key = hash_bytes_extended((const unsigned char *) query, strlen(query), 0);
+	return hash_combine64(key,
+						  hash_bytes_extended((const unsigned char *) argtypes,
+											  nargs * sizeof(Oid), 0));
+}
 
-		ReleaseSysCache(type_tuple);
-		/* First check if the input argument is NULL */
-		if (fcinfo->args[i].isnull)
-		{
-			boxed_args[i] = jl_nothing;
-			continue;
-		}
-		boxed_args[i] = convert_arg_to_julia(fcinfo->args[i].value,
-											 argtypes[i], prodesc, i);
+/*
+ * End an execution of a saved plan, freeing it if spi_freeplan was called
+ * in the meantime
+ */
+static void
+pljulia_plan_release(pljulia_query_desc *qdesc)
+{
+	if (--qdesc->use_count == 0 && qdesc->refcount == 0)
+		pljulia_plan_free(qdesc);
+}
 
-	}
+/*
+ * Free a saved plan and remove it from the hash tables. Its name becomes
+ * invalid.
+ */
+static void
+pljulia_plan_free(pljulia_query_desc *qdesc)
+{
+	pljulia_plan_key_entry *key_entry;
+
+	hash_search(pljulia_query_hashtable, qdesc->qname, HASH_REMOVE, NULL);
+	key_entry = hash_search(pljulia_plan_key_hashtable, &qdesc->key,
+							HASH_FIND, NULL);
+	if (key_entry != NULL && key_entry->query_desc == qdesc)
+		hash_search(pljulia_plan_key_hashtable, &qdesc->key, HASH_REMOVE,
+					NULL);
+	dlist_delete(&qdesc->lru_node);
+	SPI_freeplan(qdesc->plan);
+	MemoryContextDelete(qdesc->plan_cxt);
 }
 
 jl_value_t *
-convert_arg_to_julia(Datum d, Oid argtype, pljulia_proc_desc *prodesc, int i)
+pljulia_spi_execplan(jl_value_t *plan, jl_value_t *arguments, jl_value_t *lim)
 {
-	jl_value_t *result;
-	bool		is_array_type = (prodesc->arg_arraytype[i] != InvalidOid);
+	char	   *nulls;
+	int			limit;
+	Datum	   *argvalues;
+	pljulia_query_desc *qdesc;
+	int			spi_rv;
+	jl_value_t *ret_val;
 
-	if (is_array_type)
-		result = julia_array_from_datum(d, argtype);
-	else if (prodesc->arg_is_rowtype[i])
+	ret_val = jl_eval_string("[]");
+	qdesc = pljulia_find_plan(plan, "spi_exec_prepared");
+	pljulia_plan_args(qdesc, arguments, &argvalues, &nulls);
+
+	/* Execute the plan */
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI manager");
+
+	limit = 0;
+	if (!jl_is_nothing(lim) && jl_is_int64(lim))
+		limit = jl_unbox_int64(lim);
+	qdesc->use_count++;
+	PG_TRY();
 	{
-		result = julia_dict_from_datum(d);
+		spi_rv = SPI_execp(qdesc->plan, argvalues, nulls, limit);
 	}
-	else
+	PG_FINALLY();
 	{
-		char	   *value;
+		pljulia_plan_release(qdesc);
+	}
+	PG_END_TRY();
 
-		value = OutputFunctionCall(&prodesc->arg_out_func[i], d);
-		result = pg_oid_to_jl_value(argtype, value);
+	if (spi_rv > 0 && SPI_tuptable != NULL)
+		ret_val = pljulia_rows_from_tuptable(SPI_tuptable, SPI_processed);
+	if (spi_rv == SPI_OK_INSERT || spi_rv == SPI_OK_UPDATE || spi_rv == SPI_OK_DELETE)
+	{
+		/* SPI_processed is a uint64 */
+		ret_val = jl_box_int64(SPI_processed);
 	}
 
-	return result;
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish() failed");
+	return ret_val;
 }
 
+/*
+ * Execute a query and keep its result for lazy access by the SPIResult and
+ * SPIRow types of the PLJulia module, which decode a value only when it is
+ * used. Returns a Julia vector with a handle to the result, the transaction
+ * generation it belongs to, the column names and the number of rows, or the
+ * number of rows processed if the statement doesn't return rows.
+ */
 jl_value_t *
-julia_dict_from_datum(Datum d)
+pljulia_spi_exec_rows(jl_value_t *cmd, jl_value_t *lim)
 {
-	HeapTupleHeader td;
-	Oid			tupType;
-	int32		tupTypmod;
-	TupleDesc	tupdesc = NULL;
-	HeapTupleData tmptup;
-	jl_value_t *ret;
+	char	   *command;
+	int			row_limit;
+	int			ret;
+	jl_value_t *ret_val = NULL;
+	jl_array_t *names = NULL;
 
-	td = DatumGetHeapTupleHeader(d);
-	/* Extract rowtype info and find a tupdesc */
-	tupType = HeapTupleHeaderGetTypeId(td);
-	tupTypmod = HeapTupleHeaderGetTypMod(td);
-	tupdesc = lookup_rowtype_tupdesc(tupType, tupTypmod);
-	/* Build a temporary HeapTuple control structure */
-	tmptup.t_len = HeapTupleHeaderGetDatumLength(td);
-	tmptup.t_data = td;
+	command = jl_string_ptr(cmd);
+	row_limit = jl_unbox_int64(lim);
 
-	ret = pljulia_dict_from_tuple(&tmptup, tupdesc, true);
-	ReleaseTupleDesc(tupdesc);
-	return ret;
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI manager");
+
+	ret = SPI_exec(command, row_limit);
+	if (ret > 0 && SPI_tuptable != NULL)
+	{
+		SPITupleTable *tuptable = SPI_tuptable;
+		TupleDesc	tupdesc = tuptable->tupdesc;
+		pljulia_spi_result *result;
+		int			i;
+
+		/* keep the tuple table after SPI_finish */
+		MemoryContextSetParent(tuptable->tuptabcxt, TopTransactionContext);
+		result = (pljulia_spi_result *)
+			MemoryContextAllocZero(tuptable->tuptabcxt,
+								   sizeof(pljulia_spi_result));
+		result->tuptable = tuptable;
+		result->ntuples = SPI_processed;
+		result->generation = pljulia_xact_generation;
+		result->outfuncs = (FmgrInfo *)
+			MemoryContextAllocZero(tuptable->tuptabcxt,
+								   tupdesc->natts * sizeof(FmgrInfo));
+
+		JL_GC_PUSH2(&ret_val, &names);
+		names = jl_alloc_vec_any(tupdesc->natts);
+		for (i = 0; i < tupdesc->natts; i++)
+			jl_arrayset(names,
+						jl_cstr_to_string(NameStr(TupleDescAttr(tupdesc, i)->attname)),
+						i);
+		ret_val = (jl_value_t *) jl_alloc_vec_any(4);
+		jl_arrayset((jl_array_t *) ret_val, jl_box_voidpointer(result), 0);
+		jl_arrayset((jl_array_t *) ret_val,
+					jl_box_uint64(result->generation), 1);
+		jl_arrayset((jl_array_t *) ret_val, (jl_value_t *) names, 2);
+		jl_arrayset((jl_array_t *) ret_val, jl_box_int64(result->ntuples), 3);
+		JL_GC_POP();
+	}
+	else
+		ret_val = jl_box_int64(SPI_processed);
+
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish() failed");
+	return ret_val;
 }
 
+/*
+ * Decode the value of a column (0-based) of a row (0-based) of a result
+ * kept by pljulia_spi_exec_rows, like a row dictionary would hold it.
+ */
 jl_value_t *
-pljulia_dict_from_tuple(HeapTuple tuple, TupleDesc tupdesc,
-						bool include_generated)
+pljulia_spi_result_value(pljulia_spi_result *result, uint64 generation,
+						 int64 row, int64 column)
 {
-	int			i;
+	TupleDesc	tupdesc;
 	Form_pg_attribute att;
-	char	   *attname;
 	Datum		attr;
 	bool		isnull;
-	Oid			typoutput;
-	bool		typisvarlena;
-	jl_value_t *dict,
-			   *key,
-			   *value;
-	jl_function_t *dict_set;
+	char	   *outputstr;
+	jl_value_t *value;
 
-	/* dict_set(key, value, dict) */
-	dict_set = jl_get_function(jl_main_module, "dict_set");
-	/* create an empty dictionary ({Any, Any}) */
-	dict = jl_eval_string("Dict()");
+	if (generation != pljulia_xact_generation)
+		elog(ERROR, "SPI result used outside of the transaction that created it");
 
-	for (i = 0; i < tupdesc->natts; i++)
-	{
-		att = TupleDescAttr(tupdesc, i);
-		/* ignore dropped */
-		if (att->attisdropped)
-			continue;
-		if (att->attgenerated && !include_generated)
-			continue;
-		/* get attribute name */
-		attname = NameStr(att->attname);
-		key = jl_cstr_to_string(attname);
-		/* get its value as Datum */
-		attr = heap_getattr(tuple, i + 1, tupdesc, &isnull);
-		getTypeOutputInfo(att->atttypid, &typoutput, &typisvarlena);
+	tupdesc = result->tuptable->tupdesc;
+	if (row < 0 || (uint64) row >= result->ntuples ||
+		column < 0 || column >= tupdesc->natts)
+		elog(ERROR, "SPI result has no row " INT64_FORMAT " column " INT64_FORMAT,
+			 row + 1, column + 1);
 
-		if (isnull)
-		{
-			/* just do dict[attname] = nothing */
-			jl_call3(dict_set, key, (jl_value_t *) jl_nothing, dict);
-			continue;
-		}
+	attr = heap_getattr(result->tuptable->vals[row], column + 1, tupdesc,
+						&isnull);
+	if (isnull)
+		return jl_nothing;
 
-		/*
-		 * not NULL: convert the value to its julia representation first, then
-		 * call dict_set to insert it in the dictionary. For now assume all
-		 * fields of the tuple will be base types.
-		 */
-		else
-		{
-			char	   *outputstr;
+	att = TupleDescAttr(tupdesc, column);
+	if (!OidIsValid(result->outfuncs[column].fn_oid))
+	{
+		Oid			typoutput;
+		bool		typisvarlena;
 
-			outputstr = OidOutputFunctionCall(typoutput, attr);
-			value = pg_oid_to_jl_value(att->atttypid, outputstr);
-			jl_call3(dict_set, key, (jl_value_t *) value, dict);
-		}
+		getTypeOutputInfo(att->atttypid, &typoutput, &typisvarlena);
+		fmgr_info_cxt(typoutput, &result->outfuncs[column],
+					  result->tuptable->tuptabcxt);
 	}
-	return dict;
+	outputstr = OutputFunctionCall(&result->outfuncs[column], attr);
+	value = pg_oid_to_jl_value(att->atttypid, outputstr);
+	pfree(outputstr);
+	return value;
 }
 
-jl_value_t *
-julia_array_from_datum(Datum d, Oid argtype)
+/*
+ * Free a result kept by pljulia_spi_exec_rows. Results of past transactions
+ * are already gone with their TopTransactionContext.
+ */
+void
+pljulia_spi_result_free(pljulia_spi_result *result, uint64 generation)
 {
-	ArrayType  *ar;
-	Oid			elementtype,
-				typioparam,
-				typoutputfunc;
-	int16		typlen;
-	bool		typbyval;
-	char		typalign,
-				typdelim;
-	int			i,
-				j,
-				nitems,
-				ndims,
-			   *dims;
-	bool	   *nulls;
-	Datum	   *elements;
-	jl_array_t *jl_arr;
-	char	   *value;
-	jl_value_t **types,
-			  **tupvalues;		/* types: the dimension types, so all int64
-								 * tupvalues: the size of each dimension  */
-	jl_tupletype_t *tt;
-	jl_function_t *init_arr;
-	jl_value_t *jl_boxed_elem,
-			   *dimtuple;
-	FmgrInfo   *arg_out_func;
-	Form_pg_type type_struct;
-	HeapTuple	type_tuple;
-
-	arg_out_func = (FmgrInfo *) palloc0(sizeof(FmgrInfo));
-	ar = DatumGetArrayTypeP(d);
-	elementtype = ARR_ELEMTYPE(ar);
-	ndims = ARR_NDIM(ar);
-	dims = ARR_DIMS(ar);
-
-	types = (jl_value_t **) palloc0(ndims * sizeof(jl_value_t *));
-	tupvalues = (jl_value_t **) palloc0(ndims * sizeof(jl_value_t *));
-
-	get_typlenbyvalalign(elementtype, &typlen, &typbyval, &typalign);
-
-	/* get datum representation of each array element */
-	deconstruct_array(ar, elementtype, typlen, typbyval, typalign, &elements,
-					  &nulls, &nitems);
-	/* elements[i] is a datum */
-
-	/* get the conversion function from Datum to elementtype */
-	type_tuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(elementtype));
-	if (!HeapTupleIsValid(type_tuple))
-		elog(ERROR, "cache lookup failed for type %u", argtype);
-
-	type_struct = (Form_pg_type) GETSTRUCT(type_tuple);
-	fmgr_info(type_struct->typoutput, arg_out_func);
-	ReleaseSysCache(type_tuple);
-
-	for (i = 0; i < ndims; i++)
-		types[i] = (jl_value_t *) jl_int64_type;
+	if (generation == pljulia_xact_generation)
+		MemoryContextDelete(result->tuptable->tuptabcxt);
+}
 
-	tt = jl_apply_tuple_type_v(types, ndims);
+/*
+ * Invalidate the objects handed to Julia that live in transaction memory,
+ * closing the table scans before commit.
+ */
+static void
+pljulia_xact_callback(XactEvent event, void *arg)
+{
+	switch (event)
+	{
+		case XACT_EVENT_PRE_COMMIT:
+		case XACT_EVENT_PRE_PREPARE:
+			while (!dlist_is_empty(&pljulia_table_scans))
+				pljulia_table_scan_end(dlist_container(pljulia_table_scan, node,
+													   dlist_head_node(&pljulia_table_scans)));
+			break;
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+		case XACT_EVENT_PREPARE:
+			if (pljulia_cache_logged)
+				pljulia_cache_rollback(event == XACT_EVENT_ABORT ||
+									   event == XACT_EVENT_PARALLEL_ABORT ?
+									   TopSubTransactionId :
+									   InvalidSubTransactionId);
+			pljulia_xact_generation++;
+			/* after an abort the resource owner released the scans */
+			dlist_init(&pljulia_table_scans);
+			/* and the large objects are closed */
+			if (pljulia_lo_nhandles > 0)
+				memset(pljulia_lo_handles, 0,
+					   pljulia_lo_nhandles * sizeof(pljulia_lo_handle));
+			break;
+		default:
+			break;
+	}
+}
 
-	for (i = 0; i < ndims; i++)
-		tupvalues[i] = jl_box_int64(dims[i]);
+/*
+ * Remove the session cache entries written by an aborted subtransaction and
+ * invalidate its large objects, which it closed. Those of a committed one
+ * now belong to its parent.
+ */
+static void
+pljulia_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+						 SubTransactionId parentSubid, void *arg)
+{
+	int			i;
 
-	dimtuple = jl_new_structv(tt, tupvalues, ndims);
-	init_arr = jl_get_function(jl_main_module, "init_nulls_anyarray");
-	jl_arr = jl_call1(init_arr, dimtuple);
+	if (event == SUBXACT_EVENT_ABORT_SUB && pljulia_cache_logged)
+		pljulia_cache_rollback(mySubid);
 
-	for (i = 0; i < nitems; i++)
+	if (event != SUBXACT_EVENT_ABORT_SUB && event != SUBXACT_EVENT_COMMIT_SUB)
+		return;
+	for (i = 0; i < pljulia_lo_nhandles; i++)
 	{
-		j = calculate_cm_offset(i, ndims, dims);
-		/* Check whether null */
-		if (nulls[i])
-		{
-			/* already initialized to nothing so this is redundant */
-			jl_arrayset(jl_arr, (jl_value_t *) jl_nothing, j);
+		if (pljulia_lo_handles[i].serial == 0 ||
+			pljulia_lo_handles[i].subid != mySubid)
 			continue;
-		}
-		value = OutputFunctionCall(arg_out_func, elements[i]);
-
-		jl_boxed_elem = pg_oid_to_jl_value(elementtype, value);
-		jl_arrayset(jl_arr, (jl_value_t *) jl_boxed_elem, j);
+		if (event == SUBXACT_EVENT_ABORT_SUB)
+			pljulia_lo_handles[i].serial = 0;
+		else
+			pljulia_lo_handles[i].subid = parentSubid;
 	}
-	return (jl_value_t *) jl_arr;
 }
 
-Datum
-pljulia_inline_handler(PG_FUNCTION_ARGS)
+/*
+ * Remove the entries of session caches written since subtransaction subid
+ * started, or only forget which entries the transaction wrote if subid is
+ * InvalidSubTransactionId. This runs while the transaction ends, where a
+ * Julia error can only be reported.
+ */
+static void
+pljulia_cache_rollback(SubTransactionId subid)
 {
-	/*
-	 * An inline code block is basically a function that doesn't take input
-	 * arguments and does not return anything (void)
-	 */
-	InlineCodeBlock *codeblock = (InlineCodeBlock *) PG_GETARG_POINTER(0);
-	char	   *source_code = codeblock->source_text;
-
-	jl_eval_string(source_code);
+	jl_call1(jl_get_function(pljulia_module, "cache_rollback"),
+			 jl_box_uint32(subid));
 	if (jl_exception_occurred())
-		elog(ERROR, "%s",
-			 jl_string_ptr(jl_eval_string(
-										  "sprint(showerror, ccall(:jl_exception_occurred, Any, ()))")));
+	{
+		jl_exception_clear();
+		elog(WARNING, "could not roll back the session caches");
+	}
+	if (subid == InvalidSubTransactionId || subid == TopSubTransactionId)
+		pljulia_cache_logged = false;
+}
 
-	PG_RETURN_VOID();
+/*
+ * Called by session caches when they write an entry, so that it is removed
+ * if the current subtransaction aborts. Returns the subtransaction.
+ */
+uint32
+pljulia_cache_log(void)
+{
+	pljulia_cache_logged = true;
+	return GetCurrentSubTransactionId();
 }
 
 /*
- * Handle function, procedure, and trigger calls.
+ * The maximum size of the cache of cache_get!(f, key), 0 meaning no limit
  */
-Datum
-pljulia_call_handler(PG_FUNCTION_ARGS)
+int64
+pljulia_session_cache_size_bytes(void)
 {
-	Datum		ret;
-	pljulia_call_data *volatile save_call_data = current_call_data;
-	pljulia_call_data this_call_data;
+	return (int64) pljulia_session_cache_size * 1024;
+}
 
-	/* Initialize current-call status record */
-	MemSet(&this_call_data, 0, sizeof(this_call_data));
-	this_call_data.fcinfo = fcinfo;
+/*
+ * Call a SQL function, given by its signature such as "power(float8,float8)",
+ * directly through fmgr. Arguments of boolean, numeric and text types are
+ * converted from their Julia values without going through text, and so are
+ * the results of boolean, integer and floating point types.
+ */
+jl_value_t *
+pljulia_pg_call(jl_value_t *signature, jl_value_t *arguments)
+{
+	pljulia_fcall_entry *entry;
+	MemoryContext call_cxt;
+	MemoryContext oldcontext;
+	jl_value_t *volatile ret_val = NULL;
+	Datum		result = (Datum) 0;
+	AclResult	aclresult;
+	int			nargs;
+	int			i;
 
-	current_call_data = &this_call_data;
-	/* run Julia code */
-	if (CALLED_AS_TRIGGER(fcinfo))
-		ret = pljulia_trigger_handler(fcinfo);
-	else if (CALLED_AS_EVENT_TRIGGER(fcinfo))
-	{
-		pljulia_event_trigger_handler(fcinfo);
-		ret = (Datum) 0;
-	}
-	else
-		ret = pljulia_execute(fcinfo);
+	LOCAL_FCINFO(fcinfo, FUNC_MAX_ARGS);
 
-	current_call_data = save_call_data;
+	entry = pljulia_fcall_lookup(jl_string_ptr(signature));
+
+	nargs = jl_array_len((jl_array_t *) arguments);
+	if (nargs != entry->nargs)
+		elog(ERROR, "pg_call: %s expects %d argument(s), %d passed",
+			 entry->signature, entry->nargs, nargs);
 
 	/*
-	 * strongly recommended: notify Julia that the program is about to
-	 * terminate. this allows Julia time to cleanup pending write requests and
-	 * run all finalizers
+	 * Checked on every call, as the executor does: the privilege can come
+	 * from a role membership granted or revoked since the last one.
 	 */
-	/* jl_atexit_hook(0); */
+	aclresult = pg_proc_aclcheck(entry->flinfo.fn_oid, GetUserId(),
+								 ACL_EXECUTE);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, OBJECT_FUNCTION,
+					   get_func_name(entry->flinfo.fn_oid));
 
-	return ret;
+	call_cxt = AllocSetContextCreate(CurrentMemoryContext, "PL/Julia pg_call",
+									 ALLOCSET_SMALL_SIZES);
+	oldcontext = MemoryContextSwitchTo(call_cxt);
+
+	InitFunctionCallInfoData(*fcinfo, &entry->flinfo, nargs, entry->collation,
+							 NULL, NULL);
+	for (i = 0; i < nargs; i++)
+	{
+		jl_value_t *arg = jl_arrayref((jl_array_t *) arguments, i);
+
+		fcinfo->args[i].isnull = jl_is_nothing(arg);
+		if (fcinfo->args[i].isnull)
+			fcinfo->args[i].value = (Datum) 0;
+		else if (!jl_value_to_param_datum(arg, entry->argconvs[i],
+										  &fcinfo->args[i].value))
+			fcinfo->args[i].value = jl_value_t_to_datum(NULL, arg,
+														entry->argtypes[i],
+														false);
+	}
+
+	pljulia_fcall_depth++;
+	PG_TRY();
+	{
+		bool		strict_null = false;
+
+		if (entry->flinfo.fn_strict)
+			for (i = 0; i < nargs; i++)
+				strict_null |= fcinfo->args[i].isnull;
+
+		if (strict_null)
+			fcinfo->isnull = true;
+		else
+			result = FunctionCallInvoke(fcinfo);
+
+		if (fcinfo->isnull || entry->rettype == VOIDOID)
+			ret_val = jl_nothing;
+		else
+		{
+			ret_val = pg_datum_to_jl_value(result, entry->rettype);
+			if (ret_val == NULL)
+				ret_val = pg_oid_to_jl_value(entry->rettype,
+											 OutputFunctionCall(&entry->retoutfunc,
+																result));
+		}
+	}
+	PG_FINALLY();
+	{
+		pljulia_fcall_depth--;
+	}
+	PG_END_TRY();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(call_cxt);
+	return ret_val;
 }
 
 /*
- * Retrieve Julia code and create a user-defined function
- * with a unique name.
+ * Find the function of a pg_call signature, resolving it on first use
  */
-pljulia_proc_desc *
-pljulia_compile(FunctionCallInfo fcinfo, HeapTuple procedure_tuple,
-				Form_pg_proc procedure_struct, bool is_trigger,
-				bool is_event_trigger)
+static pljulia_fcall_entry *
+pljulia_fcall_lookup(const char *signature)
 {
-	Datum		procedure_source_datum;
-	const char *procedure_code;
-	bool		isnull;
-	volatile MemoryContext proc_cxt = NULL;
+	pljulia_fcall_entry *entry;
+	HeapTuple	procTup;
+	Form_pg_proc procStruct;
+	MemoryContext cxt = pljulia_fcall_cxt;
 	MemoryContext oldcontext;
-
-	int			compiled_len = 0;
-	char	   *compiled_code;
-	pljulia_proc_desc *prodesc = NULL;
-
+	uint64		key;
+	bool		found;
+	bool		collatable = false;
+	Oid			fn_oid;
+	Oid			typoutput;
+	bool		typisvarlena;
 	int			i;
-	FmgrInfo   *arg_out_func;
-	Form_pg_type type_struct;
-	HeapTuple	type_tuple;
-
-	Oid		   *argtypes;
-	char	  **argnames;
-	char	   *argmodes;
-	char	   *value;
-
-	bool		found_hashentry;
-	pljulia_proc_key proc_key;
-	pljulia_hash_entry *hash_entry;
-
-	/* First try to find the function in the lookup table */
-	proc_key.fn_oid = fcinfo->flinfo->fn_oid;
-	proc_key.is_trigger = is_trigger;
-	hash_entry = hash_search(pljulia_proc_hashtable, &proc_key, HASH_FIND,
-							 &found_hashentry);
 
-	if (found_hashentry)
-		prodesc = hash_entry->prodesc;
+	if (!pljulia_fcall_valid && pljulia_fcall_depth == 0)
+	{
+		MemoryContextReset(pljulia_fcall_cxt);
+		pljulia_fcall_hashtable = NULL;
+		pljulia_fcall_valid = true;
+	}
+	if (pljulia_fcall_hashtable == NULL)
+	{
+		HASHCTL		hash_ctl;
+
+		memset(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(uint64);
+		hash_ctl.entrysize = sizeof(pljulia_fcall_entry);
+		hash_ctl.hcxt = pljulia_fcall_cxt;
+		pljulia_fcall_hashtable = hash_create("PL/Julia pg_call functions hashtable",
+											  32, &hash_ctl,
+											  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
 
-	if (prodesc != NULL)
+	key = hash_bytes_extended((const unsigned char *) signature,
+							  strlen(signature), 0);
+	entry = hash_search(pljulia_fcall_hashtable, &key, HASH_FIND, NULL);
+	if (entry != NULL)
 	{
-		/* Check that it hasn't been modified (CREATE OR REPLACE) */
-		if (prodesc->fn_xmin ==
-			HeapTupleHeaderGetRawXmin(procedure_tuple->t_data))
+		if (strcmp(entry->signature, signature) != 0)
 		{
-			/* it's ok to return it, hasn't been modified */
-			return prodesc;
+			/* a hash collision, this signature is resolved on every call */
+			cxt = CurrentMemoryContext;
 		}
-		else
+		else if (OverrideSearchPathMatchesCurrent(entry->search_path))
+			return entry;
+		else if (pljulia_fcall_depth == 0)
 		{
-			/* remove this outdated entry from the hash table */
 			/*
-			 * found_hashentry is redundant since we don't expect a returned
-			 * entry from HASH_REMOVE
+			 * The signature may name another function with this search_path.
+			 * Empty the cache, the other signatures are resolved again too.
 			 */
-			hash_search(pljulia_proc_hashtable, &proc_key, HASH_REMOVE, NULL);
+			MemoryContextReset(pljulia_fcall_cxt);
+			pljulia_fcall_hashtable = NULL;
+			return pljulia_fcall_lookup(signature);
+		}
+		else
+		{
+			/* the entry may be in use, resolve the signature for this call */
+			cxt = CurrentMemoryContext;
 		}
 	}
 
-	/***************************************************
-	 * At this point prodesc is either NULL or outdated
-	 * so we have to create a new entry for the function
-	 ***************************************************/
-
-	/*
-	 * the length here is arbitrary but should be enough for at-most-32-length
-	 * oid and even the NAMEDATALEN-length function name should we decide to
-	 * include that too
-	 */
-	char		internal_procname[256];
-
-	procedure_source_datum = SysCacheGetAttr(PROCOID, procedure_tuple,
-											 Anum_pg_proc_prosrc, &isnull);
-	if (isnull)
-		elog(ERROR, "null prosrc");
-
-	procedure_code = DatumGetCString(DirectFunctionCall1(textout,
-														 procedure_source_datum));
-	elog(DEBUG1, "procedure code:\n%s", procedure_code);
-
-	/* if it's a regular function call */
-	if (!is_trigger && !is_event_trigger)
+	fn_oid = DatumGetObjectId(DirectFunctionCall1(regprocedurein,
+												  CStringGetDatum(signature)));
+	procTup = SearchSysCache1(PROCOID, ObjectIdGetDatum(fn_oid));
+	if (!HeapTupleIsValid(procTup))
+		elog(ERROR, "cache lookup failed for function %u", fn_oid);
+	procStruct = (Form_pg_proc) GETSTRUCT(procTup);
+
+	if (procStruct->prokind != PROKIND_FUNCTION)
+		elog(ERROR, "pg_call: %s is not a plain function", signature);
+	if (procStruct->proretset)
+		elog(ERROR, "pg_call: set-returning function %s is not supported",
+			 signature);
+	if (IsPolymorphicType(procStruct->prorettype))
+		elog(ERROR, "pg_call: polymorphic function %s is not supported",
+			 signature);
+	for (i = 0; i < procStruct->pronargs; i++)
 	{
-		/*
-		 * Add the final carriage return to the length of the original
-		 * procedure.
-		 */
-		compiled_len += strlen(procedure_code) + 1;
-
-		arg_out_func = (FmgrInfo *) palloc0(fcinfo->nargs * sizeof(FmgrInfo));
-
-		proc_cxt = AllocSetContextCreate(TopMemoryContext, "PL/Julia function",
-										 ALLOCSET_SMALL_SIZES);
-
-		get_func_arg_info(procedure_tuple, &argtypes, &argnames, &argmodes);
-
-		elog(DEBUG1, "nargs %d", fcinfo->nargs);
+		Oid			argtype = procStruct->proargtypes.values[i];
 
-		snprintf(internal_procname, sizeof(internal_procname), "pljulia_%u",
-				 fcinfo->flinfo->fn_oid);
-		/* +1 is for the line break (\n) */
-		compiled_len += strlen("function ") + 1;
-		i = strlen(internal_procname);
-		compiled_len += i;
-		internal_procname[i] = '\0';
-		/* one \n and '(' and ')' */
-		compiled_len += strlen("end") + 3;
+		if (IsPolymorphicType(argtype))
+			elog(ERROR, "pg_call: polymorphic function %s is not supported",
+				 signature);
+		collatable |= type_is_collatable(argtype);
+	}
 
-		/*
-		 * Loop through the parameters to determine how big of a buffer is
-		 * needed for prepending the parameter names as input arguments to the
-		 * function/procedure code.
-		 */
-		for (i = 0; i < fcinfo->nargs; i++)
-		{
-			Oid			argtype = procedure_struct->proargtypes.values[i];
+	oldcontext = MemoryContextSwitchTo(cxt);
+	if (entry == NULL)
+		entry = hash_search(pljulia_fcall_hashtable, &key, HASH_ENTER, &found);
+	else
+		entry = (pljulia_fcall_entry *) palloc0(sizeof(pljulia_fcall_entry));
+	entry->signature = pstrdup(signature);
+	entry->nargs = procStruct->pronargs;
+	entry->argtypes = (Oid *) palloc(Max(entry->nargs, 1) * sizeof(Oid));
+	entry->argconvs = (pljulia_param_conv *)
+		palloc(Max(entry->nargs, 1) * sizeof(pljulia_param_conv));
+	for (i = 0; i < entry->nargs; i++)
+	{
+		entry->argtypes[i] = procStruct->proargtypes.values[i];
+		entry->argconvs[i] = pg_oid_to_param_conv(entry->argtypes[i]);
+	}
+	entry->rettype = procStruct->prorettype;
+	entry->collation = collatable ? DEFAULT_COLLATION_OID : InvalidOid;
+	entry->search_path = GetOverrideSearchPath(cxt);
+	ReleaseSysCache(procTup);
 
-			type_tuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(argtype));
-			if (!HeapTupleIsValid(type_tuple))
-				elog(ERROR, "cache lookup failed for type %u", argtype);
+	fmgr_info_cxt(fn_oid, &entry->flinfo, cxt);
+	if (entry->rettype != VOIDOID)
+	{
+		getTypeOutputInfo(entry->rettype, &typoutput, &typisvarlena);
+		fmgr_info_cxt(typoutput, &entry->retoutfunc, cxt);
+	}
+	MemoryContextSwitchTo(oldcontext);
 
-			type_struct = (Form_pg_type) GETSTRUCT(type_tuple);
-			fmgr_info_cxt(type_struct->typoutput, &(arg_out_func[i]), proc_cxt);
-			ReleaseSysCache(type_tuple);
+	return entry;
+}
 
-			value = OutputFunctionCall(&arg_out_func[i], fcinfo->args[i].value);
+/*
+ * Syscache callback for pg_proc: the functions of pg_call are resolved again
+ * on their next call
+ */
+static void
+pljulia_fcall_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+{
+	pljulia_fcall_valid = false;
+}
 
-			elog(DEBUG1, "[%d] %s = %s :: %u", i, argnames[i], value, argtypes[i]);
+/*
+ * Start a sequential scan of a table with the active snapshot, for
+ * table_scan. columns is a Julia array of the names of the columns to read,
+ * all of them if it is empty. Like SELECT, this checks the SELECT privilege
+ * on these columns; tables with row level security are refused since their
+ * policies would be bypassed. Returns a Julia vector with a handle to the
+ * scan, the transaction generation it belongs to and the column names.
+ */
+jl_value_t *
+pljulia_table_scan_open(jl_value_t *table, jl_value_t *columns)
+{
+	pljulia_table_scan *tscan;
+	Relation	rel;
+	TupleDesc	tupdesc;
+	ParseState *pstate;
+	ParseNamespaceItem *nsitem;
+	RangeTblEntry *rte;
+	MemoryContext oldcontext;
+	ResourceOwner save_owner = CurrentResourceOwner;
+	jl_value_t *ret_val = NULL;
+	jl_array_t *names = NULL;
+	Oid			relid;
+	int			ncolumns;
+	int			i;
 
-			/* Factor in length of a ',' */
-			compiled_len += strlen(argnames[i]) + 1;
-		}
-		elog(DEBUG1, "compiled_len = %d", compiled_len);
+	rel = table_openrv(makeRangeVarFromNameList(stringToQualifiedNameList(jl_string_ptr(table))),
+					   AccessShareLock);
+	if (rel->rd_rel->relkind != RELKIND_RELATION &&
+		rel->rd_rel->relkind != RELKIND_MATVIEW)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("table_scan: \"%s\" is not a table or materialized view",
+						RelationGetRelationName(rel))));
+	tupdesc = RelationGetDescr(rel);
+
+	oldcontext = MemoryContextSwitchTo(TopTransactionContext);
+	tscan = (pljulia_table_scan *) palloc0(sizeof(pljulia_table_scan));
+	ncolumns = jl_array_len((jl_array_t *) columns);
+	tscan->attnums = (AttrNumber *) palloc(Max(ncolumns, tupdesc->natts) * sizeof(AttrNumber));
+	tscan->typids = (Oid *) palloc(Max(ncolumns, tupdesc->natts) * sizeof(Oid));
+	MemoryContextSwitchTo(oldcontext);
 
-		oldcontext = MemoryContextSwitchTo(proc_cxt);
-		/* stuff that the new prodesc uses must be palloc'd in this context */
-		compiled_code = (char *) palloc0(compiled_len * sizeof(char));
+	pstate = make_parsestate(NULL);
+	nsitem = addRangeTableEntryForRelation(pstate, rel, AccessShareLock,
+										   NULL, false, false);
+	rte = nsitem->p_rte;
+	rte->requiredPerms = ACL_SELECT;
 
-		/*
-		 * Declare the procedure code as a function with the input parameters
-		 * as the function arguments.
-		 */
-		compiled_code[0] = '\0';
-		strcpy(compiled_code, "function ");
-		strcat(compiled_code, internal_procname);
-		/* now the argument names */
-		strcat(compiled_code, "(");
-		for (i = 0; i < fcinfo->nargs; i++)
+	if (ncolumns == 0)
+	{
+		for (i = 0; i < tupdesc->natts; i++)
 		{
-			strcat(compiled_code, argnames[i]);
-			strcat(compiled_code, ",");
+			if (TupleDescAttr(tupdesc, i)->attisdropped)
+				continue;
+			tscan->attnums[tscan->ncols++] = i + 1;
 		}
-		/* remove the last ',' if present, close ')' */
-		if (i > 0)
+	}
+	else
+	{
+		for (i = 0; i < ncolumns; i++)
 		{
-			i = strlen(compiled_code) - 1;
-			compiled_code[i] = ')';
+			char	   *name = jl_string_ptr(jl_arrayref((jl_array_t *) columns, i));
+			AttrNumber	attnum = attnameAttNum(rel, name, false);
+
+			if (attnum == InvalidAttrNumber)
+				ereport(ERROR,
+						(errcode(ERRCODE_UNDEFINED_COLUMN),
+						 errmsg("column \"%s\" of relation \"%s\" does not exist",
+								name, RelationGetRelationName(rel))));
+			tscan->attnums[tscan->ncols++] = attnum;
 		}
-		else
-			strcat(compiled_code, ")");
-		strcat(compiled_code, procedure_code);
-		strcat(compiled_code, "\nend");
-		elog(DEBUG1, "compiled code (%ld)\n%s", strlen(compiled_code),
-			 compiled_code);
-
-		prodesc = (pljulia_proc_desc *) palloc0(sizeof(pljulia_proc_desc));
-		if (!prodesc)
-			elog(ERROR, "pljulia: out of memory");
-		prodesc->function_body = compiled_code;
-		prodesc->user_proname = pstrdup(NameStr(procedure_struct->proname));
-		prodesc->internal_proname = pstrdup(internal_procname);
-		prodesc->nargs = fcinfo->nargs;
-		prodesc->result_typid = procedure_struct->prorettype;
-		prodesc->fn_retisset = procedure_struct->proretset;
-		prodesc->fn_retistuple = type_is_rowtype(procedure_struct->prorettype);
-		prodesc->mcxt = proc_cxt;
-		prodesc->fn_xmin = HeapTupleHeaderGetRawXmin(procedure_tuple->t_data);
-		/* this is filled later on when handling the input args */
-		prodesc->arg_out_func = (FmgrInfo *) palloc0(prodesc->nargs *
-													 sizeof(FmgrInfo));
-		prodesc->arg_arraytype = (Oid *) palloc0(prodesc->nargs * sizeof(Oid));
-		prodesc->arg_is_rowtype = (bool *) palloc0(prodesc->nargs * sizeof(bool));
-		MemoryContextSwitchTo(oldcontext);
 	}
-	else if (is_trigger)
-	{
-		/* the following arguments are standard for trigger calls */
-		char	   *TD_standard_args =
-		"TD_name, TD_relid, TD_table_name, TD_table_schema, TD_event, TD_when, "
-		"TD_level, TD_NEW, TD_OLD, args";
-
-		compiled_len += strlen(procedure_code) + 1;
-		proc_cxt = AllocSetContextCreate(TopMemoryContext, "PL/Julia function",
-										 ALLOCSET_SMALL_SIZES);
-		snprintf(internal_procname, sizeof(internal_procname), "pljulia_%u",
-				 fcinfo->flinfo->fn_oid);
-		/* +1 is for the line break (\n) */
-		compiled_len += strlen("function ") + 1;
-		i = strlen(internal_procname);
-		compiled_len += i;
-		internal_procname[i] = '\0';
-		/* one \n and '(' and ')' */
-		compiled_len += strlen("end") + 3;
-		compiled_len += strlen(TD_standard_args);
-
-		oldcontext = MemoryContextSwitchTo(proc_cxt);
-		compiled_code = (char *) palloc0(compiled_len * sizeof(char));
-
-		compiled_code[0] = '\0';
-		strcpy(compiled_code, "function ");
-		strcat(compiled_code, internal_procname);
-		/* now the argument names */
-		strcat(compiled_code, "(");
-		strcat(compiled_code, TD_standard_args);
-		strcat(compiled_code, ")");
-
-		strcat(compiled_code, procedure_code);
-		strcat(compiled_code, "\nend");
-		elog(DEBUG1, "compiled code (%ld)\n%s", strlen(compiled_code),
-			 compiled_code);
-
-		prodesc = (pljulia_proc_desc *) palloc0(sizeof(pljulia_proc_desc));
-		if (!prodesc)
-			elog(ERROR, "pljulia: out of memory");
-		prodesc->function_body = compiled_code;
-		prodesc->user_proname = pstrdup(NameStr(procedure_struct->proname));
-		prodesc->internal_proname = pstrdup(internal_procname);
-		prodesc->mcxt = proc_cxt;
-		MemoryContextSwitchTo(oldcontext);
+	for (i = 0; i < tscan->ncols; i++)
+	{
+		AttrNumber	attnum = tscan->attnums[i];
+
+		tscan->typids[i] = TupleDescAttr(tupdesc, attnum - 1)->atttypid;
+		tscan->maxattnum = Max(tscan->maxattnum, attnum);
+		rte->selectedCols = bms_add_member(rte->selectedCols,
+										   attnum - FirstLowInvalidHeapAttributeNumber);
 	}
-	else if (is_event_trigger)
+	ExecCheckRTPerms(pstate->p_rtable, true);
+
+	if (check_enable_rls(RelationGetRelid(rel), InvalidOid, false) == RLS_ENABLED)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("table_scan not supported with row-level security")));
+
+	/* the resources of the scan belong to the transaction, not the call */
+	relid = RelationGetRelid(rel);
+	table_close(rel, NoLock);
+	tscan->owner = TopTransactionResourceOwner;
+	CurrentResourceOwner = tscan->owner;
+	PG_TRY();
 	{
-		/* the following arguments are standard for event trigger calls */
-		char	   *TD_standard_args = "TD_event, TD_tag";
-
-		compiled_len += strlen(procedure_code) + 1;
-		proc_cxt = AllocSetContextCreate(TopMemoryContext, "PL/Julia function",
-										 ALLOCSET_SMALL_SIZES);
-		snprintf(internal_procname, sizeof(internal_procname), "pljulia_%u",
-				 fcinfo->flinfo->fn_oid);
-		/* +1 is for the line break (\n) */
-		compiled_len += strlen("function ") + 1;
-		i = strlen(internal_procname);
-		compiled_len += i;
-		internal_procname[i] = '\0';
-		/* one \n and '(' and ')' */
-		compiled_len += strlen("end") + 3;
-		compiled_len += strlen(TD_standard_args);
-
-		oldcontext = MemoryContextSwitchTo(proc_cxt);
-		compiled_code = (char *) palloc0(compiled_len * sizeof(char));
-
-		compiled_code[0] = '\0';
-		strcpy(compiled_code, "function ");
-		strcat(compiled_code, internal_procname);
-		/* now the argument names */
-		strcat(compiled_code, "(");
-		strcat(compiled_code, TD_standard_args);
-		strcat(compiled_code, ")");
-
-		strcat(compiled_code, procedure_code);
-		strcat(compiled_code, "\nend");
-		elog(DEBUG1, "compiled code (%ld)\n%s", strlen(compiled_code),
-			 compiled_code);
-
-		prodesc = (pljulia_proc_desc *) palloc0(sizeof(pljulia_proc_desc));
-		if (!prodesc)
-			elog(ERROR, "pljulia: out of memory");
-		prodesc->function_body = compiled_code;
-		prodesc->user_proname = pstrdup(NameStr(procedure_struct->proname));
-		prodesc->internal_proname = pstrdup(internal_procname);
-		prodesc->mcxt = proc_cxt;
+		oldcontext = MemoryContextSwitchTo(TopTransactionContext);
+		tscan->rel = table_open(relid, AccessShareLock);
+		tscan->snapshot = RegisterSnapshot(GetActiveSnapshot());
+		tscan->scan = table_beginscan(tscan->rel, tscan->snapshot, 0, NULL);
+		tscan->slot = table_slot_create(tscan->rel, NULL);
+		dlist_push_head(&pljulia_table_scans, &tscan->node);
 		MemoryContextSwitchTo(oldcontext);
 	}
-	/* Create a new hashtable entry for the new function definition */
-	hash_entry = hash_search(pljulia_proc_hashtable, &proc_key, HASH_ENTER,
-							 &found_hashentry);
-	if (hash_entry == NULL)
-		elog(ERROR, "pljulia: hash table out of memory");
-	hash_entry->prodesc = prodesc;
-
-	/* insert function declaration into Julia */
-	jl_eval_string(compiled_code);
-	if (jl_exception_occurred())
-		show_julia_error();
+	PG_FINALLY();
+	{
+		CurrentResourceOwner = save_owner;
+	}
+	PG_END_TRY();
+
+	tupdesc = RelationGetDescr(tscan->rel);
+	JL_GC_PUSH2(&ret_val, &names);
+	names = jl_alloc_vec_any(tscan->ncols);
+	for (i = 0; i < tscan->ncols; i++)
+		jl_arrayset(names,
+					jl_cstr_to_string(NameStr(TupleDescAttr(tupdesc, tscan->attnums[i] - 1)->attname)),
+					i);
+	ret_val = (jl_value_t *) jl_alloc_vec_any(3);
+	jl_arrayset((jl_array_t *) ret_val, jl_box_voidpointer(tscan), 0);
+	jl_arrayset((jl_array_t *) ret_val, jl_box_uint64(pljulia_xact_generation), 1);
+	jl_arrayset((jl_array_t *) ret_val, (jl_value_t *) names, 2);
+	JL_GC_POP();
 
-	return prodesc;
+	return ret_val;
 }
 
 /*
- * Execute Julia code and handle the data returned by Julia.
+ * Read up to count more rows of a table scan into column vectors, deforming
+ * only the attributes that are returned. Returns a Julia vector with the
+ * column vectors, their validity masks (see pljulia_columns_from_tuptable)
+ * and whether the table is exhausted, in which case the scan is closed.
  */
-static Datum
-pljulia_execute(FunctionCallInfo fcinfo)
+jl_value_t *
+pljulia_table_scan_fetch(pljulia_table_scan *tscan, uint64 generation,
+						 int64 count)
 {
-	jl_value_t **boxed_args;
-	HeapTuple	procedure_tuple;
-	Form_pg_proc procedure_struct;
-	jl_value_t *ret;
-	jl_function_t *func;
-	Datum		retval;
-	ReturnSetInfo *rsi;
-
-	pljulia_proc_desc *prodesc = NULL;
+	pljulia_column_batch batch = {0};
+	ResourceOwner save_owner = CurrentResourceOwner;
+	MemoryContext batch_cxt;
+	MemoryContext oldcontext;
+	jl_value_t *ret_val = NULL;
+	volatile int64 nrows = 0;
+	volatile bool done = false;
+
+	if (generation != pljulia_xact_generation)
+		elog(ERROR, "table_scan used outside of the transaction that started it");
+	if (count < 1)
+		elog(ERROR, "table_scan: the batch size must be positive");
+
+	JL_GC_PUSH3(&ret_val, &batch.columns, &batch.valid);
+	pljulia_column_batch_init(&batch, tscan->typids, tscan->ncols, count);
+
+	/* the output functions may leak, free their memory with the batch */
+	batch_cxt = AllocSetContextCreate(CurrentMemoryContext,
+									  "PL/Julia table_scan batch",
+									  ALLOCSET_DEFAULT_SIZES);
+	oldcontext = MemoryContextSwitchTo(batch_cxt);
+	CurrentResourceOwner = tscan->owner;
+	PG_TRY();
+	{
+		while (nrows < count)
+		{
+			TupleTableSlot *slot = tscan->slot;
+			int			j;
+
+			if (!table_scan_getnextslot(tscan->scan, ForwardScanDirection, slot))
+			{
+				done = true;
+				break;
+			}
+			slot_getsomeattrs(slot, tscan->maxattnum);
+			for (j = 0; j < tscan->ncols; j++)
+			{
+				int			att = tscan->attnums[j] - 1;
+
+				pljulia_column_batch_set(&batch, nrows, j,
+										 slot->tts_values[att],
+										 slot->tts_isnull[att]);
+			}
+			nrows++;
+
+			CHECK_FOR_INTERRUPTS();
+		}
+	}
+	PG_FINALLY();
+	{
+		CurrentResourceOwner = save_owner;
+	}
+	PG_END_TRY();
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(batch_cxt);
 
-	rsi = (ReturnSetInfo *) fcinfo->resultinfo;
+	if (done)
+	{
+		pljulia_column_batch_truncate(&batch, nrows);
+		pljulia_table_scan_end(tscan);
+	}
 
-	procedure_tuple = SearchSysCache(PROCOID,
-									 ObjectIdGetDatum(fcinfo->flinfo->fn_oid), 0, 0, 0);
-	if (!HeapTupleIsValid(procedure_tuple))
-		elog(ERROR, "cache lookup failed for function %u",
-			 fcinfo->flinfo->fn_oid);
-	procedure_struct = (Form_pg_proc) GETSTRUCT(procedure_tuple);
+	ret_val = (jl_value_t *) jl_alloc_vec_any(3);
+	jl_arrayset((jl_array_t *) ret_val, (jl_value_t *) batch.columns, 0);
+	jl_arrayset((jl_array_t *) ret_val, (jl_value_t *) batch.valid, 1);
+	jl_arrayset((jl_array_t *) ret_val, jl_box_bool(done), 2);
+	JL_GC_POP();
 
-	/* function definition + body code */
-	prodesc = pljulia_compile(fcinfo, procedure_tuple, procedure_struct, false,
-							  false);
-	current_call_data->prodesc = prodesc;
-	ReleaseSysCache(procedure_tuple);
+	pljulia_column_batch_free(&batch);
+	return ret_val;
+}
 
-	/*
-	 * this assumes that pljulia_compile inserts the function definition into
-	 * the interpreter
-	 */
-	func = jl_get_function(jl_main_module, prodesc->internal_proname);
+/*
+ * Close a table scan before it is exhausted, unless its transaction ended
+ */
+void
+pljulia_table_scan_close(pljulia_table_scan *tscan, uint64 generation)
+{
+	if (generation == pljulia_xact_generation)
+		pljulia_table_scan_end(tscan);
+}
 
-	if (jl_exception_occurred())
-		show_julia_error();
+static void
+pljulia_table_scan_end(pljulia_table_scan *tscan)
+{
+	ResourceOwner save_owner = CurrentResourceOwner;
+
+	CurrentResourceOwner = tscan->owner;
+	ExecDropSingleTupleTableSlot(tscan->slot);
+	table_endscan(tscan->scan);
+	UnregisterSnapshot(tscan->snapshot);
+	table_close(tscan->rel, NoLock);
+	CurrentResourceOwner = save_owner;
+
+	dlist_delete(&tscan->node);
+	pfree(tscan->attnums);
+	pfree(tscan->typids);
+	pfree(tscan);
+}
 
-	/*
-	 * insert the function code into the julia interpreter then get a pointer
-	 * to the function and call it after the arguments are settled too .
-	 * Allocate the space for the arguments here
-	 */
-	boxed_args = (jl_value_t **) palloc0(prodesc->nargs * sizeof(jl_value_t *));
+/*
+ * Look up the rows of a table whose btree index keys are equal to the given
+ * values, with an index scan and no query. keys holds values for the first
+ * key columns of the index and columns the names of the columns to return,
+ * all of them if it is empty; both are converted without going through text
+ * for the types that allow it. Returns the names, column vectors and
+ * validity masks of the rows found, see pljulia_columns_from_tuptable.
+ *
+ * Like SELECT, this checks the SELECT privilege on the returned columns and
+ * the index columns, and refuses tables with row level security.
+ */
+jl_value_t *
+pljulia_index_lookup(jl_value_t *index_name, jl_value_t *keys,
+					 jl_value_t *columns)
+{
+	pljulia_index_entry *entry;
+	pljulia_column_batch batch = {0};
+	Relation	heap = NULL;
+	Relation	index = NULL;
+	IndexScanDesc scan;
+	TupleTableSlot *slot;
+	ScanKeyData skeys[INDEX_MAX_KEYS];
+	ParseState *pstate;
+	ParseNamespaceItem *nsitem;
+	RangeTblEntry *rte;
+	MemoryContext call_cxt;
+	MemoryContext oldcontext;
+	StringInfoData signature;
+	Datum	  **values;
+	bool	  **nulls;
+	jl_value_t *result = NULL;
+	jl_array_t *names = NULL;
+	uint64		key;
+	size_t		nrows = 0;
+	size_t		maxrows = 8;
+	bool		found;
+	int			nkeys;
+	int			i;
+	int			j;
+
+	initStringInfo(&signature);
+	appendStringInfoString(&signature, jl_string_ptr(index_name));
+	for (j = 0; j < (int) jl_array_len((jl_array_t *) columns); j++)
+		appendStringInfo(&signature, ",%s",
+						 jl_string_ptr(jl_arrayref((jl_array_t *) columns, j)));
+	key = hash_bytes_extended((const unsigned char *) signature.data,
+							  signature.len, 0);
+
+	entry = hash_search(pljulia_index_hashtable, &key, HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->cxt = NULL;
+		entry->signature = NULL;
+		entry->valid = false;
+	}
+	else if (entry->signature == NULL ||
+			 strcmp(entry->signature, signature.data) != 0)
+		entry->valid = false;	/* a hash collision, the new one makes way */
+	else if (entry->valid &&
+			 !OverrideSearchPathMatchesCurrent(entry->search_path))
+		entry->valid = false;	/* the name may now refer to another index */
+
+	/* open the relations, checking that the entry is still up to date */
+	if (entry->valid)
+	{
+		heap = try_relation_open(entry->heapoid, AccessShareLock);
+		if (heap != NULL)
+			index = try_relation_open(entry->indexoid, AccessShareLock);
+		if (index == NULL || !entry->valid)
+		{
+			if (index != NULL)
+				relation_close(index, NoLock);
+			if (heap != NULL)
+				table_close(heap, NoLock);
+			entry->valid = false;
+		}
+	}
+	if (!entry->valid)
+		pljulia_index_resolve(entry, signature.data, jl_string_ptr(index_name),
+							  columns, &heap, &index);
 
-	julia_setup_input_args(fcinfo, procedure_tuple, procedure_struct,
-						   boxed_args, prodesc);
-	if (jl_exception_occurred())
-		show_julia_error();
-	ret = jl_call(func, boxed_args, prodesc->nargs);
+	nkeys = jl_array_len((jl_array_t *) keys);
+	if (nkeys < 1 || nkeys > entry->nkeys)
+		elog(ERROR, "index_lookup: index %s has %d key column(s), %d key(s) passed",
+			 RelationGetRelationName(index), entry->nkeys, nkeys);
 
-	if (jl_exception_occurred())
-		show_julia_error();
+	call_cxt = AllocSetContextCreate(CurrentMemoryContext, "PL/Julia index_lookup",
+									 ALLOCSET_SMALL_SIZES);
+	oldcontext = MemoryContextSwitchTo(call_cxt);
 
 	/*
-	 * if fn_retisset handle differently... jl_value_t_to_datum only if we
-	 * have a non-srf
+	 * Checked on every call, as the executor does: privileges can come from
+	 * role memberships, and row level security depends on the user and
+	 * row_security, neither of which invalidates the entry.
 	 */
-
-	if (prodesc->fn_retisset)
+	pstate = make_parsestate(NULL);
+	nsitem = addRangeTableEntryForRelation(pstate, heap, AccessShareLock,
+										   NULL, false, false);
+	rte = nsitem->p_rte;
+	rte->requiredPerms = ACL_SELECT;
+	for (j = 0; j < entry->ncols; j++)
+		rte->selectedCols = bms_add_member(rte->selectedCols,
+										   entry->attnums[j] - FirstLowInvalidHeapAttributeNumber);
+	for (i = 0; i < nkeys; i++)
+		if (index->rd_index->indkey.values[i] != 0)
+			rte->selectedCols = bms_add_member(rte->selectedCols,
+											   index->rd_index->indkey.values[i] - FirstLowInvalidHeapAttributeNumber);
+	ExecCheckRTPerms(pstate->p_rtable, true);
+
+	if (check_enable_rls(entry->heapoid, InvalidOid, false) == RLS_ENABLED)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("index_lookup not supported with row-level security")));
+
+	/* the keys, a NULL key matches no rows */
+	found = true;
+	for (i = 0; i < nkeys; i++)
 	{
-		rsi->returnMode = SFRM_Materialize;
-		/* if we have any tuples to return */
-		if (current_call_data->tuple_store)
+		jl_value_t *arg = jl_arrayref((jl_array_t *) keys, i);
+		Datum		argvalue;
+
+		if (jl_is_nothing(arg))
 		{
-			rsi->setResult = current_call_data->tuple_store;
-			rsi->setDesc = current_call_data->ret_tupdesc;
+			found = false;
+			break;
 		}
-		/* equivalent to PG_RERTURN_NULL */
-		retval = (Datum) 0;
-		fcinfo->isnull = true;
+		if (!jl_value_to_param_datum(arg, entry->keyconvs[i], &argvalue))
+			argvalue = jl_value_t_to_datum(NULL, arg, entry->keytypes[i], false);
+		ScanKeyInit(&skeys[i], i + 1, BTEqualStrategyNumber,
+					entry->eqprocs[i], argvalue);
+		skeys[i].sk_collation = entry->keycollations[i];
 	}
-	else
+
+	values = (Datum **) palloc(Max(entry->ncols, 1) * sizeof(Datum *));
+	nulls = (bool **) palloc(Max(entry->ncols, 1) * sizeof(bool *));
+	for (j = 0; j < entry->ncols; j++)
 	{
-		retval = jl_value_t_to_datum(fcinfo, ret, procedure_struct->prorettype,
-									 true);
+		values[j] = (Datum *) palloc(maxrows * sizeof(Datum));
+		nulls[j] = (bool *) palloc(maxrows * sizeof(bool));
 	}
-	return retval;
+
+	if (found)
+	{
+		slot = table_slot_create(heap, NULL);
+		scan = index_beginscan(heap, index, GetActiveSnapshot(), nkeys, 0);
+		index_rescan(scan, skeys, nkeys, NULL, 0);
+		while (index_getnext_slot(scan, ForwardScanDirection, slot))
+		{
+			if (nrows == maxrows)
+			{
+				maxrows *= 2;
+				for (j = 0; j < entry->ncols; j++)
+				{
+					values[j] = (Datum *) repalloc(values[j], maxrows * sizeof(Datum));
+					nulls[j] = (bool *) repalloc(nulls[j], maxrows * sizeof(bool));
+				}
+			}
+			slot_getsomeattrs(slot, entry->maxattnum);
+			for (j = 0; j < entry->ncols; j++)
+			{
+				int			att = entry->attnums[j] - 1;
+
+				nulls[j][nrows] = slot->tts_isnull[att];
+				values[j][nrows] = nulls[j][nrows] ? (Datum) 0 :
+					datumCopy(slot->tts_values[att], entry->typbyvals[j],
+							  entry->typlens[j]);
+			}
+			nrows++;
+
+			CHECK_FOR_INTERRUPTS();
+		}
+		index_endscan(scan);
+		ExecDropSingleTupleTableSlot(slot);
+	}
+	relation_close(index, NoLock);
+	table_close(heap, NoLock);
+
+	JL_GC_PUSH4(&result, &names, &batch.columns, &batch.valid);
+	names = jl_alloc_vec_any(entry->ncols);
+	for (j = 0; j < entry->ncols; j++)
+		jl_arrayset(names, jl_cstr_to_string(entry->attnames[j]), j);
+	pljulia_column_batch_init(&batch, entry->typids, entry->ncols, nrows);
+	for (i = 0; i < (int) nrows; i++)
+		for (j = 0; j < entry->ncols; j++)
+			pljulia_column_batch_set(&batch, i, j, values[j][i], nulls[j][i]);
+
+	result = (jl_value_t *) jl_alloc_vec_any(3);
+	jl_arrayset((jl_array_t *) result, (jl_value_t *) names, 0);
+	jl_arrayset((jl_array_t *) result, (jl_value_t *) batch.columns, 1);
+	jl_arrayset((jl_array_t *) result, (jl_value_t *) batch.valid, 2);
+	JL_GC_POP();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(call_cxt);
+	pfree(signature.data);
+	return result;
 }
 
-Datum
-pg_array_from_julia_array(FunctionCallInfo fcinfo, jl_value_t *ret,
-						  Oid prorettype)
+/*
+ * Resolve the index and columns of an index_lookup call site, leaving the
+ * index and its table open and locked
+ */
+static void
+pljulia_index_resolve(pljulia_index_entry *entry, const char *signature,
+					  const char *index_name, jl_value_t *columns,
+					  Relation *heapp, Relation *indexp)
 {
-	ArrayType  *array;
-	Datum	   *array_elem;
-	bool	   *nulls = NULL;
-	int16		typlen;
-	bool		typbyval;
-	char		typalign;
-	int			row_major_offset;
-	Oid			elem_type = get_element_type(prorettype);
-	size_t		len = jl_array_len(ret);
-	int			ndim = jl_array_ndims(ret);
-	int		   *dims = (int *) palloc0(sizeof(int) * ndim);
-	int		   *lbs = (int *) palloc0(sizeof(int) * ndim);
+	Relation	heap;
+	Relation	index;
+	TupleDesc	tupdesc;
+	MemoryContext oldcontext;
+	Oid			indexoid;
+	int			ncolumns = jl_array_len((jl_array_t *) columns);
 	int			i;
-	jl_value_t *curr_elem;
 
-	for (i = 0; i < ndim; i++)
+	entry->valid = false;
+	entry->signature = NULL;
+	if (entry->cxt != NULL)
+		MemoryContextReset(entry->cxt);
+	else
+		entry->cxt = AllocSetContextCreate(TopMemoryContext,
+										   "PL/Julia index_lookup call site",
+										   ALLOCSET_SMALL_SIZES);
+
+	indexoid = RangeVarGetRelid(makeRangeVarFromNameList(stringToQualifiedNameList(index_name)),
+								NoLock, false);
+	if (get_rel_relkind(indexoid) != RELKIND_INDEX)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("index_lookup: \"%s\" is not an index", index_name)));
+	/* lock the table first, as the executor does */
+	heap = table_open(IndexGetRelation(indexoid, false), AccessShareLock);
+	index = index_open(indexoid, AccessShareLock);
+	if (index->rd_rel->relam != BTREE_AM_OID)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("index_lookup: index \"%s\" is not a btree index",
+						RelationGetRelationName(index))));
+	tupdesc = RelationGetDescr(heap);
+
+	oldcontext = MemoryContextSwitchTo(entry->cxt);
+	entry->indexoid = indexoid;
+	entry->heapoid = RelationGetRelid(heap);
+
+	/* the equality functions of the key columns */
+	entry->nkeys = IndexRelationGetNumberOfKeyAttributes(index);
+	entry->eqprocs = (RegProcedure *) palloc(entry->nkeys * sizeof(RegProcedure));
+	entry->keytypes = (Oid *) palloc(entry->nkeys * sizeof(Oid));
+	entry->keycollations = (Oid *) palloc(entry->nkeys * sizeof(Oid));
+	entry->keyconvs = (pljulia_param_conv *) palloc(entry->nkeys * sizeof(pljulia_param_conv));
+	for (i = 0; i < entry->nkeys; i++)
 	{
-		dims[i] = jl_array_dim(ret, i);
-		lbs[i] = 1;
+		Oid			opfamily = index->rd_opfamily[i];
+		Oid			opcintype = index->rd_opcintype[i];
+		Oid			eqop;
+
+		eqop = get_opfamily_member(opfamily, opcintype, opcintype,
+								   BTEqualStrategyNumber);
+		if (!OidIsValid(eqop))
+			elog(ERROR, "missing operator %d(%u,%u) in opfamily %u",
+				 BTEqualStrategyNumber, opcintype, opcintype, opfamily);
+		entry->eqprocs[i] = get_opcode(eqop);
+		/* keys of array, enum... columns have the type of the column */
+		if (IsPolymorphicType(opcintype))
+			opcintype = TupleDescAttr(RelationGetDescr(index), i)->atttypid;
+		entry->keytypes[i] = opcintype;
+		entry->keycollations[i] = index->rd_indcollation[i];
+		entry->keyconvs[i] = pg_oid_to_param_conv(opcintype);
 	}
-	elog(DEBUG1, "len : %zu\n", len);
-
-	array_elem = (Datum *) palloc0(sizeof(Datum) * len);
 
-	for (i = 0; i < len; i++)
+	/* the columns returned */
+	entry->ncols = 0;
+	entry->maxattnum = 0;
+	entry->attnums = (AttrNumber *) palloc(Max(ncolumns, tupdesc->natts) * sizeof(AttrNumber));
+	if (ncolumns == 0)
 	{
-		row_major_offset = calculate_rm_offset(i, ndim, dims);
-		curr_elem = jl_arrayref(ret, i);
-		/* if jl_nothing then set it as NULL */
-		if (jl_typeis(curr_elem, jl_nothing_type))
+		for (i = 0; i < tupdesc->natts; i++)
+			if (!TupleDescAttr(tupdesc, i)->attisdropped)
+				entry->attnums[entry->ncols++] = i + 1;
+	}
+	else
+	{
+		for (i = 0; i < ncolumns; i++)
 		{
-			/* first null we found, so palloc */
-			if (!nulls)
-				nulls = (bool *) palloc0(sizeof(bool) * len);
-
-			nulls[i] = true;
-			continue;
+			char	   *name = jl_string_ptr(jl_arrayref((jl_array_t *) columns, i));
+			AttrNumber	attnum = attnameAttNum(heap, name, false);
+
+			if (attnum == InvalidAttrNumber)
+				ereport(ERROR,
+						(errcode(ERRCODE_UNDEFINED_COLUMN),
+						 errmsg("column \"%s\" of relation \"%s\" does not exist",
+								name, RelationGetRelationName(heap))));
+			entry->attnums[entry->ncols++] = attnum;
 		}
+	}
+	entry->attnames = (char **) palloc(Max(entry->ncols, 1) * sizeof(char *));
+	entry->typids = (Oid *) palloc(Max(entry->ncols, 1) * sizeof(Oid));
+	entry->typlens = (int16 *) palloc(Max(entry->ncols, 1) * sizeof(int16));
+	entry->typbyvals = (bool *) palloc(Max(entry->ncols, 1) * sizeof(bool));
+	for (i = 0; i < entry->ncols; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, entry->attnums[i] - 1);
 
-		array_elem[row_major_offset] = jl_value_t_to_datum(fcinfo, curr_elem,
-														   elem_type, false);
-		/* if for some reason it wasn't possible to */
+		entry->attnames[i] = pstrdup(NameStr(att->attname));
+		entry->typids[i] = att->atttypid;
+		entry->typlens[i] = att->attlen;
+		entry->typbyvals[i] = att->attbyval;
+		entry->maxattnum = Max(entry->maxattnum, att->attnum);
 	}
-	get_typlenbyvalalign(elem_type, &typlen, &typbyval, &typalign);
-	array = construct_md_array(array_elem, nulls, ndim, dims, lbs, elem_type,
-							   typlen, typbyval, typalign);
-	PG_RETURN_ARRAYTYPE_P(array);
+
+	entry->signature = pstrdup(signature);
+	entry->search_path = GetOverrideSearchPath(entry->cxt);
+	entry->valid = true;
+	MemoryContextSwitchTo(oldcontext);
+
+	*heapp = heap;
+	*indexp = index;
 }
 
-Datum
-pg_composite_from_julia_tuple(FunctionCallInfo fcinfo, jl_value_t *ret,
-							  Oid prorettype, bool usefcinfo)
+/*
+ * Relcache callback: the index_lookup call sites of the relation are
+ * resolved again on their next call
+ */
+static void
+pljulia_index_invalidate(Datum arg, Oid relid)
 {
-	int			nfields,
-				i;
-	jl_value_t *curr_elem;
-	TupleDesc	tupdesc;
-	Oid			resultTypeId;
-	Datum	   *elements;
-	bool	   *nulls = NULL;
-	HeapTuple	tup;
-	Form_pg_attribute att;
-
-	if (usefcinfo)
-	{
-		if (get_call_result_type(fcinfo, &resultTypeId, &tupdesc) !=
-			TYPEFUNC_COMPOSITE)
-			elog(ERROR, "function returning record called in context that cannot "
-				 "accept type record");
-	}
+	HASH_SEQ_STATUS status;
+	pljulia_index_entry *entry;
 
-	/*
-	 * if !usefcinfo then don't use it to get a tupdesc because we've been
-	 * called from pg_array_from_julia_array and fcinfo concerns the array,
-	 * not the tuple we need to build
-	 */
-	else
+	hash_seq_init(&status, pljulia_index_hashtable);
+	while ((entry = hash_seq_search(&status)) != NULL)
 	{
-		/*
-		 * set typmod -1 because we don't expect a domain. For domains extra
-		 * work needs to be done
-		 */
-		tupdesc = lookup_rowtype_tupdesc(prorettype, -1);
+		if (relid == InvalidOid || entry->indexoid == relid ||
+			entry->heapoid == relid)
+			entry->valid = false;
 	}
+}
 
-	nfields = jl_nfields(ret);
-	if (tupdesc->natts != nfields)
-		elog(ERROR, "Tuple number of fields mismatch");
+/*
+ * Open a large object for the Julia LargeObject IO type, for reading or, if
+ * write is set, for reading and writing. This goes through the descriptors
+ * of the lo_* SQL functions, so that the same privileges are checked and
+ * the descriptors are closed at the end of the transaction, or of the
+ * subtransaction that opened them if it aborts. Returns a Julia vector with
+ * the descriptor and the serial number of the open, see pljulia_lo_handle.
+ */
+jl_value_t *
+pljulia_lo_open(Oid loid, int32 write)
+{
+	jl_value_t *ret_val = NULL;
+	int32		fd;
 
-	elements = (Datum *) palloc0(sizeof(Datum) * nfields);
-	nulls = (bool *) palloc0(sizeof(bool) * nfields);
+	fd = DatumGetInt32(DirectFunctionCall2(be_lo_open,
+										   ObjectIdGetDatum(loid),
+										   Int32GetDatum(write ? INV_READ | INV_WRITE : INV_READ)));
 
-	for (i = 0; i < nfields; i++)
+	if (fd >= pljulia_lo_nhandles)
 	{
-		curr_elem = jl_get_nth_field(ret, i);
-		if (jl_typeis(curr_elem, jl_nothing_type))
+		int			newsize = Max(fd + 1, Max(pljulia_lo_nhandles * 2, 16));
+
+		if (pljulia_lo_handles == NULL)
+			pljulia_lo_handles = (pljulia_lo_handle *)
+				MemoryContextAllocZero(TopMemoryContext,
+									   newsize * sizeof(pljulia_lo_handle));
+		else
 		{
-			nulls[i] = true;
-			continue;
+			pljulia_lo_handles = (pljulia_lo_handle *)
+				repalloc(pljulia_lo_handles, newsize * sizeof(pljulia_lo_handle));
+			memset(pljulia_lo_handles + pljulia_lo_nhandles, 0,
+				   (newsize - pljulia_lo_nhandles) * sizeof(pljulia_lo_handle));
 		}
-		nulls[i] = false;
-		att = TupleDescAttr(tupdesc, i);
-
-		elements[i] = jl_value_t_to_datum(fcinfo, curr_elem, att->atttypid, false);
+		pljulia_lo_nhandles = newsize;
 	}
-	tup = heap_form_tuple(tupdesc, elements, nulls);
-	ReleaseTupleDesc(tupdesc);
-	return HeapTupleGetDatum(tup);
+	pljulia_lo_handles[fd].serial = ++pljulia_lo_serial;
+	pljulia_lo_handles[fd].subid = GetCurrentSubTransactionId();
+
+	JL_GC_PUSH1(&ret_val);
+	ret_val = (jl_value_t *) jl_alloc_vec_any(2);
+	jl_arrayset((jl_array_t *) ret_val, jl_box_int32(fd), 0);
+	jl_arrayset((jl_array_t *) ret_val, jl_box_uint64(pljulia_lo_serial), 1);
+	JL_GC_POP();
+
+	return ret_val;
 }
 
-Datum
-pg_composite_from_julia_dict(FunctionCallInfo fcinfo, jl_value_t *ret,
-							 Oid prorettype, bool usefcinfo)
+/*
+ * Read up to len bytes of a large object into buf, returning how many were
+ * read, 0 at its end
+ */
+int64
+pljulia_lo_read(int32 fd, uint64 serial, char *buf, int64 len)
 {
-	int			nfields,
-				i;
-	jl_value_t *curr_elem,
-			   *key;
-	TupleDesc	tupdesc;
-	Oid			resultTypeId;
-	Datum	   *elements;
-	bool	   *nulls = NULL;
-	HeapTuple	tup;
-	char	   *attname;
-	Form_pg_attribute att;
-	jl_function_t *dict_get,
-			   *dict_nfields;
+	pljulia_lo_check(fd, serial);
+	return lo_read(fd, buf, (int) Min(len, MaxAllocSize));
+}
 
-	if (usefcinfo)
+/*
+ * Write len bytes to a large object, at most MaxAllocSize at a time as
+ * lo_write takes, returning how many were written
+ */
+int64
+pljulia_lo_write(int32 fd, uint64 serial, const char *buf, int64 len)
+{
+	int64		written = 0;
+
+	pljulia_lo_check(fd, serial);
+	while (written < len)
 	{
-		if (get_call_result_type(fcinfo, &resultTypeId, &tupdesc) !=
-			TYPEFUNC_COMPOSITE)
-			elog(ERROR,
-				 "function returning record called in context that cannot "
-				 "accept type record");
+		int			n;
+
+		n = lo_write(fd, buf + written, (int) Min(len - written, MaxAllocSize));
+		if (n <= 0)
+			break;
+		written += n;
 	}
+	return written;
+}
 
-	/*
-	 * if !usefcinfo then don't use it to get a tupdesc because we've been
-	 * called from pg_array_from_julia_array and fcinfo concerns the array,
-	 * not the tuple we need to build
-	 */
-	else
+/*
+ * Move the position of a large object, whence being SEEK_SET, SEEK_CUR or
+ * SEEK_END, and return the new position
+ */
+int64
+pljulia_lo_seek(int32 fd, uint64 serial, int64 offset, int32 whence)
+{
+	pljulia_lo_check(fd, serial);
+	return DatumGetInt64(DirectFunctionCall3(be_lo_lseek64,
+											 Int32GetDatum(fd),
+											 Int64GetDatum(offset),
+											 Int32GetDatum(whence)));
+}
+
+/*
+ * Close a large object, unless its transaction or subtransaction already did
+ */
+void
+pljulia_lo_close(int32 fd, uint64 serial)
+{
+	if (fd >= 0 && fd < pljulia_lo_nhandles &&
+		pljulia_lo_handles[fd].serial == serial)
 	{
-		/*
-		 * set typmod -1 because we don't expect a domain. For domains extra
-		 * work needs to be done
-		 */
-		tupdesc = lookup_rowtype_tupdesc(prorettype, -1);
+		DirectFunctionCall1(be_lo_close, Int32GetDatum(fd));
+		pljulia_lo_handles[fd].serial = 0;
 	}
+}
 
-	/* the number of entries in the dictionary equals its length */
-	dict_nfields = jl_get_function(jl_base_module, "length");
-	dict_get = jl_get_function(jl_main_module, "dict_get");
-	nfields = jl_unbox_int64(jl_call1(dict_nfields, ret));
-	if (tupdesc->natts != nfields)
-		elog(ERROR, "Dict number of fields mismatch");
+static void
+pljulia_lo_check(int32 fd, uint64 serial)
+{
+	if (fd < 0 || fd >= pljulia_lo_nhandles ||
+		pljulia_lo_handles[fd].serial != serial)
+		elog(ERROR, "large object used outside of the transaction or subtransaction that opened it");
+}
 
-	elements = (Datum *) palloc0(sizeof(Datum) * nfields);
-	nulls = (bool *) palloc0(sizeof(bool) * nfields);
+/*
+ * The path of the file of a shared array, creating the directory of shared
+ * arrays if create is set
+ */
+jl_value_t *
+pljulia_shared_path(jl_value_t *name, int32 create)
+{
+	char	   *path = pljulia_shared_file(jl_string_ptr(name));
 
-	for (i = 0; i < nfields; i++)
-	{
-		att = TupleDescAttr(tupdesc, i);
-		attname = NameStr(att->attname);
-		key = jl_cstr_to_string(attname);
-		curr_elem = jl_call2(dict_get, key, ret);
-		if (jl_typeis(curr_elem, jl_nothing_type))
-		{
-			nulls[i] = true;
-			continue;
-		}
-		nulls[i] = false;
+	if (create && MakePGDirectory(PLJULIA_SHARED_DIR) < 0 && errno != EEXIST)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create directory \"%s\": %m",
+						PLJULIA_SHARED_DIR)));
 
-		elements[i] = jl_value_t_to_datum(fcinfo, curr_elem, att->atttypid,
-										  false);
-	}
-	tup = heap_form_tuple(tupdesc, elements, nulls);
-	ReleaseTupleDesc(tupdesc);
-	return HeapTupleGetDatum(tup);
+	return jl_cstr_to_string(path);
 }
 
-static Datum
-pljulia_trigger_handler(PG_FUNCTION_ARGS)
+/*
+ * Replace the file of a shared array by a new one, atomically and durably.
+ * Backends that mapped the old file keep it until they look the array up
+ * again.
+ */
+void
+pljulia_shared_rename(jl_value_t *tmppath, jl_value_t *path)
 {
-	TriggerData *trigdata = (TriggerData *) fcinfo->context;
-	TupleDesc	tupdesc;
-	HeapTuple	procedure_tuple;
-	Form_pg_proc procedure_struct;
-	volatile HeapTuple rettuple;
-	int			i,
-				rc;
-	pljulia_proc_desc *prodesc;
-	jl_value_t *trig_args[10];
-	char	   *stroid,
-			   *when,
-			   *level,
-			   *event,
-			   *arg;
-	jl_function_t *func,
-			   *init_arr;
-	jl_value_t *ret;
+	durable_rename(jl_string_ptr(tmppath), jl_string_ptr(path), ERROR);
+}
 
-	/* make sure we're here from a call to a trigger */
-	if (!CALLED_AS_TRIGGER(fcinfo))
-		elog(ERROR, "not called by trigger manager");
-	/* connect to the SPI manager */
-	if (SPI_connect() != SPI_OK_CONNECT)
-		elog(ERROR, "could not connect to SPI manager");
-	/* make transition tables visible to this SPI connection */
-	rc = SPI_register_trigger_data(trigdata);
+static char *
+pljulia_shared_file(const char *name)
+{
+	if (name[0] == '\0' || name[0] == '.' || strlen(name) >= NAMEDATALEN ||
+		strspn(name, "abcdefghijklmnopqrstuvwxyz"
+			   "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-.") != strlen(name))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid shared array name \"%s\"", name),
+				 errhint("Names are made of letters, digits, underscores, hyphens and dots, and don't start with a dot.")));
+
+	return psprintf("%s/%s/%s", DataDir, PLJULIA_SHARED_DIR, name);
+}
 
-	if (rc < 0)
-		elog(ERROR,
-			 "Could not make transition tables visible to PL trigger handler");
+/*
+ * Look up a key of SD. Returns nothing if it has no value, else a Julia
+ * vector with a copy of the value, or nothing unless copy is set, and its
+ * version.
+ */
+jl_value_t *
+pljulia_sd_get(jl_value_t *key, int32 copy)
+{
+	char		keybuf[PLJULIA_SD_KEYSIZE];
+	pljulia_sd_entry *entry;
+	char	   *data = NULL;
+	Size		size;
+	uint64		version;
+	jl_value_t *bytes = NULL;
+	jl_value_t *ret_val = NULL;
 
-	procedure_tuple = SearchSysCache(PROCOID,
-									 ObjectIdGetDatum(fcinfo->flinfo->fn_oid),
-									 0, 0, 0);
-	if (!HeapTupleIsValid(procedure_tuple))
-		elog(ERROR, "cache lookup failed for function %u",
-			 fcinfo->flinfo->fn_oid);
-	procedure_struct = (Form_pg_proc) GETSTRUCT(procedure_tuple);
+	pljulia_sd_key(jl_string_ptr(key), keybuf);
+	pljulia_sd_attach();
 
-	prodesc = pljulia_compile(fcinfo, procedure_tuple, procedure_struct,
-							  true, false);
-	current_call_data->prodesc = prodesc;
-	ReleaseSysCache(procedure_tuple);
-	tupdesc = RelationGetDescr(trigdata->tg_relation);
+	entry = dshash_find(pljulia_sd_table, keybuf, false);
+	if (entry == NULL)
+		return jl_nothing;
 
 	/*
-	 * setup trigger args, first the standard ones, 10 in total  TD_name,
-	 * TD_relid, TD_table_name, TD_table_schema, TD_event, TD_when TD_level,
-	 * TD_NEW, TD_OLD, args, where args will be passed as an array
+	 * Recency is only a hint for eviction, so it is updated under the shared
+	 * lock. The value is copied before going back to Julia, which must not
+	 * run while the lock is held.
 	 */
+	entry->last_used = pg_atomic_add_fetch_u64(&pljulia_sd_ctl->clock, 1);
+	version = entry->version;
+	size = entry->size;
+	if (copy)
+	{
+		data = MemoryContextAllocHuge(CurrentMemoryContext, Max(size, 1));
+		memcpy(data, dsa_get_address(pljulia_sd_area, entry->value), size);
+	}
+	dshash_release_lock(pljulia_sd_table, entry);
 
-	/* set up TD_name with trigger name */
-	trig_args[0] = jl_cstr_to_string(utf_e2u(trigdata->tg_trigger->tgname));
-	/* TD_relid */
-	stroid = DatumGetCString(
-							 DirectFunctionCall1(oidout,
-												 ObjectIdGetDatum(trigdata->tg_relation->rd_id)));
-	trig_args[1] = jl_cstr_to_string(stroid);
-	pfree(stroid);
+	JL_GC_PUSH2(&bytes, &ret_val);
+	bytes = jl_nothing;
+	if (copy)
+	{
+		bytes = (jl_value_t *) jl_alloc_array_1d(jl_apply_array_type((jl_value_t *) jl_uint8_type, 1),
+												 size);
+		memcpy(jl_array_data(bytes), data, size);
+		pfree(data);
+	}
+	ret_val = (jl_value_t *) jl_alloc_vec_any(2);
+	jl_arrayset((jl_array_t *) ret_val, bytes, 0);
+	jl_arrayset((jl_array_t *) ret_val, jl_box_uint64(version), 1);
+	JL_GC_POP();
 
-	/* TD_table_name */
-	stroid = SPI_getrelname(trigdata->tg_relation);
-	trig_args[2] = jl_cstr_to_string(utf_e2u(stroid));
-	pfree(stroid);
+	return ret_val;
+}
 
-	/* TD_table_schema */
-	stroid = SPI_getnspname(trigdata->tg_relation);
-	trig_args[3] = jl_cstr_to_string(utf_e2u(stroid));
-	pfree(stroid);
+/*
+ * Store the bytes of a Julia vector as the value of a key of SD. If check
+ * is set, only if the version of the key is still expected, 0 meaning that
+ * it has no value. Returns the new version, or 0 if the check failed.
+ * Versions come from a clock of the whole store, so a key that is deleted
+ * and put again never gets back an old version.
+ */
+uint64
+pljulia_sd_put(jl_value_t *key, jl_value_t *value, uint64 expected,
+			   int32 check)
+{
+	char		keybuf[PLJULIA_SD_KEYSIZE];
+	pljulia_sd_entry *entry;
+	Size		size = jl_array_len((jl_array_t *) value);
+	dsa_pointer dp;
+	bool		found;
+	uint64		version;
+
+	pljulia_sd_key(jl_string_ptr(key), keybuf);
+	if (size > (Size) pljulia_shared_data_size * 1024)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("SD value of %zu bytes exceeds pljulia.shared_data_size",
+						size)));
+	pljulia_sd_attach();
+
+	/* make room first, since eviction scans the table */
+	pljulia_sd_evict(PLJULIA_SD_CHARGE(size));
+
+	entry = dshash_find_or_insert(pljulia_sd_table, keybuf, &found);
+	if (check && (found ? entry->version : 0) != expected)
+	{
+		if (found)
+			dshash_release_lock(pljulia_sd_table, entry);
+		else
+			dshash_delete_entry(pljulia_sd_table, entry);
+		return 0;
+	}
 
-	/* TD_event */
-	if (TRIGGER_FIRED_BY_INSERT(trigdata->tg_event))
-		event = "INSERT";
-	else if (TRIGGER_FIRED_BY_DELETE(trigdata->tg_event))
-		event = "DELETE";
-	else if (TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
-		event = "UPDATE";
-	else if (TRIGGER_FIRED_BY_TRUNCATE(trigdata->tg_event))
-		event = "TRUNCATE";
+	dp = dsa_allocate_extended(pljulia_sd_area, Max(size, 1),
+							   DSA_ALLOC_HUGE | DSA_ALLOC_NO_OOM);
+	if (!DsaPointerIsValid(dp))
+	{
+		if (found)
+			dshash_release_lock(pljulia_sd_table, entry);
+		else
+			dshash_delete_entry(pljulia_sd_table, entry);
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of shared memory"),
+				 errdetail("Failed on SD value of %zu bytes.", size)));
+	}
+	memcpy(dsa_get_address(pljulia_sd_area, dp), jl_array_data(value), size);
+
+	if (found)
+	{
+		dsa_free(pljulia_sd_area, entry->value);
+		pg_atomic_sub_fetch_u64(&pljulia_sd_ctl->size,
+								PLJULIA_SD_CHARGE(entry->size));
+	}
 	else
-		elog(ERROR, "unrecognized OPERATION tg_event: %u", trigdata->tg_event);
+		pg_atomic_add_fetch_u64(&pljulia_sd_ctl->entries, 1);
+	pg_atomic_add_fetch_u64(&pljulia_sd_ctl->size, PLJULIA_SD_CHARGE(size));
 
-	trig_args[4] = jl_cstr_to_string(event);
+	version = pg_atomic_add_fetch_u64(&pljulia_sd_ctl->clock, 1);
+	entry->value = dp;
+	entry->size = size;
+	entry->version = version;
+	entry->last_used = version;
+	dshash_release_lock(pljulia_sd_table, entry);
 
-	/* TD_when, can be BEFORE, AFTER, INSTEAD OF */
-	if (TRIGGER_FIRED_BEFORE(trigdata->tg_event))
-		when = "BEFORE";
-	else if (TRIGGER_FIRED_AFTER(trigdata->tg_event))
-		when = "AFTER";
-	else if (TRIGGER_FIRED_INSTEAD(trigdata->tg_event))
-		when = "INSTEAD OF";
-	else
-		elog(ERROR, "unrecognized WHEN tg_event: %u", trigdata->tg_event);
-	trig_args[5] = jl_cstr_to_string(when);
-	/* TD_level */
-	if (TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
-		level = "ROW";
-	else if (TRIGGER_FIRED_FOR_STATEMENT(trigdata->tg_event))
-		level = "STATEMENT";
-	else
-		elog(ERROR, "unrecognized LEVEL tg_event: %u", trigdata->tg_event);
-	trig_args[6] = jl_cstr_to_string(level);
+	return version;
+}
 
-	/* TD_new and TD_old */
+/*
+ * Delete a key of SD, returning whether it had a value
+ */
+int32
+pljulia_sd_delete(jl_value_t *key)
+{
+	char		keybuf[PLJULIA_SD_KEYSIZE];
+	pljulia_sd_entry *entry;
 
-	/*
-	 * TD_new and TD_old are initialized NULL (Julia nothing), and depending
-	 * on whether we have a trigger function that modifies rows, we set the
-	 * appropriate values for NEW/OLD rows
-	 */
+	pljulia_sd_key(jl_string_ptr(key), keybuf);
+	pljulia_sd_attach();
 
-	/* TD_new */
-	trig_args[7] = jl_nothing;
-	/* TD_OLD */
-	trig_args[8] = jl_nothing;
+	entry = dshash_find(pljulia_sd_table, keybuf, true);
+	if (entry == NULL)
+		return false;
+	pljulia_sd_remove(entry);
+	return true;
+}
 
-	rettuple = (HeapTuple) NULL;
+#if PG_VERSION_NUM >= 170000
+static void
+pljulia_sd_init_control(void *ptr)
+{
+	((pljulia_sd_control *) ptr)->initialized = false;
+}
+#endif
 
-	if (TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
+/*
+ * Attach to SD for the rest of the session, creating it if no backend did
+ * since the server started. From PostgreSQL 17, its control struct is a
+ * segment of the DSM registry. Before, it is allocated by ShmemInitStruct
+ * although pljulia isn't in shared_preload_libraries, which takes its few
+ * bytes from the spare space of the main shared memory segment: SD fails
+ * with "out of shared memory" if other libraries used it all.
+ */
+static void
+pljulia_sd_attach(void)
+{
+	dshash_parameters params;
+	MemoryContext oldcontext;
+	bool		found;
+
+	if (pljulia_sd_table != NULL)
+		return;
+
+	memset(&params, 0, sizeof(params));
+	params.key_size = PLJULIA_SD_KEYSIZE;
+	params.entry_size = sizeof(pljulia_sd_entry);
+	params.compare_function = dshash_memcmp;
+	params.hash_function = dshash_memhash;
+
+	/* the backend-local descriptors of the area and table are kept */
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+#if PG_VERSION_NUM >= 170000
+	pljulia_sd_ctl = GetNamedDSMSegment("pljulia SD",
+										sizeof(pljulia_sd_control),
+										pljulia_sd_init_control, &found);
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+#else
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+	pljulia_sd_ctl = ShmemInitStruct("pljulia SD", sizeof(pljulia_sd_control),
+									 &found);
+	if (!found)
+		pljulia_sd_ctl->initialized = false;
+#endif
+
+	if (!pljulia_sd_ctl->initialized)
 	{
-		/* we only have a new row to return in the case of INSERT */
-		if (TRIGGER_FIRED_BY_INSERT(trigdata->tg_event))
+		pljulia_sd_ctl->tranche_id = LWLockNewTrancheId();
+		LWLockRegisterTranche(pljulia_sd_ctl->tranche_id, "pljulia_sd");
+		params.tranche_id = pljulia_sd_ctl->tranche_id;
+
+		pljulia_sd_area = dsa_create(pljulia_sd_ctl->tranche_id);
+		dsa_pin(pljulia_sd_area);
+		dsa_pin_mapping(pljulia_sd_area);
+		pljulia_sd_table = dshash_create(pljulia_sd_area, &params, NULL);
+
+		pljulia_sd_ctl->area = dsa_get_handle(pljulia_sd_area);
+		pljulia_sd_ctl->table = dshash_get_hash_table_handle(pljulia_sd_table);
+		pg_atomic_init_u64(&pljulia_sd_ctl->clock, 0);
+		pg_atomic_init_u64(&pljulia_sd_ctl->entries, 0);
+		pg_atomic_init_u64(&pljulia_sd_ctl->size, 0);
+		pljulia_sd_ctl->initialized = true;
+	}
+	else
+	{
+		LWLockRegisterTranche(pljulia_sd_ctl->tranche_id, "pljulia_sd");
+		params.tranche_id = pljulia_sd_ctl->tranche_id;
+
+		pljulia_sd_area = dsa_attach(pljulia_sd_ctl->area);
+		dsa_pin_mapping(pljulia_sd_area);
+		pljulia_sd_table = dshash_attach(pljulia_sd_area, &params,
+										 pljulia_sd_ctl->table, NULL);
+	}
+	LWLockRelease(AddinShmemInitLock);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+static void
+pljulia_sd_key(const char *key, char *keybuf)
+{
+	size_t		len = strlen(key);
+
+	if (len >= PLJULIA_SD_KEYSIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_NAME_TOO_LONG),
+				 errmsg("SD key \"%s\" is too long", key),
+				 errdetail("Keys are limited to %d bytes.",
+						   PLJULIA_SD_KEYSIZE - 1)));
+	memset(keybuf, 0, PLJULIA_SD_KEYSIZE);
+	memcpy(keybuf, key, len);
+}
+
+/*
+ * Evict the least recently used values of SD until size more bytes fit in
+ * pljulia.shared_data_size. Finding them takes a scan of the table, which
+ * dshash only has from PostgreSQL 15: older versions refuse the values that
+ * don't fit instead. A scan collects up to PLJULIA_SD_EVICT_BATCH of the
+ * oldest values, so that making room for a large value doesn't scan the
+ * table once per value evicted.
+ */
+static void
+pljulia_sd_evict(Size size)
+{
+	Size		max_size = (Size) pljulia_shared_data_size * 1024;
+
+	while (pg_atomic_read_u64(&pljulia_sd_ctl->size) + size > max_size)
+	{
+#if PG_VERSION_NUM >= 150000
+		dshash_seq_status status;
+		pljulia_sd_entry *entry;
+		pljulia_sd_victim victims[PLJULIA_SD_EVICT_BATCH];
+		int			nvictims = 0;
+		int			i;
+
+		/* the oldest values, kept sorted by last use */
+		dshash_seq_init(&status, pljulia_sd_table, false);
+		while ((entry = dshash_seq_next(&status)) != NULL)
 		{
-			trig_args[7] = pljulia_dict_from_tuple(trigdata->tg_trigtuple,
-												   tupdesc, !TRIGGER_FIRED_BEFORE(trigdata->tg_event));
-			rettuple = trigdata->tg_trigtuple;
+			if (nvictims == PLJULIA_SD_EVICT_BATCH &&
+				entry->last_used >= victims[nvictims - 1].last_used)
+				continue;
+			if (nvictims < PLJULIA_SD_EVICT_BATCH)
+				nvictims++;
+			for (i = nvictims - 1;
+				 i > 0 && victims[i - 1].last_used > entry->last_used; i--)
+				victims[i] = victims[i - 1];
+			memcpy(victims[i].key, entry->key, PLJULIA_SD_KEYSIZE);
+			victims[i].version = entry->version;
+			victims[i].last_used = entry->last_used;
 		}
+		dshash_seq_term(&status);
 
-		/* we only have an old row in the case of DELETE */
-		else if (TRIGGER_FIRED_BY_DELETE(trigdata->tg_event))
+		/* the size left is that of puts in progress */
+		if (nvictims == 0)
+			break;
+
+		for (i = 0; i < nvictims &&
+			 pg_atomic_read_u64(&pljulia_sd_ctl->size) + size > max_size; i++)
 		{
-			trig_args[8] = pljulia_dict_from_tuple(trigdata->tg_trigtuple,
-												   tupdesc, true);
-			rettuple = trigdata->tg_trigtuple;
+			/* unless it was put again meanwhile */
+			entry = dshash_find(pljulia_sd_table, victims[i].key, true);
+			if (entry != NULL && entry->version == victims[i].version)
+				pljulia_sd_remove(entry);
+			else if (entry != NULL)
+				dshash_release_lock(pljulia_sd_table, entry);
 		}
+#else
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("SD is full"),
+				 errhint("Delete values or increase pljulia.shared_data_size.")));
+#endif
+	}
+}
 
-		/* we have both a new and an old row */
-		else if (TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+/*
+ * Free the value of an entry of SD locked exclusively, and delete it
+ */
+static void
+pljulia_sd_remove(pljulia_sd_entry *entry)
+{
+	dsa_free(pljulia_sd_area, entry->value);
+	pg_atomic_sub_fetch_u64(&pljulia_sd_ctl->size,
+							PLJULIA_SD_CHARGE(entry->size));
+	pg_atomic_sub_fetch_u64(&pljulia_sd_ctl->entries, 1);
+	dshash_delete_entry(pljulia_sd_table, entry);
+}
+
+/*
+ * Execute a saved plan once for each of nrows rows of arguments, given by
+ * column as a Julia array of nargs vectors, within a single SPI connection.
+ * The argument arrays are allocated once and the converted arguments of a
+ * row are freed before the next one. Returns the total number of rows
+ * processed.
+ */
+jl_value_t *
+pljulia_spi_execplan_many(jl_value_t *plan, jl_value_t *columns,
+						  jl_value_t *rows)
+{
+	pljulia_query_desc *qdesc;
+	MemoryContext row_cxt;
+	MemoryContext oldcontext;
+	jl_value_t **column_arrays;
+	Datum	   *argvalues;
+	char	   *nulls;
+	int64		nrows;
+	int64		row;
+	uint64		processed = 0;
+	int			nargs;
+	int			i;
+
+	qdesc = pljulia_find_plan(plan, "spi_exec_prepared_many");
+	nargs = jl_array_len((jl_array_t *) columns);
+	if (qdesc->nargs != nargs)
+		elog(ERROR, "spi_exec_prepared_many: expected %d argument(s), %d passed",
+			 qdesc->nargs, nargs);
+	nrows = jl_unbox_int64(rows);
+
+	column_arrays = (jl_value_t **) palloc(Max(nargs, 1) * sizeof(jl_value_t *));
+	argvalues = (Datum *) palloc0(Max(nargs, 1) * sizeof(Datum));
+	nulls = (char *) palloc0(Max(nargs, 1) * sizeof(char));
+	for (i = 0; i < nargs; i++)
+		column_arrays[i] = jl_arrayref((jl_array_t *) columns, i);
+
+	row_cxt = AllocSetContextCreate(CurrentMemoryContext,
+									"PL/Julia spi_exec_prepared_many row",
+									ALLOCSET_DEFAULT_SIZES);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI manager");
+
+	qdesc->use_count++;
+	PG_TRY();
+	{
+		for (row = 0; row < nrows; row++)
 		{
-			trig_args[7] = pljulia_dict_from_tuple(trigdata->tg_newtuple,
-												   tupdesc, !TRIGGER_FIRED_BEFORE(trigdata->tg_event));
-			trig_args[8] = pljulia_dict_from_tuple(trigdata->tg_trigtuple,
-												   tupdesc, true);
-			rettuple = trigdata->tg_newtuple;
+			int			spi_rv;
+
+			MemoryContextReset(row_cxt);
+			oldcontext = MemoryContextSwitchTo(row_cxt);
+			for (i = 0; i < nargs; i++)
+				pljulia_plan_arg(qdesc, i,
+								 jl_arrayref((jl_array_t *) column_arrays[i], row),
+								 &argvalues[i], &nulls[i]);
+			MemoryContextSwitchTo(oldcontext);
+
+			spi_rv = SPI_execp(qdesc->plan, argvalues, nulls, 0);
+			if (spi_rv < 0)
+				elog(ERROR, "spi_exec_prepared_many: SPI_execp() failed:%s",
+					 SPI_result_code_string(spi_rv));
+			processed += SPI_processed;
+			SPI_freetuptable(SPI_tuptable);
+
+			CHECK_FOR_INTERRUPTS();
 		}
 	}
-	/* Finally, setup any args to the trigger in an array */
-	init_arr = jl_get_function(jl_main_module, "init_nulls_anyarray");
-	trig_args[9] = jl_call1(init_arr, jl_box_int64(trigdata->tg_trigger->tgnargs));
+	PG_FINALLY();
+	{
+		pljulia_plan_release(qdesc);
+	}
+	PG_END_TRY();
 
-	/*
-	 * All arguments are passed as strings to the Julia function, and it's up
-	 * to the user to convert to the desired type if needed (for example,
-	 * using parse for numeric input).
-	 */
-	for (i = 0; i < trigdata->tg_trigger->tgnargs; i++)
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish() failed");
+	MemoryContextDelete(row_cxt);
+
+	return jl_box_int64(processed);
+}
+
+/*
+ * The Julia object COPY FROM is reading from, see pljulia_copy_in, and what
+ * remains of the chunk of data it returned last
+ */
+static jl_value_t *copy_in_source = NULL;
+static const char *copy_in_data = NULL;
+static size_t copy_in_len = 0;
+
+/*
+ * Load rows into a table with COPY FROM. The rows are produced by a
+ * PLJulia.CopySource, which copy_next_chunk serializes into chunks of COPY
+ * data: in binary format if the types of all the target columns have a
+ * simple binary representation, in text format otherwise, or if strings
+ * would be read in a client encoding other than UTF-8. columns is a Julia
+ * array of column names, all the columns of the table if it is empty.
+ * Returns the number of rows loaded.
+ *
+ * Like COPY, this checks the INSERT privilege on the target columns and
+ * refuses tables with row level security.
+ */
+jl_value_t *
+pljulia_copy_in(jl_value_t *table, jl_value_t *columns, jl_value_t *source)
+{
+	Relation	rel;
+	ParseState *pstate;
+	ParseNamespaceItem *nsitem;
+	RangeTblEntry *rte;
+	CopyFromState cstate;
+	List	   *attnamelist = NIL;
+	List	   *options = NIL;
+	TupleDesc	tupdesc;
+	jl_array_t *types;
+	jl_value_t *volatile save_source = copy_in_source;
+	uint64		processed;
+	bool		binary = true;
+	int			ncolumns;
+	int			i;
+
+	rel = table_openrv(makeRangeVarFromNameList(stringToQualifiedNameList(jl_string_ptr(table))),
+					   RowExclusiveLock);
+	tupdesc = RelationGetDescr(rel);
+
+	pstate = make_parsestate(NULL);
+	nsitem = addRangeTableEntryForRelation(pstate, rel, RowExclusiveLock,
+										   NULL, false, false);
+	rte = nsitem->p_rte;
+	rte->requiredPerms = ACL_INSERT;
+
+	/* the target columns, their types and the columns to check */
+	ncolumns = jl_array_len((jl_array_t *) columns);
+	types = jl_alloc_vec_any(0);
+	JL_GC_PUSH1(&types);
+	if (ncolumns == 0)
 	{
-		arg = utf_e2u(trigdata->tg_trigger->tgargs[i]);
-		jl_arrayset(trig_args[9],
-					jl_cstr_to_string(arg), i);
+		for (i = 0; i < tupdesc->natts; i++)
+		{
+			Form_pg_attribute att = TupleDescAttr(tupdesc, i);
+
+			if (att->attisdropped || att->attgenerated)
+				continue;
+			jl_array_ptr_1d_push(types, jl_box_uint32(att->atttypid));
+			rte->insertedCols = bms_add_member(rte->insertedCols,
+											   att->attnum - FirstLowInvalidHeapAttributeNumber);
+		}
 	}
-	/* Now call the trigger function */
-	func = jl_get_function(jl_main_module, prodesc->internal_proname);
+	else
+	{
+		for (i = 0; i < ncolumns; i++)
+		{
+			char	   *name = jl_string_ptr(jl_arrayref((jl_array_t *) columns, i));
+			AttrNumber	attnum = attnameAttNum(rel, name, false);
+
+			if (attnum == InvalidAttrNumber)
+				ereport(ERROR,
+						(errcode(ERRCODE_UNDEFINED_COLUMN),
+						 errmsg("column \"%s\" of relation \"%s\" does not exist",
+								name, RelationGetRelationName(rel))));
+			attnamelist = lappend(attnamelist, makeString(pstrdup(name)));
+			jl_array_ptr_1d_push(types,
+								 jl_box_uint32(TupleDescAttr(tupdesc, attnum - 1)->atttypid));
+			rte->insertedCols = bms_add_member(rte->insertedCols,
+											   attnum - FirstLowInvalidHeapAttributeNumber);
+		}
+	}
+	ExecCheckRTPerms(pstate->p_rtable, true);
 
-	ret = jl_call(func, trig_args, 10);
+	if (check_enable_rls(RelationGetRelid(rel), InvalidOid, false) == RLS_ENABLED)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("spi_copy_in not supported with row-level security")));
+
+	for (i = 0; i < (int) jl_array_len(types); i++)
+	{
+		switch (jl_unbox_uint32(jl_arrayref(types, i)))
+		{
+			case BOOLOID:
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case FLOAT4OID:
+			case FLOAT8OID:
+				break;
+			case TEXTOID:
+			case VARCHAROID:
+				/* binary COPY reads strings in the client encoding */
+				if (pg_get_client_encoding() != PG_UTF8)
+					binary = false;
+				break;
+			default:
+				binary = false;
+				break;
+		}
+	}
+	if (binary)
+		options = lappend(options, makeDefElem("format",
+											   (Node *) makeString("binary"),
+											   -1));
+	/* Julia strings are UTF-8, converted to the database encoding */
+	options = lappend(options,
+					  makeDefElem("encoding", (Node *) makeString("UTF8"), -1));
+
+	jl_call3(jl_get_function(pljulia_module, "copy_begin"), source,
+			 jl_box_bool(binary), (jl_value_t *) types);
+	JL_GC_POP();
 	if (jl_exception_occurred())
 		show_julia_error();
 
-	/* Disconnect from the SPI_manager */
+	PG_TRY();
+	{
+		copy_in_source = source;
+		copy_in_data = NULL;
+		copy_in_len = 0;
+#if PG_VERSION_NUM >= 140000
+		cstate = BeginCopyFrom(pstate, rel, NULL, NULL, false,
+							   pljulia_copy_in_read, attnamelist, options);
+#else
+		cstate = BeginCopyFrom(pstate, rel, NULL, false,
+							   pljulia_copy_in_read, attnamelist, options);
+#endif
+		processed = CopyFrom(cstate);
+		EndCopyFrom(cstate);
+	}
+	PG_FINALLY();
+	{
+		copy_in_source = save_source;
+		copy_in_data = NULL;
+		copy_in_len = 0;
+	}
+	PG_END_TRY();
+
+	free_parsestate(pstate);
+	table_close(rel, NoLock);
+
+	return jl_box_int64(processed);
+}
+
+/*
+ * The data source callback of COPY FROM: copy the chunks returned by
+ * PLJulia.copy_next_chunk, an empty chunk being the end of the data.
+ */
+static int
+pljulia_copy_in_read(void *outbuf, int minread, int maxread)
+{
+	jl_function_t *next_chunk = jl_get_function(pljulia_module, "copy_next_chunk");
+	int			nread = 0;
+
+	while (nread < minread)
+	{
+		size_t		n;
+
+		if (copy_in_len == 0)
+		{
+			/* the chunk is kept alive by the source */
+			jl_value_t *chunk = jl_call1(next_chunk, copy_in_source);
+
+			if (jl_exception_occurred())
+				show_julia_error();
+			copy_in_data = (const char *) jl_array_data(chunk);
+			copy_in_len = jl_array_len((jl_array_t *) chunk);
+			if (copy_in_len == 0)
+				break;
+		}
+		n = Min((size_t) (maxread - nread), copy_in_len);
+		memcpy((char *) outbuf + nread, copy_in_data, n);
+		copy_in_data += n;
+		copy_in_len -= n;
+		nread += n;
+	}
+	return nread;
+}
+
+/*
+ * Run a query and write its result as COPY data to a Julia IO, in binary or
+ * CSV format, without keeping more than a chunk of it in memory: the tuples
+ * are sent straight from the executor to a pljulia_copy_dest. Returns the
+ * number of rows written.
+ */
+jl_value_t *
+pljulia_copy_out(jl_value_t *cmd, jl_value_t *io, jl_value_t *binary,
+				 jl_value_t *header)
+{
+	pljulia_copy_dest *dest;
+	SPIPlanPtr	plan;
+	Portal		portal;
+	uint64		processed;
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI manager");
+
+	plan = SPI_prepare(jl_string_ptr(cmd), 0, NULL);
+	if (plan == NULL)
+		elog(ERROR, "SPI_prepare() failed:%s",
+			 SPI_result_code_string(SPI_result));
+	portal = SPI_cursor_open(NULL, plan, NULL, NULL, true);
+	if (portal == NULL)
+		elog(ERROR, "SPI_cursor_open() failed:%s",
+			 SPI_result_code_string(SPI_result));
+
+	dest = (pljulia_copy_dest *) palloc0(sizeof(pljulia_copy_dest));
+	dest->pub.receiveSlot = pljulia_copy_dest_receive;
+	dest->pub.rStartup = pljulia_copy_dest_startup;
+	dest->pub.rShutdown = pljulia_copy_dest_shutdown;
+	dest->pub.rDestroy = pljulia_copy_dest_destroy;
+	dest->pub.mydest = DestNone;
+	dest->io = io;
+	dest->binary = jl_unbox_bool(binary);
+	dest->header = jl_unbox_bool(header);
+	initStringInfo(&dest->buf);
+	dest->rowcontext = AllocSetContextCreate(CurrentMemoryContext,
+											 "PL/Julia spi_copy_out row",
+											 ALLOCSET_DEFAULT_SIZES);
+
+	PortalRunFetch(portal, FETCH_FORWARD, FETCH_ALL, (DestReceiver *) dest);
+	processed = dest->processed;
+
+	dest->pub.rDestroy((DestReceiver *) dest);
+	SPI_cursor_close(portal);
+	SPI_freeplan(plan);
 	if (SPI_finish() != SPI_OK_FINISH)
 		elog(ERROR, "SPI_finish() failed");
 
-	/*
-	 * If function returned nothing or "OK", proceed normally. If function
-	 * returned "SKIP", then suppress the operation for this row. Otherwise,
-	 * for a "MODIFY" operation, the returned value must be a dictionary, with
-	 * rownames as keys and the desired corresponding values.
-	 */
-	if (jl_is_nothing(ret))
-		return PointerGetDatum(rettuple);
-	else if (jl_is_string(ret))
+	return jl_box_int64(processed);
+}
+
+static void
+pljulia_copy_dest_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
+{
+	pljulia_copy_dest *dest = (pljulia_copy_dest *) self;
+	int			i;
+
+	dest->natts = typeinfo->natts;
+	dest->out_funcs = (FmgrInfo *) palloc(dest->natts * sizeof(FmgrInfo));
+	for (i = 0; i < dest->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(typeinfo, i);
+		Oid			func;
+		bool		isvarlena;
+
+		if (dest->binary)
+			getTypeBinaryOutputInfo(att->atttypid, &func, &isvarlena);
+		else
+			getTypeOutputInfo(att->atttypid, &func, &isvarlena);
+		fmgr_info(func, &dest->out_funcs[i]);
+	}
+
+	if (dest->binary)
+	{
+		int32		zero = 0;
+
+		/* signature, flags and header extension length */
+		appendBinaryStringInfo(&dest->buf, "PGCOPY\n\377\r\n\0", 11);
+		appendBinaryStringInfo(&dest->buf, (char *) &zero, sizeof(zero));
+		appendBinaryStringInfo(&dest->buf, (char *) &zero, sizeof(zero));
+	}
+	else if (dest->header)
+	{
+		for (i = 0; i < dest->natts; i++)
+		{
+			if (i > 0)
+				appendStringInfoChar(&dest->buf, ',');
+			pljulia_copy_csv_attribute(&dest->buf,
+									   NameStr(TupleDescAttr(typeinfo, i)->attname));
+		}
+		appendStringInfoChar(&dest->buf, '\n');
+	}
+}
+
+static bool
+pljulia_copy_dest_receive(TupleTableSlot *slot, DestReceiver *self)
+{
+	pljulia_copy_dest *dest = (pljulia_copy_dest *) self;
+	MemoryContext oldcontext;
+	int			i;
+
+	slot_getallattrs(slot);
+	MemoryContextReset(dest->rowcontext);
+	oldcontext = MemoryContextSwitchTo(dest->rowcontext);
+
+	if (dest->binary)
+	{
+		uint16		natts = pg_hton16((uint16) dest->natts);
+
+		appendBinaryStringInfo(&dest->buf, (char *) &natts, sizeof(natts));
+	}
+	for (i = 0; i < dest->natts; i++)
+	{
+		if (dest->binary)
+		{
+			uint32		len;
+
+			if (slot->tts_isnull[i])
+			{
+				len = pg_hton32((uint32) -1);
+				appendBinaryStringInfo(&dest->buf, (char *) &len, sizeof(len));
+			}
+			else
+			{
+				bytea	   *outputbytes;
+
+				outputbytes = SendFunctionCall(&dest->out_funcs[i],
+											   slot->tts_values[i]);
+				len = pg_hton32(VARSIZE(outputbytes) - VARHDRSZ);
+				appendBinaryStringInfo(&dest->buf, (char *) &len, sizeof(len));
+				appendBinaryStringInfo(&dest->buf, VARDATA(outputbytes),
+									   VARSIZE(outputbytes) - VARHDRSZ);
+			}
+		}
+		else
+		{
+			if (i > 0)
+				appendStringInfoChar(&dest->buf, ',');
+			/* NULL is an unquoted empty string */
+			if (!slot->tts_isnull[i])
+				pljulia_copy_csv_attribute(&dest->buf,
+										   OutputFunctionCall(&dest->out_funcs[i],
+															  slot->tts_values[i]));
+		}
+	}
+	if (!dest->binary)
+		appendStringInfoChar(&dest->buf, '\n');
+
+	MemoryContextSwitchTo(oldcontext);
+	dest->processed++;
+
+	if (dest->buf.len >= PLJULIA_COPY_CHUNK_SIZE)
+		pljulia_copy_dest_flush(dest);
+	return true;
+}
+
+static void
+pljulia_copy_dest_shutdown(DestReceiver *self)
+{
+	pljulia_copy_dest *dest = (pljulia_copy_dest *) self;
+
+	if (dest->binary)
+	{
+		uint16		trailer = pg_hton16((uint16) -1);
+
+		appendBinaryStringInfo(&dest->buf, (char *) &trailer, sizeof(trailer));
+	}
+	pljulia_copy_dest_flush(dest);
+}
+
+static void
+pljulia_copy_dest_destroy(DestReceiver *self)
+{
+	pljulia_copy_dest *dest = (pljulia_copy_dest *) self;
+
+	MemoryContextDelete(dest->rowcontext);
+	pfree(dest->buf.data);
+	if (dest->out_funcs)
+		pfree(dest->out_funcs);
+	pfree(dest);
+}
+
+/*
+ * Write the buffered COPY data to the Julia IO
+ */
+static void
+pljulia_copy_dest_flush(pljulia_copy_dest *dest)
+{
+	jl_value_t *chunk;
+
+	if (dest->buf.len == 0)
+		return;
+	/* a Julia array over the buffer, write copies it */
+	chunk = (jl_value_t *) jl_ptr_to_array_1d(jl_apply_array_type((jl_value_t *) jl_uint8_type, 1),
+											  dest->buf.data, dest->buf.len, 0);
+	jl_call2(jl_get_function(jl_base_module, "write"), dest->io, chunk);
+	if (jl_exception_occurred())
+		show_julia_error();
+	resetStringInfo(&dest->buf);
+}
+
+/*
+ * Append a value, in the database encoding, to CSV data in UTF-8. It is
+ * quoted if it contains a delimiter, quote or newline, if it is empty and
+ * would read as NULL otherwise, if it is \. and would read as the end of the
+ * data, or if it starts or ends with white space that a reader may trim.
+ */
+static void
+pljulia_copy_csv_attribute(StringInfo buf, const char *value)
+{
+	const char *p;
+	size_t		len;
+
+	value = pg_server_to_any(value, strlen(value), PG_UTF8);
+	len = strlen(value);
+	if (len > 0 && strpbrk(value, ",\"\r\n") == NULL &&
+		strcmp(value, "\\.") != 0 &&
+		!isspace((unsigned char) value[0]) &&
+		!isspace((unsigned char) value[len - 1]))
+	{
+		appendStringInfoString(buf, value);
+		return;
+	}
+	appendStringInfoChar(buf, '"');
+	for (p = value; *p; p++)
+	{
+		if (*p == '"')
+			appendStringInfoChar(buf, '"');
+		appendStringInfoChar(buf, *p);
+	}
+	appendStringInfoChar(buf, '"');
+}
+
+/*
+ * Look up a plan saved by spi_prepare, raising an error on behalf of the
+ * caller if it doesn't exist.
+ */
+static pljulia_query_desc *
+pljulia_find_plan(jl_value_t *plan, const char *caller)
+{
+	pljulia_query_entry *hash_entry;
+	pljulia_query_desc *qdesc;
+
+	/* The hashtable entry key is a char * for the query hashtable */
+	hash_entry = hash_search(pljulia_query_hashtable, jl_string_ptr(plan),
+							 HASH_FIND, NULL);
+	if (hash_entry == NULL)
+		elog(ERROR, "%s: Invalid prepared query passed", caller);
+
+	qdesc = hash_entry->query_desc;
+	if (qdesc == NULL)
+		elog(ERROR, "%s: query_hash value vanished", caller);
+
+	qdesc->calls++;
+	qdesc->last_used = GetCurrentStatementStartTimestamp();
+	dlist_move_head(&pljulia_plan_lru, &qdesc->lru_node);
+	return qdesc;
+}
+
+/*
+ * Convert the Julia array of arguments of a saved plan to the values and
+ * nulls arrays SPI expects.
+ */
+static void
+pljulia_plan_args(pljulia_query_desc *qdesc, jl_value_t *arguments,
+				  Datum **argvalues, char **nulls)
+{
+	jl_function_t *len = jl_get_function(jl_base_module, "length");
+	int			nargs;
+	int			i;
+
+	nargs = jl_unbox_int64(jl_call1(len, arguments));
+	if (qdesc->nargs != nargs)
+		elog(ERROR, "spi_exec_prepared: expected %d argument(s), %d passed",
+			 qdesc->nargs, nargs);
+
+	if (nargs == 0)
+	{
+		*nulls = NULL;
+		*argvalues = NULL;
+		return;
+	}
+	*nulls = (char *) palloc0(nargs * sizeof(char));
+	*argvalues = (Datum *) palloc0(nargs * sizeof(Datum));
+
+	for (i = 0; i < nargs; i++)
+	{
+		jl_value_t *curr_arg = jl_arrayref(arguments, i);
+
+		pljulia_plan_arg(qdesc, i, curr_arg, &(*argvalues)[i], &(*nulls)[i]);
+	}
+}
+
+/*
+ * Convert one argument of a saved plan, directly from the unboxed Julia
+ * value when the parameter type allows it.
+ */
+static inline void
+pljulia_plan_arg(pljulia_query_desc *qdesc, int i, jl_value_t *arg,
+				 Datum *value, char *null)
+{
+	/* null value? */
+	if (jl_is_nothing(arg))
+	{
+		*null = 'n';
+		*value = (Datum) 0;
+	}
+	else
+	{
+		*null = ' ';
+		if (!jl_value_to_param_datum(arg, qdesc->argconvs[i], value))
+			*value = jl_value_t_to_datum(NULL, arg, qdesc->argtypes[i], false);
+	}
+}
+
+/*
+ * Convert the first ntuples rows of a tuple table to a Julia array of
+ * dictionaries.
+ */
+static jl_value_t *
+pljulia_rows_from_tuptable(SPITupleTable *tuptable, uint64 ntuples)
+{
+	TupleDesc	tupdesc = tuptable->tupdesc;
+	uint64		i;
+	jl_value_t *ret_val;
+	jl_function_t *init_arr = jl_get_function(pljulia_module, "init_nulls_anyarray");
+
+	/* allocate an array to store the results */
+	ret_val = jl_call1(init_arr, jl_box_int64(ntuples));
+	JL_GC_PUSH1(&ret_val);
+
+	for (i = 0; i < ntuples; i++)
+		jl_arrayset((jl_array_t *) ret_val,
+					pljulia_dict_from_tuple(tuptable->vals[i], tupdesc, false),
+					i);
+
+	JL_GC_POP();
+	return ret_val;
+}
+
+/*
+ * Open a cursor for a saved plan and its arguments, like spi_exec(query)
+ * does for a query. Returns the name of the cursor.
+ */
+jl_value_t *
+pljulia_spi_cursor_open_plan(jl_value_t *plan, jl_value_t *arguments)
+{
+	char	   *nulls;
+	Datum	   *argvalues;
+	pljulia_query_desc *qdesc;
+	Portal		portal;
+	jl_value_t *cursor = NULL;
+
+	qdesc = pljulia_find_plan(plan, "spi_cursor");
+	pljulia_plan_args(qdesc, arguments, &argvalues, &nulls);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI manager");
+
+	portal = SPI_cursor_open(NULL, qdesc->plan, argvalues, nulls, false);
+	if (portal == NULL)
+		elog(ERROR, "SPI_cursor_open() failed:%s",
+			 SPI_result_code_string(SPI_result));
+	cursor = jl_cstr_to_string(portal->name);
+
+	PinPortal(portal);
+
+	JL_GC_PUSH1(&cursor);
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish() failed");
+	JL_GC_POP();
+
+	return cursor;
+}
+
+/*
+ * Fetch up to count rows from a cursor, returned as a Julia array of
+ * dictionaries. The cursor is closed as soon as a fetch comes back short, so
+ * its end costs no extra round trip. A count of zero means
+ * pljulia.cursor_fetch_size rows.
+ */
+jl_value_t *
+pljulia_spi_fetch(jl_value_t *cursor, jl_value_t *count)
+{
+	jl_value_t *rows;
+	Portal		p;
+	long		nrows;
+
+	nrows = jl_unbox_int64(count);
+	if (nrows <= 0)
+		nrows = pljulia_fetch_size;
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI manager");
+
+	p = SPI_cursor_find(jl_string_ptr(cursor));
+	if (!p)
+		rows = jl_eval_string("[]");
+	else
+	{
+		SPI_cursor_fetch(p, true, nrows);
+		rows = pljulia_rows_from_tuptable(SPI_tuptable, SPI_processed);
+		if (SPI_processed < (uint64) nrows)
+		{
+			UnpinPortal(p);
+			SPI_cursor_close(p);
+		}
+		SPI_freetuptable(SPI_tuptable);
+	}
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish() failed");
+
+	return rows;
+}
+
+/*
+ * The default number of rows fetched at a time by cursors
+ */
+int
+pljulia_cursor_fetch_size(void)
+{
+	return pljulia_fetch_size;
+}
+
+void
+pljulia_return_next(jl_value_t *obj)
+{
+	pljulia_call_data *call_data;
+	FunctionCallInfo fcinfo;
+	pljulia_proc_desc *prodesc;
+	MemoryContext old_cxt;
+
+	call_data = pljulia_srf_call_data("return_next");
+	fcinfo = call_data->fcinfo;
+	prodesc = call_data->prodesc;
+
+	/* done with first-call initializations */
+	if (!current_call_data->tmp_cxt)
+	{
+		current_call_data->tmp_cxt = AllocSetContextCreate(
+														   CurrentMemoryContext, "PL/Julia return_next temp context",
+														   ALLOCSET_SMALL_SIZES);
+	}
+	old_cxt = MemoryContextSwitchTo(current_call_data->tmp_cxt);
+
+	if (prodesc->fn_retistuple)
+	{
+		HeapTuple	tuple;
+
+		tuple = pljulia_build_tuple_result(obj, current_call_data->ret_tupdesc);
+		tuplestore_puttuple(call_data->tuple_store, tuple);
+	}
+	else if (prodesc->result_typid)
+	{
+		Datum		ret[1];
+		bool		isNull[1];
+
+		if (!obj || jl_is_nothing(obj))
+			isNull[0] = true;
+		else
+			isNull[0] = false;
+		ret[0] = jl_value_t_to_datum(fcinfo, obj, prodesc->result_typid, false);
+		tuplestore_putvalues(call_data->tuple_store, call_data->ret_tupdesc,
+							 ret, isNull);
+	}
+	MemoryContextSwitchTo(old_cxt);
+	MemoryContextReset(current_call_data->tmp_cxt);
+}
+
+/*
+ * Return the data of the current call for return_next or return_query, after
+ * checking that it is a set-returning function, and set up its tuple store if
+ * this is the first output row.
+ */
+static pljulia_call_data *
+pljulia_srf_call_data(const char *caller)
+{
+	pljulia_call_data *call_data = current_call_data;
+	FunctionCallInfo fcinfo;
+	pljulia_proc_desc *prodesc;
+	MemoryContext old_cxt;
+	ReturnSetInfo *rsi;
+
+	if (call_data == NULL || call_data->prodesc == NULL ||
+		!call_data->prodesc->fn_retisset)
+		elog(ERROR, "%s called in function that doesn't return set", caller);
+
+	fcinfo = call_data->fcinfo;
+	prodesc = call_data->prodesc;
+	rsi = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	if (!call_data->ret_tupdesc)
+	{
+		TupleDesc	tupdesc;
+
+		if (prodesc->fn_retistuple)
+		{
+			Oid			typid;
+
+			if (get_call_result_type(fcinfo, &typid, &tupdesc) !=
+				TYPEFUNC_COMPOSITE)
+				elog(ERROR, "function returning record called in context that "
+					 "cannot accept type record");
+		}
+		else
+		{
+			tupdesc = rsi->expectedDesc;
+			if (tupdesc == NULL || tupdesc->natts != 1)
+				elog(ERROR, "expected single-column result descriptor for "
+					 "non-composite SETOF result");
+		}
+
+		/*
+		 * Make sure the tuple_store and ret_tdesc are sufficiently
+		 * long-lived.
+		 */
+		old_cxt = MemoryContextSwitchTo(rsi->econtext->ecxt_per_query_memory);
+
+		call_data->ret_tupdesc = CreateTupleDescCopy(tupdesc);
+		call_data->tuple_store = tuplestore_begin_heap(rsi->allowedModes
+													   & SFRM_Materialize_Random,
+													   false, work_mem);
+
+		MemoryContextSwitchTo(old_cxt);
+	}
+	return call_data;
+}
+
+/*
+ * Run a query and append its rows to the result of the current set-returning
+ * function, like RETURN QUERY in PL/pgSQL. The executor sends the tuples
+ * straight to the tuple store, so they never go through Julia. Returns the
+ * number of rows appended.
+ */
+jl_value_t *
+pljulia_return_query(jl_value_t *cmd, jl_value_t *arguments)
+{
+	pljulia_call_data *call_data;
+	pljulia_return_dest *dest;
+	int			nargs;
+	Oid		   *argtypes;
+	Datum	   *argvalues;
+	char	   *nulls;
+	pljulia_stmt_entry *volatile entry;
+	SPIPlanPtr	plan;
+	Portal		portal;
+	uint64		processed;
+
+	call_data = pljulia_srf_call_data("return_query");
+	pljulia_bind_params(arguments, &nargs, &argtypes, &argvalues, &nulls);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI manager");
+
+	entry = pljulia_stmt_lookup(jl_string_ptr(cmd), nargs, argtypes);
+	if (entry != NULL)
+		plan = entry->plan;
+	else
+		plan = pljulia_prepare_params(jl_string_ptr(cmd), nargs, argtypes);
+	pljulia_input_params(plan, nargs, argtypes, argvalues, nulls);
+
+	dest = (pljulia_return_dest *) palloc0(sizeof(pljulia_return_dest));
+	dest->pub.receiveSlot = pljulia_return_dest_receive;
+	dest->pub.rStartup = pljulia_return_dest_startup;
+	dest->pub.rShutdown = pljulia_return_dest_shutdown;
+	dest->pub.rDestroy = pljulia_return_dest_destroy;
+	dest->pub.mydest = DestNone;
+	dest->tuple_store = call_data->tuple_store;
+	dest->ret_tupdesc = call_data->ret_tupdesc;
+
+	PG_TRY();
+	{
+		if (entry != NULL)
+			entry->use_count++;
+		portal = SPI_cursor_open(NULL, plan, argvalues, nulls, false);
+		if (portal == NULL)
+			elog(ERROR, "SPI_cursor_open() failed:%s",
+				 SPI_result_code_string(SPI_result));
+		PortalRunFetch(portal, FETCH_FORWARD, FETCH_ALL, (DestReceiver *) dest);
+		SPI_cursor_close(portal);
+	}
+	PG_FINALLY();
+	{
+		if (entry != NULL)
+			entry->use_count--;
+	}
+	PG_END_TRY();
+
+	processed = dest->processed;
+	dest->pub.rDestroy((DestReceiver *) dest);
+	if (entry == NULL)
+		SPI_freeplan(plan);
+
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish() failed");
+	return jl_box_int64(processed);
+}
+
+static void
+pljulia_return_dest_startup(DestReceiver *self, int operation,
+							TupleDesc typeinfo)
+{
+	pljulia_return_dest *dest = (pljulia_return_dest *) self;
+
+	dest->map = convert_tuples_by_position(typeinfo, dest->ret_tupdesc,
+										   gettext_noop("structure of query does not match function result type"));
+	if (dest->map != NULL)
+		dest->outslot = MakeSingleTupleTableSlot(dest->ret_tupdesc,
+												 &TTSOpsVirtual);
+}
+
+static bool
+pljulia_return_dest_receive(TupleTableSlot *slot, DestReceiver *self)
+{
+	pljulia_return_dest *dest = (pljulia_return_dest *) self;
+
+	if (dest->map != NULL)
+		slot = execute_attr_map_slot(dest->map->attrMap, slot, dest->outslot);
+	tuplestore_puttupleslot(dest->tuple_store, slot);
+	dest->processed++;
+	return true;
+}
+
+static void
+pljulia_return_dest_shutdown(DestReceiver *self)
+{
+	pljulia_return_dest *dest = (pljulia_return_dest *) self;
+
+	if (dest->outslot != NULL)
+	{
+		ExecDropSingleTupleTableSlot(dest->outslot);
+		dest->outslot = NULL;
+	}
+	if (dest->map != NULL)
+	{
+		free_conversion_map(dest->map);
+		dest->map = NULL;
+	}
+}
+
+static void
+pljulia_return_dest_destroy(DestReceiver *self)
+{
+	pfree(self);
+}
+
+void
+pljulia_elog(jl_value_t *lvl, jl_value_t *msg)
+{
+	volatile int level;
+	int			priority_idx;
+	int			i;
+
+	static const char *logpriorities[] = {
+		"DEBUG", "LOG", "INFO", "NOTICE",
+		"WARNING", "ERROR", "FATAL", (const char *) NULL
+	};
+
+	static const int loglevels[] = {
+		DEBUG1, LOG, INFO, NOTICE,
+		WARNING, ERROR, FATAL
+	};
+
+	for (i = 0; i < 8; i++)
+	{
+		if (strcmp(logpriorities[i], jl_string_ptr(lvl)) == 0)
+		{
+			priority_idx = i;
+			break;
+		}
+	}
+	if (i >= 7)
+		elog(ERROR, "no match found for elog levels");
+	else
+	{
+		level = loglevels[priority_idx];
+		elog(level, "%s", jl_string_ptr(msg));
+	}
+	return;
+}
+
+
+
+/*
+ * takes a Julia tuple or dictionary and a TupleDesc as input,
+ * and returns a heaptuple to use in a SRF tuplestore.
+ */
+static HeapTuple
+pljulia_build_tuple_result(jl_value_t *obj, TupleDesc tupdesc)
+{
+	Datum	   *values;
+	bool	   *nulls;
+	HeapTuple	tup;
+	int			nfields;
+	Form_pg_attribute att;
+	int			i;
+	jl_value_t *curr_elem;
+
+	if (!obj || jl_is_nothing(obj))
+		elog(ERROR, "Attempting to build tuple from nothing");
+
+	if (jl_is_dict(obj))
+	{
+		jl_function_t *dict_nfields;
+
+		dict_nfields = jl_get_function(jl_base_module, "length");
+
+		nfields = jl_unbox_int64(jl_call1(dict_nfields, obj));
+		if (tupdesc->natts != nfields)
+			elog(ERROR, "Dict number of fields mismatch");
+	}
+	else
+	{
+		nfields = jl_nfields(obj);
+		if (tupdesc->natts != nfields)
+			elog(ERROR, "Tuple number of fields mismatch");
+	}
+
+	values = (Datum *) palloc0(sizeof(Datum) * nfields);
+	nulls = (bool *) palloc0(sizeof(bool) * nfields);
+
+	for (i = 0; i < nfields; i++)
+	{
+		att = TupleDescAttr(tupdesc, i);
+		nulls[i] = false;
+
+		if (jl_is_tuple(obj))
+			curr_elem = jl_get_nth_field(obj, i);
+		else
+		{
+			char	   *attname = NameStr(att->attname);
+			jl_value_t *key = jl_cstr_to_string(attname);
+			jl_function_t *dict_get = jl_get_function(pljulia_module, "dict_get");
+
+			curr_elem = jl_call2(dict_get, key, obj);
+		}
+
+		if (jl_typeis(curr_elem, jl_nothing_type))
+		{
+			nulls[i] = true;
+			continue;
+		}
+
+		values[i] = jl_value_t_to_datum(current_call_data->fcinfo, curr_elem,
+										att->atttypid, false);
+	}
+	tup = heap_form_tuple(tupdesc, values, nulls);
+	pfree(nulls);
+	pfree(values);
+	return tup;
+}
+
+void
+_PG_init(void)
+{
+	double		jl_init_time;
+	struct timeval t1,
+				t2;
+	char		sharepath[MAXPGPATH];
+	char		jl_file[MAXPGPATH];
+
+	gettimeofday(&t1, NULL);
+	/* required: setup the Julia context */
+	jl_init();
+	gettimeofday(&t2, NULL);
+	jl_init_time = (double) (t2.tv_usec - t1.tv_usec) / 1000 +
+		(double) (t2.tv_sec - t1.tv_sec) * 1000;
+	elog(DEBUG1, "Julia initialized in %f milliseconds.", jl_init_time);
+
+	/*
+	 * Initialize the hash table
+	 */
+	HASHCTL		hash_ctl;
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(pljulia_proc_key);
+	hash_ctl.entrysize = sizeof(pljulia_hash_entry);
+
+	pljulia_proc_hashtable =
+		hash_create("PL/Julia cached procedures hashtable", 32, &hash_ctl,
+					HASH_ELEM | HASH_BLOBS);
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = NAMEDATALEN;
+	hash_ctl.entrysize = sizeof(pljulia_query_entry);
+	pljulia_query_hashtable = hash_create("PL/Julia cached plans hashtable",
+										  32, &hash_ctl,
+										  HASH_ELEM | HASH_STRINGS);
+	CacheRegisterSyscacheCallback(PROCOID, pljulia_proc_invalidate, (Datum) 0);
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(uint64);
+	hash_ctl.entrysize = sizeof(pljulia_stmt_entry);
+	pljulia_stmt_hashtable = hash_create("PL/Julia cached statements hashtable",
+										 64, &hash_ctl,
+										 HASH_ELEM | HASH_BLOBS);
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(uint64);
+	hash_ctl.entrysize = sizeof(pljulia_plan_key_entry);
+	pljulia_plan_key_hashtable = hash_create("PL/Julia saved plans by query hashtable",
+											 32, &hash_ctl,
+											 HASH_ELEM | HASH_BLOBS);
+
+	pljulia_stmt_cxt = AllocSetContextCreate(TopMemoryContext,
+											 "PL/Julia cached statements",
+											 ALLOCSET_SMALL_SIZES);
+
+	pljulia_fcall_cxt = AllocSetContextCreate(TopMemoryContext,
+											  "PL/Julia pg_call functions",
+											  ALLOCSET_SMALL_SIZES);
+	CacheRegisterSyscacheCallback(PROCOID, pljulia_fcall_invalidate, (Datum) 0);
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(uint64);
+	hash_ctl.entrysize = sizeof(pljulia_index_entry);
+	pljulia_index_hashtable = hash_create("PL/Julia index_lookup hashtable",
+										  32, &hash_ctl,
+										  HASH_ELEM | HASH_BLOBS);
+	CacheRegisterRelcacheCallback(pljulia_index_invalidate, (Datum) 0);
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(Oid);
+	hash_ctl.entrysize = sizeof(pljulia_decoding_relation);
+	pljulia_decoding_relations = hash_create("PL/Julia decoded relations",
+											 32, &hash_ctl,
+											 HASH_ELEM | HASH_BLOBS);
+	CacheRegisterRelcacheCallback(pljulia_decoding_invalidate, (Datum) 0);
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(uint64);
+	hash_ctl.entrysize = sizeof(pljulia_inline_entry);
+	pljulia_inline_hashtable = hash_create("PL/Julia cached DO blocks hashtable",
+										   32, &hash_ctl,
+										   HASH_ELEM | HASH_BLOBS);
+
+	DefineCustomIntVariable("pljulia.inline_cache_size",
+							"Sets the maximum number of compiled DO blocks "
+							"kept by each session.",
+							"Zero disables caching.",
+							&pljulia_inline_cache_size,
+							32, 0, INT_MAX,
+							PGC_USERSET, 0,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pljulia.max_cached_functions",
+							"Sets the maximum number of compiled functions "
+							"kept by each session.",
+							"The least recently used functions are evicted "
+							"first. Zero means no limit.",
+							&pljulia_max_cached_functions,
+							0, 0, INT_MAX,
+							PGC_USERSET, 0,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pljulia.memoize_size",
+							"Sets the maximum number of results memoized "
+							"for each immutable function.",
+							"Read when the function is compiled, so it is "
+							"usually set with the SET clause of CREATE "
+							"FUNCTION. Zero disables memoization.",
+							&pljulia_memoize_size,
+							0, 0, INT_MAX,
+							PGC_USERSET, 0,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pljulia.cursor_fetch_size",
+							"Sets the number of rows fetched at a time by "
+							"cursors.",
+							"Used by cursors opened without an explicit "
+							"fetch size.",
+							&pljulia_fetch_size,
+							1000, 1, INT_MAX,
+							PGC_USERSET, 0,
+							NULL, NULL, NULL);
+	DefineCustomIntVariable("pljulia.statement_cache_size",
+							"Sets the maximum number of plans of statements "
+							"executed with parameters kept by each session.",
+							"The least recently used plans are freed first. "
+							"Zero disables the cache.",
+							&pljulia_statement_cache_size,
+							64, 0, INT_MAX,
+							PGC_USERSET, 0,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pljulia.max_saved_plans",
+							"Sets the maximum number of plans saved by "
+							"spi_prepare kept by each session.",
+							"The least recently used plans are freed first.",
+							&pljulia_max_saved_plans,
+							1000, 1, INT_MAX,
+							PGC_USERSET, 0,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pljulia.shared_data_size",
+							"Sets the maximum size of the values kept in SD "
+							"by all the sessions.",
+							"The least recently used values are evicted "
+							"first, from PostgreSQL 15.",
+							&pljulia_shared_data_size,
+							65536, 64, INT_MAX,
+							PGC_SIGHUP, GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pljulia.session_cache_size",
+							"Sets the maximum size of the values kept by "
+							"cache_get! in each session.",
+							"The least recently used values are evicted "
+							"first. Zero means no limit.",
+							&pljulia_session_cache_size,
+							65536, 0, INT_MAX,
+							PGC_USERSET, GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
+	RegisterXactCallback(pljulia_xact_callback, NULL);
+	RegisterSubXactCallback(pljulia_subxact_callback, NULL);
+
+#if PG_VERSION_NUM >= 150000
+	MarkGUCPrefixReserved("pljulia");
+#else
+	EmitWarningsOnPlaceholders("pljulia");
+#endif
+
+	/*
+	 * Load the Julia side of the language, the PLJulia module. It holds our
+	 * global data (a dictionary named GD, which holds data we want to be
+	 * shared between functions), the functions user code calls to access the
+	 * database and the helpers used to convert composite types to
+	 * dictionaries. Each pljulia function is later compiled into its own
+	 * module importing PLJulia, so nothing user-defined ends up in Main.
+	 */
+	get_share_path(my_exec_path, sharepath);
+	snprintf(jl_file, sizeof(jl_file), "%s/extension/pljulia.jl", sharepath);
+	jl_call2(jl_get_function(jl_base_module, "include"),
+			 (jl_value_t *) jl_main_module, jl_cstr_to_string(jl_file));
+	if (jl_exception_occurred())
+		show_julia_error();
+	pljulia_module = (jl_module_t *) jl_get_global(jl_main_module,
+												   jl_symbol("PLJulia"));
+
+	/* load the installed packages */
+	jl_eval_string("using Pkg; "
+				   "PLJulia.load_packages(keys(Pkg.installed()))");
+}
+
+/*
+ * Convert the C string "input" to a Datum of type "typeoid".
+ */
+static Datum
+cstring_to_type(char *input, Oid typeoid)
+{
+	Oid			typInput,
+				typIOParam;
+	Datum		ret;
+
+	getTypeInputInfo(typeoid, &typInput, &typIOParam);
+	ret = OidFunctionCall3(typInput, CStringGetDatum(input), 0, -1);
+
+	PG_RETURN_DATUM(ret);
+}
+
+/*
+ * Convert the Julia result to a Datum of type "typeoid".
+ */
+static Datum
+jl_value_t_to_datum(FunctionCallInfo fcinfo, jl_value_t *ret, Oid prorettype, bool usefcinfo)
+{
+	/* maybe I should check the depth of the recursion stack */
+	char	   *buffer;
+
+	/* A nothing in Julia is a NULL in Postgres */
+	if (jl_is_nothing(ret))
+		PG_RETURN_VOID();
+	/* Handle base types */
+	if (jl_is_string(ret))
+	{
+		elog(DEBUG1, "ret (string): %s", jl_string_ptr(ret));
+		PG_RETURN_DATUM(cstring_to_type((char *) jl_string_ptr(ret),
+										prorettype));
+	}
+	else if (jl_typeis(ret, jl_float64_type))
+	{
+		double		ret_unboxed = jl_unbox_float64(ret);
+
+		elog(DEBUG1, "ret (float64): %f", jl_unbox_float64(ret));
+
+		buffer = (char *) palloc0((DOUBLE_LEN + 1) * sizeof(char));
+		snprintf(buffer, DOUBLE_LEN, "%.16f", ret_unboxed);
+	}
+	else if (jl_is_bigfloat(ret))
+	{
+		/* this is how we map the numeric types */
+		jl_function_t *str_func = jl_get_function(jl_base_module, "string");
+
+		/*
+		 * get the string representation of bigfloat since there's not a
+		 * function in Julia's C-API for unboxing this type
+		 */
+		buffer = jl_string_ptr(jl_call1(str_func, ret));
+	}
+	else if (jl_typeis(ret, jl_float32_type))
+	{
+		double		ret_unboxed = jl_unbox_float32(ret);
+
+		elog(DEBUG1, "ret (float32): %f", jl_unbox_float32(ret));
+
+		buffer = (char *) palloc0((DOUBLE_LEN + 1) * sizeof(char));
+		snprintf(buffer, DOUBLE_LEN, "%f", ret_unboxed);
+	}
+	else if (jl_typeis(ret, jl_int64_type))
+	{
+		long int	ret_unboxed = jl_unbox_int64(ret);
+
+		elog(DEBUG1, "ret (int64): %ld", jl_unbox_int64(ret));
+
+		buffer = (char *) palloc0((LONG_INT_LEN + 1) * sizeof(char));
+		snprintf(buffer, LONG_INT_LEN, "%ld", ret_unboxed);
+	}
+	else if (jl_typeis(ret, jl_int32_type))
+	{
+		int			ret_unboxed = jl_unbox_int32(ret);
+
+		elog(DEBUG1, "ret (int32): %d", jl_unbox_int32(ret));
+
+		buffer = (char *) palloc0((LONG_INT_LEN + 1) * sizeof(char));
+		snprintf(buffer, LONG_INT_LEN, "%d", ret_unboxed);
+	}
+	else if (jl_typeis(ret, jl_char_type))
+	{
+		char		ret_unboxed = jl_unbox_int32(ret);
+
+		elog(DEBUG1, "ret (int32): %d", jl_unbox_int32(ret));
+
+		buffer = (char *) palloc0((LONG_INT_LEN + 1) * sizeof(char));
+		snprintf(buffer, LONG_INT_LEN, "%c", ret_unboxed);
+	}
+	else if (jl_typeis(ret, jl_bool_type))
+	{
+		int			ret_unboxed = jl_unbox_bool(ret);
+
+		elog(DEBUG1, "ret (bool): %d", jl_unbox_bool(ret));
+
+		buffer = (char *) palloc0((LONG_INT_LEN + 1) * sizeof(char));
+		snprintf(buffer, LONG_INT_LEN, "%d", ret_unboxed);
+	}
+	/* If not a base type, but still a valid type */
+	else if (jl_is_array(ret))
+	{
+		/* handle the arraytype */
+		PG_RETURN_DATUM(pg_array_from_julia_array(fcinfo, ret, prorettype));
+	}
+	else if (jl_is_tuple(ret))
+	{
+		/* handle the tupletype - return a composite */
+		PG_RETURN_DATUM(pg_composite_from_julia_tuple(fcinfo, ret, prorettype, usefcinfo));
+	}
+	else if (jl_is_dict(ret))
+	{
+		PG_RETURN_DATUM(pg_composite_from_julia_dict(fcinfo, ret, prorettype, usefcinfo));
+	}
+	else
+	{
+		elog(ERROR, "ERROR: unexpected unboxed Julia return type");
+		PG_RETURN_NULL();
+	}
+	elog(DEBUG1, "ret (buffer): %s", buffer);
+
+	PG_RETURN_DATUM(cstring_to_type(buffer, prorettype));
+}
+
+void
+julia_setup_input_args(FunctionCallInfo fcinfo, HeapTuple procedure_tuple,
+					   Form_pg_proc procedure_struct, jl_value_t **boxed_args,
+					   pljulia_proc_desc *prodesc)
+{
+	Oid		   *argtypes;
+	char	  **argnames;
+	char	   *argmodes;
+	int			i;
+	Form_pg_type type_struct;
+	HeapTuple	type_tuple;
+	MemoryContext proc_cxt;
+	bool		is_array_type;
+
+	get_func_arg_info(procedure_tuple, &argtypes, &argnames, &argmodes);
+	proc_cxt = prodesc->mcxt;
+
+	for (i = 0; i < fcinfo->nargs; i++)
+	{
+		Oid			argtype = procedure_struct->proargtypes.values[i];
+
+		type_tuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(argtype));
+		if (!HeapTupleIsValid(type_tuple))
+			elog(ERROR, "cache lookup failed for type %u", argtype);
+
+		prodesc->arg_is_rowtype[i] = type_is_rowtype(argtypes[i]);
+
+		type_struct = (Form_pg_type) GETSTRUCT(type_tuple);
+		if (!prodesc->arg_is_rowtype[i])
+			fmgr_info_cxt(type_struct->typoutput, &(prodesc->arg_out_func[i]),
+						  proc_cxt);
+		/* Whether it's a "true" array type */
+		is_array_type = (type_struct->typelem != 0 &&
+						 type_struct->typlen == -1);
+		prodesc->arg_arraytype[i] = (is_array_type) ? argtypes[i] : InvalidOid;
+
+		ReleaseSysCache(type_tuple);
+		/* First check if the input argument is NULL */
+		if (fcinfo->args[i].isnull)
+		{
+			boxed_args[i] = jl_nothing;
+			continue;
+		}
+		boxed_args[i] = convert_arg_to_julia(fcinfo->args[i].value,
+											 argtypes[i], prodesc, i);
+
+	}
+}
+
+jl_value_t *
+convert_arg_to_julia(Datum d, Oid argtype, pljulia_proc_desc *prodesc, int i)
+{
+	jl_value_t *result;
+	bool		is_array_type = (prodesc->arg_arraytype[i] != InvalidOid);
+
+	if (is_array_type)
+		result = julia_array_from_datum(d, argtype);
+	else if (prodesc->arg_is_rowtype[i])
+	{
+		result = julia_dict_from_datum(d);
+	}
+	else
+	{
+		char	   *value;
+
+		value = OutputFunctionCall(&prodesc->arg_out_func[i], d);
+		result = pg_oid_to_jl_value(argtype, value);
+	}
+
+	return result;
+}
+
+jl_value_t *
+julia_dict_from_datum(Datum d)
+{
+	HeapTupleHeader td;
+	Oid			tupType;
+	int32		tupTypmod;
+	TupleDesc	tupdesc = NULL;
+	HeapTupleData tmptup;
+	jl_value_t *ret;
+
+	td = DatumGetHeapTupleHeader(d);
+	/* Extract rowtype info and find a tupdesc */
+	tupType = HeapTupleHeaderGetTypeId(td);
+	tupTypmod = HeapTupleHeaderGetTypMod(td);
+	tupdesc = lookup_rowtype_tupdesc(tupType, tupTypmod);
+	/* Build a temporary HeapTuple control structure */
+	tmptup.t_len = HeapTupleHeaderGetDatumLength(td);
+	tmptup.t_data = td;
+
+	ret = pljulia_dict_from_tuple(&tmptup, tupdesc, true);
+	ReleaseTupleDesc(tupdesc);
+	return ret;
+}
+
+jl_value_t *
+pljulia_dict_from_tuple(HeapTuple tuple, TupleDesc tupdesc,
+						bool include_generated)
+{
+	int			i;
+	Form_pg_attribute att;
+	char	   *attname;
+	Datum		attr;
+	bool		isnull;
+	Oid			typoutput;
+	bool		typisvarlena;
+	jl_value_t *dict,
+			   *key,
+			   *value;
+	jl_function_t *dict_set;
+
+	/* dict_set(key, value, dict) */
+	dict_set = jl_get_function(pljulia_module, "dict_set");
+	/* create an empty dictionary ({Any, Any}) */
+	dict = jl_eval_string("Dict()");
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		att = TupleDescAttr(tupdesc, i);
+		/* ignore dropped */
+		if (att->attisdropped)
+			continue;
+		if (att->attgenerated && !include_generated)
+			continue;
+		/* get attribute name */
+		attname = NameStr(att->attname);
+		key = jl_cstr_to_string(attname);
+		/* get its value as Datum */
+		attr = heap_getattr(tuple, i + 1, tupdesc, &isnull);
+		getTypeOutputInfo(att->atttypid, &typoutput, &typisvarlena);
+
+		if (isnull)
+		{
+			/* just do dict[attname] = nothing */
+			jl_call3(dict_set, key, (jl_value_t *) jl_nothing, dict);
+			continue;
+		}
+
+		/*
+		 * not NULL: convert the value to its julia representation first, then
+		 * call dict_set to insert it in the dictionary. For now assume all
+		 * fields of the tuple will be base types.
+		 */
+		else
+		{
+			char	   *outputstr;
+
+			outputstr = OidOutputFunctionCall(typoutput, attr);
+			value = pg_oid_to_jl_value(att->atttypid, outputstr);
+			jl_call3(dict_set, key, (jl_value_t *) value, dict);
+		}
+	}
+	return dict;
+}
+
+jl_value_t *
+julia_array_from_datum(Datum d, Oid argtype)
+{
+	ArrayType  *ar;
+	Oid			elementtype,
+				typioparam,
+				typoutputfunc;
+	int16		typlen;
+	bool		typbyval;
+	char		typalign,
+				typdelim;
+	int			i,
+				j,
+				nitems,
+				ndims,
+			   *dims;
+	bool	   *nulls;
+	Datum	   *elements;
+	jl_array_t *jl_arr;
+	char	   *value;
+	jl_value_t **types,
+			  **tupvalues;		/* types: the dimension types, so all int64
+								 * tupvalues: the size of each dimension  */
+	jl_tupletype_t *tt;
+	jl_function_t *init_arr;
+	jl_value_t *jl_boxed_elem,
+			   *dimtuple;
+	FmgrInfo   *arg_out_func;
+	Form_pg_type type_struct;
+	HeapTuple	type_tuple;
+
+	arg_out_func = (FmgrInfo *) palloc0(sizeof(FmgrInfo));
+	ar = DatumGetArrayTypeP(d);
+	elementtype = ARR_ELEMTYPE(ar);
+	ndims = ARR_NDIM(ar);
+	dims = ARR_DIMS(ar);
+
+	types = (jl_value_t **) palloc0(ndims * sizeof(jl_value_t *));
+	tupvalues = (jl_value_t **) palloc0(ndims * sizeof(jl_value_t *));
+
+	get_typlenbyvalalign(elementtype, &typlen, &typbyval, &typalign);
+
+	/* get datum representation of each array element */
+	deconstruct_array(ar, elementtype, typlen, typbyval, typalign, &elements,
+					  &nulls, &nitems);
+	/* elements[i] is a datum */
+
+	/* get the conversion function from Datum to elementtype */
+	type_tuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(elementtype));
+	if (!HeapTupleIsValid(type_tuple))
+		elog(ERROR, "cache lookup failed for type %u", argtype);
+
+	type_struct = (Form_pg_type) GETSTRUCT(type_tuple);
+	fmgr_info(type_struct->typoutput, arg_out_func);
+	ReleaseSysCache(type_tuple);
+
+	for (i = 0; i < ndims; i++)
+		types[i] = (jl_value_t *) jl_int64_type;
+
+	tt = jl_apply_tuple_type_v(types, ndims);
+
+	for (i = 0; i < ndims; i++)
+		tupvalues[i] = jl_box_int64(dims[i]);
+
+	dimtuple = jl_new_structv(tt, tupvalues, ndims);
+	init_arr = jl_get_function(pljulia_module, "init_nulls_anyarray");
+	jl_arr = jl_call1(init_arr, dimtuple);
+
+	for (i = 0; i < nitems; i++)
+	{
+		j = calculate_cm_offset(i, ndims, dims);
+		/* Check whether null */
+		if (nulls[i])
+		{
+			/* already initialized to nothing so this is redundant */
+			jl_arrayset(jl_arr, (jl_value_t *) jl_nothing, j);
+			continue;
+		}
+		value = OutputFunctionCall(arg_out_func, elements[i]);
+
+		jl_boxed_elem = pg_oid_to_jl_value(elementtype, value);
+		jl_arrayset(jl_arr, (jl_value_t *) jl_boxed_elem, j);
+	}
+	return (jl_value_t *) jl_arr;
+}
+
+/*
+ * Remove a compiled DO block from the cache.
+ */
+static void
+pljulia_inline_evict(pljulia_inline_entry *entry)
+{
+	uint64		source_hash = entry->source_hash;
+
+	jl_call1(jl_get_function(pljulia_module, "forget_inline"),
+			 jl_box_uint64(source_hash));
+	dlist_delete(&entry->lru_node);
+	pfree(entry->source_text);
+	hash_search(pljulia_inline_hashtable, &source_hash, HASH_REMOVE, NULL);
+}
+
+/*
+ * Look up the compiled function for the code of a DO block, wrapping the
+ * code in a function and compiling it if it isn't cached yet. Repeated
+ * blocks thus run compiled code instead of going through top-level
+ * evaluation every time. At most pljulia.inline_cache_size blocks are kept,
+ * the least recently used one is evicted first.
+ */
+static jl_function_t *
+pljulia_compile_inline(const char *source_code, uint64 source_hash)
+{
+	bool		found;
+	pljulia_inline_entry *entry;
+	jl_function_t *func;
+
+	entry = hash_search(pljulia_inline_hashtable, &source_hash, HASH_FIND,
+						&found);
+	if (found)
+	{
+		if (strcmp(entry->source_text, source_code) == 0)
+		{
+			dlist_move_head(&pljulia_inline_lru, &entry->lru_node);
+			return entry->julia_func;
+		}
+		/* a hash collision, make room for the new block */
+		pljulia_inline_evict(entry);
+	}
+
+	func = jl_call3(jl_get_function(pljulia_module, "compile_inline"),
+					jl_box_uint64(source_hash),
+					jl_cstr_to_string(source_code),
+					jl_box_bool(pljulia_inline_cache_size > 0));
+	if (jl_exception_occurred())
+		show_julia_error();
+
+	if (pljulia_inline_cache_size <= 0)
+		return func;
+
+	while (hash_get_num_entries(pljulia_inline_hashtable) >=
+		   pljulia_inline_cache_size)
+		pljulia_inline_evict(dlist_tail_element(pljulia_inline_entry, lru_node,
+												&pljulia_inline_lru));
+
+	entry = hash_search(pljulia_inline_hashtable, &source_hash, HASH_ENTER,
+						NULL);
+	entry->source_text = MemoryContextStrdup(TopMemoryContext, source_code);
+	entry->julia_func = func;
+	dlist_push_head(&pljulia_inline_lru, &entry->lru_node);
+
+	return func;
+}
+
+Datum
+pljulia_inline_handler(PG_FUNCTION_ARGS)
+{
+	/*
+	 * An inline code block is basically a function that doesn't take input
+	 * arguments and does not return anything (void)
+	 */
+	InlineCodeBlock *codeblock = (InlineCodeBlock *) PG_GETARG_POINTER(0);
+	char	   *source_code = codeblock->source_text;
+	uint64		source_hash;
+	jl_function_t *func;
+
+	source_hash = hash_bytes_extended((const unsigned char *) source_code,
+									  strlen(source_code), 0);
+	func = pljulia_compile_inline(source_code, source_hash);
+	jl_call0(func);
+	if (jl_exception_occurred())
+		show_julia_error();
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Handle function, procedure, and trigger calls.
+ */
+Datum
+pljulia_call_handler(PG_FUNCTION_ARGS)
+{
+	Datum		ret;
+	pljulia_call_data *volatile save_call_data = current_call_data;
+	pljulia_call_data this_call_data;
+
+	/* Initialize current-call status record */
+	MemSet(&this_call_data, 0, sizeof(this_call_data));
+	this_call_data.fcinfo = fcinfo;
+
+	current_call_data = &this_call_data;
+	PG_TRY();
+	{
+		/* run Julia code */
+		if (CALLED_AS_TRIGGER(fcinfo))
+			ret = pljulia_trigger_handler(fcinfo);
+		else if (CALLED_AS_EVENT_TRIGGER(fcinfo))
+		{
+			pljulia_event_trigger_handler(fcinfo);
+			ret = (Datum) 0;
+		}
+		else
+			ret = pljulia_execute(fcinfo);
+	}
+	PG_FINALLY();
+	{
+		current_call_data = save_call_data;
+		/* the handlers mark the function in use once it's compiled */
+		if (this_call_data.prodesc &&
+			--this_call_data.prodesc->use_count == 0 &&
+			this_call_data.prodesc->evicted)
+			pljulia_proc_free(this_call_data.prodesc);
+	}
+	PG_END_TRY();
+
+	/*
+	 * strongly recommended: notify Julia that the program is about to
+	 * terminate. this allows Julia time to cleanup pending write requests and
+	 * run all finalizers
+	 */
+	/* jl_atexit_hook(0); */
+
+	return ret;
+}
+
+/*
+ * Build the Julia definition of a pljulia function: its code wrapped in a
+ * function named internal_procname, taking the input arguments of the
+ * function (or the standard trigger arguments) as parameters.
+ */
+static char *
+pljulia_function_code(const char *internal_procname, HeapTuple procedure_tuple,
+					  bool is_trigger, bool is_event_trigger)
+{
+	StringInfoData buf;
+	Datum		procedure_source_datum;
+	char	   *procedure_code;
+	bool		isnull;
+	Oid		   *argtypes;
+	char	  **argnames;
+	char	   *argmodes;
+	int			i,
+				nargs,
+				ninargs = 0;
+
+	procedure_source_datum = SysCacheGetAttr(PROCOID, procedure_tuple,
+											 Anum_pg_proc_prosrc, &isnull);
+	if (isnull)
+		elog(ERROR, "null prosrc");
+
+	procedure_code = DatumGetCString(DirectFunctionCall1(textout,
+														 procedure_source_datum));
+	elog(DEBUG1, "procedure code:\n%s", procedure_code);
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "function %s(", internal_procname);
+	if (is_trigger)
+		appendStringInfoString(&buf, PLJULIA_TRIGGER_ARGS);
+	else if (is_event_trigger)
+		appendStringInfoString(&buf, PLJULIA_EVENT_TRIGGER_ARGS);
+	else
+	{
+		nargs = get_func_arg_info(procedure_tuple, &argtypes, &argnames,
+								  &argmodes);
+		for (i = 0; i < nargs; i++)
+		{
+			/* OUT arguments aren't passed to the function */
+			if (argmodes && (argmodes[i] == PROARGMODE_OUT ||
+							 argmodes[i] == PROARGMODE_TABLE))
+				continue;
+			if (ninargs++ > 0)
+				appendStringInfoChar(&buf, ',');
+			/* unnamed arguments can't be referenced by the code anyway */
+			if (argnames && argnames[i][0] != '\0')
+				appendStringInfoString(&buf, argnames[i]);
+			else
+				appendStringInfoChar(&buf, '_');
+		}
+	}
+	appendStringInfo(&buf, ")%s\nend", procedure_code);
+
+	return buf.data;
+}
+
+/*
+ * Retrieve Julia code and create a user-defined function
+ * with a unique name.
+ */
+pljulia_proc_desc *
+pljulia_compile(FunctionCallInfo fcinfo, HeapTuple procedure_tuple,
+				Form_pg_proc procedure_struct, bool is_trigger,
+				bool is_event_trigger)
+{
+	volatile MemoryContext proc_cxt = NULL;
+	MemoryContext oldcontext;
+	char	   *compiled_code;
+	uint64		code_hash;
+	pljulia_proc_desc *prodesc = NULL;
+
+	bool		found_hashentry;
+	pljulia_proc_key proc_key;
+	pljulia_hash_entry *hash_entry;
+
+	/*
+	 * the length here is arbitrary but should be enough for at-most-32-length
+	 * oid and even the NAMEDATALEN-length function name should we decide to
+	 * include that too
+	 */
+	char		internal_procname[256];
+
+	if (pljulia_proc_check_dropped)
+		pljulia_forget_dropped();
+
+	/* First try to find the function in the lookup table */
+	proc_key.fn_oid = fcinfo->flinfo->fn_oid;
+	proc_key.is_trigger = is_trigger;
+	hash_entry = hash_search(pljulia_proc_hashtable, &proc_key, HASH_FIND,
+							 &found_hashentry);
+
+	if (found_hashentry)
+		prodesc = hash_entry->prodesc;
+
+	if (prodesc != NULL)
+	{
+		/* Check that it hasn't been modified (CREATE OR REPLACE) */
+		if (prodesc->fn_xmin ==
+			HeapTupleHeaderGetRawXmin(procedure_tuple->t_data))
+		{
+			/* it's ok to return it, hasn't been modified */
+			prodesc->calls++;
+			prodesc->last_used = GetCurrentStatementStartTimestamp();
+			dlist_move_head(&pljulia_proc_lru, &prodesc->lru_node);
+			return prodesc;
+		}
+		else
+		{
+			/* remove this outdated entry from the hash table */
+			pljulia_proc_evict(prodesc);
+		}
+	}
+
+	/***************************************************
+	 * At this point prodesc is either NULL or outdated
+	 * so we have to create a new entry for the function
+	 ***************************************************/
+
+	snprintf(internal_procname, sizeof(internal_procname), "pljulia_%u",
+			 fcinfo->flinfo->fn_oid);
+	compiled_code = pljulia_function_code(internal_procname, procedure_tuple,
+										  is_trigger, is_event_trigger);
+	elog(DEBUG1, "compiled code (%ld)\n%s", strlen(compiled_code),
+		 compiled_code);
+
+	proc_cxt = AllocSetContextCreate(TopMemoryContext, "PL/Julia function",
+									 ALLOCSET_SMALL_SIZES);
+	oldcontext = MemoryContextSwitchTo(proc_cxt);
+	/* stuff that the new prodesc uses must be palloc'd in this context */
+	prodesc = (pljulia_proc_desc *) palloc0(sizeof(pljulia_proc_desc));
+	if (!prodesc)
+		elog(ERROR, "pljulia: out of memory");
+	prodesc->function_body = pstrdup(compiled_code);
+	prodesc->user_proname = pstrdup(NameStr(procedure_struct->proname));
+	prodesc->internal_proname = pstrdup(internal_procname);
+	prodesc->mcxt = proc_cxt;
+	prodesc->fn_xmin = HeapTupleHeaderGetRawXmin(procedure_tuple->t_data);
+	prodesc->fn_oid = fcinfo->flinfo->fn_oid;
+	prodesc->is_trigger = is_trigger;
+	prodesc->calls = 1;
+	prodesc->last_used = GetCurrentStatementStartTimestamp();
+
+	/* if it's a regular function call */
+	if (!is_trigger && !is_event_trigger)
+	{
+		prodesc->nargs = fcinfo->nargs;
+		prodesc->result_typid = procedure_struct->prorettype;
+		prodesc->fn_retisset = procedure_struct->proretset;
+		prodesc->fn_retistuple = type_is_rowtype(procedure_struct->prorettype);
+		/* this is filled later on when handling the input args */
+		prodesc->arg_out_func = (FmgrInfo *) palloc0(prodesc->nargs *
+													 sizeof(FmgrInfo));
+		prodesc->arg_arraytype = (Oid *) palloc0(prodesc->nargs * sizeof(Oid));
+		prodesc->arg_is_rowtype = (bool *) palloc0(prodesc->nargs * sizeof(bool));
+		pljulia_memo_init(prodesc, procedure_tuple, procedure_struct);
+	}
+	MemoryContextSwitchTo(oldcontext);
+
+	/*
+	 * Insert the function declaration into Julia. It's compiled into a module
+	 * of its own, kept until this definition is freed, even if a newer one
+	 * replaced it meanwhile. If the validator has parsed the same code in
+	 * this session, its parse is reused.
+	 */
+	code_hash = hash_bytes_extended((const unsigned char *) compiled_code,
+									strlen(compiled_code), 0);
+	prodesc->julia_func = jl_call3(jl_get_function(pljulia_module,
+												   "define_function"),
+								   jl_cstr_to_string(internal_procname),
+								   jl_cstr_to_string(compiled_code),
+								   jl_box_uint64(code_hash));
+	if (jl_exception_occurred())
+	{
+		MemoryContextDelete(proc_cxt);
+		show_julia_error();
+	}
+
+	/* Make room for the new function, evicting the least recently used */
+	if (pljulia_max_cached_functions > 0 &&
+		!dlist_is_empty(&pljulia_proc_lru))
+	{
+		long		nentries = hash_get_num_entries(pljulia_proc_hashtable);
+		dlist_node *cur = dlist_tail_node(&pljulia_proc_lru);
+
+		while (cur && nentries >= pljulia_max_cached_functions)
+		{
+			pljulia_proc_desc *lru;
+
+			lru = dlist_container(pljulia_proc_desc, lru_node, cur);
+			cur = dlist_has_prev(&pljulia_proc_lru, cur) ?
+				dlist_prev_node(&pljulia_proc_lru, cur) : NULL;
+			/* functions in use, e.g. our callers, are kept */
+			if (lru->use_count > 0)
+				continue;
+			pljulia_proc_evict(lru);
+			nentries--;
+		}
+	}
+
+	/* Create a new hashtable entry for the new function definition */
+	hash_entry = hash_search(pljulia_proc_hashtable, &proc_key, HASH_ENTER,
+							 &found_hashentry);
+	if (hash_entry == NULL)
+		elog(ERROR, "pljulia: hash table out of memory");
+	hash_entry->prodesc = prodesc;
+	dlist_push_head(&pljulia_proc_lru, &prodesc->lru_node);
+
+	return prodesc;
+}
+
+/*
+ * Remove a compiled function from the cache. Its memory and Julia module are
+ * released right away, or when the last active call of the function ends.
+ */
+static void
+pljulia_proc_evict(pljulia_proc_desc *prodesc)
+{
+	pljulia_proc_key proc_key;
+
+	proc_key.fn_oid = prodesc->fn_oid;
+	proc_key.is_trigger = prodesc->is_trigger;
+	hash_search(pljulia_proc_hashtable, &proc_key, HASH_REMOVE, NULL);
+	dlist_delete(&prodesc->lru_node);
+
+	if (prodesc->use_count > 0)
+		prodesc->evicted = true;
+	else
+		pljulia_proc_free(prodesc);
+}
+
+/*
+ * Release the memory and Julia module of an evicted function.
+ */
+static void
+pljulia_proc_free(pljulia_proc_desc *prodesc)
+{
+	jl_call1(jl_get_function(pljulia_module, "drop_function"),
+			 prodesc->julia_func);
+	MemoryContextDelete(prodesc->mcxt);
+}
+
+/*
+ * Syscache callback for pg_proc. A function may have been dropped, which we
+ * check on the next compilation.
+ */
+static void
+pljulia_proc_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+{
+	pljulia_proc_check_dropped = true;
+}
+
+/*
+ * Evict the functions which no longer exist, releasing their modules.
+ */
+static void
+pljulia_forget_dropped(void)
+{
+	HASH_SEQ_STATUS status;
+	pljulia_hash_entry *hash_entry;
+
+	pljulia_proc_check_dropped = false;
+	hash_seq_init(&status, pljulia_proc_hashtable);
+	while ((hash_entry = hash_seq_search(&status)) != NULL)
+	{
+		if (!SearchSysCacheExists1(PROCOID,
+								   ObjectIdGetDatum(hash_entry->proc_key.fn_oid)))
+			pljulia_proc_evict(hash_entry->prodesc);
+	}
+}
+
+/*
+ * Execute Julia code and handle the data returned by Julia.
+ */
+static Datum
+pljulia_execute(FunctionCallInfo fcinfo)
+{
+	jl_value_t **boxed_args;
+	HeapTuple	procedure_tuple;
+	Form_pg_proc procedure_struct;
+	jl_value_t *ret;
+	jl_function_t *func;
+	Datum		retval;
+	ReturnSetInfo *rsi;
+	Datum	   *memo_args = NULL;
+	uint64		memo_hash = 0;
+
+	pljulia_proc_desc *prodesc = NULL;
+
+	rsi = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	procedure_tuple = SearchSysCache(PROCOID,
+									 ObjectIdGetDatum(fcinfo->flinfo->fn_oid), 0, 0, 0);
+	if (!HeapTupleIsValid(procedure_tuple))
+		elog(ERROR, "cache lookup failed for function %u",
+			 fcinfo->flinfo->fn_oid);
+	procedure_struct = (Form_pg_proc) GETSTRUCT(procedure_tuple);
+
+	/* function definition + body code */
+	prodesc = pljulia_compile(fcinfo, procedure_tuple, procedure_struct, false,
+							  false);
+	current_call_data->prodesc = prodesc;
+	prodesc->use_count++;
+
+	/* an immutable function may have been called with these arguments */
+	if (prodesc->memo)
+	{
+		memo_args = (Datum *) palloc(prodesc->nargs * sizeof(Datum));
+		if (pljulia_memo_lookup(prodesc, fcinfo, memo_args, &memo_hash,
+								&retval))
+		{
+			ReleaseSysCache(procedure_tuple);
+			return retval;
+		}
+	}
+
+	func = prodesc->julia_func;
+
+	/*
+	 * insert the function code into the julia interpreter then get a pointer
+	 * to the function and call it after the arguments are settled too .
+	 * Allocate the space for the arguments here
+	 */
+	boxed_args = (jl_value_t **) palloc0(prodesc->nargs * sizeof(jl_value_t *));
+
+	julia_setup_input_args(fcinfo, procedure_tuple, procedure_struct,
+						   boxed_args, prodesc);
+	ReleaseSysCache(procedure_tuple);
+	if (jl_exception_occurred())
+		show_julia_error();
+	ret = jl_call(func, boxed_args, prodesc->nargs);
+
+	if (jl_exception_occurred())
+		show_julia_error();
+
+	/*
+	 * if fn_retisset handle differently... jl_value_t_to_datum only if we
+	 * have a non-srf
+	 */
+
+	if (prodesc->fn_retisset)
+	{
+		rsi->returnMode = SFRM_Materialize;
+		/* if we have any tuples to return */
+		if (current_call_data->tuple_store)
+		{
+			rsi->setResult = current_call_data->tuple_store;
+			rsi->setDesc = current_call_data->ret_tupdesc;
+		}
+		/* equivalent to PG_RERTURN_NULL */
+		retval = (Datum) 0;
+		fcinfo->isnull = true;
+	}
+	else if (jl_is_nothing(ret))
+	{
+		retval = (Datum) 0;
+		fcinfo->isnull = true;
+	}
+	else
+	{
+		retval = jl_value_t_to_datum(fcinfo, ret, prodesc->result_typid,
+									 true);
+	}
+
+	if (prodesc->memo)
+		pljulia_memo_store(prodesc, fcinfo, memo_args, memo_hash, retval);
+
+	return retval;
+}
+
+/*
+ * Enable memoization for an immutable function if pljulia.memoize_size is
+ * set. Set-returning functions aren't eligible, nor polymorphic ones: the
+ * arguments and results are hashed and copied with the length of their
+ * declared types, which the actual types of a call may not share. Neither
+ * are functions with SET clauses, which fmgr applies before every call,
+ * memoized or not, and whose settings the result may depend on.
+ */
+static void
+pljulia_memo_init(pljulia_proc_desc *prodesc, HeapTuple procedure_tuple,
+				  Form_pg_proc procedure_struct)
+{
+	HASHCTL		hash_ctl;
+	int			i;
+
+	if (pljulia_memoize_size <= 0 ||
+		procedure_struct->provolatile != PROVOLATILE_IMMUTABLE ||
+		procedure_struct->proretset ||
+		IsPolymorphicType(procedure_struct->prorettype) ||
+		!heap_attisnull(procedure_tuple, Anum_pg_proc_proconfig, NULL))
+		return;
+	for (i = 0; i < prodesc->nargs; i++)
+	{
+		if (IsPolymorphicType(procedure_struct->proargtypes.values[i]))
+			return;
+	}
+
+	prodesc->memo_cxt = AllocSetContextCreate(prodesc->mcxt,
+											  "PL/Julia memoized results",
+											  ALLOCSET_DEFAULT_SIZES);
+	prodesc->memo_size = pljulia_memoize_size;
+	dlist_init(&prodesc->memo_lru);
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(uint64);
+	hash_ctl.entrysize = sizeof(pljulia_memo_entry);
+	hash_ctl.hcxt = prodesc->memo_cxt;
+	prodesc->memo = hash_create("PL/Julia memoized results hashtable", 64,
+								&hash_ctl,
+								HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	prodesc->arg_typlen = (int16 *) palloc(prodesc->nargs * sizeof(int16));
+	prodesc->arg_typbyval = (bool *) palloc(prodesc->nargs * sizeof(bool));
+	for (i = 0; i < prodesc->nargs; i++)
+		get_typlenbyval(procedure_struct->proargtypes.values[i],
+						&prodesc->arg_typlen[i], &prodesc->arg_typbyval[i]);
+	get_typlenbyval(prodesc->result_typid, &prodesc->result_typlen,
+					&prodesc->result_typbyval);
+}
+
+/*
+ * Compare a memoized argument with the argument of a call. Varlena values
+ * are compared without their headers, which may be short or not for the
+ * same value.
+ */
+static bool
+pljulia_memo_arg_equal(pljulia_proc_desc *prodesc, int i, Datum memo_arg,
+					   Datum arg)
+{
+	struct varlena *a1;
+	struct varlena *a2;
+
+	if (prodesc->arg_typlen[i] != -1)
+		return datumIsEqual(memo_arg, arg, prodesc->arg_typbyval[i],
+							prodesc->arg_typlen[i]);
+	a1 = (struct varlena *) DatumGetPointer(memo_arg);
+	a2 = (struct varlena *) DatumGetPointer(arg);
+	return VARSIZE_ANY_EXHDR(a1) == VARSIZE_ANY_EXHDR(a2) &&
+		memcmp(VARDATA_ANY(a1), VARDATA_ANY(a2), VARSIZE_ANY_EXHDR(a1)) == 0;
+}
+
+/*
+ * Look for a memoized result for the arguments of this call. The arguments,
+ * detoasted, and their hash are returned in args and args_hash so that the
+ * caller can store the result of the call on a miss. Varlena arguments are
+ * hashed without their header, so that a value hashes the same whether it
+ * is packed or not.
+ */
+static bool
+pljulia_memo_lookup(pljulia_proc_desc *prodesc, FunctionCallInfo fcinfo,
+					Datum *args, uint64 *args_hash, Datum *result)
+{
+	pljulia_memo_entry *entry;
+	uint64		hash = 0;
+	int			i;
+
+	/* hash the binary representation of the arguments */
+	for (i = 0; i < prodesc->nargs; i++)
+	{
+		uint64		arg_hash = 0;
+		int16		typlen = prodesc->arg_typlen[i];
+
+		if (fcinfo->args[i].isnull)
+		{
+			hash = hash_combine64(hash, arg_hash);
+			continue;
+		}
+		args[i] = fcinfo->args[i].value;
+		if (prodesc->arg_typbyval[i])
+			arg_hash = hash_bytes_extended((const unsigned char *) &args[i],
+										   sizeof(Datum), 0);
+		else if (typlen == -1)
+		{
+			struct varlena *arg;
+
+			arg = PG_DETOAST_DATUM_PACKED(args[i]);
+			args[i] = PointerGetDatum(arg);
+			arg_hash = hash_bytes_extended((const unsigned char *) VARDATA_ANY(arg),
+										   VARSIZE_ANY_EXHDR(arg), 0);
+		}
+		else
+			arg_hash = hash_bytes_extended((const unsigned char *) DatumGetPointer(args[i]),
+										   datumGetSize(args[i], false, typlen),
+										   0);
+		hash = hash_combine64(hash, arg_hash);
+	}
+	*args_hash = hash;
+
+	entry = hash_search(prodesc->memo, &hash, HASH_FIND, NULL);
+	if (entry == NULL)
+		return false;
+
+	/* make sure it's not a hash collision */
+	for (i = 0; i < prodesc->nargs; i++)
+	{
+		if (entry->argnulls[i] != fcinfo->args[i].isnull)
+			return false;
+		if (!entry->argnulls[i] &&
+			!pljulia_memo_arg_equal(prodesc, i, entry->args[i], args[i]))
+			return false;
+	}
+
+	prodesc->memo_hits++;
+	dlist_move_head(&prodesc->memo_lru, &entry->lru_node);
+	fcinfo->isnull = entry->isnull;
+	*result = entry->isnull ? (Datum) 0 :
+		datumCopy(entry->result, prodesc->result_typbyval,
+				  prodesc->result_typlen);
+	return true;
+}
+
+/*
+ * Remember the result of a call, evicting the least recently used result if
+ * the function already has pljulia.memoize_size results.
+ */
+static void
+pljulia_memo_store(pljulia_proc_desc *prodesc, FunctionCallInfo fcinfo,
+				   Datum *args, uint64 args_hash, Datum result)
+{
+	pljulia_memo_entry *entry;
+	MemoryContext oldcontext;
+	bool		found;
+	int			i;
+
+	prodesc->memo_misses++;
+
+	entry = hash_search(prodesc->memo, &args_hash, HASH_FIND, NULL);
+	if (entry == NULL &&
+		hash_get_num_entries(prodesc->memo) >= prodesc->memo_size)
+		entry = dlist_tail_element(pljulia_memo_entry, lru_node,
+								   &prodesc->memo_lru);
+	if (entry != NULL)
+	{
+		/* a collision or the least recently used result, drop it */
+		for (i = 0; i < prodesc->nargs; i++)
+			if (!entry->argnulls[i] && !prodesc->arg_typbyval[i])
+				pfree(DatumGetPointer(entry->args[i]));
+		pfree(entry->args);
+		pfree(entry->argnulls);
+		if (!entry->isnull && !prodesc->result_typbyval)
+			pfree(DatumGetPointer(entry->result));
+		dlist_delete(&entry->lru_node);
+		hash_search(prodesc->memo, &entry->args_hash, HASH_REMOVE, NULL);
+	}
+
+	oldcontext = MemoryContextSwitchTo(prodesc->memo_cxt);
+	entry = hash_search(prodesc->memo, &args_hash, HASH_ENTER, &found);
+	entry->args = (Datum *) palloc(prodesc->nargs * sizeof(Datum));
+	entry->argnulls = (bool *) palloc(prodesc->nargs * sizeof(bool));
+	for (i = 0; i < prodesc->nargs; i++)
+	{
+		entry->argnulls[i] = fcinfo->args[i].isnull;
+		entry->args[i] = entry->argnulls[i] ? (Datum) 0 :
+			datumCopy(args[i], prodesc->arg_typbyval[i],
+					  prodesc->arg_typlen[i]);
+	}
+	entry->isnull = fcinfo->isnull;
+	entry->result = entry->isnull ? (Datum) 0 :
+		datumCopy(result, prodesc->result_typbyval, prodesc->result_typlen);
+	dlist_push_head(&prodesc->memo_lru, &entry->lru_node);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+Datum
+pg_array_from_julia_array(FunctionCallInfo fcinfo, jl_value_t *ret,
+						  Oid prorettype)
+{
+	ArrayType  *array;
+	Datum	   *array_elem;
+	bool	   *nulls = NULL;
+	int16		typlen;
+	bool		typbyval;
+	char		typalign;
+	int			row_major_offset;
+	Oid			elem_type = get_element_type(prorettype);
+	size_t		len = jl_array_len(ret);
+	int			ndim = jl_array_ndims(ret);
+	int		   *dims = (int *) palloc0(sizeof(int) * ndim);
+	int		   *lbs = (int *) palloc0(sizeof(int) * ndim);
+	int			i;
+	jl_value_t *curr_elem;
+
+	for (i = 0; i < ndim; i++)
+	{
+		dims[i] = jl_array_dim(ret, i);
+		lbs[i] = 1;
+	}
+	elog(DEBUG1, "len : %zu\n", len);
+
+	array_elem = (Datum *) palloc0(sizeof(Datum) * len);
+
+	for (i = 0; i < len; i++)
+	{
+		row_major_offset = calculate_rm_offset(i, ndim, dims);
+		curr_elem = jl_arrayref(ret, i);
+		/* if jl_nothing then set it as NULL */
+		if (jl_typeis(curr_elem, jl_nothing_type))
+		{
+			/* first null we found, so palloc */
+			if (!nulls)
+				nulls = (bool *) palloc0(sizeof(bool) * len);
+
+			nulls[i] = true;
+			continue;
+		}
+
+		array_elem[row_major_offset] = jl_value_t_to_datum(fcinfo, curr_elem,
+														   elem_type, false);
+		/* if for some reason it wasn't possible to */
+	}
+	get_typlenbyvalalign(elem_type, &typlen, &typbyval, &typalign);
+	array = construct_md_array(array_elem, nulls, ndim, dims, lbs, elem_type,
+							   typlen, typbyval, typalign);
+	PG_RETURN_ARRAYTYPE_P(array);
+}
+
+Datum
+pg_composite_from_julia_tuple(FunctionCallInfo fcinfo, jl_value_t *ret,
+							  Oid prorettype, bool usefcinfo)
+{
+	int			nfields,
+				i;
+	jl_value_t *curr_elem;
+	TupleDesc	tupdesc;
+	Oid			resultTypeId;
+	Datum	   *elements;
+	bool	   *nulls = NULL;
+	HeapTuple	tup;
+	Form_pg_attribute att;
+
+	if (usefcinfo)
+	{
+		if (get_call_result_type(fcinfo, &resultTypeId, &tupdesc) !=
+			TYPEFUNC_COMPOSITE)
+			elog(ERROR, "function returning record called in context that cannot "
+				 "accept type record");
+	}
+
+	/*
+	 * if !usefcinfo then don't use it to get a tupdesc because we've been
+	 * called from pg_array_from_julia_array and fcinfo concerns the array,
+	 * not the tuple we need to build
+	 */
+	else
+	{
+		/*
+		 * set typmod -1 because we don't expect a domain. For domains extra
+		 * work needs to be done
+		 */
+		tupdesc = lookup_rowtype_tupdesc(prorettype, -1);
+	}
+
+	nfields = jl_nfields(ret);
+	if (tupdesc->natts != nfields)
+		elog(ERROR, "Tuple number of fields mismatch");
+
+	elements = (Datum *) palloc0(sizeof(Datum) * nfields);
+	nulls = (bool *) palloc0(sizeof(bool) * nfields);
+
+	for (i = 0; i < nfields; i++)
+	{
+		curr_elem = jl_get_nth_field(ret, i);
+		if (jl_typeis(curr_elem, jl_nothing_type))
+		{
+			nulls[i] = true;
+			continue;
+		}
+		nulls[i] = false;
+		att = TupleDescAttr(tupdesc, i);
+
+		elements[i] = jl_value_t_to_datum(fcinfo, curr_elem, att->atttypid, false);
+	}
+	tup = heap_form_tuple(tupdesc, elements, nulls);
+	ReleaseTupleDesc(tupdesc);
+	return HeapTupleGetDatum(tup);
+}
+
+Datum
+pg_composite_from_julia_dict(FunctionCallInfo fcinfo, jl_value_t *ret,
+							 Oid prorettype, bool usefcinfo)
+{
+	int			nfields,
+				i;
+	jl_value_t *curr_elem,
+			   *key;
+	TupleDesc	tupdesc;
+	Oid			resultTypeId;
+	Datum	   *elements;
+	bool	   *nulls = NULL;
+	HeapTuple	tup;
+	char	   *attname;
+	Form_pg_attribute att;
+	jl_function_t *dict_get,
+			   *dict_nfields;
+
+	if (usefcinfo)
+	{
+		if (get_call_result_type(fcinfo, &resultTypeId, &tupdesc) !=
+			TYPEFUNC_COMPOSITE)
+			elog(ERROR,
+				 "function returning record called in context that cannot "
+				 "accept type record");
+	}
+
+	/*
+	 * if !usefcinfo then don't use it to get a tupdesc because we've been
+	 * called from pg_array_from_julia_array and fcinfo concerns the array,
+	 * not the tuple we need to build
+	 */
+	else
+	{
+		/*
+		 * set typmod -1 because we don't expect a domain. For domains extra
+		 * work needs to be done
+		 */
+		tupdesc = lookup_rowtype_tupdesc(prorettype, -1);
+	}
+
+	/* the number of entries in the dictionary equals its length */
+	dict_nfields = jl_get_function(jl_base_module, "length");
+	dict_get = jl_get_function(pljulia_module, "dict_get");
+	nfields = jl_unbox_int64(jl_call1(dict_nfields, ret));
+	if (tupdesc->natts != nfields)
+		elog(ERROR, "Dict number of fields mismatch");
+
+	elements = (Datum *) palloc0(sizeof(Datum) * nfields);
+	nulls = (bool *) palloc0(sizeof(bool) * nfields);
+
+	for (i = 0; i < nfields; i++)
+	{
+		att = TupleDescAttr(tupdesc, i);
+		attname = NameStr(att->attname);
+		key = jl_cstr_to_string(attname);
+		curr_elem = jl_call2(dict_get, key, ret);
+		if (jl_typeis(curr_elem, jl_nothing_type))
+		{
+			nulls[i] = true;
+			continue;
+		}
+		nulls[i] = false;
+
+		elements[i] = jl_value_t_to_datum(fcinfo, curr_elem, att->atttypid,
+										  false);
+	}
+	tup = heap_form_tuple(tupdesc, elements, nulls);
+	ReleaseTupleDesc(tupdesc);
+	return HeapTupleGetDatum(tup);
+}
+
+static Datum
+pljulia_trigger_handler(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+	TupleDesc	tupdesc;
+	HeapTuple	procedure_tuple;
+	Form_pg_proc procedure_struct;
+	volatile HeapTuple rettuple;
+	int			i,
+				rc;
+	pljulia_proc_desc *prodesc;
+	jl_value_t *trig_args[10];
+	char	   *stroid,
+			   *when,
+			   *level,
+			   *event,
+			   *arg;
+	jl_function_t *func,
+			   *init_arr;
+	jl_value_t *ret;
+
+	/* make sure we're here from a call to a trigger */
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "not called by trigger manager");
+	/* connect to the SPI manager */
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI manager");
+	/* make transition tables visible to this SPI connection */
+	rc = SPI_register_trigger_data(trigdata);
+
+	if (rc < 0)
+		elog(ERROR,
+			 "Could not make transition tables visible to PL trigger handler");
+
+	procedure_tuple = SearchSysCache(PROCOID,
+									 ObjectIdGetDatum(fcinfo->flinfo->fn_oid),
+									 0, 0, 0);
+	if (!HeapTupleIsValid(procedure_tuple))
+		elog(ERROR, "cache lookup failed for function %u",
+			 fcinfo->flinfo->fn_oid);
+	procedure_struct = (Form_pg_proc) GETSTRUCT(procedure_tuple);
+
+	prodesc = pljulia_compile(fcinfo, procedure_tuple, procedure_struct,
+							  true, false);
+	current_call_data->prodesc = prodesc;
+	prodesc->use_count++;
+	ReleaseSysCache(procedure_tuple);
+	tupdesc = RelationGetDescr(trigdata->tg_relation);
+
+	/*
+	 * setup trigger args, first the standard ones, 10 in total  TD_name,
+	 * TD_relid, TD_table_name, TD_table_schema, TD_event, TD_when TD_level,
+	 * TD_NEW, TD_OLD, args, where args will be passed as an array
+	 */
+
+	/* set up TD_name with trigger name */
+	trig_args[0] = jl_cstr_to_string(utf_e2u(trigdata->tg_trigger->tgname));
+	/* TD_relid */
+	stroid = DatumGetCString(
+							 DirectFunctionCall1(oidout,
+												 ObjectIdGetDatum(trigdata->tg_relation->rd_id)));
+	trig_args[1] = jl_cstr_to_string(stroid);
+	pfree(stroid);
+
+	/* TD_table_name */
+	stroid = SPI_getrelname(trigdata->tg_relation);
+	trig_args[2] = jl_cstr_to_string(utf_e2u(stroid));
+	pfree(stroid);
+
+	/* TD_table_schema */
+	stroid = SPI_getnspname(trigdata->tg_relation);
+	trig_args[3] = jl_cstr_to_string(utf_e2u(stroid));
+	pfree(stroid);
+
+	/* TD_event */
+	if (TRIGGER_FIRED_BY_INSERT(trigdata->tg_event))
+		event = "INSERT";
+	else if (TRIGGER_FIRED_BY_DELETE(trigdata->tg_event))
+		event = "DELETE";
+	else if (TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+		event = "UPDATE";
+	else if (TRIGGER_FIRED_BY_TRUNCATE(trigdata->tg_event))
+		event = "TRUNCATE";
+	else
+		elog(ERROR, "unrecognized OPERATION tg_event: %u", trigdata->tg_event);
+
+	trig_args[4] = jl_cstr_to_string(event);
+
+	/* TD_when, can be BEFORE, AFTER, INSTEAD OF */
+	if (TRIGGER_FIRED_BEFORE(trigdata->tg_event))
+		when = "BEFORE";
+	else if (TRIGGER_FIRED_AFTER(trigdata->tg_event))
+		when = "AFTER";
+	else if (TRIGGER_FIRED_INSTEAD(trigdata->tg_event))
+		when = "INSTEAD OF";
+	else
+		elog(ERROR, "unrecognized WHEN tg_event: %u", trigdata->tg_event);
+	trig_args[5] = jl_cstr_to_string(when);
+	/* TD_level */
+	if (TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
+		level = "ROW";
+	else if (TRIGGER_FIRED_FOR_STATEMENT(trigdata->tg_event))
+		level = "STATEMENT";
+	else
+		elog(ERROR, "unrecognized LEVEL tg_event: %u", trigdata->tg_event);
+	trig_args[6] = jl_cstr_to_string(level);
+
+	/* TD_new and TD_old */
+
+	/*
+	 * TD_new and TD_old are initialized NULL (Julia nothing), and depending
+	 * on whether we have a trigger function that modifies rows, we set the
+	 * appropriate values for NEW/OLD rows
+	 */
+
+	/* TD_new */
+	trig_args[7] = jl_nothing;
+	/* TD_OLD */
+	trig_args[8] = jl_nothing;
+
+	rettuple = (HeapTuple) NULL;
+
+	if (TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
+	{
+		/* we only have a new row to return in the case of INSERT */
+		if (TRIGGER_FIRED_BY_INSERT(trigdata->tg_event))
+		{
+			trig_args[7] = pljulia_dict_from_tuple(trigdata->tg_trigtuple,
+												   tupdesc, !TRIGGER_FIRED_BEFORE(trigdata->tg_event));
+			rettuple = trigdata->tg_trigtuple;
+		}
+
+		/* we only have an old row in the case of DELETE */
+		else if (TRIGGER_FIRED_BY_DELETE(trigdata->tg_event))
+		{
+			trig_args[8] = pljulia_dict_from_tuple(trigdata->tg_trigtuple,
+												   tupdesc, true);
+			rettuple = trigdata->tg_trigtuple;
+		}
+
+		/* we have both a new and an old row */
+		else if (TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+		{
+			trig_args[7] = pljulia_dict_from_tuple(trigdata->tg_newtuple,
+												   tupdesc, !TRIGGER_FIRED_BEFORE(trigdata->tg_event));
+			trig_args[8] = pljulia_dict_from_tuple(trigdata->tg_trigtuple,
+												   tupdesc, true);
+			rettuple = trigdata->tg_newtuple;
+		}
+	}
+	/* Finally, setup any args to the trigger in an array */
+	init_arr = jl_get_function(pljulia_module, "init_nulls_anyarray");
+	trig_args[9] = jl_call1(init_arr, jl_box_int64(trigdata->tg_trigger->tgnargs));
+
+	/*
+	 * All arguments are passed as strings to the Julia function, and it's up
+	 * to the user to convert to the desired type if needed (for example,
+	 * using parse for numeric input).
+	 */
+	for (i = 0; i < trigdata->tg_trigger->tgnargs; i++)
+	{
+		arg = utf_e2u(trigdata->tg_trigger->tgargs[i]);
+		jl_arrayset(trig_args[9],
+					jl_cstr_to_string(arg), i);
+	}
+	/* Now call the trigger function */
+	func = prodesc->julia_func;
+
+	ret = jl_call(func, trig_args, 10);
+	if (jl_exception_occurred())
+		show_julia_error();
+
+	/* Disconnect from the SPI_manager */
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish() failed");
+
+	/*
+	 * If function returned nothing or "OK", proceed normally. If function
+	 * returned "SKIP", then suppress the operation for this row. Otherwise,
+	 * for a "MODIFY" operation, the returned value must be a dictionary, with
+	 * rownames as keys and the desired corresponding values.
+	 */
+	if (jl_is_nothing(ret))
+		return PointerGetDatum(rettuple);
+	else if (jl_is_string(ret))
+	{
+		if (strcmp("OK", jl_string_ptr(ret)) == 0)
+			return PointerGetDatum(rettuple);
+		else if (strcmp("SKIP", jl_string_ptr(ret)) == 0)
+		{
+			rettuple = (HeapTuple) NULL;
+			return PointerGetDatum(rettuple);
+		}
+		else
+			elog(ERROR, "Trigger function must return either nothing, \"OK\", "
+				 "\"SKIP\" or a dictionary corresponding to the new tuple");
+	}
+	else if (jl_is_dict(ret))
+	{
+		/* Create the modified tuple to return */
+		rettuple = pljulia_build_tuple_result(ret,
+											  trigdata->tg_relation->rd_att);
+
+		/*
+		 * Still need to check if the operation was an INSERT or UPDATE
+		 * Otherwise, returning a modified row doesn't make sense
+		 */
+		if (!TRIGGER_FIRED_BY_INSERT(trigdata->tg_event) && !TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+		{
+			/* Perhaps another error level ? */
+			elog(NOTICE, "Ignoring modified row, not an INSERT or UPDATE");
+			rettuple = trigdata->tg_trigtuple;
+		}
+
+	}
+	else
+		elog(ERROR, "Trigger function must return either nothing, \"OK\", "
+			 "\"SKIP\" or a dictionary corresponding to the new tuple");
+
+	return PointerGetDatum(rettuple);
+}
+
+static void
+pljulia_event_trigger_handler(PG_FUNCTION_ARGS)
+{
+	pljulia_proc_desc *prodesc;
+	EventTriggerData *trigdata = (EventTriggerData *) fcinfo->context;
+	HeapTuple	procedure_tuple;
+	Form_pg_proc procedure_struct;
+	jl_value_t *trig_args[2];
+	jl_function_t *func;
+
+	/* make sure we're here from a call to an event trigger */
+	if (!CALLED_AS_EVENT_TRIGGER(fcinfo))
+		elog(ERROR, "not called by trigger manager");
+	/* connect to the SPI manager */
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "could not connect to SPI manager");
+
+	procedure_tuple = SearchSysCache(PROCOID,
+									 ObjectIdGetDatum(fcinfo->flinfo->fn_oid),
+									 0, 0, 0);
+	if (!HeapTupleIsValid(procedure_tuple))
+		elog(ERROR, "cache lookup failed for function %u",
+			 fcinfo->flinfo->fn_oid);
+	procedure_struct = (Form_pg_proc) GETSTRUCT(procedure_tuple);
+
+	prodesc = pljulia_compile(fcinfo, procedure_tuple, procedure_struct,
+							  false, true);
+	current_call_data->prodesc = prodesc;
+	prodesc->use_count++;
+	ReleaseSysCache(procedure_tuple);
+
+	/* TD_event */
+	trig_args[0] = jl_cstr_to_string(utf_e2u(trigdata->event));
+	/* TD_tag */
+	trig_args[1] = jl_cstr_to_string(utf_e2u(GetCommandTagName(trigdata->tag)));
+
+	func = prodesc->julia_func;
+	/* the value returned by an event trigger is ignored */
+	jl_call2(func, trig_args[0], trig_args[1]);
+	if (jl_exception_occurred())
+		show_julia_error();
+
+	/* disconnect from the SPI manager */
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish() failed");
+
+}
+
+PG_FUNCTION_INFO_V1(pljulia_validator);
+
+Datum
+pljulia_validator(PG_FUNCTION_ARGS)
+{
+	Oid			funcoid = PG_GETARG_OID(0);
+	HeapTuple	tuple;
+	Form_pg_proc proc;
+	char		functyptype;
+	bool		is_trigger = false,
+				is_event_trigger = false;
+	char		internal_procname[256];
+	char	   *compiled_code;
+	uint64		code_hash;
+
+	/*
+	 * Verify that we have a pljulia function and that the user has access to
+	 * both the language and the function
+	 */
+	if (!CheckFunctionValidatorAccess(fcinfo->flinfo->fn_oid, funcoid))
+		PG_RETURN_VOID();
+	/* the user might not require validation */
+	if (!check_function_bodies)
+	{
+		elog(NOTICE, "check_function_bodies is disabled, skipping validation");
+		PG_RETURN_VOID();
+	}
+
+	tuple = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcoid));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for function %u", funcoid);
+	proc = (Form_pg_proc) GETSTRUCT(tuple);
+
+	functyptype = get_typtype(proc->prorettype);
+
+	/* Disallow pseudotype result */
+	/* except for TRIGGER, EVTTRIGGER, RECORD, VOID, or INTERNAL (callbacks) */
+	if (functyptype == TYPTYPE_PSEUDO)
+	{
+		if (proc->prorettype == TRIGGEROID)
+			is_trigger = true;
+		else if (proc->prorettype ==
+#if PG_VERSION_NUM >= 140000
+			 EVENT_TRIGGEROID
+#else
+			 EVTTRIGGEROID
+#endif
+			 )
+			is_event_trigger = true;
+		else if (proc->prorettype != RECORDOID &&
+				 proc->prorettype != VOIDOID &&
+				 proc->prorettype != INTERNALOID)
+			elog(ERROR,
+				 "PL/Julia functions cannot return type %s",
+				 format_type_be(proc->prorettype));
+	}
+
+	/*
+	 * Only parse the definition, the same way pljulia_compile builds it, to
+	 * catch syntax errors. The parsed code is kept so that the first call of
+	 * the function in this session doesn't have to parse it again.
+	 */
+	snprintf(internal_procname, sizeof(internal_procname), "pljulia_%u",
+			 funcoid);
+	compiled_code = pljulia_function_code(internal_procname, tuple,
+										  is_trigger, is_event_trigger);
+	code_hash = hash_bytes_extended((const unsigned char *) compiled_code,
+									strlen(compiled_code), 0);
+	jl_call2(jl_get_function(pljulia_module, "validate"),
+			 jl_cstr_to_string(compiled_code), jl_box_uint64(code_hash));
+	if (jl_exception_occurred())
+		show_julia_error();
+	ReleaseSysCache(tuple);
+
+	/* The validator's result is ignored in any case */
+	PG_RETURN_VOID();
+}
+
+/*
+ * Set up a tuplestore for the result of a set-returning function
+ * returning its rows in materialize mode.
+ */
+static Tuplestorestate *
+pljulia_materialize_srf(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	MemoryContext oldcontext;
+	Tuplestorestate *tupstore;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		elog(ERROR, "set-valued function called in context that cannot "
+			 "accept a set");
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		elog(ERROR, "materialize mode required, but it is not allowed in "
+			 "this context");
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	if (get_call_result_type(fcinfo, NULL, tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = *tupdesc;
+	MemoryContextSwitchTo(oldcontext);
+
+	return tupstore;
+}
+
+/*
+ * The memory held by a saved plan: the SPI plan itself, its plan sources and
+ * their generic plans.
+ */
+static int64
+pljulia_plan_memory(SPIPlanPtr plan)
+{
+	int64		total = MemoryContextMemAllocated(plan->plancxt, true);
+	ListCell   *lc;
+
+	foreach(lc, plan->plancache_list)
+	{
+		CachedPlanSource *plansource = (CachedPlanSource *) lfirst(lc);
+
+		total += MemoryContextMemAllocated(plansource->context, true);
+		if (plansource->gplan)
+			total += MemoryContextMemAllocated(plansource->gplan->context,
+											   true);
+	}
+	return total;
+}
+
+/*
+ * List the compiled functions of this session, most recently used first.
+ */
+PG_FUNCTION_INFO_V1(pljulia_cache_info);
+
+Datum
+pljulia_cache_info(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	dlist_iter	iter;
+
+	tupstore = pljulia_materialize_srf(fcinfo, &tupdesc);
+
+	dlist_foreach(iter, &pljulia_proc_lru)
+	{
+		pljulia_proc_desc *prodesc;
+		Datum		values[7];
+		bool		nulls[7] = {false};
+
+		prodesc = dlist_container(pljulia_proc_desc, lru_node, iter.cur);
+		values[0] = ObjectIdGetDatum(prodesc->fn_oid);
+		values[1] = Int64GetDatum(MemoryContextMemAllocated(prodesc->mcxt, true));
+		values[2] = Int64GetDatum(prodesc->calls);
+		values[3] = TimestampTzGetDatum(prodesc->last_used);
+		if (prodesc->memo)
+		{
+			values[4] = Int64GetDatum(hash_get_num_entries(prodesc->memo));
+			values[5] = Int64GetDatum(prodesc->memo_hits);
+			values[6] = Int64GetDatum(prodesc->memo_misses);
+		}
+		else
+			nulls[4] = nulls[5] = nulls[6] = true;
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * List the plans saved by spi_prepare and the statements cached by spi_exec
+ * in this session.
+ */
+PG_FUNCTION_INFO_V1(pljulia_plan_cache_info);
+
+Datum
+pljulia_plan_cache_info(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	HASH_SEQ_STATUS status;
+	pljulia_query_entry *hash_entry;
+	dlist_iter	iter;
+
+	tupstore = pljulia_materialize_srf(fcinfo, &tupdesc);
+
+	hash_seq_init(&status, pljulia_query_hashtable);
+	while ((hash_entry = hash_seq_search(&status)) != NULL)
+	{
+		pljulia_query_desc *qdesc = hash_entry->query_desc;
+		Datum		values[7];
+		bool		nulls[7] = {false};
+
+		values[0] = CStringGetTextDatum(qdesc->qname);
+		values[1] = CStringGetTextDatum(qdesc->query);
+		values[2] = Int32GetDatum(qdesc->nargs);
+		values[3] = Int64GetDatum(MemoryContextMemAllocated(qdesc->plan_cxt, true) +
+								  pljulia_plan_memory(qdesc->plan));
+		values[4] = Int64GetDatum(qdesc->calls);
+		if (qdesc->calls > 0)
+			values[5] = TimestampTzGetDatum(qdesc->last_used);
+		else
+			nulls[5] = true;
+		values[6] = Int32GetDatum(qdesc->refcount);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* the statements cached by spi_exec, which have no name */
+	dlist_foreach(iter, &pljulia_stmt_lru)
+	{
+		pljulia_stmt_entry *entry;
+		Datum		values[7];
+		bool		nulls[7] = {false};
+
+		entry = dlist_container(pljulia_stmt_entry, lru_node, iter.cur);
+		nulls[0] = true;
+		values[1] = CStringGetTextDatum(entry->query);
+		values[2] = Int32GetDatum(entry->nargs);
+		values[3] = Int64GetDatum(pljulia_plan_memory(entry->plan));
+		values[4] = Int64GetDatum(entry->calls);
+		values[5] = TimestampTzGetDatum(entry->last_used);
+		nulls[6] = true;
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Remove a function from the compiled functions of this session. Returns
+ * false if it isn't cached or is in use.
+ */
+PG_FUNCTION_INFO_V1(pljulia_cache_evict);
+
+Datum
+pljulia_cache_evict(PG_FUNCTION_ARGS)
+{
+	pljulia_proc_key proc_key;
+	pljulia_hash_entry *hash_entry;
+	bool		evicted = false;
+
+	proc_key.fn_oid = PG_GETARG_OID(0);
+	for (proc_key.is_trigger = 0; proc_key.is_trigger <= 1; proc_key.is_trigger++)
+	{
+		hash_entry = hash_search(pljulia_proc_hashtable, &proc_key, HASH_FIND,
+								 NULL);
+		if (hash_entry == NULL || hash_entry->prodesc->use_count > 0)
+			continue;
+		pljulia_proc_evict(hash_entry->prodesc);
+		evicted = true;
+	}
+
+	PG_RETURN_BOOL(evicted);
+}
+
+/*
+ * The number of bytes in use by the Julia heap.
+ */
+PG_FUNCTION_INFO_V1(pljulia_heap_size);
+
+Datum
+pljulia_heap_size(PG_FUNCTION_ARGS)
+{
+	jl_value_t *live_bytes;
+
+	live_bytes = jl_eval_string("Int64(Base.gc_live_bytes())");
+	if (jl_exception_occurred())
+		show_julia_error();
+
+	PG_RETURN_INT64(jl_unbox_int64(live_bytes));
+}
+
+/*
+ * Read the rows of an Arrow IPC file as the row type of the second
+ * argument, matching its columns by name:
+ *
+ *   SELECT * FROM pljulia_read_arrow('/data/features.arrow', NULL::features);
+ *
+ * The file is mapped in memory and its metadata parsed by PLJulia.arrow_open.
+ * Each record batch is then converted straight from its column buffers, in
+ * place, to the tuplestore of the result, so that the values never go
+ * through Julia objects. Strings are read with the input function of the
+ * column type when it isn't text.
+ */
+PG_FUNCTION_INFO_V1(pljulia_read_arrow);
+
+Datum
+pljulia_read_arrow(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	pljulia_arrow_column *columns;
+	MemoryContext rowcxt;
+	MemoryContext oldcontext;
+	jl_value_t *file = NULL;
+	jl_value_t *opened = NULL;
+	jl_value_t *batch = NULL;
+	jl_array_t *names = NULL;
+	Datum	   *values;
+	bool	   *nulls;
+	int64	   *info;
+	int64		nbatches;
+	int64		b;
+	int			ncolumns = 0;
+	int			i;
+
+	if (PG_ARGISNULL(0))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("pljulia_read_arrow: path must not be null")));
+	tupstore = pljulia_materialize_srf(fcinfo, &tupdesc);
+
+	columns = (pljulia_arrow_column *) palloc0(tupdesc->natts * sizeof(pljulia_arrow_column));
+	values = (Datum *) palloc(tupdesc->natts * sizeof(Datum));
+	nulls = (bool *) palloc(tupdesc->natts * sizeof(bool));
+
+	JL_GC_PUSH4(&file, &opened, &batch, &names);
+	names = jl_alloc_vec_any(0);
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, i);
+
+		nulls[i] = true;
+		if (att->attisdropped)
+			continue;
+		jl_array_ptr_1d_push(names, jl_cstr_to_string(NameStr(att->attname)));
+	}
+	file = jl_cstr_to_string(text_to_cstring(PG_GETARG_TEXT_PP(0)));
+	opened = jl_call2(jl_get_function(pljulia_module, "arrow_open"), file,
+					  (jl_value_t *) names);
+	if (jl_exception_occurred())
+	{
+		JL_GC_POP();
+		show_julia_error();
+	}
+	file = jl_arrayref((jl_array_t *) opened, 0);
+	nbatches = jl_unbox_int64(jl_arrayref((jl_array_t *) opened, 1));
+	info = (int64 *) jl_array_data((jl_array_t *) jl_arrayref((jl_array_t *) opened, 2));
+
+	/* on errors, unmap the file and pop the GC frame before going on */
+	PG_TRY();
+	{
+		for (i = 0; i < tupdesc->natts; i++)
+		{
+			Form_pg_attribute att = TupleDescAttr(tupdesc, i);
+			pljulia_arrow_column *col = &columns[i];
+
+			if (att->attisdropped)
+				continue;
+			col->name = NameStr(att->attname);
+			col->kind = (pljulia_arrow_kind) info[2 * ncolumns];
+			col->unit = (int) info[2 * ncolumns + 1];
+			col->typid = att->atttypid;
+			col->typmod = att->atttypmod;
+			ncolumns++;
+			if (!pljulia_arrow_readable(col->kind, col->typid))
+				ereport(ERROR,
+						(errcode(ERRCODE_DATATYPE_MISMATCH),
+						 errmsg("pljulia_read_arrow: column \"%s\" can't be read as %s",
+								col->name, format_type_be(col->typid))));
+			if ((col->kind == ARROW_UTF8 || col->kind == ARROW_LARGE_UTF8) &&
+				col->typid != TEXTOID && col->typid != BYTEAOID)
+			{
+				Oid			typinput;
+
+				col->input = true;
+				getTypeInputInfo(col->typid, &typinput, &col->typioparam);
+				fmgr_info(typinput, &col->typinput);
+			}
+		}
+
+		rowcxt = AllocSetContextCreate(CurrentMemoryContext,
+									   "PL/Julia read_arrow row",
+									   ALLOCSET_DEFAULT_SIZES);
+		for (b = 1; b <= nbatches; b++)
+		{
+			int64	   *buffers;
+			int64		nrows;
+			int64		row;
+			int			j = 0;
+
+			batch = jl_box_int64(b);
+			batch = jl_call2(jl_get_function(pljulia_module, "arrow_batch"),
+							 file, batch);
+			if (jl_exception_occurred())
+				show_julia_error();
+			buffers = (int64 *) jl_array_data((jl_array_t *) batch);
+			nrows = buffers[0];
+			for (i = 0; i < tupdesc->natts; i++)
+			{
+				pljulia_arrow_column *col = &columns[i];
+
+				if (TupleDescAttr(tupdesc, i)->attisdropped)
+					continue;
+				col->validity = (const uint8 *) (uintptr_t) buffers[4 * j + 1];
+				col->values = (const char *) (uintptr_t) buffers[4 * j + 2];
+				col->data = (const char *) (uintptr_t) buffers[4 * j + 3];
+				col->datalen = buffers[4 * j + 4];
+				j++;
+			}
+
+			for (row = 0; row < nrows; row++)
+			{
+				oldcontext = MemoryContextSwitchTo(rowcxt);
+				for (i = 0; i < tupdesc->natts; i++)
+				{
+					if (TupleDescAttr(tupdesc, i)->attisdropped)
+						continue;
+					values[i] = pljulia_arrow_value(&columns[i], row, &nulls[i]);
+				}
+				MemoryContextSwitchTo(oldcontext);
+				tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+				MemoryContextReset(rowcxt);
+
+				CHECK_FOR_INTERRUPTS();
+			}
+		}
+		MemoryContextDelete(rowcxt);
+	}
+	PG_CATCH();
+	{
+		jl_exception_clear();
+		jl_call1(jl_get_function(pljulia_module, "arrow_close"), file);
+		jl_exception_clear();
+		JL_GC_POP();
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	jl_call1(jl_get_function(pljulia_module, "arrow_close"), file);
+	JL_GC_POP();
+	if (jl_exception_occurred())
+		show_julia_error();
+
+	return (Datum) 0;
+}
+
+/*
+ * Whether values of an Arrow column can be read as a type
+ */
+static bool
+pljulia_arrow_readable(pljulia_arrow_kind kind, Oid typid)
+{
+	bool		isint = kind >= ARROW_INT8 && kind <= ARROW_UINT64;
+	bool		isfloat = kind == ARROW_FLOAT32 || kind == ARROW_FLOAT64;
+
+	if (kind == ARROW_NULL)
+		return true;
+	switch (typid)
+	{
+		case BOOLOID:
+			return kind == ARROW_BOOL;
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+			return isint;
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case NUMERICOID:
+			return isint || isfloat;
+		case BYTEAOID:
+			return kind >= ARROW_UTF8 && kind <= ARROW_LARGE_BINARY;
+		case DATEOID:
+			return kind == ARROW_DATE32 || kind == ARROW_DATE64;
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return kind == ARROW_TIMESTAMP;
+		default:
+			return kind == ARROW_UTF8 || kind == ARROW_LARGE_UTF8;
+	}
+}
+
+/*
+ * Read the value of a column of an Arrow record batch at row
+ */
+static Datum
+pljulia_arrow_value(pljulia_arrow_column *col, int64 row, bool *isnull)
+{
+	int64		start;
+	int64		end;
+	int64		ts;
+	int64		days;
+	uint64		u;
+	char	   *str;
+
+	if (col->kind == ARROW_NULL ||
+		(col->validity != NULL && !(col->validity[row >> 3] & (1 << (row & 7)))))
+	{
+		*isnull = true;
+		return (Datum) 0;
+	}
+	*isnull = false;
+
+	switch (col->kind)
+	{
+		case ARROW_BOOL:
+			return BoolGetDatum((((const uint8 *) col->values)[row >> 3] >> (row & 7)) & 1);
+		case ARROW_INT8:
+			return pljulia_arrow_number(col, ((const int8 *) col->values)[row], 0, true);
+		case ARROW_INT16:
+			return pljulia_arrow_number(col, ((const int16 *) col->values)[row], 0, true);
+		case ARROW_INT32:
+			return pljulia_arrow_number(col, ((const int32 *) col->values)[row], 0, true);
+		case ARROW_INT64:
+			return pljulia_arrow_number(col, ((const int64 *) col->values)[row], 0, true);
+		case ARROW_UINT8:
+			return pljulia_arrow_number(col, ((const uint8 *) col->values)[row], 0, true);
+		case ARROW_UINT16:
+			return pljulia_arrow_number(col, ((const uint16 *) col->values)[row], 0, true);
+		case ARROW_UINT32:
+			return pljulia_arrow_number(col, ((const uint32 *) col->values)[row], 0, true);
+		case ARROW_UINT64:
+			u = ((const uint64 *) col->values)[row];
+			if (u <= (uint64) PG_INT64_MAX)
+				return pljulia_arrow_number(col, (int64) u, 0, true);
+			if (col->typid == NUMERICOID)
+				return DirectFunctionCall3(numeric_in,
+										   CStringGetDatum(psprintf(UINT64_FORMAT, u)),
+										   ObjectIdGetDatum(InvalidOid),
+										   Int32GetDatum(col->typmod));
+			if (col->typid == INT8OID)
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("bigint out of range")));
+			return pljulia_arrow_number(col, 0, (double) u, false);
+		case ARROW_FLOAT32:
+			return pljulia_arrow_number(col, 0, ((const float4 *) col->values)[row], false);
+		case ARROW_FLOAT64:
+			return pljulia_arrow_number(col, 0, ((const float8 *) col->values)[row], false);
+		case ARROW_UTF8:
+		case ARROW_LARGE_UTF8:
+		case ARROW_BINARY:
+		case ARROW_LARGE_BINARY:
+			if (col->kind == ARROW_UTF8 || col->kind == ARROW_BINARY)
+			{
+				start = ((const int32 *) col->values)[row];
+				end = ((const int32 *) col->values)[row + 1];
+			}
+			else
+			{
+				start = ((const int64 *) col->values)[row];
+				end = ((const int64 *) col->values)[row + 1];
+			}
+			if (start < 0 || end < start || end > col->datalen || end - start > MaxAllocSize - VARHDRSZ)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("pljulia_read_arrow: invalid offsets in column \"%s\"",
+								col->name)));
+			if (col->typid == BYTEAOID)
+			{
+				bytea	   *result = (bytea *) palloc(end - start + VARHDRSZ);
+
+				SET_VARSIZE(result, end - start + VARHDRSZ);
+				memcpy(VARDATA(result), col->data + start, end - start);
+				return PointerGetDatum(result);
+			}
+			/* validate the UTF-8 and convert it to the database encoding */
+			str = pg_any_to_server(col->data + start, end - start, PG_UTF8);
+			if (str == col->data + start)
+				str = pnstrdup(str, end - start);
+			if (col->input)
+				return InputFunctionCall(&col->typinput, str, col->typioparam,
+										 col->typmod);
+			return PointerGetDatum(cstring_to_text(str));
+		case ARROW_DATE32:
+		case ARROW_DATE64:
+			if (col->kind == ARROW_DATE32)
+				days = ((const int32 *) col->values)[row];
+			else
+			{
+				int64		ms = ((const int64 *) col->values)[row];
+
+				days = ms / (SECS_PER_DAY * 1000) - (ms % (SECS_PER_DAY * 1000) < 0);
+			}
+			days -= POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE;
+			if (!IS_VALID_DATE(days))
+				ereport(ERROR,
+						(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+						 errmsg("date out of range")));
+			return DateADTGetDatum((DateADT) days);
+		case ARROW_TIMESTAMP:
+			ts = ((const int64 *) col->values)[row];
+			if (col->unit == 3)
+				ts = ts / 1000 - (ts % 1000 < 0);
+			if ((col->unit == 0 && pg_mul_s64_overflow(ts, USECS_PER_SEC, &ts)) ||
+				(col->unit == 1 && pg_mul_s64_overflow(ts, 1000, &ts)) ||
+				pg_sub_s64_overflow(ts, (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * USECS_PER_DAY, &ts) ||
+				!IS_VALID_TIMESTAMP(ts))
+				ereport(ERROR,
+						(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+						 errmsg("timestamp out of range")));
+			return TimestampGetDatum(ts);
+		default:
+			elog(ERROR, "unexpected Arrow column kind %d", col->kind);
+	}
+	return (Datum) 0;			/* keep compiler quiet */
+}
+
+/*
+ * Convert an Arrow integer, if isint, or float to the numeric type of a
+ * column
+ */
+static Datum
+pljulia_arrow_number(pljulia_arrow_column *col, int64 i, double d, bool isint)
+{
+	Datum		result;
+
+	switch (col->typid)
+	{
+		case INT2OID:
+			if (i < PG_INT16_MIN || i > PG_INT16_MAX)
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("smallint out of range")));
+			return Int16GetDatum((int16) i);
+		case INT4OID:
+			if (i < PG_INT32_MIN || i > PG_INT32_MAX)
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("integer out of range")));
+			return Int32GetDatum((int32) i);
+		case INT8OID:
+			return Int64GetDatum(i);
+		case FLOAT4OID:
+			if (isint)
+				d = (double) i;
+			if (isinf((float4) d) && !isinf(d))
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("value out of range: overflow")));
+			return Float4GetDatum((float4) d);
+		case FLOAT8OID:
+			return Float8GetDatum(isint ? (double) i : d);
+		default:
+			result = isint ? DirectFunctionCall1(int8_numeric, Int64GetDatum(i)) :
+				DirectFunctionCall1(float8_numeric, Float8GetDatum(d));
+			if (col->typmod >= 0)
+				result = DirectFunctionCall2(numeric, result,
+											 Int32GetDatum(col->typmod));
+			return result;
+	}
+}
+
+/*
+ * Publish an array for PLJulia.shared_array, replacing the array of the same
+ * name. The elements, in the row-major order of PostgreSQL, are given to
+ * Julia in place.
+ */
+PG_FUNCTION_INFO_V1(pljulia_publish_array);
+
+Datum
+pljulia_publish_array(PG_FUNCTION_ARGS)
+{
+	char	   *name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	ArrayType  *array = PG_GETARG_ARRAYTYPE_P(1);
+	jl_datatype_t *eltype;
+	jl_value_t *args[3] = {NULL, NULL, NULL};
+	int			i;
+
+	switch (ARR_ELEMTYPE(array))
+	{
+		case BOOLOID:
+			eltype = jl_bool_type;
+			break;
+		case INT2OID:
+			eltype = jl_int16_type;
+			break;
+		case INT4OID:
+			eltype = jl_int32_type;
+			break;
+		case INT8OID:
+			eltype = jl_int64_type;
+			break;
+		case FLOAT4OID:
+			eltype = jl_float32_type;
+			break;
+		case FLOAT8OID:
+			eltype = jl_float64_type;
+			break;
+		default:
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("pljulia_publish_array: arrays of %s can't be shared",
+							format_type_be(ARR_ELEMTYPE(array)))));
+	}
+	if (array_contains_nulls(array))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("pljulia_publish_array: the array must not contain NULLs")));
+
+	JL_GC_PUSH3(&args[0], &args[1], &args[2]);
+	args[0] = jl_cstr_to_string(name);
+	args[1] = (jl_value_t *) jl_ptr_to_array_1d(jl_apply_array_type((jl_value_t *) eltype, 1),
+												ARR_DATA_PTR(array),
+												ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array)),
+												0);
+	args[2] = (jl_value_t *) jl_alloc_vec_any(ARR_NDIM(array));
+	for (i = 0; i < ARR_NDIM(array); i++)
+		jl_arrayset((jl_array_t *) args[2], jl_box_int64(ARR_DIMS(array)[i]), i);
+	jl_call(jl_get_function(pljulia_module, "publish_pg_array"), args, 3);
+	JL_GC_POP();
+	if (jl_exception_occurred())
+		show_julia_error();
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Remove a shared array. Returns whether it existed.
+ */
+PG_FUNCTION_INFO_V1(pljulia_unpublish_array);
+
+Datum
+pljulia_unpublish_array(PG_FUNCTION_ARGS)
+{
+	char	   *path = pljulia_shared_file(text_to_cstring(PG_GETARG_TEXT_PP(0)));
+
+	if (unlink(path) < 0)
+	{
+		if (errno == ENOENT)
+			PG_RETURN_BOOL(false);
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not remove file \"%s\": %m", path)));
+	}
+	PG_RETURN_BOOL(true);
+}
+
+/*
+ * The number of values in SD, the size they are charged and the maximum
+ * size in bytes
+ */
+PG_FUNCTION_INFO_V1(pljulia_shared_data_info);
+
+Datum
+pljulia_shared_data_info(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3] = {false};
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	pljulia_sd_attach();
+	values[0] = Int64GetDatum((int64) pg_atomic_read_u64(&pljulia_sd_ctl->entries));
+	values[1] = Int64GetDatum((int64) pg_atomic_read_u64(&pljulia_sd_ctl->size));
+	values[2] = Int64GetDatum((int64) pljulia_shared_data_size * 1024);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc),
+													  values, nulls)));
+}
+
+/**********************************************************************
+ * pljulia_fdw: foreign tables whose rows are produced by pljulia functions.
+ *
+ * The "scan" option of a foreign table, or of its server, names a pljulia
+ * function taking a PLJulia.ForeignScan, declared as internal, and returning
+ * an iterator of batches of rows. The optional "estimate" option names a
+ * function of the same kind returning the number of rows of a scan, and
+ * optionally its cost, for the planner. The other options are passed to
+ * Julia as they are.
+ *
+ * The columns the query needs and its quals comparing a column with a
+ * constant or a parameter are passed to Julia, which may use them to read
+ * less; the quals are checked again on the rows returned. Batches are
+ * fetched one at a time as the executor reads the rows, so the table never
+ * has to fit in memory.
+ **********************************************************************/
+
+PG_FUNCTION_INFO_V1(pljulia_fdw_handler);
+
+Datum
+pljulia_fdw_handler(PG_FUNCTION_ARGS)
+{
+	FdwRoutine *routine = makeNode(FdwRoutine);
+
+	routine->GetForeignRelSize = pljulia_fdw_rel_size;
+	routine->GetForeignPaths = pljulia_fdw_paths;
+	routine->GetForeignPlan = pljulia_fdw_plan;
+	routine->ExplainForeignScan = pljulia_fdw_explain;
+	routine->BeginForeignScan = pljulia_fdw_begin;
+	routine->IterateForeignScan = pljulia_fdw_iterate;
+	routine->ReScanForeignScan = pljulia_fdw_rescan;
+	routine->EndForeignScan = pljulia_fdw_end;
+
+	PG_RETURN_POINTER(routine);
+}
+
+/*
+ * Check the scan and estimate options of pljulia_fdw servers and tables, the
+ * other options are left to the Julia functions.
+ */
+PG_FUNCTION_INFO_V1(pljulia_fdw_validator);
+
+Datum
+pljulia_fdw_validator(PG_FUNCTION_ARGS)
+{
+	List	   *options = untransformRelOptions(PG_GETARG_DATUM(0));
+	Oid			catalog = PG_GETARG_OID(1);
+	ListCell   *lc;
+
+	foreach(lc, options)
+	{
+		DefElem    *def = lfirst_node(DefElem, lc);
+
+		if (strcmp(def->defname, "scan") != 0 &&
+			strcmp(def->defname, "estimate") != 0)
+			continue;
+		if (catalog != ForeignServerRelationId &&
+			catalog != ForeignTableRelationId)
+			ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_OPTION_NAME),
+					 errmsg("pljulia_fdw: option \"%s\" is only valid for servers and foreign tables",
+							def->defname)));
+		pljulia_callback_oid("pljulia_fdw", def);
+	}
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Return the options of a pljulia_fdw table, those of its server first, and
+ * its scan and estimate functions. The options of the table take precedence.
+ */
+static List *
+pljulia_fdw_options(Oid relid, Oid *scanfunc, Oid *estimatefunc)
+{
+	ForeignTable *table = GetForeignTable(relid);
+	ForeignServer *server = GetForeignServer(table->serverid);
+	List	   *options = list_concat_copy(server->options, table->options);
+	ListCell   *lc;
+
+	*scanfunc = InvalidOid;
+	*estimatefunc = InvalidOid;
+	foreach(lc, options)
+	{
+		DefElem    *def = lfirst_node(DefElem, lc);
+
+		if (strcmp(def->defname, "scan") == 0)
+			*scanfunc = pljulia_callback_oid("pljulia_fdw", def);
+		else if (strcmp(def->defname, "estimate") == 0)
+			*estimatefunc = pljulia_callback_oid("pljulia_fdw", def);
+	}
+	if (!OidIsValid(*scanfunc))
+		ereport(ERROR,
+				(errcode(ERRCODE_FDW_OPTION_NAME_NOT_FOUND),
+				 errmsg("pljulia_fdw: foreign table \"%s\" has no scan function",
+						get_rel_name(relid)),
+				 errhint("Set the scan option of the table or of its server.")));
+	return options;
+}
+
+/*
+ * Look up the function named by an option of pljulia_fdw or of the output
+ * plugin: a pljulia function taking an internal argument and returning
+ * internal, which can't be called from SQL.
+ */
+static Oid
+pljulia_callback_oid(const char *caller, DefElem *def)
+{
+	Oid			argtypes[1] = {INTERNALOID};
+	Oid			funcoid;
+	HeapTuple	tuple;
+	Form_pg_proc proc;
+	bool		valid;
+
+	funcoid = LookupFuncName(stringToQualifiedNameList(defGetString(def)), 1,
+							 argtypes, false);
+	tuple = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcoid));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for function %u", funcoid);
+	proc = (Form_pg_proc) GETSTRUCT(tuple);
+	valid = proc->prolang == get_language_oid("pljulia", false) &&
+		proc->prorettype == INTERNALOID;
+	ReleaseSysCache(tuple);
+	if (!valid)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("%s: %s function %s must be a pljulia function returning internal",
+						caller, def->defname, format_procedure(funcoid))));
+	return funcoid;
+}
+
+/*
+ * Compile a function found by pljulia_callback_oid, checking that the
+ * current user may execute it. The Julia function is called directly, not
+ * through the function manager.
+ */
+static jl_function_t *
+pljulia_callback_function(Oid funcoid)
+{
+	LOCAL_FCINFO(fcinfo, 1);
+	FmgrInfo	flinfo;
+	HeapTuple	tuple;
+	pljulia_proc_desc *prodesc;
+	AclResult	aclresult;
+
+	aclresult = pg_proc_aclcheck(funcoid, GetUserId(), ACL_EXECUTE);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, OBJECT_FUNCTION, get_func_name(funcoid));
+
+	tuple = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcoid));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for function %u", funcoid);
+	/* pljulia_compile only looks at the OID and the number of arguments */
+	MemSet(&flinfo, 0, sizeof(flinfo));
+	flinfo.fn_oid = funcoid;
+	flinfo.fn_mcxt = CurrentMemoryContext;
+	InitFunctionCallInfoData(*fcinfo, &flinfo, 1, InvalidOid, NULL, NULL);
+	prodesc = pljulia_compile(fcinfo, tuple, (Form_pg_proc) GETSTRUCT(tuple),
+							  false, false);
+	ReleaseSysCache(tuple);
+
+	return prodesc->julia_func;
+}
+
+/*
+ * Build what PLJulia.ForeignScan is made of: the names and values of the
+ * options, the names of the columns fetched, and the column names, operator
+ * names and values of the quals passed to Julia. The result isn't rooted.
+ */
+static jl_value_t *
+pljulia_fdw_spec(List *options, TupleDesc tupdesc, List *attnums,
+				 List *qual_attnums, List *qual_opnames, Datum *values,
+				 bool *nulls, Oid *types)
+{
+	jl_array_t *spec;
+	jl_array_t *array;
+	jl_value_t *value = NULL;
+	ListCell   *lc;
+	ListCell   *lc2;
+	int			i;
+
+	spec = jl_alloc_vec_any(6);
+	JL_GC_PUSH2(&spec, &value);
+	for (i = 0; i < 6; i++)
+		jl_arrayset(spec,
+					(jl_value_t *) jl_alloc_vec_any(i < 2 ? list_length(options) :
+													i == 2 ? list_length(attnums) :
+													list_length(qual_attnums)),
+					i);
+
+	i = 0;
+	foreach(lc, options)
+	{
+		DefElem    *def = lfirst_node(DefElem, lc);
+
+		array = (jl_array_t *) jl_arrayref(spec, 0);
+		jl_arrayset(array, jl_cstr_to_string(def->defname), i);
+		array = (jl_array_t *) jl_arrayref(spec, 1);
+		jl_arrayset(array, jl_cstr_to_string(defGetString(def)), i);
+		i++;
+	}
+
+	i = 0;
+	foreach(lc, attnums)
+	{
+		array = (jl_array_t *) jl_arrayref(spec, 2);
+		jl_arrayset(array,
+					jl_cstr_to_string(NameStr(TupleDescAttr(tupdesc, lfirst_int(lc) - 1)->attname)),
+					i++);
+	}
+
+	i = 0;
+	forboth(lc, qual_attnums, lc2, qual_opnames)
+	{
+		array = (jl_array_t *) jl_arrayref(spec, 3);
+		jl_arrayset(array,
+					jl_cstr_to_string(NameStr(TupleDescAttr(tupdesc, lfirst_int(lc) - 1)->attname)),
+					i);
+		array = (jl_array_t *) jl_arrayref(spec, 4);
+		jl_arrayset(array, jl_cstr_to_string(strVal(lfirst(lc2))), i);
+
+		if (nulls[i])
+			value = jl_nothing;
+		else if ((value = pg_datum_to_jl_value(values[i], types[i])) == NULL)
+		{
+			Oid			typoutput;
+			bool		typisvarlena;
+
+			getTypeOutputInfo(types[i], &typoutput, &typisvarlena);
+			value = pg_oid_to_jl_value(types[i],
+									   OidOutputFunctionCall(typoutput, values[i]));
+		}
+		array = (jl_array_t *) jl_arrayref(spec, 5);
+		jl_arrayset(array, value, i);
+		i++;
+	}
+	JL_GC_POP();
+
+	return (jl_value_t *) spec;
+}
+
+/*
+ * Find the quals of a scan that can be passed to Julia, those comparing a
+ * column with a constant or a parameter with a binary operator.
+ */
+static void
+pljulia_fdw_quals(RelOptInfo *baserel, pljulia_fdw_plan_state *fdw)
+{
+	ListCell   *lc;
+
+	foreach(lc, baserel->baserestrictinfo)
+	{
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		OpExpr	   *op = (OpExpr *) rinfo->clause;
+		Node	   *left;
+		Node	   *right;
+		Oid			opno;
+
+		if (!IsA(op, OpExpr) || list_length(op->args) != 2)
+		{
+			fdw->local_quals = lappend(fdw->local_quals, rinfo);
+			continue;
+		}
+		left = linitial(op->args);
+		right = lsecond(op->args);
+		opno = op->opno;
+		if (IsA(left, RelabelType))
+			left = (Node *) ((RelabelType *) left)->arg;
+		if (IsA(right, RelabelType))
+			right = (Node *) ((RelabelType *) right)->arg;
+		/* value op column */
+		if (!IsA(left, Var) && IsA(right, Var))
+		{
+			Node	   *tmp = left;
+
+			left = right;
+			right = tmp;
+			opno = get_commutator(opno);
+		}
+		if (!OidIsValid(opno) || !IsA(left, Var) ||
+			((Var *) left)->varno != baserel->relid ||
+			((Var *) left)->varattno <= 0 ||
+			!(IsA(right, Const) || IsA(right, Param)))
+		{
+			fdw->local_quals = lappend(fdw->local_quals, rinfo);
+			continue;
+		}
+		fdw->qual_attnums = lappend_int(fdw->qual_attnums,
+										((Var *) left)->varattno);
+		fdw->qual_opnames = lappend(fdw->qual_opnames,
+									makeString(get_opname(opno)));
+		fdw->qual_exprs = lappend(fdw->qual_exprs, right);
+	}
+}
+
+/*
+ * Estimate the size of a scan with the estimate function of the table, if
+ * it has one, and remember the columns and quals to pass to Julia.
+ */
+static void
+pljulia_fdw_rel_size(PlannerInfo *root, RelOptInfo *baserel,
+					 Oid foreigntableid)
+{
+	pljulia_fdw_plan_state *fdw;
+	Relation	rel;
+	TupleDesc	tupdesc;
+	List	   *options;
+	Oid			estimatefunc;
+	Bitmapset  *attrs_used = NULL;
+	ListCell   *lc;
+	double		rows = PLJULIA_FDW_DEFAULT_ROWS;
+	Cost		run_cost = -1;
+	Selectivity selectivity;
+	bool		wholerow;
+	int			i;
+
+	fdw = (pljulia_fdw_plan_state *) palloc0(sizeof(pljulia_fdw_plan_state));
+	options = pljulia_fdw_options(foreigntableid, &fdw->scanfunc,
+								  &estimatefunc);
+
+	/* the columns the query needs, all of them for a whole-row reference */
+	pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid,
+				   &attrs_used);
+	foreach(lc, baserel->baserestrictinfo)
+		pull_varattnos((Node *) lfirst_node(RestrictInfo, lc)->clause,
+					   baserel->relid, &attrs_used);
+	wholerow = bms_is_member(0 - FirstLowInvalidHeapAttributeNumber,
+							 attrs_used);
+	rel = table_open(foreigntableid, NoLock);
+	tupdesc = RelationGetDescr(rel);
+	for (i = 1; i <= tupdesc->natts; i++)
+	{
+		if (TupleDescAttr(tupdesc, i - 1)->attisdropped)
+			continue;
+		if (wholerow ||
+			bms_is_member(i - FirstLowInvalidHeapAttributeNumber, attrs_used))
+			fdw->attnums = lappend_int(fdw->attnums, i);
+	}
+	pljulia_fdw_quals(baserel, fdw);
+
+	if (OidIsValid(estimatefunc))
+	{
+		jl_function_t *func = pljulia_callback_function(estimatefunc);
+		int			nquals = list_length(fdw->qual_exprs);
+		List	   *qual_attnums = NIL;
+		List	   *qual_opnames = NIL;
+		Datum	   *values = (Datum *) palloc(Max(nquals, 1) * sizeof(Datum));
+		bool	   *nulls = (bool *) palloc(Max(nquals, 1) * sizeof(bool));
+		Oid		   *types = (Oid *) palloc(Max(nquals, 1) * sizeof(Oid));
+		jl_value_t *spec = NULL;
+		jl_value_t *table = NULL;
+		jl_value_t *estimate;
+		ListCell   *lc2;
+		ListCell   *lc3;
+
+		/* the values of parameters aren't known yet */
+		nquals = 0;
+		forthree(lc, fdw->qual_attnums, lc2, fdw->qual_opnames,
+				 lc3, fdw->qual_exprs)
+		{
+			Const	   *value = (Const *) lfirst(lc3);
+
+			if (!IsA(value, Const))
+				continue;
+			qual_attnums = lappend_int(qual_attnums, lfirst_int(lc));
+			qual_opnames = lappend(qual_opnames, lfirst(lc2));
+			values[nquals] = value->constvalue;
+			nulls[nquals] = value->constisnull;
+			types[nquals] = value->consttype;
+			nquals++;
+		}
+
+		JL_GC_PUSH2(&spec, &table);
+		spec = pljulia_fdw_spec(options, tupdesc, fdw->attnums, qual_attnums,
+								qual_opnames, values, nulls, types);
+		table = jl_cstr_to_string(RelationGetRelationName(rel));
+		estimate = jl_call3(jl_get_function(pljulia_module, "fdw_estimate"),
+							(jl_value_t *) func, table, spec);
+		JL_GC_POP();
+		if (jl_exception_occurred())
+			show_julia_error();
+		rows = ((double *) jl_array_data(estimate))[0];
+		run_cost = ((double *) jl_array_data(estimate))[1];
+
+		/* the scan is expected to apply the quals passed to Julia */
+		selectivity = clauselist_selectivity(root, fdw->local_quals, 0,
+											 JOIN_INNER, NULL);
+	}
+	else
+		selectivity = clauselist_selectivity(root, baserel->baserestrictinfo,
+											 0, JOIN_INNER, NULL);
+	table_close(rel, NoLock);
+
+	rows = clamp_row_est(rows);
+	baserel->tuples = rows;
+	baserel->rows = clamp_row_est(rows * selectivity);
+
+	/* producing a row costs as much as a tuple, unless Julia knows better */
+	if (run_cost < 0)
+		run_cost = rows * cpu_tuple_cost;
+	fdw->startup_cost = PLJULIA_FDW_STARTUP_COST +
+		baserel->baserestrictcost.startup;
+	fdw->total_cost = fdw->startup_cost + run_cost +
+		rows * (cpu_tuple_cost + baserel->baserestrictcost.per_tuple);
+
+	baserel->fdw_private = fdw;
+}
+
+static void
+pljulia_fdw_paths(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+{
+	pljulia_fdw_plan_state *fdw = (pljulia_fdw_plan_state *) baserel->fdw_private;
+
+	add_path(baserel, (Path *)
+			 create_foreignscan_path(root, baserel, NULL, baserel->rows,
+									 fdw->startup_cost, fdw->total_cost,
+									 NIL, NULL, NULL, NIL));
+}
+
+/*
+ * The values of the quals passed to Julia go to fdw_exprs, so that their
+ * parameters are set up by the planner, and the rest to fdw_private: the
+ * scan function, the columns fetched and the columns and operators of the
+ * quals. All the quals are checked again by the executor.
+ */
+static ForeignScan *
+pljulia_fdw_plan(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid,
+				 ForeignPath *best_path, List *tlist, List *scan_clauses,
+				 Plan *outer_plan)
+{
+	pljulia_fdw_plan_state *fdw = (pljulia_fdw_plan_state *) baserel->fdw_private;
+
+	scan_clauses = extract_actual_clauses(scan_clauses, false);
+	return make_foreignscan(tlist, scan_clauses, baserel->relid,
+							fdw->qual_exprs,
+							list_make4(makeInteger((int) fdw->scanfunc),
+									   fdw->attnums, fdw->qual_attnums,
+									   fdw->qual_opnames),
+							NIL, NIL, outer_plan);
+}
+
+static void
+pljulia_fdw_explain(ForeignScanState *node, ExplainState *es)
+{
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	TupleDesc	tupdesc = RelationGetDescr(node->ss.ss_currentRelation);
+	List	   *quals = NIL;
+	ListCell   *lc;
+	ListCell   *lc2;
+
+	ExplainPropertyText("Julia Scan",
+						format_procedure((Oid) intVal(linitial(fsplan->fdw_private))),
+						es);
+	if (!es->verbose)
+		return;
+	forboth(lc, lthird(fsplan->fdw_private), lc2, lfourth(fsplan->fdw_private))
+		quals = lappend(quals,
+						psprintf("%s %s",
+								 NameStr(TupleDescAttr(tupdesc, lfirst_int(lc) - 1)->attname),
+								 strVal(lfirst(lc2))));
+	ExplainPropertyList("Julia Quals", quals, es);
+}
+
+/*
+ * Set up the execution state. The scan function is only called by the first
+ * IterateForeignScan, once the values of the parameters are known.
+ */
+static void
+pljulia_fdw_begin(ForeignScanState *node, int eflags)
+{
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	TupleDesc	tupdesc = RelationGetDescr(node->ss.ss_currentRelation);
+	pljulia_fdw_scan_state *state;
+	ListCell   *lc;
+	int			j = 0;
+
+	state = (pljulia_fdw_scan_state *) palloc0(sizeof(pljulia_fdw_scan_state));
+	state->scanfunc = (Oid) intVal(linitial(fsplan->fdw_private));
+	state->columns = lsecond(fsplan->fdw_private);
+	state->ncols = list_length(state->columns);
+	state->attnums = (AttrNumber *) palloc(Max(state->ncols, 1) * sizeof(AttrNumber));
+	state->typids = (Oid *) palloc(Max(state->ncols, 1) * sizeof(Oid));
+	state->convs = (pljulia_param_conv *) palloc(Max(state->ncols, 1) *
+												 sizeof(pljulia_param_conv));
+	foreach(lc, state->columns)
+	{
+		state->attnums[j] = lfirst_int(lc);
+		state->typids[j] = TupleDescAttr(tupdesc, state->attnums[j] - 1)->atttypid;
+		state->convs[j] = pg_oid_to_param_conv(state->typids[j]);
+		j++;
+	}
+	state->qual_attnums = lthird(fsplan->fdw_private);
+	state->qual_opnames = lfourth(fsplan->fdw_private);
+	state->qual_exprs = ExecInitExprList(fsplan->fdw_exprs, (PlanState *) node);
+	state->rowcxt = AllocSetContextCreate(CurrentMemoryContext,
+										  "PL/Julia fdw row",
+										  ALLOCSET_SMALL_SIZES);
+	node->fdw_state = state;
+}
+
+/*
+ * Call the scan function, with the current values of the quals, and keep
+ * the iterator it returns in PLJulia.fdw_scans.
+ */
+static void
+pljulia_fdw_start(ForeignScanState *node)
+{
+	pljulia_fdw_scan_state *state = (pljulia_fdw_scan_state *) node->fdw_state;
+	Relation	rel = node->ss.ss_currentRelation;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	int			nquals = list_length(state->qual_exprs);
+	Datum	   *values;
+	bool	   *nulls;
+	Oid		   *types;
+	jl_value_t *args[4] = {NULL, NULL, NULL, NULL};
+	jl_value_t *id;
+	List	   *options;
+	Oid			scanfunc;
+	Oid			estimatefunc;
+	MemoryContext oldcontext;
+	ListCell   *lc;
+	int			i = 0;
+
+	/* all of this is only needed until the values are passed to Julia */
+	oldcontext = MemoryContextSwitchTo(state->rowcxt);
+	values = (Datum *) palloc(Max(nquals, 1) * sizeof(Datum));
+	nulls = (bool *) palloc(Max(nquals, 1) * sizeof(bool));
+	types = (Oid *) palloc(Max(nquals, 1) * sizeof(Oid));
+	foreach(lc, state->qual_exprs)
+	{
+		ExprState  *expr = (ExprState *) lfirst(lc);
+
+		values[i] = ExecEvalExpr(expr, econtext, &nulls[i]);
+		types[i] = exprType((Node *) expr->expr);
+		i++;
+	}
+	options = pljulia_fdw_options(RelationGetRelid(rel), &scanfunc,
+								  &estimatefunc);
+
+	JL_GC_PUSH4(&args[0], &args[1], &args[2], &args[3]);
+	args[0] = (jl_value_t *) pljulia_callback_function(state->scanfunc);
+	args[1] = jl_cstr_to_string(RelationGetRelationName(rel));
+	args[2] = pljulia_fdw_spec(options, RelationGetDescr(rel), state->columns,
+							   state->qual_attnums, state->qual_opnames,
+							   values, nulls, types);
+	args[3] = jl_box_uint64(pljulia_xact_generation);
+	id = jl_call(jl_get_function(pljulia_module, "fdw_begin"), args, 4);
+	JL_GC_POP();
+	if (jl_exception_occurred())
+		show_julia_error();
+	MemoryContextSwitchTo(oldcontext);
+
+	state->id = jl_unbox_int64(id);
+	state->batch = NULL;
+	state->nrows = 0;
+	state->row = 0;
+	state->done = false;
+}
+
+/*
+ * Return the next row of the current batch, fetching the next batch from
+ * Julia once it's exhausted. The columns of a batch are vectors of boxed
+ * values, see PLJulia.fdw_next, or nothing for the columns Julia didn't
+ * return, which are NULL.
+ */
+static TupleTableSlot *
+pljulia_fdw_iterate(ForeignScanState *node)
+{
+	pljulia_fdw_scan_state *state = (pljulia_fdw_scan_state *) node->fdw_state;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	MemoryContext oldcontext;
+	int			j;
+
+	ExecClearTuple(slot);
+	MemoryContextReset(state->rowcxt);
+	if (state->id == 0)
+		pljulia_fdw_start(node);
+
+	while (state->row >= state->nrows)
 	{
-		if (strcmp("OK", jl_string_ptr(ret)) == 0)
-			return PointerGetDatum(rettuple);
-		else if (strcmp("SKIP", jl_string_ptr(ret)) == 0)
+		jl_value_t *batch;
+
+		if (state->done)
+			return slot;
+		batch = jl_call1(jl_get_function(pljulia_module, "fdw_next"),
+						 jl_box_int64(state->id));
+		if (jl_exception_occurred())
+			show_julia_error();
+		if (jl_is_nothing(batch))
 		{
-			rettuple = (HeapTuple) NULL;
-			return PointerGetDatum(rettuple);
+			state->done = true;
+			state->batch = NULL;
+			return slot;
 		}
-		else
-			elog(ERROR, "Trigger function must return either nothing, \"OK\", "
-				 "\"SKIP\" or a dictionary corresponding to the new tuple");
+		state->batch = (jl_array_t *) batch;
+		state->nrows = jl_unbox_int64(jl_arrayref(state->batch, 0));
+		state->row = 0;
 	}
-	else if (jl_is_dict(ret))
-	{
-		/* Create the modified tuple to return */
-		rettuple = pljulia_build_tuple_result(ret,
-											  trigdata->tg_relation->rd_att);
 
-		/*
-		 * Still need to check if the operation was an INSERT or UPDATE
-		 * Otherwise, returning a modified row doesn't make sense
-		 */
-		if (!TRIGGER_FIRED_BY_INSERT(trigdata->tg_event) && !TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
-		{
-			/* Perhaps another error level ? */
-			elog(NOTICE, "Ignoring modified row, not an INSERT or UPDATE");
-			rettuple = trigdata->tg_trigtuple;
-		}
+	oldcontext = MemoryContextSwitchTo(state->rowcxt);
+	memset(slot->tts_isnull, true,
+		   slot->tts_tupleDescriptor->natts * sizeof(bool));
+	for (j = 0; j < state->ncols; j++)
+	{
+		jl_value_t *column = jl_arrayref(state->batch, j + 1);
+		jl_value_t *value;
+		int			att = state->attnums[j] - 1;
 
+		if (jl_is_nothing(column))
+			continue;
+		value = jl_arrayref((jl_array_t *) column, state->row);
+		if (jl_is_nothing(value))
+			continue;
+		if (!jl_value_to_param_datum(value, state->convs[j],
+									 &slot->tts_values[att]))
+			slot->tts_values[att] = jl_value_t_to_datum(NULL, value,
+														state->typids[j],
+														false);
+		slot->tts_isnull[att] = false;
 	}
-	else
-		elog(ERROR, "Trigger function must return either nothing, \"OK\", "
-			 "\"SKIP\" or a dictionary corresponding to the new tuple");
+	MemoryContextSwitchTo(oldcontext);
+	state->row++;
 
-	return PointerGetDatum(rettuple);
+	return ExecStoreVirtualTuple(slot);
 }
 
+/*
+ * Drop the Julia iterator of a scan; a rescan calls the scan function again
+ * with the new values of the parameters.
+ */
 static void
-pljulia_event_trigger_handler(PG_FUNCTION_ARGS)
+pljulia_fdw_rescan(ForeignScanState *node)
 {
-	pljulia_proc_desc *prodesc;
-	EventTriggerData *trigdata = (EventTriggerData *) fcinfo->context;
-	HeapTuple	procedure_tuple;
-	Form_pg_proc procedure_struct;
-	jl_value_t *trig_args[2];
-	jl_function_t *func;
+	pljulia_fdw_scan_state *state = (pljulia_fdw_scan_state *) node->fdw_state;
+
+	if (state->id == 0)
+		return;
+	jl_call1(jl_get_function(pljulia_module, "fdw_end"),
+			 jl_box_int64(state->id));
+	state->id = 0;
+	state->batch = NULL;
+	if (jl_exception_occurred())
+		show_julia_error();
+}
 
-	/* make sure we're here from a call to an event trigger */
-	if (!CALLED_AS_EVENT_TRIGGER(fcinfo))
-		elog(ERROR, "not called by trigger manager");
-	/* connect to the SPI manager */
-	if (SPI_connect() != SPI_OK_CONNECT)
-		elog(ERROR, "could not connect to SPI manager");
+static void
+pljulia_fdw_end(ForeignScanState *node)
+{
+	pljulia_fdw_rescan(node);
+}
 
-	procedure_tuple = SearchSysCache(PROCOID,
-									 ObjectIdGetDatum(fcinfo->flinfo->fn_oid),
-									 0, 0, 0);
-	if (!HeapTupleIsValid(procedure_tuple))
-		elog(ERROR, "cache lookup failed for function %u",
-			 fcinfo->flinfo->fn_oid);
-	procedure_struct = (Form_pg_proc) GETSTRUCT(procedure_tuple);
+/**********************************************************************
+ * The pljulia logical decoding output plugin, named after this library:
+ *
+ *   SELECT * FROM pg_create_logical_replication_slot('slot', 'pljulia');
+ *   SELECT * FROM pg_logical_slot_get_changes('slot', NULL, NULL,
+ *                                             'change', 'my_changes');
+ *
+ * The begin, change and commit options name pljulia functions taking a
+ * PLJulia.DecodedTransaction, declared as internal, and returning what is
+ * written to the output: nothing, a string or a collection of strings, one
+ * message each. The change function is given the changes of a transaction
+ * in batches of up to batch_size changes, the last one at commit. Rows are
+ * converted to Julia directly from their Datums for the types that allow
+ * it, with the conversions of each relation kept until it changes.
+ **********************************************************************/
 
-	prodesc = pljulia_compile(fcinfo, procedure_tuple, procedure_struct,
-							  false, true);
-	ReleaseSysCache(procedure_tuple);
+void
+_PG_output_plugin_init(OutputPluginCallbacks *cb)
+{
+	AssertVariableIsOfType(&_PG_output_plugin_init, LogicalOutputPluginInit);
 
-	/* TD_event */
-	trig_args[0] = jl_cstr_to_string(utf_e2u(trigdata->event));
-	/* TD_tag */
-	trig_args[1] = jl_cstr_to_string(utf_e2u(GetCommandTagName(trigdata->tag)));
+	cb->startup_cb = pljulia_decoding_startup;
+	cb->begin_cb = pljulia_decoding_begin;
+	cb->change_cb = pljulia_decoding_change;
+	cb->truncate_cb = pljulia_decoding_truncate;
+	cb->commit_cb = pljulia_decoding_commit;
+}
 
-	func = jl_get_function(jl_main_module, prodesc->internal_proname);
-	/* the value returned by an event trigger is ignored */
-	jl_call2(func, trig_args[0], trig_args[1]);
+/*
+ * Read the options and compile the callbacks. The functions are looked up
+ * here, before decoding starts, since the catalog is then read with the
+ * historic snapshots of the transactions decoded.
+ */
+static void
+pljulia_decoding_startup(LogicalDecodingContext *ctx, OutputPluginOptions *opt,
+						 bool is_init)
+{
+	static const char *const callbacks[3] = {"begin", "change", "commit"};
+	pljulia_decoding_data *data;
+	Oid			funcoids[3] = {InvalidOid, InvalidOid, InvalidOid};
+	jl_value_t *funcs[3] = {NULL, NULL, NULL};
+	ListCell   *lc;
+	int			i;
+
+	data = (pljulia_decoding_data *) palloc0(sizeof(pljulia_decoding_data));
+	data->context = AllocSetContextCreate(ctx->context,
+										  "PL/Julia decoding context",
+										  ALLOCSET_DEFAULT_SIZES);
+	data->batch_size = 10000;
+	ctx->output_plugin_private = data;
+	opt->output_type = OUTPUT_PLUGIN_TEXTUAL_OUTPUT;
+
+	foreach(lc, ctx->output_plugin_options)
+	{
+		DefElem    *def = lfirst_node(DefElem, lc);
+
+		for (i = 0; i < 3; i++)
+			if (strcmp(def->defname, callbacks[i]) == 0)
+				break;
+		if (i < 3)
+			funcoids[i] = pljulia_callback_oid("pljulia output plugin", def);
+		else if (strcmp(def->defname, "batch_size") == 0)
+		{
+			data->batch_size = pg_strtoint32(defGetString(def));
+			if (data->batch_size < 1)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("pljulia output plugin: batch_size must be positive")));
+		}
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("pljulia output plugin: unknown option \"%s\"",
+							def->defname)));
+	}
+
+	/* creating the slot doesn't decode anything */
+	if (is_init)
+		return;
+	if (!OidIsValid(funcoids[0]) && !OidIsValid(funcoids[1]) &&
+		!OidIsValid(funcoids[2]))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pljulia output plugin: one of the begin, change and commit options is required")));
+
+	/*
+	 * The modules of the functions keep them alive, but a later callback may
+	 * replace one of those modules before decode_startup has stored them.
+	 */
+	JL_GC_PUSH3(&funcs[0], &funcs[1], &funcs[2]);
+	for (i = 0; i < 3; i++)
+		funcs[i] = OidIsValid(funcoids[i]) ?
+			(jl_value_t *) pljulia_callback_function(funcoids[i]) : jl_nothing;
+	jl_call3(jl_get_function(pljulia_module, "decode_startup"),
+			 funcs[0], funcs[1], funcs[2]);
+	JL_GC_POP();
 	if (jl_exception_occurred())
 		show_julia_error();
 
-	/* disconnect from the SPI manager */
-	if (SPI_finish() != SPI_OK_FINISH)
-		elog(ERROR, "SPI_finish() failed");
-
+	data->has_begin = OidIsValid(funcoids[0]);
+	data->has_change = OidIsValid(funcoids[1]);
+	data->has_commit = OidIsValid(funcoids[2]);
 }
 
-PG_FUNCTION_INFO_V1(pljulia_validator);
+static void
+pljulia_decoding_begin(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
+	pljulia_decoding_data *data = (pljulia_decoding_data *) ctx->output_plugin_private;
 
-Datum
-pljulia_validator(PG_FUNCTION_ARGS)
+	if (data->has_begin)
+		pljulia_decoding_call(ctx, txn, "begin");
+}
+
+static void
+pljulia_decoding_change(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+						Relation relation, ReorderBufferChange *change)
 {
-	Oid			funcoid = PG_GETARG_OID(0);
-	HeapTuple	tuple;
-	Form_pg_proc proc;
-	char	   *code;
-	Datum		prosrc_datum;
-	Oid		   *argtypes;
-	char	  **argnames;
-	char	   *argmodes;
-	bool		isnull;
-	char		functyptype;
-	bool		is_trigger = false,
-				is_event_trigger = false;
-	int			i,
-				nargs;
-	int			compiled_len = 0;
-	char	   *trig_args =
-	"TD_name, TD_relid, TD_table_name, TD_table_schema, TD_event, TD_when, "
-	"TD_level, TD_NEW, TD_OLD, args";
-	char	   *evt_trig_args = "TD_event, TD_tag";
-	char	   *compiled_code;
+	HeapTuple	oldtuple = NULL;
+	HeapTuple	newtuple = NULL;
 
-	/*
-	 * Verify that we have a pljulia function and that the user has access to
-	 * both the language and the function
-	 */
-	if (!CheckFunctionValidatorAccess(fcinfo->flinfo->fn_oid, funcoid))
-		PG_RETURN_VOID();
-	/* the user might not require validation */
-	if (!check_function_bodies)
+	if (change->data.tp.oldtuple != NULL)
+		oldtuple = &change->data.tp.oldtuple->tuple;
+	if (change->data.tp.newtuple != NULL)
+		newtuple = &change->data.tp.newtuple->tuple;
+
+	switch (change->action)
 	{
-		elog(NOTICE, "check_function_bodies is disabled, skipping validation");
-		PG_RETURN_VOID();
+		case REORDER_BUFFER_CHANGE_INSERT:
+			pljulia_decoding_push(ctx, txn, relation, "insert", NULL, newtuple);
+			break;
+		case REORDER_BUFFER_CHANGE_UPDATE:
+			pljulia_decoding_push(ctx, txn, relation, "update", oldtuple,
+								  newtuple);
+			break;
+		case REORDER_BUFFER_CHANGE_DELETE:
+			pljulia_decoding_push(ctx, txn, relation, "delete", oldtuple, NULL);
+			break;
+		default:
+			Assert(false);
 	}
+}
 
-	tuple = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcoid));
-	if (!HeapTupleIsValid(tuple))
-		elog(ERROR, "cache lookup failed for function %u", funcoid);
-	proc = (Form_pg_proc) GETSTRUCT(tuple);
+static void
+pljulia_decoding_truncate(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+						  int nrelations, Relation relations[],
+						  ReorderBufferChange *change)
+{
+	int			i;
 
-	functyptype = get_typtype(proc->prorettype);
+	for (i = 0; i < nrelations; i++)
+		pljulia_decoding_push(ctx, txn, relations[i], "truncate", NULL, NULL);
+}
 
-	/* Disallow pseudotype result */
-	/* except for TRIGGER, EVTTRIGGER, RECORD, or VOID */
-	if (functyptype == TYPTYPE_PSEUDO)
+/*
+ * Deliver the last batch of changes of the transaction, then call the
+ * commit callback
+ */
+static void
+pljulia_decoding_commit(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+						XLogRecPtr commit_lsn)
+{
+	pljulia_decoding_data *data = (pljulia_decoding_data *) ctx->output_plugin_private;
+
+	if (data->nchanges > 0)
 	{
-		if (proc->prorettype == TRIGGEROID)
-			is_trigger = true;
-		else if (proc->prorettype ==
-#if PG_VERSION_NUM >= 140000
-			 EVENT_TRIGGEROID
-#else
-			 EVTTRIGGEROID
-#endif
-			 )
-			is_event_trigger = true;
-		else if (proc->prorettype != RECORDOID &&
-				 proc->prorettype != VOIDOID)
-			elog(ERROR,
-				 "PL/Julia functions cannot return type %s",
-				 format_type_be(proc->prorettype));
+		data->nchanges = 0;
+		pljulia_decoding_call(ctx, txn, "change");
 	}
+	if (data->has_commit)
+		pljulia_decoding_call(ctx, txn, "commit");
+}
 
-	prosrc_datum = SysCacheGetAttr(PROCOID, tuple,
-								   Anum_pg_proc_prosrc, &isnull);
-	code = DatumGetCString(DirectFunctionCall1(textout,
-											   prosrc_datum));
-	nargs = get_func_arg_info(tuple, &argtypes, &argnames, &argmodes);
+/*
+ * Add a change to the current batch, PLJulia.decoding_changes, delivering
+ * the batch to the change callback once it is full
+ */
+static void
+pljulia_decoding_push(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					  Relation relation, const char *action,
+					  HeapTuple oldtuple, HeapTuple newtuple)
+{
+	pljulia_decoding_data *data = (pljulia_decoding_data *) ctx->output_plugin_private;
+	pljulia_decoding_relation *entry;
+	jl_value_t *args[4] = {NULL, NULL, NULL, NULL};
+	MemoryContext oldcontext;
 
-	/*
-	 * if there's another user function with the name pljulia_validate_func
-	 * this shouldn't cause an error
-	 */
-	compiled_len += strlen("function pljulia_validate_func()\n\nend");
+	if (!data->has_change)
+		return;
 
-	/*
-	 * simply prepend the arguments to the source code and then call
-	 * jl_eval_string
-	 */
-	if (is_trigger)
-		compiled_len += strlen(trig_args);
-	else if (is_event_trigger)
-		compiled_len += strlen(evt_trig_args);
-	else
+	oldcontext = MemoryContextSwitchTo(data->context);
+	entry = pljulia_decoding_relation_entry(relation);
+
+	JL_GC_PUSH4(&args[0], &args[1], &args[2], &args[3]);
+	args[0] = entry->info;
+	args[1] = (jl_value_t *) jl_symbol(action);
+	args[2] = oldtuple == NULL ? jl_nothing :
+		pljulia_decoding_row(entry, RelationGetDescr(relation), oldtuple);
+	args[3] = newtuple == NULL ? jl_nothing :
+		pljulia_decoding_row(entry, RelationGetDescr(relation), newtuple);
+	jl_call(jl_get_function(pljulia_module, "decode_push"), args, 4);
+	JL_GC_POP();
+	if (jl_exception_occurred())
+		show_julia_error();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextReset(data->context);
+
+	if (++data->nchanges >= data->batch_size)
 	{
-		for (i = 0; i < nargs; i++)
-		{
-			/* +1 for the ',' */
-			compiled_len += strlen(argnames[i]) + 1;
-		}
+		data->nchanges = 0;
+		pljulia_decoding_call(ctx, txn, "change");
 	}
-	compiled_len += strlen(code);
-	compiled_code = (char *) palloc0(compiled_len * sizeof(char));
-	compiled_code[0] = '\0';
-	strcpy(compiled_code, "function pljulia_validate_func");
-	strcat(compiled_code, "(");
-	if (is_trigger)
+}
+
+/*
+ * Call the begin, change or commit callback of the output plugin and write
+ * the messages it returns
+ */
+static void
+pljulia_decoding_call(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					  const char *callback)
+{
+	jl_value_t *args[3] = {NULL, NULL, NULL};
+	jl_value_t *output;
+	size_t		n;
+	size_t		i;
+
+	JL_GC_PUSH3(&args[0], &args[1], &args[2]);
+	args[0] = (jl_value_t *) jl_symbol(callback);
+	args[1] = jl_box_uint32(txn->xid);
+	args[2] = jl_box_uint64(txn->final_lsn);
+	output = jl_call(jl_get_function(pljulia_module, "decode_call"), args, 3);
+	JL_GC_POP();
+	if (jl_exception_occurred())
+		show_julia_error();
+
+	n = jl_array_len((jl_array_t *) output);
+	for (i = 0; i < n; i++)
 	{
-		strcat(compiled_code, trig_args);
-		strcat(compiled_code, ")");
+		OutputPluginPrepareWrite(ctx, i == n - 1);
+		appendStringInfoString(ctx->out,
+							   jl_string_ptr(jl_arrayref((jl_array_t *) output, i)));
+		OutputPluginWrite(ctx, i == n - 1);
 	}
-	else if (is_event_trigger)
+}
+
+/*
+ * Return how the rows of a relation are converted, building it if the
+ * relation changed since its last change. Its name and column names are
+ * kept on the Julia side, so that each row only carries its values.
+ */
+static pljulia_decoding_relation *
+pljulia_decoding_relation_entry(Relation relation)
+{
+	pljulia_decoding_relation *entry;
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	Oid			relid = RelationGetRelid(relation);
+	jl_value_t *args[3] = {NULL, NULL, NULL};
+	jl_value_t *info;
+	MemoryContext oldcontext;
+	char	   *name;
+	bool		found;
+	int			i;
+	int			j = 0;
+
+	entry = hash_search(pljulia_decoding_relations, &relid, HASH_ENTER, &found);
+	if (!found)
 	{
-		strcat(compiled_code, evt_trig_args);
-		strcat(compiled_code, ")");
+		entry->valid = false;
+		entry->cxt = NULL;
 	}
+	if (entry->valid && entry->natts == tupdesc->natts)
+		return entry;
+
+	entry->valid = false;
+	if (entry->cxt != NULL)
+		MemoryContextReset(entry->cxt);
 	else
-	{
-		/* now the argument names */
-		for (i = 0; i < nargs; i++)
-		{
-			strcat(compiled_code, argnames[i]);
-			strcat(compiled_code, ",");
-		}
-		/* remove the last ',' if present, close ')' */
-		if (i > 0)
-		{
-			i = strlen(compiled_code) - 1;
-			compiled_code[i] = ')';
-		}
-		else
-			strcat(compiled_code, ")");
-	}
+		entry->cxt = AllocSetContextCreate(TopMemoryContext,
+										   "PL/Julia decoded relation",
+										   ALLOCSET_SMALL_SIZES);
+	oldcontext = MemoryContextSwitchTo(entry->cxt);
+	entry->natts = tupdesc->natts;
+	entry->outfuncs = (FmgrInfo *) palloc0(Max(tupdesc->natts, 1) * sizeof(FmgrInfo));
+	MemoryContextSwitchTo(oldcontext);
 
-	strcat(compiled_code, code);
-	strcat(compiled_code, "\nend");
+	JL_GC_PUSH3(&args[0], &args[1], &args[2]);
+	args[0] = jl_box_uint32(relid);
+	name = quote_qualified_identifier(get_namespace_name(RelationGetNamespace(relation)),
+									  RelationGetRelationName(relation));
+	args[1] = jl_cstr_to_string(name);
+	args[2] = (jl_value_t *) jl_alloc_vec_any(0);
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, i);
+		Oid			typoutput;
+		bool		typisvarlena;
 
-	jl_eval_string(compiled_code);
+		if (att->attisdropped)
+			continue;
+		getTypeOutputInfo(att->atttypid, &typoutput, &typisvarlena);
+		fmgr_info_cxt(typoutput, &entry->outfuncs[i], entry->cxt);
+		jl_array_ptr_1d_push((jl_array_t *) args[2],
+							 jl_cstr_to_string(NameStr(att->attname)));
+		j++;
+	}
+	info = jl_call(jl_get_function(pljulia_module, "decode_relation"), args, 3);
+	JL_GC_POP();
 	if (jl_exception_occurred())
 		show_julia_error();
-	ReleaseSysCache(tuple);
 
-	/* The validator's result is ignored in any case */
-	PG_RETURN_VOID();
+	entry->info = info;
+	entry->ncolumns = j;
+	entry->valid = true;
+	return entry;
+}
+
+/*
+ * Convert a row of a decoded relation to a vector of Julia values. NULLs
+ * and unchanged TOASTed values, which aren't in the WAL, are nothing.
+ */
+static jl_value_t *
+pljulia_decoding_row(pljulia_decoding_relation *entry, TupleDesc tupdesc,
+					 HeapTuple tuple)
+{
+	jl_array_t *values;
+	jl_value_t *value = NULL;
+	Datum	   *datums = (Datum *) palloc(Max(tupdesc->natts, 1) * sizeof(Datum));
+	bool	   *nulls = (bool *) palloc(Max(tupdesc->natts, 1) * sizeof(bool));
+	int			i;
+	int			j = 0;
+
+	heap_deform_tuple(tuple, tupdesc, datums, nulls);
+	values = jl_alloc_vec_any(entry->ncolumns);
+	JL_GC_PUSH2(&values, &value);
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, i);
+
+		if (att->attisdropped)
+			continue;
+		if (nulls[i] ||
+			(att->attlen == -1 &&
+			 VARATT_IS_EXTERNAL_ONDISK(DatumGetPointer(datums[i]))))
+			value = jl_nothing;
+		else if ((value = pg_datum_to_jl_value(datums[i], att->atttypid)) == NULL)
+			value = pg_oid_to_jl_value(att->atttypid,
+									   OutputFunctionCall(&entry->outfuncs[i],
+														  datums[i]));
+		jl_arrayset(values, value, j++);
+	}
+	JL_GC_POP();
+
+	return (jl_value_t *) values;
+}
+
+/*
+ * Relcache callback: the conversions of the relation are built again on its
+ * next change
+ */
+static void
+pljulia_decoding_invalidate(Datum arg, Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	pljulia_decoding_relation *entry;
+
+	hash_seq_init(&status, pljulia_decoding_relations);
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		if (relid == InvalidOid || entry->relid == relid)
+			entry->valid = false;
+	}
 }
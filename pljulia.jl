@@ -0,0 +1,1783 @@
+# pljulia.jl - Julia side of the PL/Julia procedural language
+#
+# This file is loaded into Main by _PG_init. Every pljulia function is
+# compiled into its own anonymous module that imports PLJulia, so the helpers
+# defined here are visible to user code while nothing but this module lives
+# in Main. Redefining or dropping a function only touches its own module.
+
+module PLJulia
+
+import Mmap
+import Serialization
+
+export GD, elog, return_next, return_query, spi_exec, spi_fetchrow,
+       spi_cursor_close, spi_prepare, spi_exec_prepared, spi_exec_columns,
+       spi_cursor, spi_exec_rows, spi_freetuptable, spi_exec_prepared_many,
+       spi_copy_in, spi_copy_out, spi_freeplan, pg_call, table_scan,
+       index_lookup, lo_open, shared_array, publish_array, SD, sd_get, sd_cas,
+       SessionCache, session_cache, cache_get!, cache_set!
+
+# Global data shared between all functions of the session
+const GD = Dict()
+
+# Installed packages, imported into every function module
+const packages = Symbol[]
+
+# Function modules, with the internal (OID based) name of their function.
+# Each is kept until the C code frees the function compiled in it, so that
+# a redefined function still running keeps its module.
+const modules = IdDict{Module,String}()
+
+# Helpers used by the C code to convert composite types to dictionaries
+function dict_set(key, val, dict)
+    dict[key] = val
+end
+
+function dict_get(key, dict)
+    if haskey(dict, key)
+        return dict[key]
+    else
+        return nothing
+    end
+end
+
+init_nulls_anyarray(dims) = Array{Any}(nothing, dims)
+parse_bigfloat(arg) = parse(BigFloat, arg)
+
+# Database access
+return_next(arg) = ccall(:pljulia_return_next, Cvoid, (Any,), arg)
+
+"""
+    return_query(query, args...)
+
+Append the rows of `query` to the result of a set-returning function, like
+RETURN QUERY in PL/pgSQL, and return the number of rows appended. Arguments
+are bound to the parameters `\$1`, `\$2`, ... as with `spi_exec`. Rows go
+straight from the query to the function result without being converted to
+Julia values; their columns must match the result type.
+"""
+return_query(query, args...) =
+    ccall(:pljulia_return_query, Any, (Any, Any),
+          query, Any[bind_value(arg) for arg in args])
+
+elog(level, message) = ccall(:pljulia_elog, Cvoid, (Any, Any), level, message)
+spi_fetchrow(cursor) = ccall(:pljulia_spi_fetchrow, Any, (Any,), cursor)
+spi_cursor_close(cursor) = ccall(:pljulia_spi_cursor_close, Cvoid, (Any,), cursor)
+spi_prepare(query, argtypes) =
+    ccall(:pljulia_spi_prepare, Any, (Any, Any), query, argtypes)
+"""
+    pg_call(signature, args...)
+
+Call the SQL function with the given signature, such as
+`"power(float8,float8)"`, directly through the function manager, without
+planning a query. The function is resolved on its first call. `nothing`
+is NULL, in arguments as in the result.
+"""
+pg_call(signature, args...) =
+    ccall(:pljulia_pg_call, Any, (Any, Any), string(signature), Any[args...])
+
+spi_freeplan(plan) = ccall(:pljulia_spi_freeplan, Cvoid, (Any,), plan)
+spi_exec_prepared(plan, args, limit) =
+    ccall(:pljulia_spi_execplan, Any, (Any, Any, Any), plan, args, limit)
+
+"""
+    spi_exec_prepared_many(plan, data)
+
+Execute a plan saved by `spi_prepare` once for every row of `data`, in a
+single round trip, and return the total number of rows processed. `data`
+is a NamedTuple or Tuple of column vectors (one per parameter), a matrix
+with one row per execution, or a vector of rows.
+"""
+function spi_exec_prepared_many(plan, data)
+    columns = param_columns(data)
+    nrows = isempty(columns) ? 0 : length(columns[1])
+    if any(column -> length(column) != nrows, columns)
+        throw(ArgumentError("all columns must have the same length"))
+    end
+    return ccall(:pljulia_spi_execplan_many, Any, (Any, Any, Any),
+                 plan, columns, Int64(nrows))
+end
+
+# Normalize the arguments of spi_exec_prepared_many to a vector of columns
+param_columns(data::Union{NamedTuple,Tuple}) =
+    Any[column isa Vector ? column : collect(column) for column in data]
+param_columns(data::AbstractMatrix) = Any[data[:, j] for j in axes(data, 2)]
+param_columns(rows::AbstractVector) =
+    isempty(rows) ? Any[] : Any[[row[j] for row in rows] for j in 1:length(first(rows))]
+
+"""
+    spi_copy_in(table, columns, data)
+    spi_copy_in(table, data)
+
+Load rows into `table` with COPY FROM and return the number of rows loaded.
+`columns` names the target columns, all the columns of the table by default
+(or the keys of a NamedTuple `data`). `data` is a NamedTuple or Tuple of
+column vectors, a matrix, or any iterable of rows; `nothing` and `missing`
+are NULLs. Rows are streamed to COPY in chunks, in binary format when all
+the target columns are of boolean, integer, floating point or text types.
+"""
+spi_copy_in(table, columns, data) =
+    ccall(:pljulia_copy_in, Any, (Any, Any, Any), table,
+          String[string(column) for column in columns], CopySource(copy_rows(data)))
+spi_copy_in(table, data::NamedTuple) = spi_copy_in(table, keys(data), data)
+spi_copy_in(table, data) = spi_copy_in(table, String[], data)
+
+"""
+    spi_copy_out(query, io::IO; format = :binary, header = false)
+
+Run `query` and write its result to `io` as COPY data, in PostgreSQL's
+binary COPY format or as CSV (with a header line if `header` is true), and
+return the number of rows written. Rows go from the executor to `io` in
+chunks, so memory use does not depend on the size of the result.
+"""
+function spi_copy_out(query, io::IO; format::Symbol = :binary, header::Bool = false)
+    format in (:binary, :csv) ||
+        throw(ArgumentError("spi_copy_out: format must be :binary or :csv"))
+    return ccall(:pljulia_copy_out, Any, (Any, Any, Any, Any),
+                 query, io, format === :binary, header)
+end
+
+copy_rows(data::Union{NamedTuple,Tuple}) = zip(data...)
+copy_rows(data::AbstractMatrix) = (Tuple(row) for row in eachrow(data))
+copy_rows(data) = data
+
+# The rows of spi_copy_in, serialized to COPY data by copy_next_chunk
+mutable struct CopySource
+    rows::Any
+    next::Any
+    started::Bool
+    done::Bool
+    binary::Bool
+    types::Vector{UInt32}
+    buffer::IOBuffer
+    chunk::Vector{UInt8}
+end
+
+CopySource(rows) = CopySource(rows, nothing, false, false, false, UInt32[],
+                              IOBuffer(), UInt8[])
+
+const copy_chunk_size = 65536
+
+# Type OIDs of the columns COPY data is written for in binary format
+const BOOLOID = UInt32(16)
+const INT8OID = UInt32(20)
+const INT2OID = UInt32(21)
+const INT4OID = UInt32(23)
+const FLOAT4OID = UInt32(700)
+const FLOAT8OID = UInt32(701)
+
+# Called by the C code with the format and the types of the target columns
+function copy_begin(source::CopySource, binary, types)
+    source.binary = binary
+    source.types = UInt32.(types)
+    return nothing
+end
+
+# The next chunk of COPY data, empty at the end of the data
+function copy_next_chunk(source::CopySource)
+    buffer = source.buffer
+    if !source.started
+        source.started = true
+        if source.binary
+            write(buffer, b"PGCOPY\n\xff\r\n\0", hton(Int32(0)), hton(Int32(0)))
+        end
+        source.next = iterate(source.rows)
+    end
+    while source.next !== nothing && position(buffer) < copy_chunk_size
+        row, state = source.next
+        if length(row) != length(source.types)
+            throw(ArgumentError("spi_copy_in: rows must have $(length(source.types)) values"))
+        end
+        if source.binary
+            write_binary_row(buffer, row, source.types)
+        else
+            write_text_row(buffer, row)
+        end
+        source.next = iterate(source.rows, state)
+    end
+    if source.next === nothing && !source.done
+        source.binary && write(buffer, hton(Int16(-1)))
+        source.done = true
+    end
+    source.chunk = take!(buffer)
+    return source.chunk
+end
+
+isnull(value) = value === nothing || value === missing
+
+function write_binary_row(io, row, types)
+    write(io, hton(Int16(length(types))))
+    for (j, type) in enumerate(types)
+        value = row[j]
+        if isnull(value)
+            write(io, hton(Int32(-1)))
+        elseif type == BOOLOID
+            write(io, hton(Int32(1)), UInt8(Bool(value)))
+        elseif type == INT2OID
+            write(io, hton(Int32(2)), hton(Int16(value)))
+        elseif type == INT4OID
+            write(io, hton(Int32(4)), hton(Int32(value)))
+        elseif type == INT8OID
+            write(io, hton(Int32(8)), hton(Int64(value)))
+        elseif type == FLOAT4OID
+            write(io, hton(Int32(4)), hton(reinterpret(UInt32, Float32(value))))
+        elseif type == FLOAT8OID
+            write(io, hton(Int32(8)), hton(reinterpret(UInt64, Float64(value))))
+        else
+            str = string(value)
+            write(io, hton(Int32(sizeof(str))), str)
+        end
+    end
+end
+
+function write_text_row(io, row)
+    for j in 1:length(row)
+        j > 1 && write(io, '\t')
+        value = row[j]
+        if isnull(value)
+            write(io, "\\N")
+        elseif value isa Bool
+            write(io, value ? 't' : 'f')
+        else
+            for c in string(value)
+                if c == '\\'
+                    write(io, "\\\\")
+                elseif c == '\t'
+                    write(io, "\\t")
+                elseif c == '\n'
+                    write(io, "\\n")
+                elseif c == '\r'
+                    write(io, "\\r")
+                else
+                    write(io, c)
+                end
+            end
+        end
+    end
+    write(io, '\n')
+end
+
+"""
+    Cursor
+
+Iterator over the rows of a query, fetched `fetch_size` rows at a time into
+a local buffer. The cursor is closed once all rows have been fetched; a
+cursor that isn't read to the end has to be closed with `spi_cursor_close`.
+"""
+mutable struct Cursor
+    name::String
+    fetch_size::Int
+    buffer::Vector{Any}
+    next::Int
+    done::Bool
+end
+
+Cursor(name, fetch_size) =
+    Cursor(name, fetch_size > 0 ? fetch_size : ccall(:pljulia_cursor_fetch_size, Cint, ()),
+           Any[], 1, false)
+
+"""
+    spi_cursor(query; fetch_size = 0)
+    spi_cursor(plan, args; fetch_size = 0)
+
+Open a cursor for a query, or for a plan saved by `spi_prepare` and its
+arguments. Rows are fetched `fetch_size` at a time, `pljulia.cursor_fetch_size`
+when it is zero.
+"""
+spi_cursor(query; fetch_size = 0) = Cursor(spi_exec(query), fetch_size)
+spi_cursor(plan, args; fetch_size = 0) =
+    Cursor(ccall(:pljulia_spi_cursor_open_plan, Any, (Any, Any), plan, args),
+           fetch_size)
+spi_exec_prepared(plan, args) = spi_cursor(plan, args)
+
+function Base.iterate(c::Cursor, state = nothing)
+    if c.next > length(c.buffer)
+        c.done && return nothing
+        c.buffer = ccall(:pljulia_spi_fetch, Any, (Any, Any), c.name, Int64(c.fetch_size))
+        c.next = 1
+        # the C code closes the cursor after a short fetch
+        c.done = length(c.buffer) < c.fetch_size
+        isempty(c.buffer) && return nothing
+    end
+    row = c.buffer[c.next]
+    c.next += 1
+    return (row, nothing)
+end
+
+Base.IteratorSize(::Type{Cursor}) = Base.SizeUnknown()
+
+function spi_fetchrow(c::Cursor)
+    next = iterate(c)
+    return next === nothing ? nothing : next[1]
+end
+
+function spi_cursor_close(c::Cursor)
+    if !c.done
+        spi_cursor_close(c.name)
+        c.done = true
+    end
+    empty!(c.buffer)
+    return nothing
+end
+
+"""
+    TableScan
+
+Iterator over the rows of a table in batches, see `table_scan`.
+"""
+mutable struct TableScan
+    handle::Ptr{Cvoid}
+    generation::UInt64
+    names::Vector{Any}
+    batch::Int
+    done::Bool
+end
+
+"""
+    table_scan(relation; columns = String[], batch = 10000)
+
+Iterate over the rows of a table or materialized view, read straight from
+the table with the snapshot of the current query rather than through the
+executor, `batch` rows at a time. Each batch is a NamedTuple of column
+vectors like the result of `spi_exec_columns`, holding only the requested
+`columns` (all of them by default). The SELECT privilege is required and
+tables with row level security are refused. The scan is closed once
+exhausted, by `close`, or at the end of the transaction.
+"""
+function table_scan(relation; columns = String[], batch::Integer = 10000)
+    batch > 0 || throw(ArgumentError("table_scan: batch must be positive"))
+    handle, generation, names =
+        ccall(:pljulia_table_scan_open, Any, (Any, Any), string(relation),
+              String[string(column) for column in columns])
+    return TableScan(handle, generation, names, batch, false)
+end
+
+function Base.iterate(scan::TableScan, state = nothing)
+    scan.done && return nothing
+    columns, valid, done =
+        ccall(:pljulia_table_scan_fetch, Any, (Ptr{Cvoid}, UInt64, Int64),
+              scan.handle, scan.generation, Int64(scan.batch))
+    # the C code closes the scan once the table is exhausted
+    scan.done = done
+    done && !isempty(columns) && isempty(columns[1]) && return nothing
+    return (column_table(scan.names, columns, valid), nothing)
+end
+
+Base.IteratorSize(::Type{TableScan}) = Base.SizeUnknown()
+
+function Base.close(scan::TableScan)
+    if !scan.done
+        scan.done = true
+        ccall(:pljulia_table_scan_close, Cvoid, (Ptr{Cvoid}, UInt64),
+              scan.handle, scan.generation)
+    end
+    return nothing
+end
+
+"""
+    index_lookup(index, keys...; columns = String[])
+
+Return the rows of a table whose btree `index` keys are equal to `keys`, the
+values of its first key columns, as a NamedTuple of column vectors like the
+result of `spi_exec_columns`. The lookup goes through the index directly,
+without a query; the index and scan keys are resolved once per index and
+list of `columns` and reused until the table or index changes. A `nothing`
+key matches no rows.
+"""
+index_lookup(index, keys...; columns = String[]) =
+    column_table(ccall(:pljulia_index_lookup, Any, (Any, Any, Any), string(index),
+                       Any[keys...], String[string(column) for column in columns])...)
+
+"""
+    LargeObject
+
+A large object opened by `lo_open`, an `IO` reading and writing through
+buffers of `lo_buffer_size` bytes, so that it can be streamed with constant
+memory.
+"""
+mutable struct LargeObject <: IO
+    fd::Int32
+    serial::UInt64          # of the open, see pljulia_lo_handle
+    writable::Bool
+    open::Bool
+    rbuf::Vector{UInt8}     # read ahead, rbuf[rpos:rlen] not consumed yet
+    rpos::Int
+    rlen::Int
+    wbuf::Vector{UInt8}     # written, wbuf[1:wlen] not sent yet
+    wlen::Int
+end
+
+const lo_buffer_size = 256 * 1024
+
+# whence of pljulia_lo_seek
+const LO_SEEK_SET = Int32(0)
+const LO_SEEK_CUR = Int32(1)
+const LO_SEEK_END = Int32(2)
+
+"""
+    lo_open(loid; write = false)
+    lo_open(f, loid; write = false)
+
+Open the large object `loid` for reading or, with `write`, for reading and
+writing, as a `LargeObject`. The privileges of the lo_* SQL functions are
+checked. The large object is closed by `close`, after `f` with the second
+form, at the end of the transaction or when the subtransaction that opened
+it aborts; what was written is only sent to the database by `flush`, `seek`
+or `close`.
+"""
+function lo_open(loid::Integer; write::Bool = false)
+    fd, serial = ccall(:pljulia_lo_open, Any, (UInt32, Int32), loid, write)
+    return LargeObject(fd, serial, write, true, UInt8[], 1, 0, UInt8[], 0)
+end
+
+function lo_open(f::Function, loid::Integer; write::Bool = false)
+    lo = lo_open(loid; write = write)
+    try
+        return f(lo)
+    finally
+        close(lo)
+    end
+end
+
+lo_check(lo) = lo.open || throw(ArgumentError("large object is closed"))
+
+lo_seek(lo, offset, whence) =
+    ccall(:pljulia_lo_seek, Int64, (Int32, UInt64, Int64, Int32),
+          lo.fd, lo.serial, offset, whence)
+
+function lo_send(lo)
+    if lo.wlen > 0
+        n = ccall(:pljulia_lo_write, Int64, (Int32, UInt64, Ptr{UInt8}, Int64),
+                  lo.fd, lo.serial, lo.wbuf, lo.wlen)
+        n == lo.wlen ||
+            error("could not write to large object: $n of $(lo.wlen) bytes written")
+        lo.wlen = 0
+    end
+    return nothing
+end
+
+# Forget what was read ahead, moving the large object back to the position
+# of the stream
+function lo_unread(lo)
+    ahead = bytesavailable(lo)
+    ahead > 0 && lo_seek(lo, -ahead, LO_SEEK_CUR)
+    lo.rpos, lo.rlen = 1, 0
+    return nothing
+end
+
+function lo_fill(lo)
+    lo_send(lo)
+    length(lo.rbuf) < lo_buffer_size && resize!(lo.rbuf, lo_buffer_size)
+    n = ccall(:pljulia_lo_read, Int64, (Int32, UInt64, Ptr{UInt8}, Int64),
+              lo.fd, lo.serial, lo.rbuf, lo_buffer_size)
+    lo.rpos, lo.rlen = 1, n
+    return n > 0
+end
+
+# Read up to n bytes to p, through the buffer but straight from the large
+# object for large reads, and return how many were read
+function lo_read(lo, p::Ptr{UInt8}, n::Int)
+    lo_check(lo)
+    nread = 0
+    while nread < n
+        if bytesavailable(lo) == 0
+            if n - nread >= lo_buffer_size
+                lo_send(lo)
+                m = ccall(:pljulia_lo_read, Int64, (Int32, UInt64, Ptr{UInt8}, Int64),
+                          lo.fd, lo.serial, p + nread, n - nread)
+                m == 0 && break
+                nread += m
+                continue
+            end
+            lo_fill(lo) || break
+        end
+        m = min(n - nread, bytesavailable(lo))
+        buf = lo.rbuf
+        GC.@preserve buf unsafe_copyto!(p + nread, pointer(buf, lo.rpos), m)
+        lo.rpos += m
+        nread += m
+    end
+    return nread
+end
+
+function lo_writable(lo)
+    lo_check(lo)
+    lo.writable || throw(ArgumentError("large object not opened for writing"))
+    lo_unread(lo)
+    length(lo.wbuf) < lo_buffer_size && resize!(lo.wbuf, lo_buffer_size)
+    return nothing
+end
+
+Base.isopen(lo::LargeObject) = lo.open
+Base.isreadable(lo::LargeObject) = lo.open
+Base.iswritable(lo::LargeObject) = lo.open && lo.writable
+Base.bytesavailable(lo::LargeObject) = lo.rlen - lo.rpos + 1
+
+function Base.eof(lo::LargeObject)
+    lo_check(lo)
+    return bytesavailable(lo) == 0 && !lo_fill(lo)
+end
+
+function Base.read(lo::LargeObject, ::Type{UInt8})
+    eof(lo) && throw(EOFError())
+    lo.rpos += 1
+    return lo.rbuf[lo.rpos - 1]
+end
+
+function Base.unsafe_read(lo::LargeObject, p::Ptr{UInt8}, n::UInt)
+    lo_read(lo, p, Int(n)) < n && throw(EOFError())
+    return nothing
+end
+
+function Base.readbytes!(lo::LargeObject, b::Vector{UInt8}, nb::Integer = length(b))
+    lb = length(b)
+    nread = 0
+    while nread < nb
+        if nread == length(b)
+            resize!(b, min(max(2 * length(b), lo_buffer_size), nb))
+        end
+        n = min(length(b), nb) - nread
+        m = GC.@preserve b lo_read(lo, pointer(b, nread + 1), n)
+        nread += m
+        m < n && break
+    end
+    # only shrink what was grown
+    length(b) > max(lb, nread) && resize!(b, max(lb, nread))
+    return nread
+end
+
+function Base.unsafe_write(lo::LargeObject, p::Ptr{UInt8}, n::UInt)
+    lo_writable(lo)
+    n = Int(n)
+    if lo.wlen + n > lo_buffer_size
+        lo_send(lo)
+        if n >= lo_buffer_size
+            return ccall(:pljulia_lo_write, Int64, (Int32, UInt64, Ptr{UInt8}, Int64),
+                         lo.fd, lo.serial, p, n)
+        end
+    end
+    buf = lo.wbuf
+    GC.@preserve buf unsafe_copyto!(pointer(buf, lo.wlen + 1), p, n)
+    lo.wlen += n
+    return n
+end
+
+function Base.write(lo::LargeObject, b::UInt8)
+    lo_writable(lo)
+    lo.wlen == lo_buffer_size && lo_send(lo)
+    lo.wbuf[lo.wlen += 1] = b
+    return 1
+end
+
+function Base.flush(lo::LargeObject)
+    lo_check(lo)
+    lo_send(lo)
+    return nothing
+end
+
+function Base.position(lo::LargeObject)
+    lo_check(lo)
+    return lo_seek(lo, 0, LO_SEEK_CUR) - bytesavailable(lo) + lo.wlen
+end
+
+function Base.seek(lo::LargeObject, pos::Integer)
+    lo_check(lo)
+    lo_send(lo)
+    lo.rpos, lo.rlen = 1, 0
+    lo_seek(lo, pos, LO_SEEK_SET)
+    return lo
+end
+
+function Base.seekend(lo::LargeObject)
+    lo_check(lo)
+    lo_send(lo)
+    lo.rpos, lo.rlen = 1, 0
+    lo_seek(lo, 0, LO_SEEK_END)
+    return lo
+end
+
+function Base.skip(lo::LargeObject, n::Integer)
+    lo_check(lo)
+    if 0 <= n <= bytesavailable(lo)
+        lo.rpos += n
+    else
+        lo_send(lo)
+        lo_seek(lo, n - bytesavailable(lo), LO_SEEK_CUR)
+        lo.rpos, lo.rlen = 1, 0
+    end
+    return lo
+end
+
+function Base.close(lo::LargeObject)
+    if lo.open
+        lo_send(lo)
+        lo.open = false
+        ccall(:pljulia_lo_close, Cvoid, (Int32, UInt64), lo.fd, lo.serial)
+    end
+    return nothing
+end
+
+# Files of shared arrays: a 64 byte header holding shared_magic, the index
+# of the element type in shared_types, the number of dimensions and up to
+# 6 dimensions, then the elements in column-major order
+const shared_magic = b"PLJARRAY"
+const shared_types = (Bool, Int8, Int16, Int32, Int64, UInt8, UInt16, UInt32,
+                      UInt64, Float32, Float64)
+const shared_header_size = 64
+
+"""
+    SharedArray
+
+A read-only array mapped from a file published by `publish_array` or
+`pljulia_publish_array`, see `shared_array`.
+"""
+struct SharedArray{T,N} <: DenseArray{T,N}
+    data::Array{T,N}
+    name::String
+end
+
+Base.size(A::SharedArray) = size(A.data)
+Base.IndexStyle(::Type{<:SharedArray}) = IndexLinear()
+Base.getindex(A::SharedArray, i::Int) = A.data[i]
+Base.setindex!(A::SharedArray, v, i::Int) =
+    throw(ArgumentError("shared array \"$(A.name)\" is read-only"))
+Base.strides(A::SharedArray) = strides(A.data)
+Base.elsize(::Type{SharedArray{T,N}}) where {T,N} = sizeof(T)
+Base.unsafe_convert(::Type{Ptr{T}}, A::SharedArray{T}) where {T} =
+    Base.unsafe_convert(Ptr{T}, A.data)
+
+# The shared arrays mapped in this session, with the identity of their file
+const shared_arrays = Dict{String,Tuple{Any,SharedArray}}()
+
+"""
+    shared_array(name)
+
+Return the array published as `name`, mapped read-only from its file in the
+data directory. The pages of the file are shared by all the backends using
+the array, through the page cache, instead of each loading its own copy.
+The mapping is reused until the array is published again, and arrays
+returned before then keep their old contents.
+"""
+function shared_array(name)
+    name = string(name)
+    path = ccall(:pljulia_shared_path, Any, (Any, Int32), name, false)
+    isfile(path) || throw(ArgumentError("shared array \"$name\" does not exist"))
+    return open(path) do io
+        st = stat(io)
+        key = (st.device, st.inode, st.mtime, st.size)
+        cached = get(shared_arrays, name, nothing)
+        cached !== nothing && cached[1] == key && return cached[2]
+
+        invalid() = throw(ArgumentError("\"$path\" is not a shared array file"))
+        st.size >= shared_header_size && read(io, 8) == shared_magic || invalid()
+        code = read(io, Int32)
+        n = read(io, Int32)
+        dims = [read(io, Int64) for _ in 1:6]
+        (1 <= code <= length(shared_types) && 0 <= n <= 6) || invalid()
+        T = shared_types[code]
+        dims = Tuple(dims[1:n])
+        shared_header_size + sizeof(T) * prod(dims) == st.size || invalid()
+        A = SharedArray(Mmap.mmap(io, Array{T,n}, dims, shared_header_size), name)
+        shared_arrays[name] = (key, A)
+        return A
+    end
+end
+
+"""
+    publish_array(name, A)
+
+Write an array of booleans, integers or floats with up to 6 dimensions to
+the file of the shared array `name`, atomically replacing it for the
+following `shared_array` calls.
+"""
+function publish_array(name, A::AbstractArray)
+    name = string(name)
+    T = eltype(A)
+    code = findfirst(==(T), shared_types)
+    code === nothing && throw(ArgumentError("publish_array: arrays of $T can't be shared"))
+    ndims(A) <= 6 || throw(ArgumentError("publish_array: arrays can't have more than 6 dimensions"))
+    path = ccall(:pljulia_shared_path, Any, (Any, Int32), name, true)
+    tmppath = "$path.$(getpid()).tmp"
+    try
+        open(tmppath, "w") do io
+            write(io, shared_magic, Int32(code), Int32(ndims(A)))
+            for i in 1:6
+                write(io, Int64(i <= ndims(A) ? size(A, i) : 0))
+            end
+            write(io, A isa Array ? A : collect(A))
+        end
+    catch
+        rm(tmppath; force = true)
+        rethrow()
+    end
+    ccall(:pljulia_shared_rename, Cvoid, (Any, Any), tmppath, path)
+    return nothing
+end
+
+# Publish the elements of a PostgreSQL array given in row-major order, so
+# that A[i, j] is array[i][j]
+function publish_pg_array(name, data, dims)
+    A = length(dims) <= 1 ? data :
+        permutedims(reshape(data, reverse(dims)...), length(dims):-1:1)
+    return publish_array(name, A)
+end
+
+"""
+    SharedData
+
+The type of `SD`.
+"""
+struct SharedData end
+
+"""
+    SD
+
+Data shared by all the sessions of the cluster until the server restarts,
+kept in dynamic shared memory. Keys are strings of up to 127 bytes. Values
+are copied in and out: arrays of booleans, integers and floats as their
+elements, other values serialized, so they must be of types every session
+can load, not types defined by function bodies.
+
+`SD[key]`, `SD[key] = value`, `get`, `haskey` and `delete!` work as with
+`GD`, and `get!(f, SD, key)` stores a value once for the whole cluster:
+sessions that find no value each call `f`, and all of them return the
+first value stored. `sd_get` and `sd_cas` update a value without
+overwriting the update of another session. When the values, along with
+their keys and entries, take more than `pljulia.shared_data_size` the least
+recently used ones are evicted, so a value put may later be gone.
+"""
+const SD = SharedData()
+
+# Values in SD: a tag, then either the index of the element type of an
+# array in shared_types, its number of dimensions, its dimensions and its
+# elements, or a serialized value
+const SD_SERIALIZED = 0x00
+const SD_ARRAY = 0x01
+
+function sd_encode(value)
+    io = IOBuffer()
+    code = value isa Array ? findfirst(==(eltype(value)), shared_types) : nothing
+    if code === nothing
+        write(io, SD_SERIALIZED)
+        Serialization.serialize(io, value)
+    else
+        write(io, SD_ARRAY, Int32(code), Int32(ndims(value)))
+        foreach(d -> write(io, Int64(d)), size(value))
+        write(io, value)
+    end
+    return take!(io)
+end
+
+function sd_decode(bytes)
+    io = IOBuffer(bytes)
+    read(io, UInt8) == SD_SERIALIZED && return Serialization.deserialize(io)
+    T = shared_types[read(io, Int32)]
+    n = Int(read(io, Int32))
+    dims = ntuple(_ -> Int(read(io, Int64)), n)
+    return read!(io, Array{T}(undef, dims))
+end
+
+"""
+    sd_get(key)
+
+Return the value of `key` in `SD` and its version, or `nothing` if it has
+none.
+"""
+function sd_get(key)
+    found = ccall(:pljulia_sd_get, Any, (Any, Int32), string(key), true)
+    found === nothing && return nothing
+    bytes, version = found
+    return sd_decode(bytes), version
+end
+
+"""
+    sd_cas(key, version, value)
+
+Store `value` as `key` in `SD` only if the version of `key` is still
+`version`, as returned by `sd_get`, or if `key` has no value and `version`
+is 0. Returns the new version, or `nothing` if `key` changed meanwhile.
+"""
+function sd_cas(key, version::Integer, value)
+    version = ccall(:pljulia_sd_put, UInt64, (Any, Any, UInt64, Int32),
+                    string(key), sd_encode(value), version, true)
+    return version == 0 ? nothing : version
+end
+
+function Base.getindex(::SharedData, key)
+    found = sd_get(key)
+    found === nothing && throw(KeyError(key))
+    return found[1]
+end
+
+function Base.get(::SharedData, key, default)
+    found = sd_get(key)
+    return found === nothing ? default : found[1]
+end
+
+function Base.setindex!(sd::SharedData, value, key)
+    ccall(:pljulia_sd_put, UInt64, (Any, Any, UInt64, Int32),
+          string(key), sd_encode(value), 0, false)
+    return sd
+end
+
+Base.haskey(::SharedData, key) =
+    ccall(:pljulia_sd_get, Any, (Any, Int32), string(key), false) !== nothing
+
+function Base.delete!(sd::SharedData, key)
+    ccall(:pljulia_sd_delete, Int32, (Any,), string(key))
+    return sd
+end
+
+# The value of the session that stored it first wins
+function Base.get!(f::Function, ::SharedData, key)
+    found = sd_get(key)
+    found === nothing || return found[1]
+    value = f()
+    sd_cas(key, 0, value) === nothing || return value
+    return get(SD, key, value)
+end
+
+# An entry of a SessionCache, in its list from the most to the least
+# recently used
+mutable struct CacheNode{K,V}
+    key::K
+    value::V
+    bytes::Int
+    expires::Float64                    # time() after which it is stale
+    prev::Union{CacheNode{K,V},Nothing}
+    next::Union{CacheNode{K,V},Nothing}
+end
+
+"""
+    SessionCache{K,V}(; maxentries = 0, maxbytes = 0, ttl = Inf, transactional = true)
+
+A cache of values of type `V` by keys of type `K`, filled by `cache_get!`.
+It keeps at most `maxentries` entries taking at most `maxbytes` bytes, as
+measured by `Base.summarysize`, 0 meaning no limit, and evicts the least
+recently used first. Entries older than `ttl` seconds are computed again.
+Unless `transactional` is false, the entries written by a transaction, or
+subtransaction, that aborts are removed.
+
+Caches that last for the session are created by `session_cache`, and
+`cache_get!(f, key)` uses a cache shared by all functions.
+"""
+mutable struct SessionCache{K,V}
+    nodes::Dict{K,CacheNode{K,V}}
+    head::Union{CacheNode{K,V},Nothing}
+    tail::Union{CacheNode{K,V},Nothing}
+    bytes::Int
+    maxentries::Int
+    maxbytes::Int
+    ttl::Float64
+    transactional::Bool
+end
+
+function SessionCache{K,V}(; maxentries::Integer = 0, maxbytes::Integer = 0,
+                           ttl::Real = Inf, transactional::Bool = true) where {K,V}
+    return SessionCache{K,V}(Dict{K,CacheNode{K,V}}(), nothing, nothing, 0,
+                             maxentries, maxbytes, ttl, transactional)
+end
+
+# The cache of cache_get!(f, key), bounded by pljulia.session_cache_size
+const default_cache = SessionCache{Any,Any}()
+
+# The caches returned by session_cache, by name
+const session_caches = Dict{Symbol,SessionCache}()
+
+"""
+    session_cache(name, K, V; maxentries = 0, maxbytes = 0, ttl = Inf, transactional = true)
+
+Return the `SessionCache{K,V}` named `name`, created with the given limits
+by the first call. It lasts for the session, and is shared by the functions
+using the same name.
+"""
+function session_cache(name::Symbol, ::Type{K}, ::Type{V}; kwargs...) where {K,V}
+    cache = get!(() -> SessionCache{K,V}(; kwargs...), session_caches, name)
+    cache isa SessionCache{K,V} ||
+        throw(ArgumentError("session cache $name is a $(typeof(cache))"))
+    return cache::SessionCache{K,V}
+end
+
+# The entries written by the current transaction to transactional caches,
+# with the subtransaction that wrote them, see cache_rollback
+const cache_log = Tuple{SessionCache,Any,CacheNode,UInt32}[]
+
+cache_maxbytes(cache::SessionCache) = cache === default_cache ?
+    ccall(:pljulia_session_cache_size_bytes, Int64, ()) : cache.maxbytes
+
+function cache_unlink!(cache::SessionCache, node::CacheNode)
+    node.prev === nothing ? (cache.head = node.next) : (node.prev.next = node.next)
+    node.next === nothing ? (cache.tail = node.prev) : (node.next.prev = node.prev)
+    node.prev = node.next = nothing
+    return node
+end
+
+function cache_push!(cache::SessionCache, node::CacheNode)
+    node.next = cache.head
+    cache.head === nothing ? (cache.tail = node) : (cache.head.prev = node)
+    cache.head = node
+    return node
+end
+
+function cache_remove!(cache::SessionCache, node::CacheNode)
+    cache_unlink!(cache, node)
+    delete!(cache.nodes, node.key)
+    cache.bytes -= node.bytes
+    return nothing
+end
+
+"""
+    cache_set!(cache, key, value; ttl = cache.ttl)
+
+Store `value` as `key` in a `SessionCache`, evicting the least recently
+used entries beyond its limits. A value larger than the whole cache isn't
+stored. Returns `value`.
+"""
+function cache_set!(cache::SessionCache{K,V}, key, value;
+                    ttl::Real = cache.ttl) where {K,V}
+    key = convert(K, key)
+    value = convert(V, value)
+    old = get(cache.nodes, key, nothing)
+    old === nothing || cache_remove!(cache, old)
+    maxbytes = cache_maxbytes(cache)
+    bytes = maxbytes > 0 ? Base.summarysize(key) + Base.summarysize(value) : 0
+    maxbytes > 0 && bytes > maxbytes && return value
+
+    node = CacheNode{K,V}(key, value, bytes, time() + ttl, nothing, nothing)
+    cache.nodes[key] = cache_push!(cache, node)
+    cache.bytes += bytes
+    while cache.tail !== node &&
+          ((cache.maxentries > 0 && length(cache.nodes) > cache.maxentries) ||
+           (maxbytes > 0 && cache.bytes > maxbytes))
+        cache_remove!(cache, cache.tail)
+    end
+    if cache.transactional
+        push!(cache_log, (cache, key, node, ccall(:pljulia_cache_log, UInt32, ())))
+    end
+    return value
+end
+
+"""
+    cache_get!(f, cache, key; ttl = cache.ttl)
+    cache_get!(f, key; ttl = Inf)
+
+Return the value of `key` in a `SessionCache`, or in the cache of the
+session with the second form, calling `f()` to compute and store it when
+the cache has none or it is older than its `ttl`.
+"""
+function cache_get!(f, cache::SessionCache{K,V}, key;
+                    ttl::Real = cache.ttl) where {K,V}
+    node = get(cache.nodes, key, nothing)
+    if node !== nothing
+        if node.expires == Inf || node.expires > time()
+            cache.head === node || cache_push!(cache, cache_unlink!(cache, node))
+            return node.value::V
+        end
+        cache_remove!(cache, node)
+    end
+    return cache_set!(cache, key, f(); ttl = ttl)::V
+end
+
+cache_get!(f, key; ttl::Real = Inf) = cache_get!(f, default_cache, key; ttl = ttl)
+
+Base.length(cache::SessionCache) = length(cache.nodes)
+Base.haskey(cache::SessionCache, key) = haskey(cache.nodes, key)
+
+function Base.get(cache::SessionCache, key, default)
+    node = get(cache.nodes, key, nothing)
+    return node === nothing || node.expires <= time() ? default : node.value
+end
+
+function Base.delete!(cache::SessionCache, key)
+    node = get(cache.nodes, key, nothing)
+    node === nothing || cache_remove!(cache, node)
+    return cache
+end
+
+function Base.empty!(cache::SessionCache)
+    empty!(cache.nodes)
+    cache.head = cache.tail = nothing
+    cache.bytes = 0
+    return cache
+end
+
+# Called by the C code at the end of a transaction: remove the entries
+# written since subtransaction subid started, or forget the log of the
+# transaction when it commits (subid 0)
+function cache_rollback(subid)
+    subid == 0 && return empty!(cache_log)
+    while !isempty(cache_log) && cache_log[end][4] >= subid
+        cache, key, node, _ = pop!(cache_log)
+        get(cache.nodes, key, nothing) === node && cache_remove!(cache, node)
+    end
+    return nothing
+end
+
+"""
+    ForeignScan
+
+A scan of a `pljulia_fdw` foreign table, passed to its scan and estimate
+functions: the name of the table, the options of the table and its server,
+the names of the columns the query needs and the quals of the query that
+compare a column with a value, as `(column, operator, value)` tuples. The
+quals are only hints, the rows returned are checked again.
+"""
+struct ForeignScan
+    table::String
+    options::Dict{String,String}
+    columns::Vector{String}
+    quals::Vector{Tuple{String,String,Any}}
+end
+
+function ForeignScan(table, spec)
+    optnames, optvalues, columns, qualcolumns, qualops, qualvalues = spec
+    return ForeignScan(table, Dict{String,String}(zip(optnames, optvalues)),
+                       String[columns...],
+                       Tuple{String,String,Any}[zip(qualcolumns, qualops, qualvalues)...])
+end
+
+# The foreign scans in progress, with the iterator returned by their scan
+# function and their current batch, kept alive here for the C code
+mutable struct FdwScan
+    scan::ForeignScan
+    batches::Any
+    state::Any
+    started::Bool
+    generation::UInt64
+    batch::Any
+end
+
+const fdw_scans = Dict{Int,FdwScan}()
+const fdw_counter = Ref(0)
+
+function fdw_begin(func, table, spec, generation)
+    # scans cut short by an error are never ended, forget them in the next
+    # transaction
+    filter!(entry -> entry.second.generation == generation, fdw_scans)
+    scan = ForeignScan(table, spec)
+    id = fdw_counter[] += 1
+    fdw_scans[id] = FdwScan(scan, func(scan), nothing, false, generation, nothing)
+    return id
+end
+
+# Return the next non-empty batch of a scan as [nrows, columns...], a vector
+# of values per column of scan.columns, or nothing once the scan is done
+function fdw_next(id)
+    s = fdw_scans[id]
+    next = s.started ? iterate(s.batches, s.state) : iterate(s.batches)
+    s.started = true
+    while next !== nothing
+        batch, s.state = next
+        s.batch = fdw_columns(s.scan.columns, batch)
+        s.batch[1] > 0 && return s.batch
+        next = iterate(s.batches, s.state)
+    end
+    s.batch = nothing
+    return nothing
+end
+
+function fdw_end(id)
+    delete!(fdw_scans, id)
+    return nothing
+end
+
+# A batch is a NamedTuple of column vectors or a vector of rows, each a
+# NamedTuple or a dictionary; missing columns and values are NULLs
+function fdw_columns(names, batch)
+    if batch isa NamedTuple
+        nrows = isempty(batch) ? 0 : length(first(batch))
+        columns = Any[haskey(batch, Symbol(name)) ?
+                      Any[fdw_value(x) for x in batch[Symbol(name)]] : nothing
+                      for name in names]
+        all(c -> c === nothing || length(c) == nrows, columns) ||
+            throw(ArgumentError("pljulia_fdw: the columns of a batch must have the same length"))
+    else
+        nrows = length(batch)
+        columns = Any[Any[fdw_value(fdw_field(row, name)) for row in batch]
+                      for name in names]
+    end
+    return Any[nrows, columns...]
+end
+
+fdw_field(row::NamedTuple, name) = get(row, Symbol(name), nothing)
+fdw_field(row::AbstractDict, name) = get(row, name, get(row, Symbol(name), nothing))
+fdw_value(x) = x === missing ? nothing : x
+
+# Return [rows, cost] for the estimate function of a table, a cost of -1
+# when the function only gives the number of rows
+function fdw_estimate(func, table, spec)
+    estimate = func(ForeignScan(table, spec))
+    rows, cost = estimate isa Tuple ? estimate : (estimate, -1)
+    return Float64[rows, cost]
+end
+
+"""
+    DecodedChange
+
+A change decoded by the `pljulia` output plugin: the qualified name of the
+table, the action (`:insert`, `:update`, `:delete` or `:truncate`) and the
+old and new rows as NamedTuples. The old row of an update or a delete is
+only there when the replica identity of the table logs it, and then only
+has the key columns unless the identity is full. NULLs and unchanged TOASTed
+values are `nothing`.
+"""
+struct DecodedChange
+    relation::String
+    action::Symbol
+    old::Union{NamedTuple,Nothing}
+    new::Union{NamedTuple,Nothing}
+end
+
+"""
+    DecodedTransaction
+
+A transaction decoded by the `pljulia` output plugin, passed to its begin,
+change and commit functions: its ID, the LSN of its commit and, for the
+change function, a batch of its changes.
+"""
+struct DecodedTransaction
+    xid::UInt32
+    lsn::UInt64
+    changes::Vector{DecodedChange}
+end
+
+# The name and columns of a decoded relation, kept alive here for the C code
+mutable struct DecodedRelation
+    name::String
+    columns::Tuple
+end
+
+# The callbacks of the decoding session, the decoded relations by OID and the
+# changes of the current batch
+const decoding_callbacks = Dict{Symbol,Any}()
+const decoding_relations = Dict{UInt32,DecodedRelation}()
+const decoding_changes = DecodedChange[]
+
+function decode_startup(on_begin, on_change, on_commit)
+    decoding_callbacks[:begin] = on_begin
+    decoding_callbacks[:change] = on_change
+    decoding_callbacks[:commit] = on_commit
+    # a batch left by a decoding session cut short by an error
+    empty!(decoding_changes)
+    return nothing
+end
+
+function decode_relation(relid, name, columns)
+    return decoding_relations[relid] =
+        DecodedRelation(name, Tuple(Symbol(column) for column in columns))
+end
+
+function decode_push(relation, action, old, new)
+    push!(decoding_changes, DecodedChange(relation.name, action,
+                                          decode_row(relation, old),
+                                          decode_row(relation, new)))
+    return nothing
+end
+
+decode_row(relation, ::Nothing) = nothing
+decode_row(relation, values) = NamedTuple{relation.columns}(Tuple(values))
+
+# Call a callback, the change one with the current batch, and return the
+# messages to write
+function decode_call(callback, xid, lsn)
+    changes = DecodedChange[]
+    if callback === :change
+        changes = copy(decoding_changes)
+        empty!(decoding_changes)
+    end
+    output = decoding_callbacks[callback](DecodedTransaction(xid, lsn, changes))
+    output === nothing && return String[]
+    output isa AbstractString && return String[output]
+    return String[string(message) for message in output]
+end
+
+# Arrow IPC files read by pljulia_read_arrow. The file is mapped in memory
+# and only its metadata is parsed here: the C code reads the column buffers
+# in place, at the addresses returned by arrow_batch. The kinds of columns
+# are the values of pljulia_arrow_kind in pljulia.c.
+const ARROW_UNSUPPORTED = 0
+const ARROW_NULL = 1
+const ARROW_BOOL = 2
+const ARROW_INT8 = 3
+const ARROW_UINT8 = 7
+const ARROW_FLOAT32 = 11
+const ARROW_FLOAT64 = 12
+const ARROW_UTF8 = 13
+const ARROW_LARGE_UTF8 = 14
+const ARROW_BINARY = 15
+const ARROW_LARGE_BINARY = 16
+const ARROW_DATE32 = 17
+const ARROW_DATE64 = 18
+const ARROW_TIMESTAMP = 19
+
+# A top-level field of an Arrow schema, with the index of its field node and
+# of its first buffer in the record batches
+struct ArrowField
+    name::String
+    kind::Int
+    unit::Int
+    node::Int
+    buffer::Int
+    nbuffers::Int
+end
+
+mutable struct ArrowFile
+    path::String
+    data::Vector{UInt8}
+    fields::Vector{ArrowField}
+    batches::Vector{Tuple{Int,Int}}     # offsets of their message and body
+    columns::Vector{Int}                # the fields read
+end
+
+# Flatbuffers, at 0-based offsets in the file
+function fb_read(data, T, pos)
+    checkbounds(data, pos+1:pos+sizeof(T))
+    return GC.@preserve data unsafe_load(Ptr{T}(pointer(data, pos + 1)))
+end
+
+function fb_field(data, table, i)
+    vtable = table - Int(fb_read(data, Int32, table))
+    4 + 2i < fb_read(data, UInt16, vtable) || return nothing
+    offset = Int(fb_read(data, UInt16, vtable + 4 + 2i))
+    return offset == 0 ? nothing : table + offset
+end
+
+function fb_scalar(data, table, i, T, default)
+    pos = fb_field(data, table, i)
+    return pos === nothing ? default : fb_read(data, T, pos)
+end
+
+function fb_table(data, table, i)
+    pos = fb_field(data, table, i)
+    return pos === nothing ? nothing : pos + Int(fb_read(data, UInt32, pos))
+end
+
+function fb_vector(data, table, i)
+    pos = fb_table(data, table, i)
+    return pos === nothing ? (0, 0) : (pos + 4, Int(fb_read(data, UInt32, pos)))
+end
+
+function fb_tables(data, table, i)
+    start, n = fb_vector(data, table, i)
+    return [start + 4k + Int(fb_read(data, UInt32, start + 4k)) for k in 0:n-1]
+end
+
+function fb_string(data, table, i)
+    start, n = fb_vector(data, table, i)
+    return String(data[start+1:start+n])
+end
+
+# The kind and unit of the type of a field, and how many buffers and field
+# nodes it has in a record batch
+function arrow_type(data, field)
+    typeid = fb_scalar(data, field, 2, UInt8, 0)
+    type = fb_table(data, field, 3)
+    # the batches of a dictionary encoded field hold its indices
+    fb_table(data, field, 4) === nothing || return ARROW_UNSUPPORTED, 0, 2, 1
+    nbuffers, nnodes = 0, 1
+    for child in fb_tables(data, field, 5)
+        _, _, b, n = arrow_type(data, child)
+        nbuffers += b
+        nnodes += n
+    end
+    if typeid == 1
+        return ARROW_NULL, 0, 0, 1
+    elseif typeid == 2
+        bits = fb_scalar(data, type, 0, Int32, 0)
+        signed = fb_scalar(data, type, 1, UInt8, 0) != 0
+        bits in (8, 16, 32, 64) || return ARROW_UNSUPPORTED, 0, 2, 1
+        return (signed ? ARROW_INT8 : ARROW_UINT8) + trailing_zeros(bits) - 3, 0, 2, 1
+    elseif typeid == 3
+        precision = fb_scalar(data, type, 0, Int16, 0)
+        return precision == 1 ? ARROW_FLOAT32 :
+               precision == 2 ? ARROW_FLOAT64 : ARROW_UNSUPPORTED, 0, 2, 1
+    elseif typeid == 6
+        return ARROW_BOOL, 0, 2, 1
+    elseif typeid == 8
+        unit = fb_scalar(data, type, 0, Int16, 1)
+        return unit == 0 ? ARROW_DATE32 : ARROW_DATE64, 0, 2, 1
+    elseif typeid == 10
+        return ARROW_TIMESTAMP, Int(fb_scalar(data, type, 0, Int16, 0)), 2, 1
+    elseif typeid in (4, 5, 19, 20)
+        kind = typeid == 4 ? ARROW_BINARY : typeid == 5 ? ARROW_UTF8 :
+               typeid == 19 ? ARROW_LARGE_BINARY : ARROW_LARGE_UTF8
+        return kind, 0, 3, 1
+    elseif typeid in (7, 9, 11, 15, 18)     # other fixed width types
+        return ARROW_UNSUPPORTED, 0, 2, 1
+    elseif typeid in (12, 17, 21)           # lists and maps
+        return ARROW_UNSUPPORTED, 0, 2 + nbuffers, nnodes
+    elseif typeid in (13, 16)               # structs and fixed size lists
+        return ARROW_UNSUPPORTED, 0, 1 + nbuffers, nnodes
+    elseif typeid == 14                     # unions, without validity bitmap
+        dense = fb_scalar(data, type, 0, Int16, 0) == 1
+        return ARROW_UNSUPPORTED, 0, (dense ? 2 : 1) + nbuffers, nnodes
+    end
+    throw(ArgumentError("pljulia_read_arrow: unsupported Arrow type $typeid"))
+end
+
+# Map an Arrow IPC file in memory and look up the fields `names`. Returns the
+# file, its number of record batches and the kind and unit of each field.
+function arrow_open(path, names)
+    data = Mmap.mmap(path)
+    n = length(data)
+    invalid() = throw(ArgumentError("pljulia_read_arrow: \"$path\" is not an Arrow IPC file"))
+    (n >= 18 && data[1:6] == b"ARROW1" && data[n-5:n] == b"ARROW1") || invalid()
+    footer = n - 10 - Int(fb_read(data, Int32, n - 10))
+    footer >= 8 || invalid()
+    footer += Int(fb_read(data, UInt32, footer))
+    schema = fb_table(data, footer, 1)
+    schema === nothing && invalid()
+    fb_scalar(data, schema, 0, Int16, 0) == 0 ||
+        throw(ArgumentError("pljulia_read_arrow: big-endian Arrow files are not supported"))
+
+    fields = ArrowField[]
+    node = buffer = 0
+    for field in fb_tables(data, schema, 1)
+        kind, unit, nbuffers, nnodes = arrow_type(data, field)
+        push!(fields, ArrowField(fb_string(data, field, 0), kind, unit, node,
+                                 buffer, nbuffers))
+        node += nnodes
+        buffer += nbuffers
+    end
+
+    start, nblocks = fb_vector(data, footer, 3)
+    batches = Tuple{Int,Int}[]
+    for k in 0:nblocks-1
+        offset = Int(fb_read(data, Int64, start + 24k))
+        push!(batches, (offset, offset + Int(fb_read(data, Int32, start + 24k + 8))))
+    end
+
+    columns = Int[]
+    info = Int64[]
+    for name in names
+        i = findfirst(field -> field.name == name, fields)
+        i === nothing &&
+            throw(ArgumentError("pljulia_read_arrow: \"$path\" has no column \"$name\""))
+        push!(columns, i)
+        push!(info, fields[i].kind, fields[i].unit)
+    end
+    return Any[ArrowFile(path, data, fields, batches, columns), length(batches), info]
+end
+
+# The size in bytes of the values of a column of nrows rows, or of their
+# offsets for variable width types
+function arrow_size(kind, nrows)
+    kind == ARROW_BOOL && return cld(nrows, 8)
+    kind in (ARROW_UTF8, ARROW_BINARY) && return 4 * (nrows + 1)
+    kind in (ARROW_LARGE_UTF8, ARROW_LARGE_BINARY) && return 8 * (nrows + 1)
+    kind in (ARROW_FLOAT32, ARROW_DATE32) && return 4 * nrows
+    kind in (ARROW_FLOAT64, ARROW_DATE64, ARROW_TIMESTAMP) && return 8 * nrows
+    return nrows << (kind - (kind >= ARROW_UINT8 ? ARROW_UINT8 : ARROW_INT8))
+end
+
+# Locate the columns read in record batch b, checking that they lie within
+# the file. Returns the number of rows then, for each column, the addresses
+# of its validity bitmap (0 when it has no NULLs), of its values or offsets
+# and of its data, and the length of its data.
+function arrow_batch(file, b)
+    data = file.data
+    invalid() = throw(ArgumentError("pljulia_read_arrow: \"$(file.path)\" is not a valid Arrow IPC file"))
+    pos, body = file.batches[b]
+    0 <= pos <= body <= length(data) || invalid()
+    fb_read(data, UInt32, pos) == 0xffffffff && (pos += 4)
+    message = pos + 4 + Int(fb_read(data, UInt32, pos + 4))
+    fb_scalar(data, message, 1, UInt8, 0) == 3 || invalid()
+    batch = fb_table(data, message, 2)
+    fb_table(data, batch, 3) === nothing ||
+        throw(ArgumentError("pljulia_read_arrow: compressed Arrow files are not supported"))
+    nrows = Int(fb_scalar(data, batch, 0, Int64, 0))
+    nodes, nnodes = fb_vector(data, batch, 1)
+    buffers, nbuffers = fb_vector(data, batch, 2)
+    nrows >= 0 || invalid()
+
+    base = Int(UInt(pointer(data)))
+    result = zeros(Int64, 1 + 4 * length(file.columns))
+    result[1] = nrows
+    for (j, c) in enumerate(file.columns)
+        field = file.fields[c]
+        field.kind == ARROW_NULL && continue
+        (field.node < nnodes && field.buffer + field.nbuffers <= nbuffers) || invalid()
+        fb_read(data, Int64, nodes + 16 * field.node) == nrows || invalid()
+        nulls = fb_read(data, Int64, nodes + 16 * field.node + 8)
+        ranges = map(field.buffer:field.buffer+field.nbuffers-1) do k
+            offset = body + Int(fb_read(data, Int64, buffers + 16k))
+            len = Int(fb_read(data, Int64, buffers + 16k + 8))
+            (len >= 0 && body <= offset <= length(data) - len) || invalid()
+            return offset, len
+        end
+        if nulls > 0
+            ranges[1][2] >= cld(nrows, 8) || invalid()
+            result[4j-2] = base + ranges[1][1]
+        end
+        ranges[2][2] >= arrow_size(field.kind, nrows) || invalid()
+        result[4j-1] = base + ranges[2][1]
+        if field.nbuffers == 3
+            result[4j] = base + ranges[3][1]
+            result[4j+1] = ranges[3][2]
+        end
+    end
+    return result
+end
+
+# Unmap the file at the end of the scan rather than when it is collected
+function arrow_close(file)
+    finalize(file.data)
+    return nothing
+end
+
+# Marks the values of an SPIResult that haven't been decoded yet
+struct Undecoded end
+const undecoded = Undecoded()
+
+"""
+    SPIResult
+
+The rows of a query returned by `spi_exec_rows`. The tuples stay in database
+memory until the result is freed by `spi_freetuptable` or at the end of the
+transaction, and a column of a row is only decoded the first time it is
+accessed. There is no finalizer: it could run in the middle of another call
+into the backend.
+"""
+mutable struct SPIResult <: AbstractVector{Any}
+    handle::Ptr{Cvoid}
+    generation::UInt64
+    names::Vector{Symbol}
+    columns::Dict{Symbol,Int}
+    values::Vector{Union{Nothing,Vector{Any}}}
+end
+
+function SPIResult(handle, generation, names, nrows)
+    names = Symbol.(names)
+    columns = Dict{Symbol,Int}()
+    for (j, name) in enumerate(names)
+        get!(columns, name, j)
+    end
+    return SPIResult(handle, generation, names, columns,
+                     Vector{Union{Nothing,Vector{Any}}}(nothing, nrows))
+end
+
+"""
+    SPIRow
+
+A row of an `SPIResult`. Columns are accessed as `row.name`, `row[:name]`,
+`row["name"]` or by position.
+"""
+struct SPIRow
+    result::SPIResult
+    index::Int
+end
+
+"""
+    spi_exec_rows(query, limit = 0)
+
+Execute a query and return its rows as an `SPIResult`, a vector of `SPIRow`s
+that decode their columns on access. Statements that don't return rows
+return the number of rows processed, like `spi_exec`.
+"""
+function spi_exec_rows(query, limit = 0)
+    result = ccall(:pljulia_spi_exec_rows, Any, (Any, Any), query, Int64(limit))
+    result isa Integer && return result
+    return SPIResult(result...)
+end
+
+"""
+    spi_freetuptable(result)
+
+Free the tuples of an `SPIResult`. Values already decoded remain accessible.
+"""
+function spi_freetuptable(result::SPIResult)
+    if result.handle != C_NULL
+        ccall(:pljulia_spi_result_free, Cvoid, (Ptr{Cvoid}, UInt64),
+              result.handle, result.generation)
+        result.handle = C_NULL
+    end
+    return nothing
+end
+
+Base.size(result::SPIResult) = (length(result.values),)
+
+function Base.getindex(result::SPIResult, i::Int)
+    @boundscheck checkbounds(result, i)
+    return SPIRow(result, i)
+end
+
+function column_value(result::SPIResult, i, j)
+    values = result.values[i]
+    if values === nothing
+        values = result.values[i] = fill!(Vector{Any}(undef, length(result.names)),
+                                          undecoded)
+    end
+    value = values[j]
+    if value === undecoded
+        result.handle == C_NULL && error("the SPI result has been freed")
+        value = values[j] =
+            ccall(:pljulia_spi_result_value, Any, (Ptr{Cvoid}, UInt64, Int64, Int64),
+                  result.handle, result.generation, i - 1, j - 1)
+    end
+    return value
+end
+
+function Base.getindex(row::SPIRow, j::Integer)
+    result = getfield(row, :result)
+    1 <= j <= length(result.names) || throw(BoundsError(row, j))
+    return column_value(result, getfield(row, :index), j)
+end
+
+Base.getindex(row::SPIRow, name::Symbol) =
+    row[getfield(row, :result).columns[name]]
+Base.getindex(row::SPIRow, name::AbstractString) = row[Symbol(name)]
+Base.getproperty(row::SPIRow, name::Symbol) = row[name]
+Base.propertynames(row::SPIRow) = Tuple(getfield(row, :result).names)
+Base.keys(row::SPIRow) = String.(getfield(row, :result).names)
+Base.haskey(row::SPIRow, name) = haskey(getfield(row, :result).columns, Symbol(name))
+Base.length(row::SPIRow) = length(getfield(row, :result).names)
+Base.iterate(row::SPIRow, j = 1) = j > length(row) ? nothing : (row[j], j + 1)
+
+# The row as a dictionary, like the rows returned by spi_exec
+Base.Dict(row::SPIRow) = Dict{Any,Any}(String(name) => row[j]
+                                       for (j, name) in enumerate(getfield(row, :result).names))
+
+return_next(row::SPIRow) = return_next(Dict(row))
+
+"""
+    spi_exec_columns(query, limit = 0)
+
+Execute a query and return its rows as a NamedTuple of column vectors, a
+column table in the sense of Tables.jl. Integer, floating point and boolean
+columns have their native element type, numeric columns hold BigFloats and
+other columns hold strings. Columns with NULLs are vectors of
+`Union{T,Nothing}`. Statements that don't return rows return the number of
+rows processed, like `spi_exec`.
+"""
+function spi_exec_columns(query, limit = 0)
+    result = ccall(:pljulia_spi_exec_columns, Any, (Any, Any), query, Int64(limit))
+    result isa Integer && return result
+    return column_table(result...)
+end
+
+# Build a NamedTuple from the column names, vectors and validity masks
+# returned by the C code, making duplicate names unique
+function column_table(names, columns, valid)
+    keys = Symbol[]
+    for name in names
+        key = Symbol(name)
+        n = 1
+        while key in keys
+            n += 1
+            key = Symbol(name, "_", n)
+        end
+        push!(keys, key)
+    end
+    return NamedTuple{Tuple(keys)}(Tuple(map(with_nulls, columns, valid)))
+end
+
+with_nulls(column, ::Nothing) = column
+
+function with_nulls(column::Vector{T}, valid) where {T}
+    result = Vector{Union{T,Nothing}}(nothing, length(column))
+    for i in eachindex(column)
+        if valid[i]
+            result[i] = column[i]
+        end
+    end
+    return result
+end
+
+"""
+    spi_exec(query)
+    spi_exec(query, limit)
+    spi_exec(query, args...; limit = 0)
+
+Execute a query. Without arguments or limit, return a cursor for
+`spi_fetchrow`. Otherwise return the rows of a SELECT as an array of
+dictionaries, or the number of rows processed by INSERT, UPDATE and DELETE.
+
+Arguments are bound to the parameters `\$1`, `\$2`, ... of the query, with
+types inferred from their Julia types; `nothing` is a NULL of the type the
+query expects, or text, and values of other types are given as text for the
+query to convert, like literals. The plan of such a query is cached by the
+session and reused for the same query and argument types. A single integer
+argument is a row limit when the query has no parameters, as before
+parameters existed.
+"""
+function spi_exec(query, args...; limit = nothing)
+    if isempty(args) && something(limit, 0) == 0
+        return ccall(:pljulia_spi_query, Any, (Any,), query)
+    elseif isempty(args) || (length(args) == 1 && args[1] isa Integer &&
+                             limit === nothing && !has_parameters(query))
+        n = isempty(args) ? limit : args[1]
+        return ccall(:pljulia_spi_exec, Any, (Any, Any), query, Int64(n))
+    end
+    return ccall(:pljulia_spi_exec_params, Any, (Any, Any, Any),
+                 query, Any[bind_value(arg) for arg in args],
+                 Int64(something(limit, 0)))
+end
+
+# Whether a query has parameters \$1, \$2, ...
+has_parameters(query) = occursin(r"\$[1-9]", query)
+
+# The text of a value bound to a parameter of type unknown: the query decides
+# its type, as for a literal
+struct UntypedParam
+    text::String
+end
+
+# Convert a query argument to one of the types the C code binds
+function bind_value(x)
+    x === nothing && return x
+    x isa Union{Bool,Int16,Int32,Int64,Float32,Float64,BigFloat,String} && return x
+    x isa Integer && return Int64(x)
+    x isa AbstractFloat && return Float64(x)
+    return UntypedParam(string(x))
+end
+
+"""
+    load_packages(names)
+
+Import the given packages into Main and remember them so that every
+function module imports them as well. Packages that fail to load are skipped.
+"""
+function load_packages(names)
+    for name in names
+        pkg = Symbol(name)
+        try
+            Core.eval(Main, Expr(:using, Expr(:., pkg)))
+            push!(packages, pkg)
+        catch
+        end
+    end
+    return nothing
+end
+
+"""
+    new_module(name)
+
+Create an anonymous module importing PLJulia and the installed packages.
+"""
+function new_module(name)
+    m = Module(Symbol(name), true)
+    Core.eval(m, :(using Main.PLJulia))
+    for pkg in packages
+        Core.eval(m, Expr(:using, Expr(:., pkg)))
+    end
+    return m
+end
+
+# Function definitions parsed by the validator, keyed by the hash of their
+# code and consumed by the first call of the function
+const parsed_functions = Dict{UInt64,Tuple{String,Any}}()
+const parsed_order = UInt64[]
+const max_parsed_functions = 1024
+
+"""
+    parse_function(code)
+
+Parse a function definition, raising an error if it isn't valid syntax.
+"""
+function parse_function(code)
+    ex = Meta.parse(code)
+    if ex isa Expr && (ex.head === :error || ex.head === :incomplete)
+        throw(Meta.ParseError(string(ex.args[1])))
+    end
+    return ex
+end
+
+"""
+    define_function(name, code, key)
+
+Evaluate the function definition `code` into a fresh module and return the
+function. The module is kept until `drop_function` is called with the
+function. If the validator already parsed the same code, its parse is used.
+"""
+function define_function(name, code, key)
+    cached = pop!(parsed_functions, key, nothing)
+    # parsed_order holds the keys of parsed_functions, and nothing else
+    cached === nothing || filter!(!=(key), parsed_order)
+    ex = (cached !== nothing && cached[1] == code) ? cached[2] : parse_function(code)
+    m = new_module(name)
+    f = Core.eval(m, ex)
+    modules[m] = name
+    return f
+end
+
+"""
+    drop_function(f)
+
+Forget the module of a function returned by `define_function`, so that it
+can be garbage-collected. The modules of other definitions of the same
+function are left alone.
+"""
+function drop_function(f)
+    delete!(modules, parentmodule(f))
+    return nothing
+end
+
+# Compiled DO blocks, keyed by the hash of their source text
+const inline_functions = Dict{UInt64,Any}()
+
+"""
+    compile_inline(key, code, keep)
+
+Wrap the code of a DO block in a function compiled into a throwaway module.
+Code that can't be wrapped, because it uses constructs only allowed at top
+level (`using`, `struct`, ...), is evaluated at top level on every call
+instead. The function is remembered under `key` if `keep` is true.
+"""
+function compile_inline(key, code, keep)
+    # syntax errors are raised here, and never cached
+    ex = parse_function("function pljulia_inline()\n$code\nend")
+    m = new_module("pljulia_inline")
+    if !toplevel_only(ex)
+        # macros may expand to top-level only code too, like @enum
+        ex = macroexpand(m, ex)
+    end
+    f = if toplevel_only(ex)
+        () -> (include_string(new_module("pljulia_inline"), code); nothing)
+    else
+        Core.eval(m, ex)
+    end
+    if keep
+        inline_functions[key] = f
+    end
+    return f
+end
+
+# Heads of the expressions only allowed at top level
+const toplevel_heads = (:using, :import, :export, :public, :struct, :abstract,
+                        :primitive, :module, :macro, :const, :toplevel)
+
+# Whether parsed code uses a construct only allowed at top level, anywhere
+# but in quoted code
+toplevel_only(ex) = ex isa Expr && ex.head !== :quote &&
+    (ex.head in toplevel_heads || any(toplevel_only, ex.args))
+
+"""
+    forget_inline(key)
+
+Forget a compiled DO block so that it can be garbage-collected.
+"""
+function forget_inline(key)
+    delete!(inline_functions, key)
+    return nothing
+end
+
+"""
+    validate(code, key)
+
+Check the syntax of a function definition, keeping the parsed code for the
+first call of the function. The oldest parses are dropped once there are
+more than `max_parsed_functions` of them.
+"""
+function validate(code, key)
+    ex = parse_function(code)
+    if !haskey(parsed_functions, key)
+        push!(parsed_order, key)
+    end
+    parsed_functions[key] = (code, ex)
+    while length(parsed_order) > max_parsed_functions
+        delete!(parsed_functions, popfirst!(parsed_order))
+    end
+    return nothing
+end
+
+end # module PLJulia
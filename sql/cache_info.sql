@@ -0,0 +1,39 @@
+-- introspection and eviction of the session caches
+create function cached_one() returns integer as $$
+return 1
+$$ language pljulia;
+
+create function cached_two() returns integer as $$
+return 2
+$$ language pljulia;
+
+select cached_one(), cached_one(), cached_two();
+
+select func, calls, memory_bytes > 0 as has_memory, last_used is not null as used
+from pljulia_cache_info() order by func::text;
+
+select pljulia_cache_evict('cached_one()');
+select pljulia_cache_evict('cached_one()');
+select func, calls from pljulia_cache_info() order by func::text;
+
+-- a bounded cache keeps the most recently used functions
+set pljulia.max_cached_functions = 1;
+select cached_one();
+select func, calls from pljulia_cache_info() order by func::text;
+reset pljulia.max_cached_functions;
+
+create function cached_plan(i integer) returns integer as $$
+plan = spi_prepare("select \$1 + 1 as next", ["integer"])
+return spi_exec_prepared(plan, [i], 0)[1]["next"]
+$$ language pljulia;
+
+select cached_plan(1);
+
+select query, nargs, calls, memory_bytes > 0 as has_memory
+from pljulia_plan_cache_info();
+
+select pljulia_heap_size() > 0 as has_heap;
+
+drop function cached_one;
+drop function cached_two;
+drop function cached_plan;
@@ -0,0 +1,67 @@
+-- bulk loading with COPY FROM
+create table copy_table(id integer, name text, score double precision,
+                        flag boolean);
+
+-- binary format, from columns
+create function copy_columns() returns bigint as $$
+return spi_copy_in("copy_table", (id = [1, 2, 3], name = ["a", "b'c", nothing],
+                                  score = [1.5, missing, 3.5],
+                                  flag = [true, false, true]))
+$$ language pljulia;
+
+select copy_columns();
+
+-- from a matrix, into some of the columns
+create function copy_matrix() returns bigint as $$
+return spi_copy_in("copy_table", ["id", "score"], [4 4.5; 5 5.5])
+$$ language pljulia;
+
+select copy_matrix();
+
+select * from copy_table order by id;
+
+-- from a generator, in several chunks
+create function copy_generator(n integer) returns bigint as $$
+return spi_copy_in("copy_table", ["id"], ((i,) for i in 100:(99 + n)))
+$$ language pljulia;
+
+select copy_generator(20000);
+select count(*), min(id), max(id) from copy_table where id >= 100;
+
+-- text format, for types without a binary conversion
+create table copy_text(id integer, amount numeric, day date, note text);
+
+create function copy_rows() returns bigint as $$
+return spi_copy_in("copy_text", [(1, big"1.25", "2020-01-01", "back\\slash"),
+                                 (2, nothing, "2020-01-02", "line\nbreak")])
+$$ language pljulia;
+
+select copy_rows();
+select id, amount, day, note = any(array[E'back\\slash', E'line\nbreak']) as note_ok
+from copy_text order by id;
+
+-- strings are UTF-8, whatever the client encoding
+create function copy_latin1() returns bigint as $$
+spi_exec("set local client_encoding = 'LATIN1'", 0)
+return spi_copy_in("copy_table", ["id", "name"], [(-1, "\u00e9t\u00e9")]) +
+       spi_copy_in("copy_text", ["id", "note"], [(3, "\u00e9t\u00e9")])
+$$ language pljulia;
+
+select copy_latin1();
+select name = chr(233) || 't' || chr(233) as name_ok from copy_table where id = -1;
+select note = chr(233) || 't' || chr(233) as note_ok from copy_text where id = 3;
+
+create function copy_bad_column() returns bigint as $$
+return spi_copy_in("copy_table", ["nope"], [(1,)])
+$$ language pljulia;
+
+select copy_bad_column();
+
+drop function copy_columns;
+drop function copy_matrix;
+drop function copy_generator;
+drop function copy_rows;
+drop function copy_bad_column;
+drop function copy_latin1;
+drop table copy_table;
+drop table copy_text;
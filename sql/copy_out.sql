@@ -0,0 +1,52 @@
+-- writing query results to a Julia IO with COPY TO
+create table copy_out_table(id integer, name text, score double precision);
+insert into copy_out_table values (1, 'plain', 1.5), (2, 'a,b "c"', null),
+                                  (3, '', 2.5), (4, '\.', 3.5),
+                                  (5, ' padded ', null);
+
+-- CSV, with a header
+create function copy_out_csv() returns setof text as $$
+io = IOBuffer()
+n = spi_copy_out("select * from copy_out_table order by id", io;
+                 format = :csv, header = true)
+for line in split(String(take!(io)), '\n', keepempty = false)
+    return_next(line)
+end
+return_next("$n rows")
+$$ language pljulia;
+
+select copy_out_csv();
+
+-- binary format
+create function copy_out_binary() returns text as $$
+io = IOBuffer()
+n = spi_copy_out("select * from copy_out_table order by id", io)
+data = take!(io)
+natts = ntoh(reinterpret(Int16, data[20:21])[1])
+id = ntoh(reinterpret(Int32, data[26:29])[1])
+trailer = ntoh(reinterpret(Int16, data[end-1:end])[1])
+return "$(data[1:11] == b"PGCOPY\n\xff\r\n\0") $n $natts $id $trailer"
+$$ language pljulia;
+
+select copy_out_binary();
+
+-- a result larger than a chunk
+create function copy_out_large(n integer) returns text as $$
+io = IOBuffer()
+rows = spi_copy_out("select i from generate_series(1, $n) i", io; format = :csv)
+return "$rows $(position(io))"
+$$ language pljulia;
+
+select copy_out_large(100000);
+
+create function copy_out_bad_format() returns bigint as $$
+return spi_copy_out("select 1", IOBuffer(); format = :text)
+$$ language pljulia;
+
+select copy_out_bad_format();
+
+drop function copy_out_csv;
+drop function copy_out_binary;
+drop function copy_out_large;
+drop function copy_out_bad_format;
+drop table copy_out_table;
@@ -0,0 +1,49 @@
+-- batched cursors over queries and saved plans
+create table cursor_table as select generate_series(1, 10) as id;
+
+create function cursor_ids(n integer) returns text as $$
+ids = [row["id"] for row in spi_cursor("select id from cursor_table order by id",
+                                       fetch_size = n)]
+return join(ids, ",")
+$$ language pljulia;
+
+select cursor_ids(3);
+select cursor_ids(5);
+select cursor_ids(0);
+
+create function cursor_plan(i integer) returns setof integer as $$
+plan = spi_prepare("select id from cursor_table where id > \$1 order by id",
+                   ["integer"])
+for row in spi_exec_prepared(plan, [i])
+    return_next(row["id"])
+end
+$$ language pljulia;
+
+select * from cursor_plan(7);
+
+create function cursor_fetch_size() returns integer as $$
+c = spi_cursor("select 1")
+n = c.fetch_size
+spi_cursor_close(c)
+return n
+$$ language pljulia;
+
+set pljulia.cursor_fetch_size = 4;
+select cursor_fetch_size();
+reset pljulia.cursor_fetch_size;
+
+-- a cursor that isn't read to the end is closed explicitly
+create function cursor_partial() returns integer as $$
+c = spi_cursor("select id from cursor_table order by id", fetch_size = 2)
+first = spi_fetchrow(c)["id"]
+spi_cursor_close(c)
+return first
+$$ language pljulia;
+
+select cursor_partial();
+
+drop function cursor_ids;
+drop function cursor_plan;
+drop function cursor_fetch_size;
+drop function cursor_partial;
+drop table cursor_table;
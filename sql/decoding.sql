@@ -0,0 +1,48 @@
+-- the pljulia logical decoding output plugin, needs wal_level = logical
+CREATE EXTENSION pljulia;
+
+create table decode_table(id integer primary key, name text);
+
+create function decode_change(txn internal) returns internal as $$
+return [string(c.action, " ", c.relation, " ",
+               c.old === nothing ? "-" : c.old.id, " ",
+               c.new === nothing ? "-" : "$(c.new.id) $(c.new.name)")
+        for c in txn.changes]
+$$ language pljulia;
+
+create function decode_commit(txn internal) returns internal as $$
+return "commit $(txn.lsn > 0) $(length(txn.changes))"
+$$ language pljulia;
+
+create function decode_batch(txn internal) returns internal as $$
+return "batch $(length(txn.changes))"
+$$ language pljulia;
+
+select 'init' from pg_create_logical_replication_slot('regress_slot', 'pljulia');
+
+insert into decode_table values (1, 'a'), (2, 'b');
+update decode_table set name = 'b2' where id = 2;
+delete from decode_table where id = 1;
+
+select data from pg_logical_slot_get_changes('regress_slot', NULL, NULL,
+    'change', 'decode_change', 'commit', 'decode_commit');
+
+-- changes are delivered in batches of batch_size
+insert into decode_table select i, 'n' || i from generate_series(3, 7) i;
+
+select data from pg_logical_slot_get_changes('regress_slot', NULL, NULL,
+    'change', 'decode_batch', 'batch_size', '2');
+
+-- errors
+select data from pg_logical_slot_get_changes('regress_slot', NULL, NULL,
+    'nope', 'decode_change');
+select data from pg_logical_slot_get_changes('regress_slot', NULL, NULL,
+    'change', 'decode_change', 'batch_size', '0');
+select data from pg_logical_slot_get_changes('regress_slot', NULL, NULL);
+
+select 'stop' from pg_drop_replication_slot('regress_slot');
+
+drop function decode_change;
+drop function decode_commit;
+drop function decode_batch;
+drop table decode_table;
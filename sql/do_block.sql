@@ -1 +1,36 @@
-DO $$ elog("INFO", "Prints an info message") $$ language pljulia;
\ No newline at end of file
+DO $$ elog("INFO", "Prints an info message") $$ language pljulia;
+
+-- repeated blocks run the cached compiled code
+DO $$ for i in 1:2 elog("INFO", "iteration $i") end $$ language pljulia;
+DO $$ for i in 1:2 elog("INFO", "iteration $i") end $$ language pljulia;
+
+-- top-level only code is still supported
+DO $$
+struct Point
+    x::Int
+end
+elog("INFO", string(Point(1).x))
+$$ language pljulia;
+
+SET pljulia.inline_cache_size = 0;
+DO $$ elog("INFO", "not cached") $$ language pljulia;
+RESET pljulia.inline_cache_size;
+
+-- so is code whose macros expand to top-level only code
+DO $$
+@enum Fruit apple banana
+elog("INFO", string(banana))
+$$ language pljulia;
+
+-- syntax errors are raised again rather than cached
+DO $outer$
+BEGIN
+    FOR i IN 1..2 LOOP
+        BEGIN
+            EXECUTE $q$DO $$ x = ( $$ language pljulia$q$;
+        EXCEPTION WHEN others THEN
+            RAISE INFO 'syntax error %', i;
+        END;
+    END LOOP;
+END
+$outer$;
@@ -0,0 +1,48 @@
+-- query results by column
+create table column_table(
+    i2 smallint,
+    i4 integer,
+    i8 bigint,
+    f4 real,
+    f8 double precision,
+    b boolean,
+    n numeric,
+    t text
+);
+insert into column_table values
+    (1, 10, 100, 1.5, 2.5, true, 1.25, 'one'),
+    (2, null, 200, 3.5, 4.5, false, 2.5, null),
+    (3, 30, 300, 5.5, 6.5, null, 3.75, 'three');
+
+create function column_types() returns setof text as $$
+t = spi_exec_columns("select * from column_table order by i2")
+for (name, column) in pairs(t)
+    return_next(string(name, " ", eltype(column)))
+end
+$$ language pljulia;
+
+select * from column_types();
+
+create function column_sums() returns text as $$
+t = spi_exec_columns("select * from column_table order by i2")
+return string(sum(t.i2), " ", sum(t.i8), " ", sum(t.f8), " ",
+              sum(something.(t.i4, 0)), " ", count(isnothing, t.t), " ",
+              t.t[3], " ", t.n[2])
+$$ language pljulia;
+
+select column_sums();
+
+-- the limit, duplicate column names and statements without rows
+create function column_misc() returns text as $$
+t = spi_exec_columns("select i2, i2 from column_table order by i2", 2)
+n = spi_exec_columns("update column_table set i4 = 0 where i4 is null")
+e = spi_exec_columns("select i4 from column_table where false")
+return string(keys(t), " ", length(t.i2), " ", n, " ", length(e.i4))
+$$ language pljulia;
+
+select column_misc();
+
+drop function column_types;
+drop function column_sums;
+drop function column_misc;
+drop table column_table;
@@ -0,0 +1,44 @@
+-- executing a saved plan for many rows
+create table many_table(id integer, name text, score double precision);
+
+create function many_columns(n integer) returns bigint as $$
+plan = spi_prepare("insert into many_table values (\$1, \$2, \$3)",
+                   ["integer", "text", "double precision"])
+return spi_exec_prepared_many(plan, (id = collect(1:n),
+                                     name = ["n$i" for i in 1:n],
+                                     score = [iseven(i) ? i / 2 : nothing for i in 1:n]))
+$$ language pljulia;
+
+select many_columns(4);
+
+create function many_rows() returns bigint as $$
+plan = spi_prepare("insert into many_table values (\$1, \$2, \$3)",
+                   ["integer", "text", "double precision"])
+return spi_exec_prepared_many(plan, [(5, "n5", 5.5), (6, nothing, 6.5)])
+$$ language pljulia;
+
+select many_rows();
+
+create function many_matrix() returns bigint as $$
+plan = spi_prepare("update many_table set score = \$2 where id = \$1",
+                   ["integer", "double precision"])
+return spi_exec_prepared_many(plan, Any[1 10.0; 3 30.0; 99 0.0])
+$$ language pljulia;
+
+select many_matrix();
+
+select * from many_table order by id;
+
+create function many_mismatch() returns bigint as $$
+plan = spi_prepare("insert into many_table values (\$1, \$2, \$3)",
+                   ["integer", "text", "double precision"])
+return spi_exec_prepared_many(plan, ([7], ["n7"]))
+$$ language pljulia;
+
+select many_mismatch();
+
+drop function many_columns;
+drop function many_rows;
+drop function many_matrix;
+drop function many_mismatch;
+drop table many_table;
@@ -0,0 +1,66 @@
+-- spi_exec with parameters and the statement cache
+create table param_table(id integer, name text, score double precision);
+
+create function param_insert() returns integer as $$
+n = 0
+for i in 1:5
+    n += spi_exec("insert into param_table values (\$1, \$2, \$3)", i, "n$i", i * 1.5)
+end
+return n
+$$ language pljulia;
+
+select param_insert();
+
+create function param_select() returns text as $$
+rows = spi_exec("select name from param_table where id > \$1 and score < \$2 order by id",
+                2, 7.0)
+limited = spi_exec("select id from param_table where id > \$1 order by id", 0;
+                   limit = 2)
+isnull = spi_exec("select \$1::integer is null as isnull", nothing)[1]["isnull"]
+n = spi_exec("select \$1 + 1 as n", big"1.5")[1]["n"]
+return string([row["name"] for row in rows], " ", length(limited), " ",
+              isnull, " ", n)
+$$ language pljulia;
+
+select param_select();
+
+select query, nargs, calls from pljulia_plan_cache_info()
+where plan is null order by query;
+
+-- without the cache, statements are planned on every call
+set pljulia.statement_cache_size = 0;
+create function param_uncached() returns integer as $$
+return length(spi_exec("select * from param_table where id < \$1", 3; limit = 0))
+$$ language pljulia;
+
+select param_uncached();
+select count(*) from pljulia_plan_cache_info()
+where query = 'select * from param_table where id < $1';
+reset pljulia.statement_cache_size;
+
+-- NULLs take the type of the parameter in the query
+create function param_null() returns integer as $$
+return spi_exec("insert into param_table values (\$1, \$2, \$3)", nothing, "none", nothing)
+$$ language pljulia;
+
+select param_null();
+select id, name, score from param_table where id is null;
+
+-- a single integer is bound to $1, other values are given as text for the
+-- query to convert
+create function param_single() returns text as $$
+name = spi_exec("select name from param_table where id = \$1", 4)[1]["name"]
+u = Base.UUID("a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11")
+same = spi_exec("select \$1 = 'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11'::uuid as same",
+                u)[1]["same"]
+return string(name, " ", same)
+$$ language pljulia;
+
+select param_single();
+
+drop function param_insert;
+drop function param_select;
+drop function param_uncached;
+drop function param_null;
+drop function param_single;
+drop table param_table;
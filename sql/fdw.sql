@@ -0,0 +1,110 @@
+-- foreign tables scanned by pljulia functions
+create function squares_scan(scan internal) returns internal as $$
+n = parse(Int, scan.options["n"])
+batch = parse(Int, scan.options["batch"])
+start = 1
+for (column, op, value) in scan.quals
+    if column == "i" && op == ">=" && value !== nothing
+        start = max(start, value)
+    end
+end
+quals = ["$column $op $value" for (column, op, value) in scan.quals]
+GD["scan"] = "[$(join(scan.columns, ","))] [$(join(quals, " and "))]"
+GD["batches"] = 0
+return (begin
+            GD["batches"] += 1
+            (i = collect(r), square = [x^2 for x in r], label = ["s$x" for x in r])
+        end for r in Iterators.partition(start:n, batch))
+$$ language pljulia;
+
+create function last_scan() returns text as $$
+return "$(GD["scan"]) ($(GD["batches"]) batches)"
+$$ language pljulia;
+
+create server julia_server foreign data wrapper pljulia_fdw
+    options (scan 'squares_scan');
+create foreign table squares(i integer, square bigint, label text)
+    server julia_server options (n '100', batch '30');
+
+-- batches are fetched as the rows are read
+select count(*), sum(square) from squares;
+select last_scan();
+select i from squares limit 5;
+select last_scan();
+
+-- columns and quals passed to Julia
+select * from squares where i >= 98;
+select last_scan();
+select label from squares where 97 <= i and square < 9500;
+select last_scan();
+select s from squares s where i = 3;
+select last_scan();
+explain (verbose, costs off) select label from squares where i >= 98;
+
+-- parameters
+set plan_cache_mode = force_generic_plan;
+prepare squares_from(integer) as select count(*) from squares where i >= $1;
+execute squares_from(91);
+select last_scan();
+execute squares_from(100);
+select last_scan();
+deallocate squares_from;
+reset plan_cache_mode;
+
+-- rescans with new parameters
+select n, (select max(square) from squares where i >= n and i < n + 2)
+from generate_series(1, 3) n;
+
+-- batches of rows, the options of the table take precedence
+create function rows_scan(scan internal) returns internal as $$
+return [[(id = 1, name = "a"), (id = 2, name = missing)],
+        Dict{String,Any}[],
+        [Dict("id" => 3, "name" => "c")]]
+$$ language pljulia;
+
+create foreign table julia_rows(id integer, name text, extra text)
+    server julia_server options (scan 'rows_scan');
+select * from julia_rows;
+
+-- estimates
+create function squares_estimate(scan internal) returns internal as $$
+GD["estimate"] = join(["$column $op $value" for (column, op, value) in scan.quals], " and ")
+return parse(Int, scan.options["n"]) ÷ 10
+$$ language pljulia;
+
+alter foreign table squares options (add estimate 'squares_estimate');
+explain select * from squares where i >= 42 and label <> 'x';
+create function estimate_quals() returns text as $$
+return GD["estimate"]
+$$ language pljulia;
+select estimate_quals();
+
+-- errors
+create function bad_scan(scan internal) returns internal as $$
+return [(a = [1, 2], b = [1])]
+$$ language pljulia;
+create function void_scan(scan internal) returns void as $$
+$$ language pljulia;
+
+create foreign table bad(a integer, b integer)
+    server julia_server options (scan 'bad_scan');
+select * from bad;
+alter foreign table bad options (set scan 'nope');
+alter foreign table bad options (set scan 'void_scan');
+create server julia_bare foreign data wrapper pljulia_fdw;
+create foreign table bare(a integer) server julia_bare;
+select * from bare;
+
+drop foreign table squares;
+drop foreign table julia_rows;
+drop foreign table bad;
+drop foreign table bare;
+drop server julia_server;
+drop server julia_bare;
+drop function squares_scan;
+drop function squares_estimate;
+drop function rows_scan;
+drop function bad_scan;
+drop function void_scan;
+drop function last_scan;
+drop function estimate_quals;
@@ -0,0 +1,29 @@
+-- each function is compiled into a module of its own
+create function modules_a() returns integer as $$
+global shared_value = 1
+return shared_value
+$$ language pljulia;
+
+create function modules_b() returns integer as $$
+return isdefined(@__MODULE__, :shared_value) ||
+       isdefined(Main, :shared_value) ? 2 : 0
+$$ language pljulia;
+
+-- modules_a runs first, modules_b must not see its global
+select modules_a();
+select modules_b();
+
+-- globals defined by a DO block don't leak into other code
+DO $$ leaked = 42 $$ language pljulia;
+DO $$ elog("INFO", string(isdefined(@__MODULE__, :leaked))) $$ language pljulia;
+
+-- a new definition gets a fresh module, without the old globals
+create or replace function modules_a() returns integer as $$
+return isdefined(@__MODULE__, :shared_value) ? 4 : 3
+$$ language pljulia;
+
+select modules_a();
+select modules_b();
+
+drop function modules_a;
+drop function modules_b;
@@ -0,0 +1,121 @@
+-- looking rows up through btree indexes
+create table lookup_table(id integer primary key, grp integer, name text,
+                          score double precision);
+insert into lookup_table
+select i, i % 10, 'n' || i, i / 4.0 from generate_series(1, 1000) i;
+update lookup_table set name = null where id = 7;
+create index lookup_grp_name on lookup_table(grp, name);
+
+create function lookup_pk() returns text as $$
+r = index_lookup("lookup_table_pkey", 42)
+m = index_lookup("lookup_table_pkey", 5000)
+n = index_lookup("lookup_table_pkey", nothing)
+return "$(keys(r)) $(r.id[1]) $(r.name[1]) $(r.score[1]) $(length(m.id)) $(length(n.id))"
+$$ language pljulia;
+
+select lookup_pk();
+
+-- non-unique indexes, key prefixes and selected columns
+create function lookup_group(g integer) returns text as $$
+r = index_lookup("lookup_grp_name", g; columns = ["id"])
+s = index_lookup("lookup_grp_name", g, "n$(g + 10)"; columns = [:id, :score])
+return "$(keys(r)) $(length(r.id)) $(sum(r.id)) $(keys(s)) $(only(s.id)) $(only(s.score))"
+$$ language pljulia;
+
+select lookup_group(3);
+
+create function lookup_nulls() returns text as $$
+r = index_lookup("lookup_grp_name", 7; columns = ["id", "name"])
+n = index_lookup("lookup_grp_name", 7, nothing)
+return "$(length(r.id)) $(count(isnothing, r.name)) $(length(n.id))"
+$$ language pljulia;
+
+select lookup_nulls();
+
+-- the call site is resolved again once the index changes
+create index lookup_name on lookup_table(name);
+
+create function lookup_by_name(k text) returns text as $$
+return join(index_lookup("lookup_name", k; columns = ["id"]).id, ",")
+$$ language pljulia;
+
+select lookup_by_name('n5');
+drop index lookup_name;
+create index lookup_name on lookup_table(lower(name), id);
+insert into lookup_table values (1001, 1, 'N5', 0);
+select lookup_by_name('n5');
+
+-- an unqualified index name is looked up again once search_path changes
+create schema lookup_schema;
+create table lookup_schema.lookup_table(id integer primary key, name text);
+insert into lookup_schema.lookup_table values (42, 'other');
+create function lookup_unqualified() returns text as $$
+return only(index_lookup("lookup_table_pkey", 42; columns = ["name"]).name)
+$$ language pljulia;
+
+select lookup_unqualified();
+set search_path = lookup_schema, public;
+select lookup_unqualified();
+reset search_path;
+select lookup_unqualified();
+drop function lookup_unqualified;
+drop table lookup_schema.lookup_table;
+drop schema lookup_schema;
+
+-- errors
+create index lookup_hash on lookup_table using hash(grp);
+
+create function lookup_error(idx text, cols text) returns integer as $$
+r = index_lookup(idx, 1, 2, 3; columns = split(cols, ",", keepempty = false))
+return length(r[1])
+$$ language pljulia;
+
+select lookup_error('lookup_hash', '');
+select lookup_error('lookup_table', '');
+select lookup_error('lookup_nope', '');
+select lookup_error('lookup_table_pkey', 'nope');
+select lookup_error('lookup_table_pkey', '');
+
+create function lookup_id(cols text) returns integer as $$
+r = index_lookup("lookup_table_pkey", 10; columns = split(cols, ","))
+return r.id[1]
+$$ language pljulia;
+
+alter table lookup_table enable row level security;
+create role regress_lookup_user;
+grant select on lookup_table to regress_lookup_user;
+set role regress_lookup_user;
+select lookup_id('id');
+reset role;
+alter table lookup_table disable row level security;
+
+revoke select on lookup_table from regress_lookup_user;
+grant select (id) on lookup_table to regress_lookup_user;
+set role regress_lookup_user;
+select lookup_id('id');
+select lookup_id('id,name');
+reset role;
+revoke all on lookup_table from regress_lookup_user;
+
+-- privileges are checked on every call, here through a membership
+create role regress_lookup_group;
+grant select on lookup_table to regress_lookup_group;
+grant regress_lookup_group to regress_lookup_user;
+set role regress_lookup_user;
+select lookup_id('id,name');
+reset role;
+revoke regress_lookup_group from regress_lookup_user;
+set role regress_lookup_user;
+select lookup_id('id,name');
+reset role;
+revoke all on lookup_table from regress_lookup_group;
+drop role regress_lookup_group;
+drop role regress_lookup_user;
+
+drop function lookup_pk;
+drop function lookup_group;
+drop function lookup_nulls;
+drop function lookup_by_name;
+drop function lookup_error;
+drop function lookup_id;
+drop table lookup_table;
@@ -0,0 +1,136 @@
+-- streaming large objects
+select lo_from_bytea(4242, convert_to(repeat('0123456789', 50000), 'UTF8'));
+
+create function lo_sum(loid oid) returns text as $$
+n = total = 0
+buf = Vector{UInt8}(undef, 1000)
+lo_open(loid) do lo
+    while !eof(lo)
+        m = readbytes!(lo, buf)
+        n += m
+        total += sum(Int, view(buf, 1:m))
+    end
+end
+return "$n $total"
+$$ language pljulia;
+
+select lo_sum(4242);
+
+-- readbytes! reads at most nb bytes, even into a larger buffer
+create function lo_readbytes(loid oid) returns text as $$
+buf = zeros(UInt8, 10)
+lo_open(loid) do lo
+    m = readbytes!(lo, buf, 4)
+    "$m $(String(buf[1:m])) $(position(lo)) $(length(buf)) $(buf[5])"
+end
+$$ language pljulia;
+
+select lo_readbytes(4242);
+
+-- seeking, and reads larger than the buffer
+create function lo_seek_read(loid oid) returns text as $$
+lo = lo_open(loid)
+seek(lo, 499995)
+a = read(lo, String)
+seek(lo, 3)
+b = Vector{UInt8}(undef, 4)
+read!(lo, b)
+p = position(lo)
+skip(lo, 10)
+c = Char(read(lo, UInt8))
+seekstart(lo)
+d = length(read(lo))
+close(lo)
+return "$a $(String(b)) $p $c $d $(isopen(lo))"
+$$ language pljulia;
+
+select lo_seek_read(4242);
+
+-- writing
+create function lo_fill(loid oid, n integer) returns bigint as $$
+lo_open(loid; write = true) do lo
+    for i in 1:n
+        write(lo, "line $i\n")
+    end
+    write(lo, UInt8('!'))
+    position(lo)
+end
+$$ language pljulia;
+
+select lo_fill(lo_create(4243), 100000);
+select lo_get(4243) = convert_to(string_agg('line ' || i || E'\n', '' order by i) || '!', 'UTF8')
+from generate_series(1, 100000) i;
+
+-- writing after reading ahead, and reading what was written
+create function lo_patch(loid oid) returns text as $$
+lo_open(loid; write = true) do lo
+    read(lo, 5)
+    write(lo, "LINE")
+    seekstart(lo)
+    String(read(lo, 12))
+end
+$$ language pljulia;
+
+select lo_patch(4243);
+
+-- a large object can't be used after its transaction
+create function lo_save(loid oid) returns void as $$
+GD["lo"] = lo_open(loid)
+return nothing
+$$ language pljulia;
+
+create function lo_saved() returns integer as $$
+return read(GD["lo"], UInt8)
+$$ language pljulia;
+
+select lo_save(4242);
+select lo_saved();
+
+-- nor after the subtransaction that opened it aborts, even once its
+-- descriptor is reused
+create function lo_reopen(loid oid) returns void as $$
+GD["lo2"] = lo_open(loid)
+return nothing
+$$ language pljulia;
+
+begin;
+savepoint s;
+select lo_save(4242);
+rollback to savepoint s;
+select lo_reopen(4243);
+select lo_saved();
+rollback;
+
+-- but it can after one that commits
+begin;
+savepoint s;
+select lo_save(4242);
+release savepoint s;
+select lo_saved();
+commit;
+
+-- errors
+create function lo_error(loid oid) returns void as $$
+lo_open(lo -> write(lo, "x"), loid)
+return nothing
+$$ language pljulia;
+
+select lo_error(4242);
+select lo_error(4249);
+
+create role regress_lo_user;
+set role regress_lo_user;
+select lo_sum(4242);
+reset role;
+drop role regress_lo_user;
+
+drop function lo_sum;
+drop function lo_readbytes;
+drop function lo_seek_read;
+drop function lo_fill;
+drop function lo_patch;
+drop function lo_save;
+drop function lo_saved;
+drop function lo_reopen;
+drop function lo_error;
+select lo_unlink(4242), lo_unlink(4243);
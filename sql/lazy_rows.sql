@@ -0,0 +1,57 @@
+-- lazily decoded query results
+create table wide_table(a integer, b text, c double precision, d integer);
+insert into wide_table values (1, 'x', 1.5, 10), (2, 'y', 2.5, null),
+    (3, 'z', 3.5, 30);
+
+create function lazy_access() returns text as $$
+r = spi_exec_rows("select * from wide_table order by a")
+return string(length(r), " ", r[1].a, " ", r[2][:b], " ", r[3]["c"], " ",
+              r[2].d === nothing, " ", keys(r[1]))
+$$ language pljulia;
+
+select lazy_access();
+
+-- only the columns used are decoded
+create function lazy_decoded() returns integer as $$
+r = spi_exec_rows("select * from wide_table order by a")
+r[1].b
+return count(v -> v !== PLJulia.undecoded, r.values[1])
+$$ language pljulia;
+
+select lazy_decoded();
+
+create function lazy_return() returns setof wide_table as $$
+for row in spi_exec_rows("select * from wide_table where a > 1 order by a")
+    return_next(row)
+end
+$$ language pljulia;
+
+select * from lazy_return();
+
+-- decoded values survive spi_freetuptable, the others don't
+create function lazy_free() returns text as $$
+r = spi_exec_rows("select a, b from wide_table order by a")
+a = r[1].a
+spi_freetuptable(r)
+msg = try
+    r[1].b
+catch e
+    sprint(showerror, e)
+end
+return string(a, " ", r[1].a, " ", msg)
+$$ language pljulia;
+
+select lazy_free();
+
+create function lazy_update() returns integer as $$
+return spi_exec_rows("update wide_table set d = 0 where d is null")
+$$ language pljulia;
+
+select lazy_update();
+
+drop function lazy_access;
+drop function lazy_decoded;
+drop function lazy_return;
+drop function lazy_free;
+drop function lazy_update;
+drop table wide_table;
@@ -0,0 +1,60 @@
+-- memoization of immutable functions
+set pljulia.memoize_size = 2;
+
+create function memo_square(i integer) returns integer immutable as $$
+GD["memo_calls"] = get(GD, "memo_calls", 0) + 1
+return i * i
+$$ language pljulia;
+
+create function memo_calls() returns integer as $$
+return get(GD, "memo_calls", 0)
+$$ language pljulia;
+
+create table memo_input(i integer);
+insert into memo_input values (1), (2), (1), (1), (2), (3), (1);
+
+select i, memo_square(i) from memo_input;
+select memo_calls();
+
+select func, memo_entries, memo_hits, memo_misses
+from pljulia_cache_info() where func::text like 'memo%' order by func::text;
+
+-- returning nothing gives NULL
+create function memo_nothing(i integer) returns integer immutable as $$
+return nothing
+$$ language pljulia;
+
+select memo_nothing(i) is null as isnull from memo_input where i = 1;
+
+-- a stored short text and the same constant are the same argument
+create function memo_length(t text) returns integer immutable as $$
+return length(t)
+$$ language pljulia;
+
+create table memo_text(t text);
+insert into memo_text values ('abc');
+
+select memo_length('abc');
+select memo_length(t) from memo_text;
+
+-- functions with SET clauses aren't memoized
+create function memo_config(i integer) returns integer immutable
+set pljulia.memoize_size = 2 as $$
+return i
+$$ language pljulia;
+
+select memo_config(1);
+
+select func, memo_entries, memo_hits, memo_misses
+from pljulia_cache_info() where func::text in ('memo_length(text)', 'memo_config(integer)')
+order by func::text;
+
+reset pljulia.memoize_size;
+
+drop table memo_input;
+drop table memo_text;
+drop function memo_square;
+drop function memo_calls;
+drop function memo_nothing;
+drop function memo_length;
+drop function memo_config;
@@ -0,0 +1,91 @@
+-- calling SQL functions directly through fmgr
+create function call_builtins() returns text as $$
+p = pg_call("power(float8,float8)", 2, 10)
+l = pg_call("length(text)", "pljulia")
+u = pg_call("upper(text)", "abc")
+n = pg_call("numeric_add(numeric,numeric)", 1, big"0.5")
+return "$p $(typeof(p)) $l $(typeof(l)) $u $n"
+$$ language pljulia;
+
+select call_builtins();
+
+-- NULLs and strict functions
+create function call_nulls() returns text as $$
+a = pg_call("int4pl(int4,int4)", 1, nothing)
+b = pg_call("coalesce_one(int4,int4)", nothing, 7)
+return "$a $b"
+$$ language pljulia;
+
+create function coalesce_one(a int4, b int4) returns int4 as $$
+select coalesce(a, b)
+$$ language sql;
+
+select call_nulls();
+
+-- user defined functions, resolved again once redefined
+create function call_udf(x integer) returns integer as $$
+return pg_call("call_target(integer)", x)
+$$ language pljulia;
+
+create function call_target(x integer) returns integer as $$
+select x * 2
+$$ language sql;
+
+select call_udf(21);
+
+create or replace function call_target(x integer) returns integer as $$
+select x * 3
+$$ language sql;
+
+select call_udf(21);
+
+-- an unqualified signature is resolved again once search_path changes
+create schema call_schema;
+create function call_schema.call_target(x integer) returns integer as $$
+select x * 4
+$$ language sql;
+
+select call_udf(21);
+set search_path = call_schema, public;
+select call_udf(21);
+reset search_path;
+select call_udf(21);
+drop function call_schema.call_target;
+drop schema call_schema;
+
+-- errors
+create function call_error(sig text) returns integer as $$
+return pg_call(sig, 1)
+$$ language pljulia;
+
+select call_error('no_such_function(integer)');
+select call_error('generate_series(integer,integer)');
+select call_error('sum(integer)');
+select call_error('int4pl(int4,int4)');
+
+create role regress_pg_call_user;
+revoke execute on function call_target(integer) from public;
+set role regress_pg_call_user;
+select call_udf(1);
+reset role;
+-- the privilege is checked again on every call, here through a membership
+create role regress_pg_call_group;
+grant execute on function call_target(integer) to regress_pg_call_group;
+grant regress_pg_call_group to regress_pg_call_user;
+set role regress_pg_call_user;
+select call_udf(1);
+reset role;
+revoke regress_pg_call_group from regress_pg_call_user;
+set role regress_pg_call_user;
+select call_udf(1);
+reset role;
+drop role regress_pg_call_user;
+revoke execute on function call_target(integer) from regress_pg_call_group;
+drop role regress_pg_call_group;
+
+drop function call_builtins;
+drop function call_nulls;
+drop function coalesce_one;
+drop function call_udf;
+drop function call_target;
+drop function call_error;
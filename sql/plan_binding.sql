@@ -0,0 +1,27 @@
+-- conversion of the arguments of saved plans
+create function plan_binding() returns text as $$
+plan = spi_prepare("select \$1 + 1 as i2, \$2 + 1 as i4, \$3 + 1 as i8, " *
+                   "\$4 * 2::real as f4, \$5 * 2 as f8, \$6 + 1 as n, " *
+                   "not \$7 as b, \$8 || '!' as t, \$9 + 1 as d, " *
+                   "\$10 is null as isnull",
+                   ["smallint", "integer", "bigint", "real", "double precision",
+                    "numeric", "boolean", "varchar", "date", "integer"])
+row = spi_exec_prepared(plan, [1, Int32(2), 3, 1.25, 2, 0.5, true, "t",
+                               "2020-01-31", nothing], 0)[1]
+return join([string(k, "=", row[k]) for k in ["i2", "i4", "i8", "f4", "f8",
+                                              "n", "b", "t", "d", "isnull"]],
+            " ")
+$$ language pljulia;
+
+select plan_binding();
+
+create function plan_overflow(i bigint) returns integer as $$
+plan = spi_prepare("select \$1 as i", ["smallint"])
+return spi_exec_prepared(plan, [i], 0)[1]["i"]
+$$ language pljulia;
+
+select plan_overflow(42);
+select plan_overflow(100000);
+
+drop function plan_binding;
+drop function plan_overflow;
@@ -0,0 +1,42 @@
+-- lifecycle of the plans saved by spi_prepare
+create function lc_prepare(query text) returns text as $$
+return spi_prepare(query, ["integer"])
+$$ language pljulia;
+
+create function lc_free(plan text) returns void as $$
+spi_freeplan(plan)
+return nothing
+$$ language pljulia;
+
+create function lc_exec(plan text) returns integer as $$
+return spi_exec_prepared(plan, [2], 0)[1]["x"]
+$$ language pljulia;
+
+-- the same query and types share a plan
+select lc_prepare('select $1 * 2 as x') = lc_prepare('select $1 * 2 as x') as same;
+select query, refs from pljulia_plan_cache_info() where plan is not null;
+
+select lc_exec(lc_prepare('select $1 * 2 as x'));
+select lc_free(plan) from pljulia_plan_cache_info() where plan is not null;
+select query, refs from pljulia_plan_cache_info() where plan is not null;
+
+-- freed once released as many times as it was prepared
+select lc_free(plan) from pljulia_plan_cache_info() where plan is not null;
+select lc_free(plan) from pljulia_plan_cache_info() where plan is not null;
+select count(*) from pljulia_plan_cache_info() where plan is not null;
+
+select lc_exec(plan) from (select lc_prepare('select $1 + 1 as x') as plan) p;
+select lc_free(plan) from pljulia_plan_cache_info() where plan is not null;
+select lc_free('plan0');
+
+-- the least recently used plans are freed first
+set pljulia.max_saved_plans = 2;
+select lc_prepare('select $1 + ' || i || ' as x') is not null as prepared
+from generate_series(1, 4) i;
+select query, refs from pljulia_plan_cache_info() where plan is not null
+order by query;
+reset pljulia.max_saved_plans;
+
+drop function lc_prepare;
+drop function lc_free;
+drop function lc_exec;
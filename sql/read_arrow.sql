@@ -0,0 +1,98 @@
+-- reading Arrow IPC files, written here by pyarrow: two record batches of
+-- id int32, name utf8, score float64, flag bool, day date32, at timestamp[ms]
+-- and extra int8
+create function arrow_write(content bytea) returns text as $$
+path = joinpath(tempdir(), "pljulia_regress_$(getpid()).arrow")
+write(path, hex2bytes(content[3:end]))
+return path
+$$ language pljulia;
+
+select arrow_write(decode('
+QVJST1cxAAD/////mAEAABAAAAAAAAoADAAGAAUACAAKAAAAAAEEAAwAAAAIAAgAAAAEAAgAAAAE
+AAAABwAAADABAADwAAAAvAAAAJAAAABkAAAAOAAAAAQAAAD8/v//AAABAhAAAAAYAAAABAAAAAAA
+AAAFAAAAZXh0cmEAAADw/v//AAAAAQgAAAAs////AAABChAAAAAUAAAABAAAAAAAAAACAAAAYXQA
+AIb///8AAAEAVP///wAAAQgQAAAAFAAAAAQAAAAAAAAAAwAAAGRheQCu////AAAAAHz///8AAAEG
+EAAAABgAAAAEAAAAAAAAAAQAAABmbGFnAAAAAKj///+k////AAABAxAAAAAcAAAABAAAAAAAAAAF
+AAAAc2NvcmUABgAIAAYABgAAAAAAAgDU////AAABBRAAAAAcAAAABAAAAAAAAAAEAAAAbmFtZQAA
+AAAEAAQABAAAABAAFAAIAAYABwAMAAAAEAAQAAAAAAABAhAAAAAcAAAABAAAAAAAAAACAAAAaWQA
+AAgADAAIAAcACAAAAAAAAAEgAAAAAAAAAP////+4AQAAFAAAAAAAAAAMABYABgAFAAgADAAMAAAA
+AAMEABgAAACgAAAAAAAAAAAACgAYAAwABAAIAAoAAAAMAQAAEAAAAAMAAAAAAAAAAAAAAA8AAAAA
+AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAMAAAAAAAAABAAAAAAAAAAAQAAAAAAAAAYAAAAAAAAABAA
+AAAAAAAAKAAAAAAAAAAEAAAAAAAAADAAAAAAAAAAAQAAAAAAAAA4AAAAAAAAABgAAAAAAAAAUAAA
+AAAAAAABAAAAAAAAAFgAAAAAAAAAAQAAAAAAAABgAAAAAAAAAAEAAAAAAAAAaAAAAAAAAAAMAAAA
+AAAAAHgAAAAAAAAAAQAAAAAAAACAAAAAAAAAABgAAAAAAAAAmAAAAAAAAAAAAAAAAAAAAJgAAAAA
+AAAAAwAAAAAAAAAAAAAABwAAAAMAAAAAAAAAAAAAAAAAAAADAAAAAAAAAAEAAAAAAAAAAwAAAAAA
+AAABAAAAAAAAAAMAAAAAAAAAAQAAAAAAAAADAAAAAAAAAAEAAAAAAAAAAwAAAAAAAAABAAAAAAAA
+AAMAAAAAAAAAAAAAAAAAAAABAAAAAgAAAAMAAAAAAAAABQAAAAAAAAAAAAAAAQAAAAEAAAAEAAAA
+YWNjYwAAAAADAAAAAAAAAAAAAAAAAOA/AAAAAAAA+D8AAAAAAAAAAAMAAAAAAAAAAQAAAAAAAAAD
+AAAAAAAAAAtNAAD/////AAAAAAAAAAAFAAAAAAAAAPQj5cSMAQAAAAAAAAAAAAAANKGDtv///wEC
+AwAAAAAA/////7gBAAAUAAAAAAAAAAwAFgAGAAUACAAMAAwAAAAAAwQAGAAAAEAAAAAAAAAAAAAK
+ABgADAAEAAgACgAAAAwBAAAQAAAAAQAAAAAAAAAAAAAADwAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA
+AAAAAAQAAAAAAAAACAAAAAAAAAAAAAAAAAAAAAgAAAAAAAAACAAAAAAAAAAQAAAAAAAAAAIAAAAA
+AAAAGAAAAAAAAAAAAAAAAAAAABgAAAAAAAAACAAAAAAAAAAgAAAAAAAAAAAAAAAAAAAAIAAAAAAA
+AAABAAAAAAAAACgAAAAAAAAAAAAAAAAAAAAoAAAAAAAAAAQAAAAAAAAAMAAAAAAAAAAAAAAAAAAA
+ADAAAAAAAAAACAAAAAAAAAA4AAAAAAAAAAAAAAAAAAAAOAAAAAAAAAABAAAAAAAAAAAAAAAHAAAA
+AQAAAAAAAAAAAAAAAAAAAAEAAAAAAAAAAAAAAAAAAAABAAAAAAAAAAAAAAAAAAAAAQAAAAAAAAAA
+AAAAAAAAAAEAAAAAAAAAAAAAAAAAAAABAAAAAAAAAAAAAAAAAAAAAQAAAAAAAAAAAAAAAAAAAAQA
+AAAAAAAAAAAAAAIAAABkZAAAAAAAAAAAAAAAABFAAQAAAAAAAAAIKwAAAAAAABg4zZ/dAAAABAAA
+AAAAAAD/////AAAAABAAAAAMABQABgAIAAwAEAAMAAAAAAAEAFAAAABAAAAABAAAAAIAAACoAQAA
+AAAAAMABAAAAAAAAoAAAAAAAAAAIBAAAAAAAAMABAAAAAAAAQAAAAAAAAAAAAAAAAAAAAAgACAAA
+AAQACAAAAAQAAAAHAAAAMAEAAPAAAAC8AAAAkAAAAGQAAAA4AAAABAAAAPz+//8AAAECEAAAABgA
+AAAEAAAAAAAAAAUAAABleHRyYQAAAPD+//8AAAABCAAAACz///8AAAEKEAAAABQAAAAEAAAAAAAA
+AAIAAABhdAAAhv///wAAAQBU////AAABCBAAAAAUAAAABAAAAAAAAAADAAAAZGF5AK7///8AAAAA
+fP///wAAAQYQAAAAGAAAAAQAAAAAAAAABAAAAGZsYWcAAAAAqP///6T///8AAAEDEAAAABwAAAAE
+AAAAAAAAAAUAAABzY29yZQAGAAgABgAGAAAAAAACANT///8AAAEFEAAAABwAAAAEAAAAAAAAAAQA
+AABuYW1lAAAAAAQABAAEAAAAEAAUAAgABgAHAAwAAAAQABAAAAAAAAECEAAAABwAAAAEAAAAAAAA
+AAIAAABpZAAACAAMAAgABwAIAAAAAAAAASAAAADYAQAAQVJST1cx
+', 'base64')) as path \gset
+
+create type arrow_row as (id integer, name text, score double precision,
+                          flag boolean, day date, at timestamp);
+select id, name, score, flag, to_char(day, 'YYYY-MM-DD') as day,
+       to_char(at, 'YYYY-MM-DD HH24:MI:SS.MS') as at
+from pljulia_read_arrow(:'path', null::arrow_row);
+
+-- columns matched by name, numeric conversions
+create type arrow_numbers as (extra numeric(4,1), id bigint, score real);
+select * from pljulia_read_arrow(:'path', null::arrow_numbers);
+
+-- errors
+create type arrow_short as (name varchar(2));
+select * from pljulia_read_arrow(:'path', null::arrow_short);
+create type arrow_bad as (name integer);
+select * from pljulia_read_arrow(:'path', null::arrow_bad);
+select * from pljulia_read_arrow(:'path', null::integer);
+
+create function arrow_corrupt(path text) returns text as $$
+data = read(path)
+# the metadata length of the first record batch, in the footer, moved back
+# so that its body would start before its message
+data[1601:1604] = reinterpret(UInt8, [Int32(-400)])
+write("pljulia_regress_corrupt.arrow", data)
+return "pljulia_regress_corrupt.arrow"
+$$ language pljulia;
+
+select arrow_corrupt(:'path') as corrupt \gset
+select count(*) from pljulia_read_arrow(:'corrupt', null::arrow_row);
+
+create role regress_arrow_user;
+set role regress_arrow_user;
+select count(*) from pljulia_read_arrow(:'path', null::arrow_row);
+reset role;
+drop role regress_arrow_user;
+
+create function arrow_remove(path text) returns void as $$
+rm(path)
+return nothing
+$$ language pljulia;
+
+select arrow_remove(:'path');
+select arrow_remove(:'corrupt');
+
+drop function arrow_write;
+drop function arrow_remove;
+drop function arrow_corrupt;
+drop type arrow_row;
+drop type arrow_numbers;
+drop type arrow_short;
+drop type arrow_bad;
@@ -0,0 +1,40 @@
+-- appending query results to a set-returning function
+create table rq_table(name text, value integer);
+insert into rq_table values ('a', 1), ('b', 2), ('c', 3);
+create type rq_pair as (name text, value integer);
+
+create function rq_composite() returns setof rq_pair as $$
+n = return_query("select name, value from rq_table order by value")
+return_next(("total", n))
+$$ language pljulia;
+
+select * from rq_composite();
+
+-- scalar results, with parameters, mixed with return_next
+create function rq_scalar(lo integer, hi integer) returns setof integer as $$
+return_next(0)
+return_query("select value from rq_table where value between \$1 and \$2 order by value", lo, hi)
+return_query("select i from generate_series(\$1, \$1 + 1) i", Int32(10))
+$$ language pljulia;
+
+select rq_scalar(2, 3);
+
+create function rq_mismatch() returns setof integer as $$
+return_query("select name from rq_table")
+$$ language pljulia;
+
+select rq_mismatch();
+
+create function rq_not_set() returns integer as $$
+return_query("select 1")
+return 1
+$$ language pljulia;
+
+select rq_not_set();
+
+drop function rq_composite;
+drop function rq_scalar;
+drop function rq_mismatch;
+drop function rq_not_set;
+drop type rq_pair;
+drop table rq_table;
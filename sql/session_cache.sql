@@ -0,0 +1,77 @@
+-- values computed once per session by cache_get!
+create function cached_square(n integer) returns text as $$
+v = cache_get!(n) do
+    GD["regress_calls"] = get(GD, "regress_calls", 0) + 1
+    n * n
+end
+return "$v $(GD["regress_calls"])"
+$$ language pljulia;
+
+select cached_square(3), cached_square(3), cached_square(4);
+
+-- typed caches, with the least recently used entries evicted first
+create function cache_lru(ks integer[]) returns text as $$
+cache = SessionCache{Int,String}(maxentries = 2)
+for k in ks
+    cache_get!(() -> string(k), cache, k)
+end
+return join(sort(collect(keys(cache.nodes))), ",")
+$$ language pljulia;
+
+select cache_lru(array[1, 2, 1, 3]);
+
+create function cache_bytes() returns text as $$
+cache = SessionCache{Int,Vector{Float64}}(maxbytes = 2000)
+for k in 1:3
+    cache_set!(cache, k, zeros(100))
+end
+cache_set!(cache, 4, zeros(1000))
+return "$(length(cache)) $(haskey(cache, 3)) $(haskey(cache, 4)) $(cache.bytes <= 2000)"
+$$ language pljulia;
+
+select cache_bytes();
+
+create function cache_ttl(ttl float8) returns integer as $$
+cache = SessionCache{Symbol,Int}(ttl = ttl)
+calls = 0
+for _ in 1:3
+    cache_get!(() -> calls += 1, cache, :value)
+end
+return calls
+$$ language pljulia;
+
+select cache_ttl(0), cache_ttl(60);
+
+-- named caches last for the session
+create function cache_named(k integer) returns text as $$
+cache = session_cache(:regress_named, Int, String; maxentries = 10)
+value = cache_get!(() -> "computed $k", cache, k)
+return "$(length(cache)) $value"
+$$ language pljulia;
+
+select cache_named(1), cache_named(2), cache_named(1);
+
+-- entries written by transactions that abort are removed
+create function cache_value(key text, val text) returns text as $$
+return cache_get!(() -> val, key)
+$$ language pljulia;
+
+begin;
+select cache_value('regress_a', 'first');
+rollback;
+select cache_value('regress_a', 'second');
+begin;
+select cache_value('regress_a', 'third');
+savepoint s;
+select cache_value('regress_b', 'first');
+rollback to savepoint s;
+select cache_value('regress_b', 'second');
+commit;
+select cache_value('regress_a', 'fourth'), cache_value('regress_b', 'third');
+
+drop function cached_square;
+drop function cache_lru;
+drop function cache_bytes;
+drop function cache_ttl;
+drop function cache_named;
+drop function cache_value;
@@ -0,0 +1,56 @@
+-- arrays mapped from files shared by all backends
+select pljulia_publish_array('regress_matrix',
+                             array[[1.5, 2.5, 3.5], [4.5, 5.5, 6.5]]::float8[]);
+
+create function shared_info(name text) returns text as $$
+A = shared_array(name)
+return "$(eltype(A)) $(size(A)) $(A[1, end]) $(A[end, 1]) $(sum(A))"
+$$ language pljulia;
+
+select shared_info('regress_matrix');
+
+-- the mapping is reused until the array is published again
+create function shared_same(name text) returns boolean as $$
+return shared_array(name) === shared_array(name)
+$$ language pljulia;
+
+select shared_same('regress_matrix');
+
+select pljulia_publish_array('regress_matrix', array[1, 2, 3, 4]);
+select shared_info('regress_matrix');
+
+-- publishing from Julia
+create function shared_publish(name text, n integer) returns void as $$
+publish_array(name, [Int16(i * j) for i in 1:n, j in 1:2n])
+return nothing
+$$ language pljulia;
+
+select shared_publish('regress_table', 3);
+select shared_info('regress_table');
+
+-- errors
+create function shared_write(name text) returns void as $$
+shared_array(name)[1] = 0
+return nothing
+$$ language pljulia;
+
+select shared_write('regress_table');
+select shared_info('regress_nope');
+select pljulia_publish_array('../regress', array[1]);
+select pljulia_publish_array('regress_text', array['a', 'b']);
+select pljulia_publish_array('regress_null', array[1, null]);
+
+create role regress_shared_user;
+set role regress_shared_user;
+select pljulia_publish_array('regress_matrix', array[1]);
+reset role;
+drop role regress_shared_user;
+
+select pljulia_unpublish_array('regress_matrix'),
+       pljulia_unpublish_array('regress_table'),
+       pljulia_unpublish_array('regress_nope');
+
+drop function shared_info;
+drop function shared_same;
+drop function shared_publish;
+drop function shared_write;
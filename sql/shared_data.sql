@@ -0,0 +1,87 @@
+-- values shared by all sessions in SD
+create function sd_put(key text, val text) returns void as $$
+SD[key] = Dict("value" => val, "length" => length(val))
+return nothing
+$$ language pljulia;
+
+create function sd_show(key text) returns text as $$
+haskey(SD, key) || return "missing"
+d = SD[key]
+return "$(d["value"]) $(d["length"])"
+$$ language pljulia;
+
+select sd_put('regress_config', 'hello');
+select sd_show('regress_config');
+
+-- other sessions see them
+\c
+select sd_show('regress_config');
+
+-- arrays of booleans, integers and floats are stored as their elements
+create function sd_array() returns text as $$
+SD["regress_matrix"] = [Float32(i + j) for i in 1:2, j in 1:3]
+A = SD["regress_matrix"]
+return "$(typeof(A)) $(size(A)) $(sum(A))"
+$$ language pljulia;
+
+select sd_array();
+
+-- get! keeps the value stored first
+create function sd_compute(key text, val integer) returns integer as $$
+return get!(() -> val, SD, key)
+$$ language pljulia;
+
+select sd_compute('regress_once', 1), sd_compute('regress_once', 2);
+
+-- compare-and-swap on versions
+create function sd_counter() returns text as $$
+delete!(SD, "regress_counter")
+first = sd_cas("regress_counter", 0, 1)
+stale = sd_cas("regress_counter", 0, 10)
+value, version = sd_get("regress_counter")
+updated = sd_cas("regress_counter", version, value + 1)
+stale2 = sd_cas("regress_counter", first, 100)
+return "$(stale === nothing) $(updated !== nothing) $(stale2 === nothing) $(SD["regress_counter"])"
+$$ language pljulia;
+
+select sd_counter();
+
+select entries >= 4 as has_entries, size_bytes > 0 as has_size, max_size_bytes
+from pljulia_shared_data_info();
+
+-- errors
+create function sd_value(key text) returns text as $$
+return string(SD[key])
+$$ language pljulia;
+
+select sd_value('regress_missing');
+select sd_value(repeat('k', 128));
+
+create function sd_put_bytes(key text, n integer) returns void as $$
+SD[key] = zeros(UInt8, n)
+return nothing
+$$ language pljulia;
+
+-- the size is set for the whole server, and bounds each value
+set pljulia.shared_data_size = 64;
+select sd_put_bytes('regress_big', 64 * 1024 * 1024);
+
+create function sd_delete(key text) returns boolean as $$
+found = haskey(SD, key)
+delete!(SD, key)
+return found
+$$ language pljulia;
+
+select sd_delete('regress_config'), sd_delete('regress_matrix'),
+       sd_delete('regress_once'), sd_delete('regress_counter'),
+       sd_delete('regress_big');
+select sd_show('regress_config');
+
+drop function sd_put;
+drop function sd_show;
+drop function sd_array;
+drop function sd_compute;
+drop function sd_counter;
+drop function sd_value;
+drop function sd_put_bytes;
+drop function sd_delete;
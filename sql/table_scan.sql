@@ -0,0 +1,88 @@
+-- reading tables directly, in column batches
+create table scan_table(id integer, name text, score double precision,
+                        amount numeric);
+insert into scan_table
+select i, 'n' || i, i / 2.0, i * 1.5 from generate_series(1, 2500) i;
+update scan_table set name = null where id = 3;
+
+create function scan_batches() returns text as $$
+nbatches = nrows = total = nulls = 0
+for b in table_scan("scan_table"; columns = ["id", "name"], batch = 1000)
+    nbatches += 1
+    nrows += length(b.id)
+    total += sum(b.id)
+    nulls += count(isnothing, b.name)
+end
+return "$nbatches $nrows $total $nulls"
+$$ language pljulia;
+
+select scan_batches();
+
+-- column types, and a scan left open until the end of the transaction
+create function scan_types() returns text as $$
+b = first(table_scan("scan_table"; batch = 10))
+return "$(keys(b)) $(length(b.id)) $(eltype(b.id)) $(eltype(b.score)) $(eltype(b.amount))"
+$$ language pljulia;
+
+select scan_types();
+
+-- closing a scan
+create function scan_close() returns text as $$
+scan = table_scan("public.scan_table"; columns = ["score"], batch = 100)
+b = first(scan)
+close(scan)
+return "$(length(b.score)) $(iterate(scan) === nothing)"
+$$ language pljulia;
+
+select scan_close();
+
+-- a scan can't be used after its transaction
+create function scan_save() returns void as $$
+GD["scan"] = table_scan("scan_table")
+return nothing
+$$ language pljulia;
+
+create function scan_saved() returns integer as $$
+return length(first(GD["scan"]).id)
+$$ language pljulia;
+
+select scan_save();
+select scan_saved();
+
+-- errors
+create view scan_view as select * from scan_table;
+
+create function scan_error(rel text, cols text) returns integer as $$
+for b in table_scan(rel; columns = split(cols, ",", keepempty = false))
+end
+return 0
+$$ language pljulia;
+
+select scan_error('scan_view', '');
+select scan_error('scan_table', 'nope');
+
+alter table scan_table enable row level security;
+create role regress_scan_user;
+grant select on scan_table to regress_scan_user;
+set role regress_scan_user;
+select scan_error('scan_table', 'id');
+reset role;
+alter table scan_table disable row level security;
+
+revoke select on scan_table from regress_scan_user;
+grant select (id) on scan_table to regress_scan_user;
+set role regress_scan_user;
+select scan_error('scan_table', 'id');
+select scan_error('scan_table', 'id,name');
+reset role;
+revoke all on scan_table from regress_scan_user;
+drop role regress_scan_user;
+
+drop function scan_batches;
+drop function scan_types;
+drop function scan_close;
+drop function scan_save;
+drop function scan_saved;
+drop function scan_error;
+drop view scan_view;
+drop table scan_table;